@@ -0,0 +1,332 @@
+// Iluminação "clustered forward" para muitas luzes pontuais e spots.
+//
+// O frustum de visualização é dividido em CLUSTER_GRID_X x CLUSTER_GRID_Y
+// ladrilhos na tela e CLUSTER_GRID_Z fatias de profundidade (espaçadas
+// exponencialmente entre os planos near e far), formando "clusters". A cada
+// quadro, ClusteredLighting_Update() testa a esfera de alcance de cada luz
+// contra as AABBs (em coordenadas da câmera) dos clusters das fatias que a
+// luz alcança, quatro clusters por vez com SSE2, e monta para cada cluster
+// a lista das luzes que o atingem, com no máximo CLUSTER_MAX_LIGHTS luzes.
+//
+// Os dados são enviados em três "buffer textures", lidas pelo fragment
+// shader (veja "shader_fragment.glsl"):
+//
+//     cluster_grid_lights    (GL_RG32UI)  início e número de luzes de cada cluster
+//     cluster_light_indices  (GL_R32UI)   índices das luzes, cluster após cluster
+//     cluster_lights         (GL_RGBA32F) 3 texels por luz: posição global e raio,
+//                                         cor e cosseno do cone, direção do spot
+//
+// O fragment shader encontra seu cluster a partir de gl_FragCoord e da
+// profundidade, e percorre somente as luzes desse cluster; o custo por
+// fragmento é limitado por CLUSTER_MAX_LIGHTS, qualquer que seja o número
+// de luzes da cena. Os parâmetros da grade vão para o bloco FrameConstants.
+#include <cmath>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+#include <glad/glad.h>
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <glm/matrix.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define CLUSTERED_LIGHTING_SSE2 1
+#endif
+
+#define CLUSTER_GRID_X     16
+#define CLUSTER_GRID_Y     9
+#define CLUSTER_GRID_Z     24
+#define CLUSTER_COUNT      (CLUSTER_GRID_X * CLUSTER_GRID_Y * CLUSTER_GRID_Z)
+#define CLUSTER_SLICE_SIZE (CLUSTER_GRID_X * CLUSTER_GRID_Y) // Múltiplo de 4 (SSE2)
+#define CLUSTER_MAX_LIGHTS 32 // Por cluster
+
+// Unidades de textura das três "buffer textures"
+#define CLUSTER_GRID_TEXTURE_UNIT    8
+#define CLUSTER_INDEX_TEXTURE_UNIT   9
+#define CLUSTER_LIGHTS_TEXTURE_UNIT  10
+
+struct PointLight
+{
+    glm::vec3 position;   // Coordenadas globais
+    float     radius;     // Alcance; a contribuição chega a zero neste raio
+    glm::vec3 color;
+    float     spot_cos;   // Cosseno do meio ângulo do cone; -1 para luzes pontuais
+    glm::vec3 direction;  // Direção do spot (normalizada)
+};
+
+struct ClusteredLighting
+{
+    std::vector<PointLight> lights;
+
+    // AABBs dos clusters em coordenadas da câmera, em estrutura de vetores
+    // (SoA) para o teste com SSE2. Recalculadas quando a projeção muda.
+    std::vector<float> min_x, min_y, min_z, max_x, max_y, max_z;
+    glm::mat4 projection = glm::mat4(0.0f);
+    float     slice_depth[CLUSTER_GRID_Z + 1]; // Profundidade (positiva) das bordas das fatias
+    float     near_depth = 0.1f;
+    float     log_scale = 1.0f;                // CLUSTER_GRID_Z / log(far/near)
+
+    // Listas de luzes por cluster, montadas a cada quadro
+    std::vector<uint32_t> counts;        // CLUSTER_COUNT
+    std::vector<uint32_t> cluster_lights; // CLUSTER_COUNT * CLUSTER_MAX_LIGHTS
+    std::vector<uint32_t> grid;          // (início, número) por cluster
+    std::vector<uint32_t> indices;
+    std::vector<glm::vec4> light_texels;
+
+    GLuint buffers[3] = { 0, 0, 0 };  // grade, índices, luzes
+    GLuint textures[3] = { 0, 0, 0 };
+
+    // Estatísticas do último quadro
+    int    visible_lights = 0;
+    int    max_cluster_lights = 0;
+    int    overflows = 0;      // Luzes descartadas por clusters cheios
+    double assign_ms = 0.0;
+};
+
+ClusteredLighting g_ClusteredLighting;
+
+// Cria os buffers e as "buffer textures". Deve ser chamada após a criação
+// do contexto OpenGL.
+void ClusteredLighting_Init()
+{
+    ClusteredLighting& cl = g_ClusteredLighting;
+    if ( cl.buffers[0] != 0 )
+        return;
+
+    const GLenum formats[3] = { GL_RG32UI, GL_R32UI, GL_RGBA32F };
+    glGenBuffers(3, cl.buffers);
+    glGenTextures(3, cl.textures);
+    for (int i = 0; i < 3; ++i)
+    {
+        glBindBuffer(GL_TEXTURE_BUFFER, cl.buffers[i]);
+        glBufferData(GL_TEXTURE_BUFFER, 16, NULL, GL_STREAM_DRAW);
+        glBindTexture(GL_TEXTURE_BUFFER, cl.textures[i]);
+        glTexBuffer(GL_TEXTURE_BUFFER, formats[i], cl.buffers[i]);
+    }
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    cl.counts.resize(CLUSTER_COUNT);
+    cl.cluster_lights.resize(CLUSTER_COUNT * CLUSTER_MAX_LIGHTS);
+    cl.grid.resize(2 * CLUSTER_COUNT);
+}
+
+// Define as luzes da cena.
+void ClusteredLighting_SetLights(const std::vector<SceneLight>& scene_lights)
+{
+    ClusteredLighting& cl = g_ClusteredLighting;
+    cl.lights.clear();
+    for (size_t i = 0; i < scene_lights.size(); ++i)
+    {
+        const SceneLight& s = scene_lights[i];
+        PointLight light;
+        light.position = s.position;
+        light.radius = s.radius;
+        light.color = s.color;
+        light.spot_cos = (s.spot_angle > 0.0f) ? cosf(s.spot_angle * 3.14159265f / 180.0f) : -1.0f;
+        float length = sqrtf(s.direction.x*s.direction.x + s.direction.y*s.direction.y + s.direction.z*s.direction.z);
+        light.direction = (length > 0.0f) ? s.direction / length : glm::vec3(0.0f, -1.0f, 0.0f);
+        cl.lights.push_back(light);
+    }
+}
+
+// Recalcula as AABBs dos clusters para a matriz de projeção dada.
+static void ClusteredLighting_BuildClusters(const glm::mat4& projection)
+{
+    ClusteredLighting& cl = g_ClusteredLighting;
+    cl.projection = projection;
+
+    // Pontos dos planos near e far, em coordenadas da câmera, que se
+    // projetam em (x,y) em NDC. Funciona para projeções perspectivas
+    // e ortográficas.
+    glm::mat4 inverse_projection = glm::inverse(projection);
+    struct Ray { glm::vec3 near_point, far_point; };
+    Ray rays[CLUSTER_GRID_Y + 1][CLUSTER_GRID_X + 1];
+    for (int j = 0; j <= CLUSTER_GRID_Y; ++j)
+    for (int i = 0; i <= CLUSTER_GRID_X; ++i)
+    {
+        float x = -1.0f + 2.0f * i / CLUSTER_GRID_X;
+        float y = -1.0f + 2.0f * j / CLUSTER_GRID_Y;
+        glm::vec4 n = inverse_projection * glm::vec4(x, y, -1.0f, 1.0f);
+        glm::vec4 f = inverse_projection * glm::vec4(x, y,  1.0f, 1.0f);
+        rays[j][i].near_point = glm::vec3(n) / n.w;
+        rays[j][i].far_point  = glm::vec3(f) / f.w;
+    }
+
+    float near_depth = -rays[0][0].near_point.z;
+    float far_depth  = -rays[0][0].far_point.z;
+    cl.near_depth = near_depth;
+    cl.log_scale = CLUSTER_GRID_Z / logf(far_depth / near_depth);
+    for (int k = 0; k <= CLUSTER_GRID_Z; ++k)
+        cl.slice_depth[k] = near_depth * powf(far_depth / near_depth, (float)k / CLUSTER_GRID_Z);
+
+    cl.min_x.resize(CLUSTER_COUNT); cl.min_y.resize(CLUSTER_COUNT); cl.min_z.resize(CLUSTER_COUNT);
+    cl.max_x.resize(CLUSTER_COUNT); cl.max_y.resize(CLUSTER_COUNT); cl.max_z.resize(CLUSTER_COUNT);
+
+    for (int k = 0; k < CLUSTER_GRID_Z; ++k)
+    for (int j = 0; j < CLUSTER_GRID_Y; ++j)
+    for (int i = 0; i < CLUSTER_GRID_X; ++i)
+    {
+        glm::vec3 bmin = glm::vec3( 1e30f);
+        glm::vec3 bmax = glm::vec3(-1e30f);
+        for (int corner = 0; corner < 4; ++corner)
+        {
+            const Ray& ray = rays[j + corner / 2][i + corner % 2];
+            for (int side = 0; side < 2; ++side)
+            {
+                // Ponto do raio na profundidade da borda da fatia
+                float depth = cl.slice_depth[k + side];
+                float t = (depth - near_depth) / (far_depth - near_depth);
+                glm::vec3 p = ray.near_point + t * (ray.far_point - ray.near_point);
+                bmin = glm::min(bmin, p);
+                bmax = glm::max(bmax, p);
+            }
+        }
+
+        int c = (k * CLUSTER_GRID_Y + j) * CLUSTER_GRID_X + i;
+        cl.min_x[c] = bmin.x; cl.min_y[c] = bmin.y; cl.min_z[c] = bmin.z;
+        cl.max_x[c] = bmax.x; cl.max_y[c] = bmax.y; cl.max_z[c] = bmax.z;
+    }
+}
+
+// Adiciona a luz "light_index" aos clusters [first, first+count) cuja AABB
+// intercepta a esfera de centro "c" e raio "r" (coordenadas da câmera).
+static void ClusteredLighting_AssignSlice(int first, int count, const glm::vec3& c, float r, uint32_t light_index)
+{
+    ClusteredLighting& cl = g_ClusteredLighting;
+
+#ifdef CLUSTERED_LIGHTING_SSE2
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 cx = _mm_set1_ps(c.x), cy = _mm_set1_ps(c.y), cz = _mm_set1_ps(c.z);
+    const __m128 r2 = _mm_set1_ps(r * r);
+
+    for (int base = first; base < first + count; base += 4)
+    {
+        // Distância ao quadrado entre o centro e a AABB, por eixo:
+        // max(0, min - c) + max(0, c - max)
+        __m128 dx = _mm_add_ps(_mm_max_ps(zero, _mm_sub_ps(_mm_loadu_ps(&cl.min_x[base]), cx)),
+                               _mm_max_ps(zero, _mm_sub_ps(cx, _mm_loadu_ps(&cl.max_x[base]))));
+        __m128 dy = _mm_add_ps(_mm_max_ps(zero, _mm_sub_ps(_mm_loadu_ps(&cl.min_y[base]), cy)),
+                               _mm_max_ps(zero, _mm_sub_ps(cy, _mm_loadu_ps(&cl.max_y[base]))));
+        __m128 dz = _mm_add_ps(_mm_max_ps(zero, _mm_sub_ps(_mm_loadu_ps(&cl.min_z[base]), cz)),
+                               _mm_max_ps(zero, _mm_sub_ps(cz, _mm_loadu_ps(&cl.max_z[base]))));
+        __m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+
+        int mask = _mm_movemask_ps(_mm_cmple_ps(d2, r2));
+        while ( mask != 0 )
+        {
+            int lane = 0;
+            while ( !(mask & (1 << lane)) )
+                ++lane;
+            mask &= ~(1 << lane);
+
+            int cluster = base + lane;
+            if ( cl.counts[cluster] < CLUSTER_MAX_LIGHTS )
+                cl.cluster_lights[cluster * CLUSTER_MAX_LIGHTS + cl.counts[cluster]++] = light_index;
+            else
+                cl.overflows += 1;
+        }
+    }
+#else
+    for (int cluster = first; cluster < first + count; ++cluster)
+    {
+        float dx = std::max(0.0f, cl.min_x[cluster] - c.x) + std::max(0.0f, c.x - cl.max_x[cluster]);
+        float dy = std::max(0.0f, cl.min_y[cluster] - c.y) + std::max(0.0f, c.y - cl.max_y[cluster]);
+        float dz = std::max(0.0f, cl.min_z[cluster] - c.z) + std::max(0.0f, c.z - cl.max_z[cluster]);
+        if ( dx*dx + dy*dy + dz*dz > r*r )
+            continue;
+
+        if ( cl.counts[cluster] < CLUSTER_MAX_LIGHTS )
+            cl.cluster_lights[cluster * CLUSTER_MAX_LIGHTS + cl.counts[cluster]++] = light_index;
+        else
+            cl.overflows += 1;
+    }
+#endif
+}
+
+// Distribui as luzes nos clusters para a câmera atual, envia os resultados
+// para a GPU e preenche os parâmetros da grade em "constants".
+void ClusteredLighting_Update(const glm::mat4& view, const glm::mat4& projection, int viewport_width, int viewport_height, FrameConstants& constants)
+{
+    ClusteredLighting& cl = g_ClusteredLighting;
+    double start = Headless_GetWallTime();
+
+    if ( projection != cl.projection )
+        ClusteredLighting_BuildClusters(projection);
+
+    std::fill(cl.counts.begin(), cl.counts.end(), 0u);
+    cl.visible_lights = 0;
+    cl.overflows = 0;
+
+    for (size_t l = 0; l < cl.lights.size(); ++l)
+    {
+        const PointLight& light = cl.lights[l];
+        glm::vec3 c = glm::vec3(view * glm::vec4(light.position, 1.0f));
+        float r = light.radius;
+
+        // Fatias de profundidade alcançadas pela esfera da luz
+        float depth_min = -c.z - r;
+        float depth_max = -c.z + r;
+        if ( depth_max < cl.slice_depth[0] || depth_min > cl.slice_depth[CLUSTER_GRID_Z] )
+            continue;
+
+        int k0 = (depth_min <= cl.near_depth) ? 0 : (int)(logf(depth_min / cl.near_depth) * cl.log_scale);
+        int k1 = (int)(logf(std::max(depth_max, cl.near_depth) / cl.near_depth) * cl.log_scale);
+        k0 = std::max(0, std::min(k0, CLUSTER_GRID_Z - 1));
+        k1 = std::max(0, std::min(k1, CLUSTER_GRID_Z - 1));
+
+        cl.visible_lights += 1;
+        for (int k = k0; k <= k1; ++k)
+            ClusteredLighting_AssignSlice(k * CLUSTER_SLICE_SIZE, CLUSTER_SLICE_SIZE, c, r, (uint32_t)l);
+    }
+
+    // Compactamos as listas: (início, número) por cluster e os índices em sequência.
+    cl.indices.clear();
+    cl.max_cluster_lights = 0;
+    for (int cluster = 0; cluster < CLUSTER_COUNT; ++cluster)
+    {
+        uint32_t n = cl.counts[cluster];
+        cl.grid[2*cluster + 0] = (uint32_t)cl.indices.size();
+        cl.grid[2*cluster + 1] = n;
+        cl.indices.insert(cl.indices.end(), &cl.cluster_lights[cluster * CLUSTER_MAX_LIGHTS], &cl.cluster_lights[cluster * CLUSTER_MAX_LIGHTS] + n);
+        cl.max_cluster_lights = std::max(cl.max_cluster_lights, (int)n);
+    }
+    if ( cl.indices.empty() )
+        cl.indices.push_back(0); // Buffers vazios não podem ser ligados a texturas
+
+    cl.light_texels.resize(3 * std::max<size_t>(cl.lights.size(), 1));
+    for (size_t l = 0; l < cl.lights.size(); ++l)
+    {
+        const PointLight& light = cl.lights[l];
+        cl.light_texels[3*l + 0] = glm::vec4(light.position, light.radius);
+        cl.light_texels[3*l + 1] = glm::vec4(light.color, light.spot_cos);
+        cl.light_texels[3*l + 2] = glm::vec4(light.direction, 0.0f);
+    }
+
+    // Envio com "orphaning": a GPU pode ainda estar lendo os dados do quadro anterior.
+    const void* data[3] = { cl.grid.data(), cl.indices.data(), cl.light_texels.data() };
+    const size_t sizes[3] = { cl.grid.size() * sizeof(uint32_t), cl.indices.size() * sizeof(uint32_t), cl.light_texels.size() * sizeof(glm::vec4) };
+    for (int i = 0; i < 3; ++i)
+    {
+        glBindBuffer(GL_TEXTURE_BUFFER, cl.buffers[i]);
+        glBufferData(GL_TEXTURE_BUFFER, sizes[i], data[i], GL_STREAM_DRAW);
+    }
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    const GLuint units[3] = { CLUSTER_GRID_TEXTURE_UNIT, CLUSTER_INDEX_TEXTURE_UNIT, CLUSTER_LIGHTS_TEXTURE_UNIT };
+    for (int i = 0; i < 3; ++i)
+    {
+        glActiveTexture(GL_TEXTURE0 + units[i]);
+        glBindTexture(GL_TEXTURE_BUFFER, cl.textures[i]);
+    }
+    glActiveTexture(GL_TEXTURE0);
+
+    constants.cluster_grid = glm::vec4(CLUSTER_GRID_X, CLUSTER_GRID_Y, CLUSTER_GRID_Z, 0.0f);
+    constants.cluster_depth = glm::vec4(cl.near_depth, cl.log_scale, (float)viewport_width, (float)viewport_height);
+
+    cl.assign_ms = (Headless_GetWallTime() - start) * 1000.0;
+}
@@ -560,4 +560,72 @@ glm::vec3 resolve_collision_ray_obb(
 
 bool colision_with_void(float min_y){
     return min_y <= -60.0f;
-}
\ No newline at end of file
+}
+
+// Transforma uma AABB definida em coordenadas locais do modelo para uma AABB
+// em coordenadas globais. Transformamos os 8 vértices da caixa pela matriz de
+// modelagem e tomamos o mínimo/máximo em cada eixo, o que resulta em uma caixa
+// conservadora (sempre contém o objeto, mesmo após rotações).
+void transform_aabb(const glm::mat4& model,
+                    const glm::vec3& local_min, const glm::vec3& local_max,
+                    glm::vec3& world_min, glm::vec3& world_max)
+{
+    world_min = glm::vec3( std::numeric_limits<float>::max());
+    world_max = glm::vec3(-std::numeric_limits<float>::max());
+
+    for (int i = 0; i < 8; ++i)
+    {
+        glm::vec4 corner = glm::vec4((i & 1) ? local_max.x : local_min.x,
+                                     (i & 2) ? local_max.y : local_min.y,
+                                     (i & 4) ? local_max.z : local_min.z,
+                                     1.0f);
+        glm::vec3 p = glm::vec3(model * corner);
+        world_min = glm::min(world_min, p);
+        world_max = glm::max(world_max, p);
+    }
+}
+
+// Teste ponto-AABB: verdadeiro se o ponto está dentro da caixa expandida por "margin".
+bool colision_point_aabb(const glm::vec3& point, const glm::vec3& aabb_min, const glm::vec3& aabb_max, float margin = 0.0f)
+{
+    return point.x >= aabb_min.x - margin && point.x <= aabb_max.x + margin
+        && point.y >= aabb_min.y - margin && point.y <= aabb_max.y + margin
+        && point.z >= aabb_min.z - margin && point.z <= aabb_max.z + margin;
+}
+
+// Extrai os 6 planos do frustum de visualização da matriz projection*view.
+// Cada plano é (a, b, c, d), com a*x + b*y + c*z + d >= 0 do lado de dentro.
+// As linhas da matriz são combinadas como em Gribb e Hartmann, "Fast
+// Extraction of Viewing Frustum Planes from the World-View-Projection Matrix".
+void extract_frustum_planes(const glm::mat4& view_projection, glm::vec4 planes[6])
+{
+    glm::vec4 row0 = glm::vec4(view_projection[0][0], view_projection[1][0], view_projection[2][0], view_projection[3][0]);
+    glm::vec4 row1 = glm::vec4(view_projection[0][1], view_projection[1][1], view_projection[2][1], view_projection[3][1]);
+    glm::vec4 row2 = glm::vec4(view_projection[0][2], view_projection[1][2], view_projection[2][2], view_projection[3][2]);
+    glm::vec4 row3 = glm::vec4(view_projection[0][3], view_projection[1][3], view_projection[2][3], view_projection[3][3]);
+
+    planes[0] = row3 + row0; // esquerda
+    planes[1] = row3 - row0; // direita
+    planes[2] = row3 + row1; // baixo
+    planes[3] = row3 - row1; // cima
+    planes[4] = row3 + row2; // near
+    planes[5] = row3 - row2; // far
+}
+
+// Teste AABB-frustum: falso somente se a caixa está inteiramente do lado de
+// fora de algum plano. Para cada plano testamos o vértice da caixa mais
+// "para dentro" (na direção da normal); o teste é conservador, podendo
+// aceitar caixas fora do frustum perto dos cantos.
+bool colision_aabb_frustum(const glm::vec3& aabb_min, const glm::vec3& aabb_max, const glm::vec4 planes[6])
+{
+    for (int i = 0; i < 6; ++i)
+    {
+        const glm::vec4& plane = planes[i];
+        glm::vec3 p = glm::vec3(plane.x >= 0.0f ? aabb_max.x : aabb_min.x,
+                                plane.y >= 0.0f ? aabb_max.y : aabb_min.y,
+                                plane.z >= 0.0f ? aabb_max.z : aabb_min.z);
+        if ( plane.x*p.x + plane.y*p.y + plane.z*p.z + plane.w < 0.0f )
+            return false;
+    }
+    return true;
+}
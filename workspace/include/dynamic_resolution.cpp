@@ -0,0 +1,172 @@
+// Resolução dinâmica: a cena 3D é renderizada em um framebuffer (FBO)
+// próprio, em uma fração da resolução da janela escolhida a cada quadro
+// para manter o tempo de GPU do quadro dentro de um orçamento.
+//
+// O FBO é alocado no tamanho da janela; quadros com escala menor usam
+// somente o canto inferior esquerdo (glViewport()), de modo que mudar a
+// escala não realoca nada. Ao final da cena, DynamicResolution_End() amplia
+// essa região para o framebuffer de destino (a janela, ou o FBO do modo
+// headless) com glBlitFramebuffer() e filtragem linear; o texto na tela é
+// desenhado depois, na resolução da janela.
+//
+// A escala é ajustada com o tempo total de GPU medido por "gpu_timers.cpp",
+// que chega alguns quadros atrasado. Para não oscilar, cada medida só é
+// utilizada se o quadro medido já foi renderizado com a escala atual. O
+// tempo dos fragmentos é aproximadamente proporcional à área, isto é, ao
+// quadrado da escala; o ajuste é amortecido e há uma folga antes de
+// aumentar a resolução.
+#include <cmath>
+#include <algorithm>
+
+#include <glad/glad.h>
+
+#define DYNAMIC_RESOLUTION_HEADROOM 0.85 // Aumenta a escala somente abaixo desta fração do orçamento
+#define DYNAMIC_RESOLUTION_DAMPING  0.5  // Fração do ajuste estimado aplicada por medida
+
+struct DynamicResolution
+{
+    bool   enabled = false;
+    double budget_ms = 16.6;   // Tempo de GPU alvo por quadro
+    float  min_scale = 0.5f;   // Menor escala (em cada eixo)
+    float  scale = 1.0f;       // Escala atual (em cada eixo)
+
+    GLuint framebuffer = 0;
+    GLuint color_renderbuffer = 0;
+    GLuint depth_renderbuffer = 0;
+    int    allocated_width = 0;
+    int    allocated_height = 0;
+
+    GLint  target_framebuffer = 0; // Framebuffer de destino, salvo em DynamicResolution_Begin()
+    int    target_width = 0;
+    int    target_height = 0;
+    int    render_width = 0;
+    int    render_height = 0;
+    bool   active = false;     // A cena do quadro atual está sendo desenhada no FBO
+
+    // Quadros numerados como em GpuTimers::frame
+    unsigned int scale_frame = 0;    // Primeiro quadro com a escala atual
+    int          measured_frame = -1; // Quadro da última medida utilizada
+    double       measured_ms = 0.0;
+};
+
+DynamicResolution g_DynamicResolution;
+
+// (Re)cria os renderbuffers do FBO no tamanho do framebuffer de destino.
+static bool DynamicResolution_Allocate(int width, int height)
+{
+    DynamicResolution& resolution = g_DynamicResolution;
+
+    if ( resolution.framebuffer == 0 )
+    {
+        glGenFramebuffers(1, &resolution.framebuffer);
+        glGenRenderbuffers(1, &resolution.color_renderbuffer);
+        glGenRenderbuffers(1, &resolution.depth_renderbuffer);
+    }
+
+    glBindRenderbuffer(GL_RENDERBUFFER, resolution.color_renderbuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, resolution.depth_renderbuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, resolution.framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, resolution.color_renderbuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, resolution.depth_renderbuffer);
+    bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    glBindFramebuffer(GL_FRAMEBUFFER, resolution.target_framebuffer);
+
+    if ( !complete )
+    {
+        fprintf(stderr, "ERROR: dynamic resolution framebuffer is incomplete, disabled.\n");
+        resolution.enabled = false;
+        return false;
+    }
+
+    resolution.allocated_width = width;
+    resolution.allocated_height = height;
+    return true;
+}
+
+// Ajusta a escala com a última medida de tempo de GPU, se ela é de um
+// quadro renderizado com a escala atual.
+static void DynamicResolution_UpdateScale()
+{
+    DynamicResolution& resolution = g_DynamicResolution;
+    const GpuTimers& timers = g_GpuTimers;
+
+    if ( !timers.enabled || timers.last_frame == resolution.measured_frame )
+        return;
+    if ( timers.last_frame < 0 || (unsigned int)timers.last_frame < resolution.scale_frame || timers.last_total_ms <= 0.0 )
+        return;
+    resolution.measured_frame = timers.last_frame;
+    resolution.measured_ms = timers.last_total_ms;
+
+    double ratio = resolution.budget_ms / timers.last_total_ms;
+    if ( ratio >= 1.0 && ratio * DYNAMIC_RESOLUTION_HEADROOM < 1.0 )
+        return; // Dentro do orçamento, sem folga suficiente para aumentar
+
+    float target = resolution.scale * (float)std::sqrt(ratio);
+    float scale = resolution.scale + (float)DYNAMIC_RESOLUTION_DAMPING * (target - resolution.scale);
+    scale = std::min(1.0f, std::max(resolution.min_scale, scale));
+    if ( std::fabs(scale - resolution.scale) < 0.01f )
+        return;
+
+    resolution.scale = scale;
+    resolution.scale_frame = timers.frame;
+}
+
+// Inicia a cena do quadro: com a resolução dinâmica ligada, liga o FBO e
+// define o viewport do tamanho reduzido. Deve ser chamada antes de
+// glClear(). Sem a resolução dinâmica, a cena é desenhada diretamente no
+// framebuffer de destino.
+void DynamicResolution_Begin(GLFWwindow* window)
+{
+    DynamicResolution& resolution = g_DynamicResolution;
+
+    Headless_GetFramebufferSize(window, &resolution.target_width, &resolution.target_height);
+    resolution.render_width = resolution.target_width;
+    resolution.render_height = resolution.target_height;
+    resolution.active = false;
+
+    if ( !resolution.enabled || resolution.target_width <= 0 || resolution.target_height <= 0 )
+        return;
+
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &resolution.target_framebuffer);
+    if ( resolution.allocated_width != resolution.target_width || resolution.allocated_height != resolution.target_height )
+        if ( !DynamicResolution_Allocate(resolution.target_width, resolution.target_height) )
+            return;
+
+    DynamicResolution_UpdateScale();
+
+    resolution.render_width = std::max(1, (int)(resolution.target_width * resolution.scale + 0.5f));
+    resolution.render_height = std::max(1, (int)(resolution.target_height * resolution.scale + 0.5f));
+    resolution.active = true;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, resolution.framebuffer);
+    glViewport(0, 0, resolution.render_width, resolution.render_height);
+}
+
+// Tamanho, em pixels, em que a cena do quadro atual é renderizada.
+void DynamicResolution_GetRenderSize(int* width, int* height)
+{
+    *width = g_DynamicResolution.render_width;
+    *height = g_DynamicResolution.render_height;
+}
+
+// Termina a cena do quadro: amplia a imagem para o framebuffer de destino,
+// que volta a ser o framebuffer atual, com o viewport da janela inteira.
+void DynamicResolution_End()
+{
+    DynamicResolution& resolution = g_DynamicResolution;
+    if ( !resolution.active )
+        return;
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, resolution.framebuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, resolution.target_framebuffer);
+    glBlitFramebuffer(0, 0, resolution.render_width, resolution.render_height,
+                      0, 0, resolution.target_width, resolution.target_height,
+                      GL_COLOR_BUFFER_BIT, GL_LINEAR);
+    glBindFramebuffer(GL_FRAMEBUFFER, resolution.target_framebuffer);
+    glViewport(0, 0, resolution.target_width, resolution.target_height);
+    resolution.active = false;
+}
@@ -0,0 +1,91 @@
+// Constantes por quadro compartilhadas por todos os programas de GPU.
+//
+// Em vez de cada programa receber "view", "projection", etc. por meio de
+// glUniform*() a cada quadro, os shaders declaram o bloco uniforme
+// "FrameConstants" (layout std140), ligado ao ponto de ligação fixo
+// FRAME_CONSTANTS_BINDING. O bloco é atualizado uma única vez por quadro por
+// FrameConstants_Update(), de modo que adicionar novos programas não aumenta
+// o número de envios por quadro.
+//
+// Cada atualização é escrita em uma nova alocação do buffer de streaming
+// (veja "stream_buffer.cpp"), que garante que a GPU não está mais lendo a
+// memória reutilizada; o bloco é então ligado a essa faixa com
+// glBindBufferRange(). Se o buffer de streaming não tem espaço, o bloco é
+// escrito em um buffer próprio, descartado a cada envio.
+#include <glad/glad.h>
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec4.hpp>
+
+#define FRAME_CONSTANTS_BINDING 0
+
+// Número de cascatas dos mapas de sombra (veja "shadow_maps.cpp"). Os
+// shaders declaram o mesmo número de matrizes no bloco "FrameConstants".
+#define SHADOW_CASCADE_COUNT 3
+
+// Layout std140 do bloco "FrameConstants" declarado nos shaders. Matrizes e
+// vec4 já estão alinhados em 16 bytes; "time" é seguido de preenchimento
+// para que o tamanho seja múltiplo de 16.
+struct FrameConstants
+{
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::mat4 view_projection;
+    glm::vec4 camera_position; // Coordenadas globais, w = 1
+    glm::vec4 light_direction; // Sentido da fonte de luz direcional, w = 0
+    glm::vec4 cluster_grid;    // Clusters em x, y e z (veja "clustered_lighting.cpp")
+    glm::vec4 cluster_depth;   // near, escala logarítmica das fatias, largura e altura da tela
+    glm::mat4 shadow_matrices[SHADOW_CASCADE_COUNT]; // Global -> mapa de sombra ([0,1]) de cada cascata
+    glm::vec4 shadow_splits;      // Profundidade final de cada cascata; w = 0 desliga as sombras
+    glm::vec4 shadow_texel_sizes; // Tamanho de um texel de cada cascata, em coordenadas globais
+    float     time;           // Segundos desde o início (glfwGetTime())
+    float     padding[3];
+};
+
+struct FrameConstantsBlock
+{
+    // Cópia das constantes do quadro atual, para código C++ que precisa
+    // derivar valores delas (por exemplo, a matriz model-view-projection de
+    // cada desenho em "render_queue.cpp").
+    FrameConstants current;
+
+    GLuint fallback_buffer = 0; // Usado quando o buffer de streaming está cheio
+
+    // Estatísticas
+    unsigned int uploads = 0; // Envios desde o início
+};
+
+FrameConstantsBlock g_FrameConstants;
+
+// Liga o bloco "FrameConstants" de um programa ao ponto de ligação fixo.
+// Programas que não utilizam o bloco são ignorados.
+void FrameConstants_BindProgram(GLuint program_id)
+{
+    GLuint block_index = glGetUniformBlockIndex(program_id, "FrameConstants");
+    if ( block_index != GL_INVALID_INDEX )
+        glUniformBlockBinding(program_id, block_index, FRAME_CONSTANTS_BINDING);
+}
+
+// Escreve as constantes do quadro no buffer de streaming e as liga ao ponto
+// FRAME_CONSTANTS_BINDING. Todos os desenhos emitidos até a próxima chamada
+// utilizam estes valores.
+void FrameConstants_Update(const FrameConstants& constants)
+{
+    g_FrameConstants.current = constants;
+
+    GLintptr offset = 0;
+    GLuint buffer_id = StreamBuffer_Write(&constants, sizeof(FrameConstants), g_StreamBuffer.uniform_alignment, &offset);
+    if ( buffer_id == 0 )
+    {
+        FrameConstantsBlock& block = g_FrameConstants;
+        if ( block.fallback_buffer == 0 )
+            glGenBuffers(1, &block.fallback_buffer);
+        glBindBuffer(GL_UNIFORM_BUFFER, block.fallback_buffer);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameConstants), &constants, GL_STREAM_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        buffer_id = block.fallback_buffer;
+    }
+
+    glBindBufferRange(GL_UNIFORM_BUFFER, FRAME_CONSTANTS_BINDING, buffer_id, offset, sizeof(FrameConstants));
+    g_FrameConstants.uploads += 1;
+}
@@ -0,0 +1,380 @@
+// Culling e escolha de LOD das instâncias na GPU, com transform feedback.
+//
+// Os pássaros só têm posição na GPU (veja BirdPathMatrix() em
+// "shader_vertex.glsl"), então a CPU só consegue testar o caminho inteiro
+// de cada pássaro, e todas as instâncias enviadas passam pelo vertex shader
+// de cada desenho. Aqui, as instâncias do quadro são desenhadas como
+// pontos, com GL_RASTERIZER_DISCARD, por "shader_vertex_cull.glsl": para
+// cada instância, o vertex shader calcula a posição, testa a esfera
+// envolvente contra o frustum e escolhe o LOD (malha com iluminação por
+// fragmento ou por vértice e/ou impostor, com as mesmas regras de
+// "lighting_lod.cpp" e "impostors.cpp"). O geometry shader
+// ("shader_geometry_cull.glsl") emite somente as instâncias do LOD pedido,
+// e o transform feedback as grava, no layout de InstanceData, no buffer
+// daquele LOD. Há um passo por LOD: gravar todos os LODs em um único passo
+// exigiria os múltiplos streams do OpenGL 4.0.
+//
+// O número de instâncias gravadas em cada buffer é contado por uma
+// consulta GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN. Com
+// glDrawElementsIndirect() (OpenGL 4.0) e ARB_query_buffer_object (OpenGL
+// 4.4), a própria GPU copia o resultado da consulta para o campo
+// "instance_count" do comando de desenho indireto do LOD, e a CPU nunca
+// espera nem toca em instâncias individuais. Sem eles, o resultado é lido
+// na CPU e o desenho é um glDrawElementsInstanced() comum; para não esperar
+// a GPU, os buffers de saída e as consultas formam um anel de
+// GPU_CULLING_READBACK_FRAMES quadros, e cada quadro desenha o conjunto
+// mais recente cujas consultas já terminaram (GL_QUERY_RESULT_AVAILABLE),
+// como as consultas de oclusão em "occlusion.cpp". As posições continuam
+// sendo as do quadro atual (calculadas no desenho); somente a seleção de
+// frustum e LOD pode ter um ou dois quadros de atraso.
+#include <cstdio>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <algorithm>
+
+#include <glad/glad.h>
+
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#define GPU_CULLING_VERTEX_FILE    "../../src/shader_vertex_cull.glsl"
+#define GPU_CULLING_GEOMETRY_FILE  "../../src/shader_geometry_cull.glsl"
+#define GPU_CULLING_INSTANCE_BYTES 132 // sizeof(InstanceData) em "main.cpp"
+#define GPU_CULLING_READBACK_FRAMES 3  // Conjuntos de saída no anel, sem desenho indireto
+
+// Constante de ARB_query_buffer_object, ausente no GLAD do OpenGL 3.3
+#ifndef GL_QUERY_BUFFER
+#define GL_QUERY_BUFFER         0x9192
+#endif
+
+void LoadShader(const char* filename, GLuint shader_id, const std::string& defines); // Funções definidas em main.cpp
+void SetInstanceAttributes(GLuint vertex_array_object_id, GLuint buffer_id, GLintptr offset);
+
+// LODs gravados pelo culling, um buffer de instâncias cada
+enum GpuCullingLod
+{
+    GPU_CULLING_MESH_PER_PIXEL  = 0, // Malha, iluminação por fragmento
+    GPU_CULLING_MESH_PER_VERTEX = 1, // Malha, iluminação por vértice
+    GPU_CULLING_IMPOSTOR        = 2, // Impostor (veja "impostors.cpp")
+    GPU_CULLING_LOD_COUNT
+};
+
+// Argumentos de glDrawElementsIndirect(), um comando por LOD
+struct GpuCullingDrawCommand
+{
+    GLuint count;
+    GLuint instance_count; // Escrito pela GPU, a partir da consulta
+    GLuint first_index;
+    GLuint base_vertex;
+    GLuint base_instance;  // Deve ser 0 antes do OpenGL 4.2
+};
+
+struct GpuCulling
+{
+    bool   enabled = true;    // Falso com "--no-gpu-culling"
+    bool   supported = false; // Programa de culling criado
+    bool   indirect = false;  // Contagem copiada pela GPU para os comandos indiretos
+
+    GLuint program_id = 0;
+    GLint  frustum_planes_uniform = -1;
+    GLint  sphere_uniform = -1;
+    GLint  lighting_lod_uniform = -1;
+    GLint  lod_uniform = -1;
+
+    GLuint input_vao = 0;    // Instâncias do quadro, uma por vértice (divisor 0)
+    GLuint input_buffer = 0; // Usado quando o buffer de streaming não comporta as instâncias
+    size_t input_capacity = 0;
+
+    // Conjuntos de saída: um com desenho indireto, GPU_CULLING_READBACK_FRAMES sem
+    int    sets = 1;
+    GLuint output_buffers[GPU_CULLING_READBACK_FRAMES][GPU_CULLING_LOD_COUNT] = {}; // Instâncias selecionadas de cada LOD
+    GLuint output_vaos[GPU_CULLING_READBACK_FRAMES][GPU_CULLING_LOD_COUNT] = {};    // Criados em main.cpp, com atributos em output_buffers
+    GLuint queries[GPU_CULLING_READBACK_FRAMES][GPU_CULLING_LOD_COUNT] = {};
+    bool   pending[GPU_CULLING_READBACK_FRAMES] = {}; // Conjunto gravado e ainda não lido
+    size_t output_capacity = 0;                        // Instâncias que cabem em cada buffer de saída
+    int    write_set = 0;                              // Conjunto gravado neste quadro
+    int    draw_set = 0;                               // Conjunto desenhado neste quadro
+    GLuint indirect_buffer = 0;                        // GpuCullingDrawCommand de cada LOD
+    GLuint counts[GPU_CULLING_LOD_COUNT] = {};         // Instâncias de cada LOD em draw_set, sem desenho indireto
+
+    // Estatísticas do último quadro com resultado disponível
+    int instances = 0;
+    int frame_instances = 0;
+    int selected[GPU_CULLING_LOD_COUNT] = {};
+};
+
+GpuCulling g_GpuCulling;
+
+// Cria o programa de culling e os buffers. Deve ser chamada após a criação
+// do contexto OpenGL; "bird_paths_unit" é a unidade de textura com os
+// caminhos dos pássaros.
+void GpuCulling_Init(GLint bird_paths_unit)
+{
+    GpuCulling& culling = g_GpuCulling;
+    if ( !culling.enabled || culling.program_id != 0 )
+        return;
+
+    GLuint vertex_shader_id = glCreateShader(GL_VERTEX_SHADER);
+    GLuint geometry_shader_id = glCreateShader(GL_GEOMETRY_SHADER);
+    LoadShader(GPU_CULLING_VERTEX_FILE, vertex_shader_id, "");
+    LoadShader(GPU_CULLING_GEOMETRY_FILE, geometry_shader_id, "");
+
+    // As saídas do geometry shader são gravadas intercaladas, na ordem de
+    // InstanceData; por isso os varyings são definidos antes da linkagem.
+    GLuint program_id = glCreateProgram();
+    glAttachShader(program_id, vertex_shader_id);
+    glAttachShader(program_id, geometry_shader_id);
+    const char* varyings[] = { "cull_model", "cull_params", "cull_path", "cull_normal_matrix" };
+    glTransformFeedbackVaryings(program_id, 4, varyings, GL_INTERLEAVED_ATTRIBS);
+    glLinkProgram(program_id);
+    glDeleteShader(vertex_shader_id);
+    glDeleteShader(geometry_shader_id);
+
+    GLint linked_ok = GL_FALSE;
+    glGetProgramiv(program_id, GL_LINK_STATUS, &linked_ok);
+    if ( linked_ok == GL_FALSE )
+    {
+        GLchar log[1024];
+        glGetProgramInfoLog(program_id, sizeof(log), NULL, log);
+        fprintf(stderr, "ERROR: OpenGL linking of GPU culling program failed; culling on the CPU.\n== Start of link log\n%s\n== End of link log\n", log);
+        glDeleteProgram(program_id);
+        return;
+    }
+
+    culling.program_id = program_id;
+    culling.frustum_planes_uniform = glGetUniformLocation(program_id, "frustum_planes");
+    culling.sphere_uniform = glGetUniformLocation(program_id, "cull_sphere");
+    culling.lighting_lod_uniform = glGetUniformLocation(program_id, "cull_lighting_lod");
+    culling.lod_uniform = glGetUniformLocation(program_id, "cull_lod");
+    FrameConstants_BindProgram(program_id);
+    Impostors_SetUniforms(program_id);
+    glUniform1i(glGetUniformLocation(program_id, "bird_paths"), bird_paths_unit);
+    glUseProgram(0);
+
+    glGenVertexArrays(1, &culling.input_vao);
+
+    // Desenho indireto com a contagem escrita pela GPU: glDrawElementsIndirect()
+    // e a escrita de consultas em buffers existem a partir do OpenGL 4.4 ou
+    // com as extensões.
+    bool has_indirect = GLVersion.major > 4 || (GLVersion.major == 4 && GLVersion.minor >= 4);
+    if ( !has_indirect )
+    {
+        bool draw_indirect = GLVersion.major >= 4;
+        bool query_buffer = false;
+        GLint num_extensions = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &num_extensions);
+        for (GLint i = 0; i < num_extensions; ++i)
+        {
+            const char* extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
+            draw_indirect = draw_indirect || strcmp(extension, "GL_ARB_draw_indirect") == 0;
+            query_buffer = query_buffer || strcmp(extension, "GL_ARB_query_buffer_object") == 0;
+        }
+        has_indirect = draw_indirect && query_buffer;
+    }
+    if ( has_indirect )
+        g_RenderQueue.draw_elements_indirect = (RenderDrawElementsIndirectProc)Headless_GetProcAddress("glDrawElementsIndirect");
+
+    if ( g_RenderQueue.draw_elements_indirect != NULL )
+    {
+        GpuCullingDrawCommand commands[GPU_CULLING_LOD_COUNT] = {};
+        glGenBuffers(1, &culling.indirect_buffer);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, culling.indirect_buffer);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, sizeof(commands), commands, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        culling.indirect = true;
+    }
+
+    culling.sets = culling.indirect ? 1 : GPU_CULLING_READBACK_FRAMES;
+    for (int set = 0; set < culling.sets; ++set)
+    {
+        glGenBuffers(GPU_CULLING_LOD_COUNT, culling.output_buffers[set]);
+        glGenQueries(GPU_CULLING_LOD_COUNT, culling.queries[set]);
+    }
+
+    culling.supported = true;
+    printf("GPU culling: transform feedback, %s.\n", culling.indirect ? "indirect draws" : "counts read back on the CPU");
+}
+
+// Retorna se o culling na GPU deve ser utilizado neste quadro.
+bool GpuCulling_Active()
+{
+    return g_GpuCulling.enabled && g_GpuCulling.supported;
+}
+
+// Define o trecho de índices desenhado para as instâncias de um LOD.
+void GpuCulling_SetDrawCommand(GpuCullingLod lod, GLuint count, GLuint first_index)
+{
+    if ( !g_GpuCulling.indirect )
+        return;
+
+    GpuCullingDrawCommand command = {};
+    command.count = count;
+    command.first_index = first_index;
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, g_GpuCulling.indirect_buffer);
+    glBufferSubData(GL_DRAW_INDIRECT_BUFFER, lod * sizeof(GpuCullingDrawCommand), sizeof(command), &command);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+// Deslocamento, no buffer indireto, do comando de um LOD.
+const void* GpuCulling_DrawCommandOffset(GpuCullingLod lod)
+{
+    return (const void*)(lod * sizeof(GpuCullingDrawCommand));
+}
+
+// Lê as contagens do último quadro cujas consultas já terminaram, para as
+// estatísticas, sem esperar a GPU.
+static void GpuCulling_ReadStats()
+{
+    GpuCulling& culling = g_GpuCulling;
+    GLuint available = GL_FALSE;
+    glGetQueryObjectuiv(culling.queries[0][GPU_CULLING_LOD_COUNT - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+    if ( !available )
+        return;
+
+    for (int lod = 0; lod < GPU_CULLING_LOD_COUNT; ++lod)
+    {
+        GLuint selected = 0;
+        glGetQueryObjectuiv(culling.queries[0][lod], GL_QUERY_RESULT, &selected);
+        culling.selected[lod] = (int)selected;
+    }
+    culling.instances = culling.frame_instances;
+}
+
+// Sem desenho indireto: escolhe o conjunto mais recente do anel cujas
+// consultas já terminaram e lê as suas contagens. Somente se nenhum está
+// pronto (nos primeiros quadros, ou se a GPU está um anel inteiro atrasada)
+// esperamos pelo conjunto mais antigo.
+static void GpuCulling_ReadBack()
+{
+    GpuCulling& culling = g_GpuCulling;
+
+    int chosen = -1;
+    int oldest = -1;
+    for (int age = 0; age < culling.sets; ++age)
+    {
+        int set = (culling.write_set - age + culling.sets) % culling.sets;
+        if ( !culling.pending[set] )
+            continue;
+        oldest = set;
+
+        GLuint available = GL_FALSE;
+        glGetQueryObjectuiv(culling.queries[set][GPU_CULLING_LOD_COUNT - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+        if ( available )
+        {
+            chosen = set;
+            break;
+        }
+    }
+    if ( chosen < 0 )
+        chosen = oldest;
+
+    // Conjuntos mais antigos que o escolhido não serão mais desenhados.
+    for (int age = 0; age < culling.sets; ++age)
+    {
+        int set = (chosen - age + culling.sets) % culling.sets;
+        if ( set == culling.write_set && age > 0 )
+            break;
+        culling.pending[set] = false;
+    }
+
+    for (int lod = 0; lod < GPU_CULLING_LOD_COUNT; ++lod)
+    {
+        glGetQueryObjectuiv(culling.queries[chosen][lod], GL_QUERY_RESULT, &culling.counts[lod]);
+        culling.selected[lod] = (int)culling.counts[lod];
+    }
+    culling.draw_set = chosen;
+}
+
+// Seleciona, na GPU, as instâncias de cada LOD entre "count" instâncias
+// (InstanceData) em "instances". "sphere" é a esfera envolvente do objeto
+// em coordenadas do modelo (raio em w) e "lighting_lod" os parâmetros de
+// "cull_lighting_lod" em "shader_vertex_cull.glsl". A textura dos caminhos
+// dos pássaros deve estar ligada à sua unidade.
+void GpuCulling_Run(const void* instances, GLsizei count, const glm::vec4 frustum_planes[6], const glm::vec4& sphere, const glm::vec3& lighting_lod)
+{
+    GpuCulling& culling = g_GpuCulling;
+    if ( culling.indirect )
+        GpuCulling_ReadStats();
+
+    // Buffers de saída com espaço para todas as instâncias. Os VAOs de
+    // output_vaos referenciam os buffers pelo nome, que não muda; o
+    // conteúdo dos conjuntos ainda não lidos é perdido.
+    if ( (size_t)count > culling.output_capacity )
+    {
+        culling.output_capacity = std::max((size_t)count, 2 * culling.output_capacity);
+        for (int set = 0; set < culling.sets; ++set)
+        {
+            for (int lod = 0; lod < GPU_CULLING_LOD_COUNT; ++lod)
+            {
+                glBindBuffer(GL_TRANSFORM_FEEDBACK_BUFFER, culling.output_buffers[set][lod]);
+                glBufferData(GL_TRANSFORM_FEEDBACK_BUFFER, culling.output_capacity * GPU_CULLING_INSTANCE_BYTES, NULL, GL_DYNAMIC_COPY);
+            }
+            culling.pending[set] = false;
+        }
+        glBindBuffer(GL_TRANSFORM_FEEDBACK_BUFFER, 0);
+    }
+
+    // Instâncias de entrada no buffer de streaming (veja "stream_buffer.cpp")
+    GLsizeiptr size = (GLsizeiptr)count * GPU_CULLING_INSTANCE_BYTES;
+    GLintptr offset = 0;
+    GLuint buffer_id = StreamBuffer_Write(instances, size, sizeof(glm::vec4), &offset);
+    if ( buffer_id == 0 )
+    {
+        if ( culling.input_buffer == 0 )
+            glGenBuffers(1, &culling.input_buffer);
+        if ( (size_t)count > culling.input_capacity )
+            culling.input_capacity = std::max((size_t)count, 2 * culling.input_capacity);
+        glBindBuffer(GL_ARRAY_BUFFER, culling.input_buffer);
+        glBufferData(GL_ARRAY_BUFFER, culling.input_capacity * GPU_CULLING_INSTANCE_BYTES, NULL, GL_STREAM_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, size, instances);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        buffer_id = culling.input_buffer;
+    }
+    SetInstanceAttributes(culling.input_vao, buffer_id, offset);
+
+    glUseProgram(culling.program_id);
+    glUniform4fv(culling.frustum_planes_uniform, 6, glm::value_ptr(frustum_planes[0]));
+    glUniform4fv(culling.sphere_uniform, 1, glm::value_ptr(sphere));
+    glUniform3fv(culling.lighting_lod_uniform, 1, glm::value_ptr(lighting_lod));
+
+    int set = culling.write_set;
+    glEnable(GL_RASTERIZER_DISCARD);
+    glBindVertexArray(culling.input_vao);
+    for (int lod = 0; lod < GPU_CULLING_LOD_COUNT; ++lod)
+    {
+        glUniform1i(culling.lod_uniform, lod);
+        glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, culling.output_buffers[set][lod]);
+        glBeginQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN, culling.queries[set][lod]);
+        glBeginTransformFeedback(GL_POINTS);
+        glDrawArrays(GL_POINTS, 0, count);
+        glEndTransformFeedback();
+        glEndQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN);
+    }
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+    glBindVertexArray(0);
+    glDisable(GL_RASTERIZER_DISCARD);
+    glUseProgram(0);
+
+    culling.frame_instances = count;
+    if ( culling.indirect )
+    {
+        // A GPU escreve cada contagem no campo "instance_count" do comando
+        // do LOD, depois que o passo correspondente termina.
+        glBindBuffer(GL_QUERY_BUFFER, culling.indirect_buffer);
+        for (int lod = 0; lod < GPU_CULLING_LOD_COUNT; ++lod)
+        {
+            size_t field = lod * sizeof(GpuCullingDrawCommand) + offsetof(GpuCullingDrawCommand, instance_count);
+            glGetQueryObjectuiv(culling.queries[set][lod], GL_QUERY_RESULT, (GLuint*)field);
+        }
+        glBindBuffer(GL_QUERY_BUFFER, 0);
+    }
+    else
+    {
+        culling.pending[set] = true;
+        GpuCulling_ReadBack();
+        culling.write_set = (set + 1) % culling.sets;
+        culling.instances = count;
+    }
+}
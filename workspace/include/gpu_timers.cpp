@@ -0,0 +1,292 @@
+// Tempo de GPU de cada passo de renderização.
+//
+// TextRendering_ShowFramesPerSecond() mede somente o tempo total do quadro
+// na CPU. Aqui marcamos, com consultas GL_TIMESTAMP (glQueryCounter()), o
+// início de cada passo no fluxo de comandos: GpuTimers_Mark(passo) indica
+// que o trabalho da GPU daqui em diante pertence àquele passo, até a
+// próxima marca. O tempo entre duas marcas consecutivas é somado ao passo
+// da primeira. Usamos marcas em vez de pares glBeginQuery()/glEndQuery()
+// com GL_TIME_ELAPSED porque consultas GL_TIME_ELAPSED não podem ser
+// aninhadas (os mapas de sombra já usam uma por cascata) e porque, com a
+// ordenação da fila de renderização, os pacotes de um mesmo passo (por
+// exemplo, o personagem) podem aparecer intercalados com os de outros.
+//
+// As consultas de cada quadro ficam em um anel de GPU_TIMER_FRAMES
+// quadros. O resultado de um quadro só é lido quando sua região do anel vai
+// ser reutilizada, alguns quadros depois, e somente se já estiver pronto:
+// a CPU nunca espera pela GPU (quadros ainda não prontos são descartados e
+// contados em "dropped"). Os resultados são mostrados na tela, como média
+// do último segundo, e gravados em um arquivo CSV, um quadro por linha, se
+// pedido com "--gpu-timers-csv <arquivo>".
+//
+// Com a ordenação da fila, um quadro pode ter mais trocas de passo do que
+// GPU_TIMER_MAX_MARKS. A última consulta é reservada para a marca de fim do
+// quadro e, quando as demais acabam, o restante do quadro é somado ao passo
+// GPU_TIMER_OVERFLOW, em vez de ao passo da última marca.
+#include <cstdio>
+
+#include <glad/glad.h>
+
+#define GPU_TIMER_FRAMES    4  // Quadros no anel de consultas
+#define GPU_TIMER_MAX_MARKS 64 // Marcas por quadro, incluindo a de fim do quadro
+
+enum GpuTimerPass
+{
+    GPU_TIMER_NONE = -1,     // Fim do quadro
+    GPU_TIMER_CLEAR = 0,     // glClear() e envios de dados antes das sombras
+    GPU_TIMER_SHADOWS,       // Mapas de sombra (ShadowMaps_Render())
+    GPU_TIMER_SKY,           // Skybox
+    GPU_TIMER_DEPTH_PREPASS, // Passo somente de profundidade
+    GPU_TIMER_OPAQUE,        // Objetos opacos (mundo, voxels, projéteis)
+    GPU_TIMER_CHARACTERS,    // Personagem
+    GPU_TIMER_BIRDS,         // Pássaros
+    GPU_TIMER_PARTICLES,     // Simulação e desenho das partículas (veja "particles.cpp")
+    GPU_TIMER_OCCLUSION,     // Consultas de oclusão
+    GPU_TIMER_UPSCALE,       // Ampliação da resolução dinâmica (veja "dynamic_resolution.cpp")
+    GPU_TIMER_TEXT,          // Texto na tela
+    GPU_TIMER_OVERFLOW,      // Restante do quadro após o limite de marcas
+    GPU_TIMER_COUNT
+};
+
+static const char* const g_GpuTimerNames[GPU_TIMER_COUNT] =
+{
+    "clear", "shadows", "sky", "prepass", "opaque", "characters", "birds", "particles", "occlusion", "upscale", "text",
+    "overflow"
+};
+
+// Marcas emitidas em um quadro
+struct GpuTimerFrame
+{
+    GLuint       queries[GPU_TIMER_MAX_MARKS];
+    int          passes[GPU_TIMER_MAX_MARKS]; // GpuTimerPass iniciado por cada marca
+    int          marks = 0;
+    bool         pending = false; // Emitido e ainda não lido
+    unsigned int frame = 0;       // Número do quadro
+};
+
+struct GpuTimers
+{
+    bool          enabled = true;
+    const char*   csv_filename = NULL;
+    FILE*         csv = NULL;
+
+    GpuTimerFrame frames[GPU_TIMER_FRAMES];
+    int           current = -1;   // Região do anel do quadro atual
+    int           current_pass = GPU_TIMER_NONE;
+    unsigned int  frame = 0;
+
+    // Média do último segundo, mostrada na tela
+    double        sum_ms[GPU_TIMER_COUNT] = {};
+    double        sum_total_ms = 0.0;
+    int           sum_frames = 0;
+    double        sum_start = 0.0;
+    double        average_ms[GPU_TIMER_COUNT] = {};
+    double        average_total_ms = 0.0;
+
+    // Último quadro lido, utilizado pela resolução dinâmica
+    int           last_frame = -1;
+    double        last_total_ms = 0.0;
+
+    // Estatísticas
+    unsigned int  resolved = 0; // Quadros lidos
+    unsigned int  dropped = 0;  // Quadros descartados por não estarem prontos
+    unsigned int  overflows = 0; // Marcas somadas a GPU_TIMER_OVERFLOW por falta de consultas
+
+    // Soma de todos os quadros lidos, para o resumo ao final
+    double        run_ms[GPU_TIMER_COUNT] = {};
+    double        run_total_ms = 0.0;
+};
+
+GpuTimers g_GpuTimers;
+
+// Cria as consultas e, se pedido, o arquivo CSV. Deve ser chamada após a
+// criação do contexto OpenGL.
+void GpuTimers_Init()
+{
+    GpuTimers& timers = g_GpuTimers;
+
+    // Implementações sem contador de tempo têm 0 bits
+    GLint bits = 0;
+    glGetQueryiv(GL_TIMESTAMP, GL_QUERY_COUNTER_BITS, &bits);
+    if ( bits == 0 )
+    {
+        fprintf(stderr, "GPU timers: GL_TIMESTAMP is not supported, disabled.\n");
+        timers.enabled = false;
+        return;
+    }
+
+    for (int f = 0; f < GPU_TIMER_FRAMES; ++f)
+        glGenQueries(GPU_TIMER_MAX_MARKS, timers.frames[f].queries);
+
+    if ( timers.csv_filename != NULL )
+    {
+        timers.csv = fopen(timers.csv_filename, "w");
+        if ( timers.csv == NULL )
+        {
+            fprintf(stderr, "ERROR: cannot write \"%s\".\n", timers.csv_filename);
+        }
+        else
+        {
+            fprintf(timers.csv, "frame");
+            for (int p = 0; p < GPU_TIMER_COUNT; ++p)
+                fprintf(timers.csv, ",%s_ms", g_GpuTimerNames[p]);
+            fprintf(timers.csv, ",total_ms\n");
+        }
+    }
+}
+
+// Lê as marcas de um quadro e distribui o tempo entre os passos. Com
+// "wait" falso, quadros ainda não prontos são descartados.
+static void GpuTimers_Resolve(GpuTimerFrame& frame, bool wait)
+{
+    GpuTimers& timers = g_GpuTimers;
+    frame.pending = false;
+    if ( frame.marks < 2 )
+        return;
+
+    // As marcas terminam na ordem do fluxo de comandos: se a última está
+    // pronta, todas estão.
+    if ( !wait )
+    {
+        GLint available = 0;
+        glGetQueryObjectiv(frame.queries[frame.marks - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+        if ( !available )
+        {
+            timers.dropped += 1;
+            return;
+        }
+    }
+
+    GLuint64 timestamps[GPU_TIMER_MAX_MARKS];
+    for (int i = 0; i < frame.marks; ++i)
+        glGetQueryObjectui64v(frame.queries[i], GL_QUERY_RESULT, &timestamps[i]);
+
+    double ms[GPU_TIMER_COUNT] = {};
+    for (int i = 0; i + 1 < frame.marks; ++i)
+        if ( frame.passes[i] != GPU_TIMER_NONE )
+            ms[frame.passes[i]] += (timestamps[i + 1] - timestamps[i]) / 1.0e6;
+    double total_ms = (timestamps[frame.marks - 1] - timestamps[0]) / 1.0e6;
+
+    for (int p = 0; p < GPU_TIMER_COUNT; ++p)
+    {
+        timers.sum_ms[p] += ms[p];
+        timers.run_ms[p] += ms[p];
+    }
+    timers.sum_total_ms += total_ms;
+    timers.run_total_ms += total_ms;
+    timers.sum_frames += 1;
+    timers.resolved += 1;
+    timers.last_frame = (int)frame.frame;
+    timers.last_total_ms = total_ms;
+
+    if ( timers.csv != NULL )
+    {
+        fprintf(timers.csv, "%u", frame.frame);
+        for (int p = 0; p < GPU_TIMER_COUNT; ++p)
+            fprintf(timers.csv, ",%.4f", ms[p]);
+        fprintf(timers.csv, ",%.4f\n", total_ms);
+    }
+}
+
+// Marca o início do trabalho do passo dado no fluxo de comandos. Marcas
+// repetidas do mesmo passo são ignoradas.
+void GpuTimers_Mark(int pass)
+{
+    GpuTimers& timers = g_GpuTimers;
+    if ( !timers.enabled || timers.current < 0 || pass == timers.current_pass )
+        return;
+
+    // A última consulta fica para GPU_TIMER_NONE; antes dela, uma marca de
+    // GPU_TIMER_OVERFLOW recebe todas as trocas de passo seguintes.
+    GpuTimerFrame& frame = timers.frames[timers.current];
+    if ( pass != GPU_TIMER_NONE && frame.marks >= GPU_TIMER_MAX_MARKS - 2 )
+    {
+        timers.overflows += 1;
+        if ( timers.current_pass == GPU_TIMER_OVERFLOW )
+            return;
+        pass = GPU_TIMER_OVERFLOW;
+    }
+    glQueryCounter(frame.queries[frame.marks], GL_TIMESTAMP);
+    frame.passes[frame.marks] = pass;
+    frame.marks += 1;
+    timers.current_pass = pass;
+}
+
+// Inicia um quadro: lê o quadro que ocupava a próxima região do anel e
+// marca o início do passo GPU_TIMER_CLEAR. Deve ser chamada antes de
+// glClear().
+void GpuTimers_BeginFrame()
+{
+    GpuTimers& timers = g_GpuTimers;
+    if ( !timers.enabled )
+        return;
+
+    timers.current = (timers.current + 1) % GPU_TIMER_FRAMES;
+    GpuTimerFrame& frame = timers.frames[timers.current];
+    if ( frame.pending )
+        GpuTimers_Resolve(frame, false);
+
+    // Média exibida na tela, atualizada a cada segundo
+    double now = Headless_GetWallTime();
+    if ( now - timers.sum_start >= 1.0 )
+    {
+        if ( timers.sum_frames > 0 )
+        {
+            for (int p = 0; p < GPU_TIMER_COUNT; ++p)
+                timers.average_ms[p] = timers.sum_ms[p] / timers.sum_frames;
+            timers.average_total_ms = timers.sum_total_ms / timers.sum_frames;
+        }
+        for (int p = 0; p < GPU_TIMER_COUNT; ++p)
+            timers.sum_ms[p] = 0.0;
+        timers.sum_total_ms = 0.0;
+        timers.sum_frames = 0;
+        timers.sum_start = now;
+    }
+
+    frame.marks = 0;
+    frame.frame = timers.frame;
+    timers.current_pass = GPU_TIMER_NONE;
+    GpuTimers_Mark(GPU_TIMER_CLEAR);
+}
+
+// Marca o fim do quadro. Deve ser chamada após o último comando do quadro.
+void GpuTimers_EndFrame()
+{
+    GpuTimers& timers = g_GpuTimers;
+    if ( !timers.enabled || timers.current < 0 )
+        return;
+
+    GpuTimers_Mark(GPU_TIMER_NONE);
+    timers.frames[timers.current].pending = true;
+    timers.frame += 1;
+}
+
+// Lê os quadros ainda pendentes (esperando a GPU, pois o programa está
+// terminando), imprime o tempo médio de cada passo e fecha o arquivo CSV.
+void GpuTimers_Shutdown()
+{
+    GpuTimers& timers = g_GpuTimers;
+    if ( !timers.enabled )
+        return;
+
+    for (int i = 1; i <= GPU_TIMER_FRAMES; ++i)
+    {
+        GpuTimerFrame& frame = timers.frames[(timers.current + i) % GPU_TIMER_FRAMES];
+        if ( frame.pending )
+            GpuTimers_Resolve(frame, true);
+    }
+
+    if ( timers.resolved > 0 )
+    {
+        printf("GPU time per pass (%u frames, %u dropped):", timers.resolved, timers.dropped);
+        for (int p = 0; p < GPU_TIMER_COUNT; ++p)
+            printf(" %s %.3f", g_GpuTimerNames[p], timers.run_ms[p] / timers.resolved);
+        printf(", total %.3f ms\n", timers.run_total_ms / timers.resolved);
+    }
+
+    if ( timers.csv != NULL )
+    {
+        fclose(timers.csv);
+        timers.csv = NULL;
+    }
+}
@@ -0,0 +1,458 @@
+// Modo "headless": renderização sem janela, para máquinas sem display.
+//
+// Com "--headless", nenhuma janela GLFW é criada. O contexto OpenGL 3.3
+// core é criado com EGL na plataforma "surfaceless" do Mesa (ou, se não
+// houver EGL, com OSMesa), e o mesmo laço de quadros de main() renderiza
+// em um framebuffer (FBO) do tamanho pedido. As bibliotecas são carregadas
+// com dlopen() em tempo de execução, então o executável não passa a
+// depender delas; em máquinas sem GPU o Mesa usa o rasterizador em
+// software llvmpipe.
+//
+// O laço termina após um número fixo de quadros ou de segundos. O tempo da
+// simulação avança um passo fixo por quadro (Headless_GetTime()), de modo
+// que duas execuções produzem as mesmas imagens; o tempo de cada quadro
+// (com glFinish(), incluindo a GPU) é medido com o relógio real. Ao final
+// são impressas estatísticas dos tempos de quadro, e cada quadro pode ser
+// gravado como imagem PPM.
+#include <cmath>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <algorithm>
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#if defined(__unix__)
+#include <dlfcn.h>
+#include <sys/stat.h>
+#define HEADLESS_SUPPORTED 1
+#endif
+
+struct Headless
+{
+    bool        enabled = false;
+    int         width = 800;
+    int         height = 600;
+    int         max_frames = 300;      // 0 = sem limite de quadros
+    double      max_seconds = 0.0;     // 0 = sem limite de tempo (relógio real)
+    double      time_step = 1.0 / 60.0; // Passo do tempo simulado por quadro
+    const char* dump_directory = NULL; // Se definido, grava cada quadro como PPM
+
+    const char* backend = "none";
+    void*       library = NULL;
+    void*       display = NULL;        // EGLDisplay
+    void*       context = NULL;        // EGLContext ou OSMesaContext
+    std::vector<unsigned char> osmesa_buffer;
+
+    GLuint framebuffer = 0;
+    GLuint color_renderbuffer = 0;
+    GLuint depth_renderbuffer = 0;
+
+    int    frame = 0;
+    std::chrono::steady_clock::time_point start;
+    std::chrono::steady_clock::time_point frame_start;
+    std::vector<double> frame_ms;
+};
+
+Headless g_Headless;
+
+// Tipos e constantes de EGL e OSMesa utilizados abaixo. Os cabeçalhos não
+// são necessários, pois as funções são obtidas com dlsym().
+typedef void* (*HeadlessGetProcAddress)(const char*);
+
+#define HEADLESS_EGL_NONE                          0x3038
+#define HEADLESS_EGL_RENDERABLE_TYPE               0x3040
+#define HEADLESS_EGL_OPENGL_BIT                    0x0008
+#define HEADLESS_EGL_OPENGL_API                    0x30A2
+#define HEADLESS_EGL_CONTEXT_MAJOR_VERSION         0x3098
+#define HEADLESS_EGL_CONTEXT_MINOR_VERSION         0x30FB
+#define HEADLESS_EGL_CONTEXT_OPENGL_PROFILE_MASK   0x30FD
+#define HEADLESS_EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT 0x0001
+#define HEADLESS_EGL_PLATFORM_SURFACELESS_MESA     0x31DD
+
+#define HEADLESS_OSMESA_RGBA                       0x1908
+#define HEADLESS_OSMESA_FORMAT                     0x22
+#define HEADLESS_OSMESA_DEPTH_BITS                 0x30
+#define HEADLESS_OSMESA_PROFILE                    0x33
+#define HEADLESS_OSMESA_CORE_PROFILE               0x34
+#define HEADLESS_OSMESA_CONTEXT_MAJOR_VERSION      0x36
+#define HEADLESS_OSMESA_CONTEXT_MINOR_VERSION      0x37
+
+static HeadlessGetProcAddress g_HeadlessGetProcAddress = NULL;
+
+// Função passada para gladLoadGLLoader().
+static void* Headless_LoadProc(const char* name)
+{
+    void* proc = g_HeadlessGetProcAddress(name);
+#ifdef HEADLESS_SUPPORTED
+    if ( proc == NULL )
+        proc = dlsym(g_Headless.library, name);
+#endif
+    return proc;
+}
+
+#ifdef HEADLESS_SUPPORTED
+// Cria um contexto com EGL, sem superfície. Retorna false se EGL não
+// estiver disponível ou não suportar contextos OpenGL 3.3 core.
+static bool Headless_CreateEglContext()
+{
+    Headless& headless = g_Headless;
+
+    void* library = dlopen("libEGL.so.1", RTLD_NOW | RTLD_LOCAL);
+    if ( library == NULL )
+        return false;
+
+    typedef void*    (*GetPlatformDisplayFn)(unsigned int, void*, const intptr_t*);
+    typedef void*    (*GetPlatformDisplayEXTFn)(unsigned int, void*, const int*);
+    typedef void*    (*GetDisplayFn)(void*);
+    typedef unsigned (*InitializeFn)(void*, int*, int*);
+    typedef unsigned (*BindAPIFn)(unsigned int);
+    typedef unsigned (*ChooseConfigFn)(void*, const int*, void**, int, int*);
+    typedef void*    (*CreateContextFn)(void*, void*, void*, const int*);
+    typedef unsigned (*MakeCurrentFn)(void*, void*, void*, void*);
+    typedef unsigned (*TerminateFn)(void*);
+
+    HeadlessGetProcAddress get_proc = (HeadlessGetProcAddress)dlsym(library, "eglGetProcAddress");
+    GetPlatformDisplayFn get_platform_display = (GetPlatformDisplayFn)dlsym(library, "eglGetPlatformDisplay");
+    GetDisplayFn     get_display    = (GetDisplayFn)dlsym(library, "eglGetDisplay");
+    InitializeFn     initialize     = (InitializeFn)dlsym(library, "eglInitialize");
+    BindAPIFn        bind_api       = (BindAPIFn)dlsym(library, "eglBindAPI");
+    ChooseConfigFn   choose_config  = (ChooseConfigFn)dlsym(library, "eglChooseConfig");
+    CreateContextFn  create_context = (CreateContextFn)dlsym(library, "eglCreateContext");
+    MakeCurrentFn    make_current   = (MakeCurrentFn)dlsym(library, "eglMakeCurrent");
+    TerminateFn      terminate      = (TerminateFn)dlsym(library, "eglTerminate");
+    if ( !get_proc || !initialize || !bind_api || !choose_config || !create_context || !make_current || !terminate )
+    {
+        dlclose(library);
+        return false;
+    }
+
+    // Plataforma "surfaceless" do Mesa (EGL 1.5 ou EGL_EXT_platform_base);
+    // caso contrário, o display padrão.
+    void* display = NULL;
+    if ( get_platform_display != NULL )
+        display = get_platform_display(HEADLESS_EGL_PLATFORM_SURFACELESS_MESA, NULL, NULL);
+    if ( display == NULL )
+    {
+        GetPlatformDisplayEXTFn get_platform_display_ext = (GetPlatformDisplayEXTFn)get_proc("eglGetPlatformDisplayEXT");
+        if ( get_platform_display_ext != NULL )
+            display = get_platform_display_ext(HEADLESS_EGL_PLATFORM_SURFACELESS_MESA, NULL, NULL);
+    }
+    if ( display == NULL && get_display != NULL )
+        display = get_display(NULL);
+
+    int major, minor;
+    if ( display == NULL || !initialize(display, &major, &minor) )
+    {
+        dlclose(library);
+        return false;
+    }
+
+    const int config_attributes[] = { HEADLESS_EGL_RENDERABLE_TYPE, HEADLESS_EGL_OPENGL_BIT, HEADLESS_EGL_NONE };
+    const int context_attributes[] = {
+        HEADLESS_EGL_CONTEXT_MAJOR_VERSION, 3,
+        HEADLESS_EGL_CONTEXT_MINOR_VERSION, 3,
+        HEADLESS_EGL_CONTEXT_OPENGL_PROFILE_MASK, HEADLESS_EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        HEADLESS_EGL_NONE
+    };
+
+    // Sem configuração compatível, usamos EGL_NO_CONFIG_KHR (NULL).
+    void* config = NULL;
+    int num_configs = 0;
+    if ( !choose_config(display, config_attributes, &config, 1, &num_configs) || num_configs == 0 )
+        config = NULL;
+
+    void* context = NULL;
+    if ( bind_api(HEADLESS_EGL_OPENGL_API) )
+        context = create_context(display, config, NULL, context_attributes);
+    if ( context == NULL || !make_current(display, NULL, NULL, context) )
+    {
+        terminate(display);
+        dlclose(library);
+        return false;
+    }
+
+    headless.backend = "EGL";
+    headless.library = library;
+    headless.display = display;
+    headless.context = context;
+    g_HeadlessGetProcAddress = get_proc;
+    return true;
+}
+
+// Cria um contexto com OSMesa, que renderiza em um buffer na memória.
+static bool Headless_CreateOSMesaContext()
+{
+    Headless& headless = g_Headless;
+
+    void* library = dlopen("libOSMesa.so.8", RTLD_NOW | RTLD_LOCAL);
+    if ( library == NULL )
+        library = dlopen("libOSMesa.so", RTLD_NOW | RTLD_LOCAL);
+    if ( library == NULL )
+        return false;
+
+    typedef void*    (*CreateContextAttribsFn)(const int*, void*);
+    typedef unsigned (*MakeCurrentFn)(void*, void*, unsigned int, int, int);
+    typedef void     (*DestroyContextFn)(void*);
+
+    CreateContextAttribsFn create_context = (CreateContextAttribsFn)dlsym(library, "OSMesaCreateContextAttribs");
+    MakeCurrentFn make_current = (MakeCurrentFn)dlsym(library, "OSMesaMakeCurrent");
+    DestroyContextFn destroy_context = (DestroyContextFn)dlsym(library, "OSMesaDestroyContext");
+    HeadlessGetProcAddress get_proc = (HeadlessGetProcAddress)dlsym(library, "OSMesaGetProcAddress");
+    if ( !create_context || !make_current || !destroy_context || !get_proc )
+    {
+        dlclose(library);
+        return false;
+    }
+
+    const int attributes[] = {
+        HEADLESS_OSMESA_FORMAT, HEADLESS_OSMESA_RGBA,
+        HEADLESS_OSMESA_DEPTH_BITS, 24,
+        HEADLESS_OSMESA_PROFILE, HEADLESS_OSMESA_CORE_PROFILE,
+        HEADLESS_OSMESA_CONTEXT_MAJOR_VERSION, 3,
+        HEADLESS_OSMESA_CONTEXT_MINOR_VERSION, 3,
+        0
+    };
+    void* context = create_context(attributes, NULL);
+    if ( context == NULL )
+    {
+        dlclose(library);
+        return false;
+    }
+
+    headless.osmesa_buffer.resize((size_t)headless.width * headless.height * 4);
+    if ( !make_current(context, headless.osmesa_buffer.data(), GL_UNSIGNED_BYTE, headless.width, headless.height) )
+    {
+        destroy_context(context);
+        headless.osmesa_buffer.clear();
+        dlclose(library);
+        return false;
+    }
+
+    headless.backend = "OSMesa";
+    headless.library = library;
+    headless.context = context;
+    g_HeadlessGetProcAddress = get_proc;
+    return true;
+}
+#endif
+
+// Cria o contexto OpenGL sem janela, carrega as funções com GLAD e cria o
+// framebuffer onde os quadros são renderizados, que fica ligado como
+// GL_FRAMEBUFFER. Retorna false se nenhum backend estiver disponível.
+bool Headless_Init()
+{
+    Headless& headless = g_Headless;
+
+#ifdef HEADLESS_SUPPORTED
+    if ( !Headless_CreateEglContext() && !Headless_CreateOSMesaContext() )
+    {
+        fprintf(stderr, "ERROR: headless mode needs libEGL.so.1 (surfaceless) or libOSMesa.so.\n");
+        return false;
+    }
+#else
+    fprintf(stderr, "ERROR: headless mode is only supported on Linux/Unix.\n");
+    return false;
+#endif
+
+    if ( !gladLoadGLLoader((GLADloadproc)Headless_LoadProc) )
+    {
+        fprintf(stderr, "ERROR: failed to load OpenGL functions (%s).\n", headless.backend);
+        return false;
+    }
+
+    glGenRenderbuffers(1, &headless.color_renderbuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, headless.color_renderbuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, headless.width, headless.height);
+    glGenRenderbuffers(1, &headless.depth_renderbuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, headless.depth_renderbuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, headless.width, headless.height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &headless.framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, headless.framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, headless.color_renderbuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, headless.depth_renderbuffer);
+    if ( glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE )
+    {
+        fprintf(stderr, "ERROR: headless framebuffer is incomplete.\n");
+        return false;
+    }
+
+    // Cria o diretório das imagens, se ainda não existir
+    if ( headless.dump_directory != NULL )
+        mkdir(headless.dump_directory, 0755);
+
+    printf("Headless: %s, %dx%d, ", headless.backend, headless.width, headless.height);
+    if ( headless.max_frames > 0 )
+        printf("%d frames", headless.max_frames);
+    if ( headless.max_seconds > 0.0 )
+        printf("%s%.1f s", headless.max_frames > 0 ? " or " : "", headless.max_seconds);
+    printf("%s%s\n", headless.dump_directory ? ", dumping to " : "", headless.dump_directory ? headless.dump_directory : "");
+    return true;
+}
+
+// Deve ser chamada logo antes do laço de quadros: o carregamento da cena
+// não entra no tempo do primeiro quadro nem no limite de segundos.
+void Headless_BeginLoop()
+{
+    g_Headless.start = std::chrono::steady_clock::now();
+    g_Headless.frame_start = g_Headless.start;
+}
+
+// Tempo em segundos utilizado pela simulação: glfwGetTime() com janela;
+// no modo headless, o número de quadros vezes o passo fixo.
+double Headless_GetTime()
+{
+    if ( !g_Headless.enabled )
+        return glfwGetTime();
+    return g_Headless.frame * g_Headless.time_step;
+}
+
+// Relógio real em segundos, com ou sem janela, para medir durações.
+double Headless_GetWallTime()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// glfwGetKey(); no modo headless não há teclado e nenhuma tecla está pressionada.
+int Headless_GetKey(GLFWwindow* window, int key)
+{
+    if ( g_Headless.enabled )
+        return GLFW_RELEASE;
+    return glfwGetKey(window, key);
+}
+
+// glfwGetProcAddress(); no modo headless, a função de EGL/OSMesa. Utilizada
+// para funções OpenGL que o GLAD deste projeto (3.3) não carrega.
+void* Headless_GetProcAddress(const char* name)
+{
+    if ( g_Headless.enabled )
+        return Headless_LoadProc(name);
+    return (void*)glfwGetProcAddress(name);
+}
+
+// glfwGetFramebufferSize(); no modo headless, o tamanho do FBO.
+void Headless_GetFramebufferSize(GLFWwindow* window, int* width, int* height)
+{
+    if ( g_Headless.enabled )
+    {
+        *width = g_Headless.width;
+        *height = g_Headless.height;
+        return;
+    }
+    glfwGetFramebufferSize(window, width, height);
+}
+
+// glfwWindowShouldClose(); no modo headless, verdadeiro quando o número de
+// quadros ou o tempo pedidos foram atingidos.
+bool Headless_ShouldClose(GLFWwindow* window)
+{
+    const Headless& headless = g_Headless;
+    if ( !headless.enabled )
+        return glfwWindowShouldClose(window);
+
+    if ( headless.max_frames > 0 && headless.frame >= headless.max_frames )
+        return true;
+    if ( headless.max_seconds > 0.0 )
+    {
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - headless.start).count();
+        if ( elapsed >= headless.max_seconds )
+            return true;
+    }
+    return false;
+}
+
+// Grava o conteúdo do FBO como imagem PPM (P6), de cima para baixo.
+static void Headless_DumpFrame()
+{
+    Headless& headless = g_Headless;
+
+    std::vector<unsigned char> pixels((size_t)headless.width * headless.height * 3);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, headless.framebuffer);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, headless.width, headless.height, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+
+    char filename[512];
+    snprintf(filename, sizeof(filename), "%s/frame_%05d.ppm", headless.dump_directory, headless.frame);
+    FILE* file = fopen(filename, "wb");
+    if ( file == NULL )
+    {
+        fprintf(stderr, "ERROR: cannot write \"%s\".\n", filename);
+        return;
+    }
+    fprintf(file, "P6\n%d %d\n255\n", headless.width, headless.height);
+    size_t row = (size_t)headless.width * 3;
+    for (int y = headless.height - 1; y >= 0; --y)
+        fwrite(&pixels[y * row], 1, row, file);
+    fclose(file);
+}
+
+// Substitui glfwSwapBuffers()/glfwPollEvents() no modo headless: espera a
+// GPU terminar o quadro, mede seu tempo, grava a imagem se pedido e avança
+// o tempo simulado.
+void Headless_EndFrame()
+{
+    Headless& headless = g_Headless;
+
+    glFinish();
+    if ( headless.dump_directory != NULL )
+        Headless_DumpFrame();
+
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    headless.frame_ms.push_back(std::chrono::duration<double, std::milli>(now - headless.frame_start).count());
+    headless.frame_start = now;
+    headless.frame += 1;
+}
+
+// Imprime as estatísticas dos tempos de quadro e destrói o contexto.
+void Headless_Shutdown()
+{
+    Headless& headless = g_Headless;
+
+    if ( !headless.frame_ms.empty() )
+    {
+        std::vector<double> sorted = headless.frame_ms;
+        std::sort(sorted.begin(), sorted.end());
+        double total = 0.0;
+        for (size_t i = 0; i < sorted.size(); ++i)
+            total += sorted[i];
+        double mean = total / sorted.size();
+        double variance = 0.0;
+        for (size_t i = 0; i < sorted.size(); ++i)
+            variance += (sorted[i] - mean) * (sorted[i] - mean);
+        double deviation = sqrt(variance / sorted.size());
+
+        #define HEADLESS_PERCENTILE(p) sorted[std::min(sorted.size() - 1, (size_t)((p) / 100.0 * sorted.size()))]
+        printf("Headless frame times (%d frames, %.2f s, %.1f fps):\n", (int)sorted.size(), total / 1000.0, 1000.0 * sorted.size() / total);
+        printf("  mean %.3f ms, stddev %.3f ms, min %.3f ms, max %.3f ms\n", mean, deviation, sorted.front(), sorted.back());
+        printf("  p50 %.3f ms, p90 %.3f ms, p95 %.3f ms, p99 %.3f ms\n",
+               HEADLESS_PERCENTILE(50), HEADLESS_PERCENTILE(90), HEADLESS_PERCENTILE(95), HEADLESS_PERCENTILE(99));
+        #undef HEADLESS_PERCENTILE
+    }
+
+    glDeleteFramebuffers(1, &headless.framebuffer);
+    glDeleteRenderbuffers(1, &headless.color_renderbuffer);
+    glDeleteRenderbuffers(1, &headless.depth_renderbuffer);
+
+#ifdef HEADLESS_SUPPORTED
+    if ( headless.display != NULL )
+    {
+        typedef unsigned (*TerminateFn)(void*);
+        TerminateFn terminate = (TerminateFn)dlsym(headless.library, "eglTerminate");
+        if ( terminate != NULL )
+            terminate(headless.display);
+    }
+    else if ( headless.context != NULL )
+    {
+        typedef void (*DestroyContextFn)(void*);
+        DestroyContextFn destroy_context = (DestroyContextFn)dlsym(headless.library, "OSMesaDestroyContext");
+        if ( destroy_context != NULL )
+            destroy_context(headless.context);
+    }
+#endif
+}
@@ -0,0 +1,304 @@
+// Impostores para os pássaros distantes.
+//
+// Na carga, Impostors_Bake() desenha o modelo do pássaro, com câmeras
+// ortográficas, a partir de IMPOSTOR_GRID x IMPOSTOR_GRID direções, em um
+// atlas de duas texturas: refletância difusa e normal (em coordenadas do
+// modelo). As direções cobrem a esfera inteira com um mapeamento octaédrico:
+// a célula (i, j) do atlas corresponde à direção cujas coordenadas
+// octaédricas são o centro da célula (veja Impostors_OctahedralDecode()).
+//
+// Pássaros a partir de "distance" da câmera são desenhados como
+// quadriláteros voltados para a câmera ("shader_vertex_impostor.glsl"), que
+// interpolam as quatro vistas mais próximas da direção de observação e são
+// iluminados no fragment shader com as normais do atlas. Entre "distance" e
+// "distance + blend", malha e impostor dividem os pixels de cada pássaro
+// com um padrão de dithering complementar (ImpostorDither() nos shaders),
+// sem blending e sem ordenação.
+//
+// A posição de cada pássaro só é conhecida na GPU, então a CPU classifica o
+// caminho inteiro pela sua AABB (Impostors_Classify()): caminhos inteiramente
+// antes da transição só têm malha, caminhos inteiramente depois só têm
+// impostor, e os demais entram nos dois desenhos; os shaders decidem, por
+// pássaro, a fração de cada um. Impostores não são desenhados nos mapas de
+// sombra: a sombra vem sempre da malha, inclusive a dos caminhos que só têm
+// impostor (um pacote somente de sombra em main.cpp), e não muda na
+// distância de troca.
+#include <cmath>
+#include <cstdio>
+
+#include <glad/glad.h>
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#define IMPOSTOR_GRID      16 // Vistas em cada eixo do atlas
+#define IMPOSTOR_CELL_SIZE 64 // Pixels de cada vista
+#define IMPOSTOR_MIP_LEVELS 4 // Mipmaps até 8x8 pixels por vista, para não misturar vistas vizinhas
+
+#define IMPOSTOR_COLOR_TEXTURE_UNIT  15
+#define IMPOSTOR_NORMAL_TEXTURE_UNIT 16
+
+#define IMPOSTOR_VERTEX_FILE   "../../src/shader_vertex_impostor.glsl"
+#define IMPOSTOR_FRAGMENT_FILE "../../src/shader_fragment_impostor.glsl"
+
+// Como os pássaros de um caminho são desenhados
+enum ImpostorLevel
+{
+    IMPOSTOR_MESH      = 0, // Somente a malha
+    IMPOSTOR_CROSSFADE = 1, // Malha e impostor; o shader escolhe por pássaro
+    IMPOSTOR_ONLY      = 2  // Somente o impostor
+};
+
+struct Impostors
+{
+    bool      enabled = true;
+    float     distance = 25.0f; // Distância da câmera onde começa a transição para o impostor
+    float     blend = 5.0f;     // Largura da transição
+
+    int       bake_variant = -1; // Variante de shader que desenha o atlas (veja LoadShadersFromFiles())
+    GLuint    color_texture = 0;
+    GLuint    normal_texture = 0;
+    GLuint    quad_vao = 0;      // Quadrilátero [-1,1]² com 6 índices
+    glm::vec4 sphere = glm::vec4(0.0f); // Esfera envolvente do modelo: centro e raio
+    bool      baked = false;
+    double    bake_ms = 0.0;
+
+    // Estatísticas do quadro atual (em caminhos de pássaros)
+    int       mesh_paths = 0;
+    int       crossfade_paths = 0;
+    int       impostor_paths = 0;
+};
+
+Impostors g_Impostors;
+
+// Direção (unitária) com coordenadas octaédricas (x, y) em [-1,1]²; inversa
+// de OctahedralEncode() em "shader_vertex_impostor.glsl".
+static glm::vec3 Impostors_OctahedralDecode(float x, float y)
+{
+    glm::vec3 d(x, 1.0f - fabsf(x) - fabsf(y), y);
+    if ( d.y < 0.0f )
+    {
+        float dx = d.x;
+        d.x = (1.0f - fabsf(d.z)) * (dx >= 0.0f ? 1.0f : -1.0f);
+        d.z = (1.0f - fabsf(dx)) * (d.z >= 0.0f ? 1.0f : -1.0f);
+    }
+    return glm::normalize(d);
+}
+
+// Cria uma textura do atlas, com espaço para os mipmaps.
+static GLuint Impostors_CreateAtlasTexture(int size)
+{
+    GLuint texture_id;
+    glGenTextures(1, &texture_id);
+    glBindTexture(GL_TEXTURE_2D, texture_id);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, size, size, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, IMPOSTOR_MIP_LEVELS - 1);
+    return texture_id;
+}
+
+// Desenha o atlas do modelo dado (VAO e faixa de índices, como em
+// DrawVirtualObject()) e cria o quadrilátero dos impostores. Deve ser
+// chamada após LoadShadersFromFiles(), que compila a variante de desenho
+// do atlas.
+void Impostors_Bake(GLuint vao, GLenum mode, GLsizei count, const void* offset,
+                    const glm::vec3& bbox_min, const glm::vec3& bbox_max)
+{
+    Impostors& impostors = g_Impostors;
+    if ( !impostors.enabled || impostors.bake_variant < 0 )
+        return;
+
+    double start = Headless_GetWallTime();
+    const ShaderVariant& variant = g_ShaderVariants.variants[impostors.bake_variant];
+
+    glm::vec3 center = 0.5f * (bbox_min + bbox_max);
+    float radius = 0.5f * glm::length(bbox_max - bbox_min);
+    impostors.sphere = glm::vec4(center, radius);
+
+    // Framebuffer com as duas texturas do atlas
+    int size = IMPOSTOR_GRID * IMPOSTOR_CELL_SIZE;
+    if ( impostors.color_texture == 0 )
+    {
+        impostors.color_texture = Impostors_CreateAtlasTexture(size);
+        impostors.normal_texture = Impostors_CreateAtlasTexture(size);
+    }
+
+    GLint previous_framebuffer = 0;
+    GLint previous_viewport[4];
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previous_framebuffer);
+    glGetIntegerv(GL_VIEWPORT, previous_viewport);
+
+    GLuint framebuffer, depth_renderbuffer;
+    glGenFramebuffers(1, &framebuffer);
+    glGenRenderbuffers(1, &depth_renderbuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, depth_renderbuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, size, size);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, impostors.color_texture, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, impostors.normal_texture, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth_renderbuffer);
+    GLenum draw_buffers[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+    glDrawBuffers(2, draw_buffers);
+
+    if ( glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE )
+    {
+        fprintf(stderr, "ERROR: impostor atlas framebuffer is incomplete, impostors disabled.\n");
+        impostors.enabled = false;
+    }
+    else
+    {
+        glViewport(0, 0, size, size);
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        GLboolean cull_face = glIsEnabled(GL_CULL_FACE);
+        GLboolean depth_test = glIsEnabled(GL_DEPTH_TEST);
+        glDisable(GL_CULL_FACE);
+        glEnable(GL_DEPTH_TEST);
+
+        glUseProgram(variant.program_id);
+        glBindVertexArray(vao);
+
+        // Uma câmera ortográfica por célula, a 2 raios do centro, olhando
+        // para o centro. A base da câmera (Matrix_Camera_View()) é a mesma
+        // montada para o quadrilátero em "shader_vertex_impostor.glsl".
+        glm::mat4 projection = Matrix_Orthographic(-radius, radius, -radius, radius, -radius, -3.0f * radius);
+        for (int j = 0; j < IMPOSTOR_GRID; ++j)
+        {
+            for (int i = 0; i < IMPOSTOR_GRID; ++i)
+            {
+                glm::vec3 direction = Impostors_OctahedralDecode((i + 0.5f) / IMPOSTOR_GRID * 2.0f - 1.0f,
+                                                                 (j + 0.5f) / IMPOSTOR_GRID * 2.0f - 1.0f);
+                glm::vec4 up = (fabsf(direction.y) > 0.99f) ? glm::vec4(0.0f, 0.0f, 1.0f, 0.0f) : glm::vec4(0.0f, 1.0f, 0.0f, 0.0f);
+                glm::vec4 camera = glm::vec4(center + 2.0f * radius * direction, 1.0f);
+                glm::mat4 view = Matrix_Camera_View(camera, -glm::vec4(direction, 0.0f), up);
+                glm::mat4 model_view_projection = projection * view;
+
+                glViewport(i * IMPOSTOR_CELL_SIZE, j * IMPOSTOR_CELL_SIZE, IMPOSTOR_CELL_SIZE, IMPOSTOR_CELL_SIZE);
+                glUniformMatrix4fv(variant.model_view_projection_uniform, 1, GL_FALSE, glm::value_ptr(model_view_projection));
+                glDrawElements(mode, count, GL_UNSIGNED_INT, offset);
+            }
+        }
+
+        glBindVertexArray(0);
+        glUseProgram(0);
+        if ( cull_face )
+            glEnable(GL_CULL_FACE);
+        if ( !depth_test )
+            glDisable(GL_DEPTH_TEST);
+
+        glBindTexture(GL_TEXTURE_2D, impostors.color_texture);
+        glGenerateMipmap(GL_TEXTURE_2D);
+        glBindTexture(GL_TEXTURE_2D, impostors.normal_texture);
+        glGenerateMipmap(GL_TEXTURE_2D);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        impostors.baked = true;
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, previous_framebuffer);
+    glViewport(previous_viewport[0], previous_viewport[1], previous_viewport[2], previous_viewport[3]);
+    glDeleteFramebuffers(1, &framebuffer);
+    glDeleteRenderbuffers(1, &depth_renderbuffer);
+
+    if ( !impostors.baked )
+        return;
+
+    // O atlas fica ligado às suas unidades de textura durante todo o programa.
+    glActiveTexture(GL_TEXTURE0 + IMPOSTOR_COLOR_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D, impostors.color_texture);
+    glActiveTexture(GL_TEXTURE0 + IMPOSTOR_NORMAL_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D, impostors.normal_texture);
+    glActiveTexture(GL_TEXTURE0);
+
+    // Quadrilátero dos impostores: cantos (x, y) em [-1,1]², expandidos no
+    // vertex shader até o raio da esfera envolvente.
+    if ( impostors.quad_vao == 0 )
+    {
+        GLfloat corners[] = {
+            -1.0f, -1.0f, 0.0f, 1.0f,
+             1.0f, -1.0f, 0.0f, 1.0f,
+             1.0f,  1.0f, 0.0f, 1.0f,
+            -1.0f,  1.0f, 0.0f, 1.0f,
+        };
+        GLuint indices[] = { 0, 1, 2, 0, 2, 3 };
+
+        GLuint vertex_buffer, index_buffer;
+        glGenVertexArrays(1, &impostors.quad_vao);
+        glBindVertexArray(impostors.quad_vao);
+        glGenBuffers(1, &vertex_buffer);
+        glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+        glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 0, 0);
+        glEnableVertexAttribArray(0);
+        glGenBuffers(1, &index_buffer);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    glFinish();
+    impostors.bake_ms = (Headless_GetWallTime() - start) * 1000.0;
+    printf("Impostors: %dx%d views of %d px baked in %.1f ms.\n", IMPOSTOR_GRID, IMPOSTOR_GRID, IMPOSTOR_CELL_SIZE, impostors.bake_ms);
+}
+
+// Envia os parâmetros dos impostores para um programa. Programas que não os
+// declaram são ignorados (glGetUniformLocation() retorna -1).
+void Impostors_SetUniforms(GLuint program_id)
+{
+    const Impostors& impostors = g_Impostors;
+    float distance = (impostors.enabled && impostors.baked) ? impostors.distance : 0.0f;
+
+    glUseProgram(program_id);
+    glUniform2f(glGetUniformLocation(program_id, "impostor_range"), distance, impostors.blend);
+    glUniform4fv(glGetUniformLocation(program_id, "impostor_sphere"), 1, glm::value_ptr(impostors.sphere));
+    glUniform1f(glGetUniformLocation(program_id, "impostor_grid"), (float)IMPOSTOR_GRID);
+    glUniform1i(glGetUniformLocation(program_id, "impostor_color"), IMPOSTOR_COLOR_TEXTURE_UNIT);
+    glUniform1i(glGetUniformLocation(program_id, "impostor_normal"), IMPOSTOR_NORMAL_TEXTURE_UNIT);
+}
+
+// Classifica os pássaros de um caminho com AABB [bbox_min, bbox_max] pela
+// distância até a câmera, e conta o resultado nas estatísticas do quadro.
+ImpostorLevel Impostors_Classify(const glm::vec3& bbox_min, const glm::vec3& bbox_max, const glm::vec4& camera_position)
+{
+    Impostors& impostors = g_Impostors;
+    ImpostorLevel level = IMPOSTOR_MESH;
+
+    if ( impostors.enabled && impostors.baked )
+    {
+        // Menor e maior distância entre a câmera e um ponto da AABB
+        glm::vec3 camera = glm::vec3(camera_position);
+        glm::vec3 nearest = glm::clamp(camera, bbox_min, bbox_max);
+        glm::vec3 farthest = glm::max(glm::abs(camera - bbox_min), glm::abs(camera - bbox_max));
+        float near_distance = glm::length(nearest - camera);
+        float far_distance = glm::length(farthest);
+
+        if ( near_distance >= impostors.distance + impostors.blend )
+            level = IMPOSTOR_ONLY;
+        else if ( far_distance > impostors.distance )
+            level = IMPOSTOR_CROSSFADE;
+    }
+
+    if ( level == IMPOSTOR_MESH )
+        impostors.mesh_paths += 1;
+    else if ( level == IMPOSTOR_CROSSFADE )
+        impostors.crossfade_paths += 1;
+    else
+        impostors.impostor_paths += 1;
+    return level;
+}
+
+// Zera as estatísticas do quadro.
+void Impostors_BeginFrame()
+{
+    g_Impostors.mesh_paths = 0;
+    g_Impostors.crossfade_paths = 0;
+    g_Impostors.impostor_paths = 0;
+}
@@ -0,0 +1,118 @@
+// Sistema simples de tarefas para distribuir trabalho entre threads.
+// Criamos um conjunto fixo de threads na inicialização, que ficam dormindo
+// até que JobSystem_ParallelFor() seja chamada. A thread que chama a função
+// também executa tarefas, e só retorna quando todas tiverem terminado.
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <condition_variable>
+
+struct JobSystem
+{
+    std::vector<std::thread> workers;
+    std::mutex               mutex;
+    std::condition_variable  work_available;
+    std::condition_variable  work_done;
+
+    std::function<void(int)> task;       // Função executada para cada índice de tarefa
+    int                      task_count = 0;
+    int                      next_task = 0;
+    int                      tasks_finished = 0;
+    bool                     quit = false;
+};
+
+JobSystem g_JobSystem;
+
+// Pega a próxima tarefa disponível, executa e marca como concluída. Deve ser
+// chamada com o mutex travado; retorna com o mutex travado.
+static void JobSystem_RunOneTask(std::unique_lock<std::mutex>& lock)
+{
+    int task_index = g_JobSystem.next_task++;
+    lock.unlock();
+
+    g_JobSystem.task(task_index);
+
+    lock.lock();
+    g_JobSystem.tasks_finished += 1;
+    if ( g_JobSystem.tasks_finished == g_JobSystem.task_count )
+        g_JobSystem.work_done.notify_all();
+}
+
+static void JobSystem_WorkerLoop()
+{
+    std::unique_lock<std::mutex> lock(g_JobSystem.mutex);
+    while (true)
+    {
+        g_JobSystem.work_available.wait(lock, []{
+            return g_JobSystem.quit || g_JobSystem.next_task < g_JobSystem.task_count;
+        });
+
+        if ( g_JobSystem.quit )
+            return;
+
+        JobSystem_RunOneTask(lock);
+    }
+}
+
+// Cria as threads de trabalho. Se num_workers < 0, utilizamos uma thread a
+// menos que o número de núcleos da CPU (a thread principal também trabalha).
+void JobSystem_Init(int num_workers = -1)
+{
+    if ( num_workers < 0 )
+    {
+        int cores = (int)std::thread::hardware_concurrency();
+        num_workers = (cores > 1) ? cores - 1 : 0;
+    }
+
+    for (int i = 0; i < num_workers; ++i)
+        g_JobSystem.workers.push_back(std::thread(JobSystem_WorkerLoop));
+
+    printf("Sistema de tarefas: %d threads de trabalho.\n", num_workers);
+}
+
+// Número total de threads que executam tarefas (incluindo a principal).
+int JobSystem_ThreadCount()
+{
+    return (int)g_JobSystem.workers.size() + 1;
+}
+
+// Executa fn(0), fn(1), ..., fn(count-1) distribuídas entre as threads e
+// espera que todas terminem.
+void JobSystem_ParallelFor(int count, const std::function<void(int)>& fn)
+{
+    if ( count <= 0 )
+        return;
+
+    std::unique_lock<std::mutex> lock(g_JobSystem.mutex);
+    g_JobSystem.task = fn;
+    g_JobSystem.task_count = count;
+    g_JobSystem.next_task = 0;
+    g_JobSystem.tasks_finished = 0;
+    g_JobSystem.work_available.notify_all();
+
+    while ( g_JobSystem.next_task < g_JobSystem.task_count )
+        JobSystem_RunOneTask(lock);
+
+    g_JobSystem.work_done.wait(lock, []{
+        return g_JobSystem.tasks_finished == g_JobSystem.task_count;
+    });
+
+    g_JobSystem.task_count = 0;
+    g_JobSystem.next_task = 0;
+    g_JobSystem.task = nullptr;
+}
+
+// Acorda as threads de trabalho e espera que terminem.
+void JobSystem_Shutdown()
+{
+    {
+        std::lock_guard<std::mutex> lock(g_JobSystem.mutex);
+        g_JobSystem.quit = true;
+    }
+    g_JobSystem.work_available.notify_all();
+
+    for (size_t i = 0; i < g_JobSystem.workers.size(); ++i)
+        g_JobSystem.workers[i].join();
+    g_JobSystem.workers.clear();
+}
@@ -32,29 +32,10 @@
 #include "utils.h"
 #include "matrices.h"
 
-extern std::vector<std::vector<glm::vec4>> passaros = {
-    {
-    glm::vec4(6.0f + 2.5f * cos(0.0f),                 2.0f, 3.5f + 2.5f * sin(0.0f),        1.0f),
-    glm::vec4(6.0f + 2.5f * cos(glm::radians(45.0f)),  2.5f, 3.5f + 2.5f * sin(glm::radians(45.0f)), 1.0f),
-    glm::vec4(6.0f + 2.5f * cos(glm::radians(90.0f)),  2.8f, 3.5f + 2.5f * sin(glm::radians(90.0f)), 1.0f),
-    glm::vec4(6.0f + 2.5f * cos(glm::radians(135.0f)), 3.0f, 3.5f + 2.5f * sin(glm::radians(135.0f)), 1.0f),
-    glm::vec4(6.0f + 2.5f * cos(glm::radians(180.0f)), 2.7f, 3.5f + 2.5f * sin(glm::radians(180.0f)), 1.0f),
-    glm::vec4(6.0f + 2.5f * cos(glm::radians(225.0f)), 2.4f, 3.5f + 2.5f * sin(glm::radians(225.0f)), 1.0f),
-    glm::vec4(6.0f + 2.5f * cos(glm::radians(270.0f)), 2.0f, 3.5f + 2.5f * sin(glm::radians(270.0f)), 1.0f),
-    glm::vec4(6.0f + 2.5f * cos(glm::radians(315.0f)), 1.9f, 3.5f + 2.5f * sin(glm::radians(315.0f)), 1.0f)
-    },
-    {
-    glm::vec4(-3.6f, 2.5f, -6.0f, 1.0f),
-    glm::vec4(0.0f, 2.5f, -7.0f, 1.0f),
-    glm::vec4(3.6f, 2.5f, -6.0f, 1.0f),
-    glm::vec4(4.2f, 2.5f, 0.0f, 1.0f),
-    glm::vec4(3.6f, 2.5f, 6.0f, 1.0f),
-    glm::vec4(0.0f, 2.5f, 7.0f, 1.0f),
-    glm::vec4(-3.6f, 2.5f, 6.0f, 1.0f),
-    glm::vec4(-4.2f, 2.5f, 0.0f, 1.0f),
-    }
-};
-extern int n_passaros = passaros.size();
+// Pontos de controle dos caminhos dos pássaros. São lidos do arquivo de cena
+// (linhas "bird_path", veja "scene_file.cpp") na inicialização.
+std::vector<std::vector<glm::vec4>> passaros;
+int n_passaros = 0;
 
 
 struct CubicBézierCurve {
@@ -144,6 +125,77 @@ ClosedCompositeCubicBézierCurve generateClosedBezierCycle(const std::vector<glm
     return curves;
 }
 
+// Caminhos dos pássaros avaliados na GPU. Os pontos de controle de todos os
+// segmentos de todos os caminhos ficam em um único buffer de textura (4
+// texels RGBA32F por segmento), lido em "shader_vertex.glsl" pela função
+// BirdPathMatrix(), que reproduz prepareDrawBird(). Cada instância de pássaro
+// informa somente o primeiro segmento e o número de segmentos do seu caminho.
+#define BIRD_PATH_TEXTURE_UNIT 14
+
+struct BirdPath
+{
+    int       first_segment;
+    int       num_segments;
+    glm::vec3 bbox_min; // AABB que contém todo o caminho, usada no culling
+    glm::vec3 bbox_max;
+};
+
+std::vector<BirdPath> g_BirdPaths;
+GLuint g_BirdPathBufferID = 0;
+GLuint g_BirdPathTextureID = 0;
+
+// Gera as curvas de cada caminho e envia seus pontos de controle para a GPU.
+// Uma curva de Bézier está contida no fecho convexo dos seus pontos de
+// controle, então a AABB desses pontos, expandida por "margin" (o raio do
+// modelo do pássaro), contém o pássaro em qualquer instante.
+void UploadBirdPaths(const std::vector<std::vector<glm::vec4>>& paths, float margin)
+{
+    std::vector<glm::vec4> control_points;
+    g_BirdPaths.clear();
+
+    for (size_t i = 0; i < paths.size(); ++i)
+    {
+        ClosedCompositeCubicBézierCurve curve = generateClosedBezierCycle(paths[i]);
+
+        BirdPath path;
+        path.first_segment = control_points.size() / 4;
+        path.num_segments = curve.size();
+        path.bbox_min = glm::vec3(std::numeric_limits<float>::max());
+        path.bbox_max = glm::vec3(std::numeric_limits<float>::lowest());
+
+        for (size_t j = 0; j < curve.size(); ++j)
+        {
+            const glm::vec4 points[4] = { curve[j].p1, curve[j].p2, curve[j].p3, curve[j].p4 };
+            for (int k = 0; k < 4; ++k)
+            {
+                control_points.push_back(points[k]);
+                path.bbox_min = glm::min(path.bbox_min, glm::vec3(points[k]));
+                path.bbox_max = glm::max(path.bbox_max, glm::vec3(points[k]));
+            }
+        }
+
+        path.bbox_min -= glm::vec3(margin);
+        path.bbox_max += glm::vec3(margin);
+        g_BirdPaths.push_back(path);
+    }
+
+    if ( g_BirdPathBufferID == 0 )
+    {
+        glGenBuffers(1, &g_BirdPathBufferID);
+        glGenTextures(1, &g_BirdPathTextureID);
+    }
+
+    glBindBuffer(GL_TEXTURE_BUFFER, g_BirdPathBufferID);
+    glBufferData(GL_TEXTURE_BUFFER, control_points.size() * sizeof(glm::vec4), control_points.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    glActiveTexture(GL_TEXTURE0 + BIRD_PATH_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_BUFFER, g_BirdPathTextureID);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, g_BirdPathBufferID);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glActiveTexture(GL_TEXTURE0);
+}
+
 
 
 
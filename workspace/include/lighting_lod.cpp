@@ -0,0 +1,125 @@
+// Nível de detalhe (LOD) da iluminação.
+//
+// Objetos que ocupam uma fração pequena da tela trocam a iluminação por
+// fragmento (Phong, "shader_fragment.glsl") pela iluminação por vértice
+// (Gouraud, "shader_vertex_gouraud.glsl"), cujo fragment shader somente
+// interpola a cor. A decisão usa o tamanho projetado da esfera envolvente
+// do objeto, em fração da altura da tela. Para evitar que um objeto perto
+// do limiar alterne de nível a cada quadro ("popping"), há uma histerese:
+// um objeto volta para a iluminação por fragmento somente quando fica
+// (1 + hysteresis) vezes maior que o limiar.
+//
+// Cada objeto é identificado por uma chave escolhida pelo chamador, que
+// guarda o nível do quadro anterior. Chaves não usadas em um quadro (objetos
+// descartados pelo culling ou descarregados pelo streaming) são removidas
+// no início do quadro seguinte. LightingLod_Select() pode ser chamada
+// por várias tarefas ao mesmo tempo (veja "render_queue.cpp"); somente o
+// acesso aos níveis anteriores e às estatísticas é protegido pelo mutex.
+#include <map>
+#include <cmath>
+#include <mutex>
+#include <cstdint>
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec4.hpp>
+
+enum LightingLevel
+{
+    LIGHTING_PER_PIXEL  = 0, // Phong por fragmento
+    LIGHTING_PER_VERTEX = 1, // Gouraud
+    LIGHTING_LEVEL_COUNT
+};
+
+// Nível de um objeto e o quadro em que foi escolhido
+struct LightingLodEntry
+{
+    int          level;
+    unsigned int frame;
+};
+
+struct LightingLod
+{
+    bool  enabled = true;
+    float min_screen_size = 0.06f; // Abaixo desta fração da altura da tela, iluminação por vértice
+    float hysteresis = 0.25f;
+
+    // Estado do quadro atual
+    glm::vec4 camera_position;
+    float     projection_scale = 1.0f; // Elemento [1][1] da matriz de projeção
+    bool      perspective = true;
+
+    std::map<uint64_t, LightingLodEntry> levels; // Nível anterior de cada objeto
+    std::mutex   mutex;     // Protege "levels" e as estatísticas
+    unsigned int frame = 0; // Número do quadro atual
+
+    // Estatísticas do último quadro
+    int per_pixel = 0;
+    int per_vertex = 0;
+};
+
+LightingLod g_LightingLod;
+
+// Chaves para LightingLod_Select(): o tipo do objeto nos 16 bits mais
+// altos e um índice nos demais.
+#define LIGHTING_LOD_KEY(kind, index) (((uint64_t)(kind) << 48) | (uint64_t)(index))
+
+// Deve ser chamada uma vez por quadro, antes de LightingLod_Select().
+void LightingLod_Begin(const glm::vec4& camera_position, const glm::mat4& projection)
+{
+    LightingLod& lod = g_LightingLod;
+    lod.camera_position = camera_position;
+    lod.projection_scale = fabsf(projection[1][1]);
+    lod.perspective = (projection[3][3] == 0.0f);
+
+    // Somente os objetos escolhidos no quadro anterior têm histerese.
+    std::map<uint64_t, LightingLodEntry>::iterator it = lod.levels.begin();
+    while ( it != lod.levels.end() )
+    {
+        if ( it->second.frame != lod.frame )
+            it = lod.levels.erase(it);
+        else
+            ++it;
+    }
+    lod.frame += 1;
+
+    lod.per_pixel = 0;
+    lod.per_vertex = 0;
+}
+
+// Escolhe o nível de iluminação de um objeto com esfera envolvente de centro
+// "center" (coordenadas globais) e raio "radius".
+LightingLevel LightingLod_Select(uint64_t key, const glm::vec4& center, float radius)
+{
+    LightingLod& lod = g_LightingLod;
+
+    // Diâmetro projetado em NDC (2*radius*[1][1]/distância) dividido pela
+    // altura da tela em NDC (2).
+    float screen_size = radius * lod.projection_scale;
+    if ( lod.perspective )
+    {
+        glm::vec4 d = center - lod.camera_position;
+        float distance = sqrtf(d.x*d.x + d.y*d.y + d.z*d.z);
+        screen_size = (distance > radius) ? screen_size / distance : 1.0f;
+    }
+
+    std::lock_guard<std::mutex> lock(lod.mutex);
+
+    int level = LIGHTING_PER_PIXEL;
+    if ( lod.enabled )
+    {
+        std::map<uint64_t, LightingLodEntry>::iterator previous = lod.levels.find(key);
+        bool was_per_vertex = (previous != lod.levels.end() && previous->second.level == LIGHTING_PER_VERTEX);
+        float threshold = was_per_vertex ? lod.min_screen_size * (1.0f + lod.hysteresis) : lod.min_screen_size;
+
+        if ( screen_size < threshold )
+            level = LIGHTING_PER_VERTEX;
+    }
+
+    lod.levels[key] = LightingLodEntry{ level, lod.frame };
+    if ( level == LIGHTING_PER_VERTEX )
+        lod.per_vertex += 1;
+    else
+        lod.per_pixel += 1;
+    return (LightingLevel)level;
+}
+
@@ -0,0 +1,259 @@
+// Culling por oclusão utilizando consultas de oclusão em hardware
+// (GL_ANY_SAMPLES_PASSED). Para cada objeto testado desenhamos somente a sua
+// AABB (em coordenadas globais), sem escrever cor nem profundidade, e
+// perguntamos à GPU se algum fragmento passou no teste de profundidade.
+//
+// Para que a CPU nunca fique esperando a GPU, os resultados são lidos com
+// atraso: uma consulta emitida no quadro N só é lida nos quadros seguintes,
+// quando GL_QUERY_RESULT_AVAILABLE indicar que o resultado já está pronto.
+// Enquanto isso, o objeto utiliza a visibilidade do último resultado
+// conhecido (coerência temporal). Objetos visíveis são reconsultados somente
+// a cada "visible_requery_interval" quadros; objetos ocultos são reconsultados
+// sempre que a consulta anterior terminou, para que reapareçam rapidamente.
+#include <vector>
+
+#include <glad/glad.h>
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec4.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+GLuint LoadShader_Vertex(const char* filename);   // Funções definidas em main.cpp
+GLuint LoadShader_Fragment(const char* filename);
+GLuint CreateGpuProgram(GLuint vertex_shader_id, GLuint fragment_shader_id);
+
+// Estado de oclusão de um objeto da cena, identificado por uma chave inteira.
+struct OcclusionEntry
+{
+    GLuint    query_id;       // Objeto de consulta de oclusão (glGenQueries)
+    bool      query_pending;  // Consulta emitida cujo resultado ainda não foi lido
+    bool      visible;        // Último resultado conhecido
+    bool      wants_query;    // Objeto deve ser consultado ao final deste quadro
+    glm::vec3 bbox_min;       // AABB em coordenadas globais usada na consulta
+    glm::vec3 bbox_max;
+};
+
+struct OcclusionCulling
+{
+    bool   enabled = true;
+    int    visible_requery_interval = 4;
+
+    GLuint program_id = 0;
+    GLint  bbox_min_uniform = -1;
+    GLint  bbox_max_uniform = -1;
+    GLuint cube_vao = 0;
+
+    std::vector<OcclusionEntry> entries;
+    unsigned int frame = 0;
+
+    // Contadores do quadro atual, mostrados na tela.
+    int objects_tested = 0;
+    int draws_skipped = 0;
+    int queries_issued = 0;
+    int results_read = 0;
+};
+
+OcclusionCulling g_OcclusionCulling;
+
+// Cria o programa de GPU e o cubo unitário utilizados para desenhar as AABBs.
+void OcclusionCulling_Init()
+{
+    GLuint vertex_shader_id = LoadShader_Vertex("../../src/shader_vertex_occlusion.glsl");
+    GLuint fragment_shader_id = LoadShader_Fragment("../../src/shader_fragment_occlusion.glsl");
+
+    if ( g_OcclusionCulling.program_id != 0 )
+        glDeleteProgram(g_OcclusionCulling.program_id);
+
+    g_OcclusionCulling.program_id = CreateGpuProgram(vertex_shader_id, fragment_shader_id);
+    FrameConstants_BindProgram(g_OcclusionCulling.program_id);
+    g_OcclusionCulling.bbox_min_uniform        = glGetUniformLocation(g_OcclusionCulling.program_id, "bbox_min");
+    g_OcclusionCulling.bbox_max_uniform        = glGetUniformLocation(g_OcclusionCulling.program_id, "bbox_max");
+
+    if ( g_OcclusionCulling.cube_vao != 0 )
+        return;
+
+    // Cubo unitário [0,1]^3; o vertex shader o estica até a AABB.
+    GLfloat model_coefficients[] = {
+        0.0f, 0.0f, 0.0f, 1.0f,
+        1.0f, 0.0f, 0.0f, 1.0f,
+        0.0f, 1.0f, 0.0f, 1.0f,
+        1.0f, 1.0f, 0.0f, 1.0f,
+        0.0f, 0.0f, 1.0f, 1.0f,
+        1.0f, 0.0f, 1.0f, 1.0f,
+        0.0f, 1.0f, 1.0f, 1.0f,
+        1.0f, 1.0f, 1.0f, 1.0f,
+    };
+
+    GLuint indices[] = {
+        0, 2, 1,  1, 2, 3, // z = 0
+        4, 5, 6,  5, 7, 6, // z = 1
+        0, 1, 4,  1, 5, 4, // y = 0
+        2, 6, 3,  3, 6, 7, // y = 1
+        0, 4, 2,  2, 4, 6, // x = 0
+        1, 3, 5,  3, 7, 5, // x = 1
+    };
+
+    glGenVertexArrays(1, &g_OcclusionCulling.cube_vao);
+    glBindVertexArray(g_OcclusionCulling.cube_vao);
+
+    GLuint VBO_model_coefficients_id;
+    glGenBuffers(1, &VBO_model_coefficients_id);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO_model_coefficients_id);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(model_coefficients), model_coefficients, GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 0, 0);
+    glEnableVertexAttribArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    GLuint indices_id;
+    glGenBuffers(1, &indices_id);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indices_id);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+
+    glBindVertexArray(0);
+}
+
+// Início de um quadro: lê (sem bloquear) os resultados de consultas emitidas
+// em quadros anteriores e zera os contadores.
+void OcclusionCulling_BeginFrame()
+{
+    g_OcclusionCulling.frame += 1;
+    g_OcclusionCulling.objects_tested = 0;
+    g_OcclusionCulling.draws_skipped = 0;
+    g_OcclusionCulling.queries_issued = 0;
+    g_OcclusionCulling.results_read = 0;
+
+    for (size_t i = 0; i < g_OcclusionCulling.entries.size(); ++i)
+    {
+        OcclusionEntry& entry = g_OcclusionCulling.entries[i];
+        entry.wants_query = false;
+
+        if ( !entry.query_pending )
+            continue;
+
+        GLuint available = GL_FALSE;
+        glGetQueryObjectuiv(entry.query_id, GL_QUERY_RESULT_AVAILABLE, &available);
+        if ( !available )
+            continue; // Ainda não terminou: mantemos a visibilidade anterior.
+
+        GLuint any_samples_passed = GL_TRUE;
+        glGetQueryObjectuiv(entry.query_id, GL_QUERY_RESULT, &any_samples_passed);
+        entry.visible = (any_samples_passed != GL_FALSE);
+        entry.query_pending = false;
+        g_OcclusionCulling.results_read += 1;
+    }
+}
+
+// Retorna se o objeto identificado por "key" deve ser desenhado neste quadro,
+// com base no último resultado conhecido. Também agenda uma nova consulta
+// para o objeto caso ela seja devida. A AABB deve estar em coordenadas globais.
+bool OcclusionCulling_IsVisible(unsigned int key, const glm::vec3& bbox_min, const glm::vec3& bbox_max, const glm::vec4& camera_position)
+{
+    if ( !g_OcclusionCulling.enabled )
+        return true;
+
+    if ( key >= g_OcclusionCulling.entries.size() )
+    {
+        size_t old_size = g_OcclusionCulling.entries.size();
+        g_OcclusionCulling.entries.resize(key + 1);
+        for (size_t i = old_size; i < g_OcclusionCulling.entries.size(); ++i)
+        {
+            OcclusionEntry& entry = g_OcclusionCulling.entries[i];
+            glGenQueries(1, &entry.query_id);
+            entry.query_pending = false;
+            entry.visible = true; // Objetos novos começam visíveis.
+            entry.wants_query = false;
+        }
+    }
+
+    OcclusionEntry& entry = g_OcclusionCulling.entries[key];
+    entry.bbox_min = bbox_min;
+    entry.bbox_max = bbox_max;
+
+    g_OcclusionCulling.objects_tested += 1;
+
+    // Se a câmera está dentro da AABB, as faces da caixa seriam recortadas
+    // pelo near plane e a consulta poderia falhar. O objeto é visível.
+    if ( colision_point_aabb(glm::vec3(camera_position), bbox_min, bbox_max, 0.2f) )
+    {
+        entry.visible = true;
+        return true;
+    }
+
+    if ( !entry.query_pending )
+    {
+        // Distribuímos as reconsultas de objetos visíveis ao longo dos quadros.
+        bool requery_visible = ((g_OcclusionCulling.frame + key) % g_OcclusionCulling.visible_requery_interval) == 0;
+        entry.wants_query = !entry.visible || requery_visible;
+    }
+
+    if ( !entry.visible )
+        g_OcclusionCulling.draws_skipped += 1;
+
+    return entry.visible;
+}
+
+// Emite as consultas agendadas no quadro atual. Deve ser chamada após todos
+// os objetos opacos terem sido desenhados, para que o Z-buffer contenha os
+// oclusores. Os resultados serão lidos por OcclusionCulling_BeginFrame().
+void OcclusionCulling_IssueQueries()
+{
+    if ( !g_OcclusionCulling.enabled )
+        return;
+
+    bool any_query = false;
+    for (size_t i = 0; i < g_OcclusionCulling.entries.size() && !any_query; ++i)
+        any_query = g_OcclusionCulling.entries[i].wants_query;
+
+    if ( !any_query )
+        return;
+
+    // Desenhamos as caixas sem alterar o framebuffer nem o Z-buffer. O
+    // backface culling é desabilitado para que caixas muito finas ou vistas
+    // de perto ainda gerem fragmentos.
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    glDepthMask(GL_FALSE);
+    glDepthFunc(GL_LEQUAL);
+    glDisable(GL_CULL_FACE);
+
+    glUseProgram(g_OcclusionCulling.program_id);
+    glBindVertexArray(g_OcclusionCulling.cube_vao);
+
+    for (size_t i = 0; i < g_OcclusionCulling.entries.size(); ++i)
+    {
+        OcclusionEntry& entry = g_OcclusionCulling.entries[i];
+        if ( !entry.wants_query )
+            continue;
+
+        glUniform4f(g_OcclusionCulling.bbox_min_uniform, entry.bbox_min.x, entry.bbox_min.y, entry.bbox_min.z, 1.0f);
+        glUniform4f(g_OcclusionCulling.bbox_max_uniform, entry.bbox_max.x, entry.bbox_max.y, entry.bbox_max.z, 1.0f);
+
+        glBeginQuery(GL_ANY_SAMPLES_PASSED, entry.query_id);
+        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, (void*)0);
+        glEndQuery(GL_ANY_SAMPLES_PASSED);
+
+        entry.query_pending = true;
+        entry.wants_query = false;
+        g_OcclusionCulling.queries_issued += 1;
+    }
+
+    glBindVertexArray(0);
+    glUseProgram(0);
+
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    glDepthMask(GL_TRUE);
+    glDepthFunc(GL_LESS);
+    glEnable(GL_CULL_FACE);
+}
+
+// Liga/desliga o culling por oclusão. Ao desligar, descartamos os resultados
+// antigos para que todos objetos voltem a ser desenhados imediatamente.
+void OcclusionCulling_Toggle()
+{
+    g_OcclusionCulling.enabled = !g_OcclusionCulling.enabled;
+
+    for (size_t i = 0; i < g_OcclusionCulling.entries.size(); ++i)
+    {
+        g_OcclusionCulling.entries[i].visible = true;
+        g_OcclusionCulling.entries[i].wants_query = false;
+    }
+}
@@ -0,0 +1,397 @@
+// Sistema de partículas na GPU, simulado com transform feedback.
+//
+// As partículas vivem somente na GPU, em dois buffers com o mesmo número
+// de posições ("capacity"). A cada quadro, "shader_vertex_particle_update.glsl"
+// lê todas as partículas de um buffer, desenhadas como pontos com
+// GL_RASTERIZER_DISCARD, e grava o novo estado de cada uma no outro buffer
+// (ping-pong); o buffer escrito é então desenhado como quadriláteros
+// instanciados ("shader_vertex_particle.glsl"), um por partícula, no passo
+// RENDER_PASS_BLENDED da fila de renderização.
+//
+// A CPU não percorre partículas. Particles_Emit() somente reserva um trecho
+// do anel de partículas (as mais antigas são substituídas) e guarda um
+// emissor, enviado como uniform: as partículas desse trecho renascem na GPU,
+// com posição, velocidade e tempo de vida aleatórios. O custo de CPU por
+// quadro é, portanto, fixo (poucos uniforms e até três chamadas de
+// desenho), qualquer que seja o número de partículas. Quando todas as
+// partículas já morreram, a simulação e o desenho são omitidos.
+//
+// Como o anel é preenchido em ordem, as partículas possivelmente vivas são
+// sempre as últimas reservadas antes de "cursor": a CPU guarda quantas
+// posições cada quadro reservou e, descartando os quadros mais antigos que
+// o maior tempo de vida, sabe o tamanho dessa janela ("live"). Somente ela
+// é desenhada, em uma ou duas partes se passar do fim do anel.
+//
+// A gravidade é a mesma do personagem e dos projéteis ("gravity" em
+// "main.cpp"). A GPU não conhece os colisores da cena: cada partícula
+// guarda a altura do chão sob o ponto onde foi emitida e quica nesse plano.
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include <glad/glad.h>
+
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#define PARTICLE_UPDATE_VERTEX_FILE "../../src/shader_vertex_particle_update.glsl"
+#define PARTICLE_VERTEX_FILE        "../../src/shader_vertex_particle.glsl"
+#define PARTICLE_FRAGMENT_FILE      "../../src/shader_fragment_particle.glsl"
+#define PARTICLE_MAX_EMITTERS       16     // Emissores por quadro; os seguintes são ignorados
+#define PARTICLE_DEFAULT_CAPACITY   262144 // Partículas em cada buffer
+
+// Partículas emitidas pelos eventos do jogo (veja main.cpp)
+#define PARTICLE_LANDING_COUNT      40000  // Pouso a partir de 8 m/s; menos em quedas mais lentas
+#define PARTICLE_TRAIL_RATE         60000  // Por segundo no ar
+#define PARTICLE_IMPACT_COUNT       20000  // Impacto a partir de 10 m/s; menos em impactos mais lentos
+#define PARTICLE_IMPACT_MIN_SPEED   2.0f   // Mudança de velocidade mínima para um impacto
+
+void LoadShader(const char* filename, GLuint shader_id, const std::string& defines); // Função definida em main.cpp
+
+// Tipos de partícula. A cor, o arrasto e o crescimento de cada tipo estão
+// nos shaders, indexados por este valor.
+enum ParticleKind
+{
+    PARTICLE_DUST  = 0, // Poeira do pouso do personagem
+    PARTICLE_TRAIL = 1, // Rastro do personagem no ar
+    PARTICLE_SPARK = 2, // Faíscas do impacto de projéteis
+    PARTICLE_KIND_COUNT
+};
+
+// Parâmetros de emissão de cada tipo
+struct ParticlePreset
+{
+    float radius;   // Raio da região de emissão, no plano XZ
+    float speed;    // Variação aleatória da velocidade
+    float vertical; // Fração vertical da direção aleatória
+    float lifetime; // Tempo de vida máximo (s)
+    float size;     // Meia largura do quadrilátero
+};
+
+// Posições do anel reservadas em um quadro anterior
+struct ParticleBatch
+{
+    float age;   // Segundos desde a emissão
+    int   count;
+};
+
+static const ParticlePreset g_ParticlePresets[PARTICLE_KIND_COUNT] =
+{
+    { 0.3f, 5.0f, 0.25f, 1.2f, 0.06f }, // PARTICLE_DUST
+    { 0.1f, 0.4f, 1.0f, 0.6f, 0.04f }, // PARTICLE_TRAIL
+    { 0.0f, 6.0f, 1.5f, 0.9f, 0.02f }, // PARTICLE_SPARK
+};
+
+// Uma partícula, no layout dos atributos dos shaders (48 bytes)
+struct ParticleVertex
+{
+    glm::vec4 position_age;  // xyz = posição, w = idade (s)
+    glm::vec4 velocity_life; // xyz = velocidade, w = tempo de vida (s)
+    glm::vec4 info;          // x = altura do chão, y = tamanho, z = tipo, w = valor aleatório
+};
+
+struct ParticleSystem
+{
+    bool   enabled = true;     // Falso com "--no-particles"
+    bool   supported = false;  // Programa de simulação criado
+    int    capacity = PARTICLE_DEFAULT_CAPACITY; // "--particles <n>"
+
+    GLuint update_program_id = 0;
+    GLint  delta_time_uniform = -1;
+    GLint  gravity_uniform = -1;
+    GLint  emitter_count_uniform = -1;
+    GLint  emitter_ranges_uniform = -1;
+    GLint  emitter_origins_uniform = -1;
+    GLint  emitter_motions_uniform = -1;
+    GLint  emitter_velocities_uniform = -1;
+    GLint  emitter_params_uniform = -1;
+    int    render_variant = -1; // Programa de desenho (veja "shader_variants.cpp")
+
+    GLuint buffers[2] = {};
+    GLuint update_vaos[2] = {}; // Atributos de buffers[i], um por vértice
+    GLuint render_vaos[2] = {}; // Atributos de buffers[i], um por instância
+    GLuint window_vaos[2] = {}; // Idem, a partir da posição "window_first"
+    int    window_first = 0;
+    int    current = 0;         // Buffer com o estado mais recente
+
+    // Emissores do quadro, enviados por Particles_Simulate()
+    int        emitter_count = 0;
+    glm::ivec4 emitter_ranges[PARTICLE_MAX_EMITTERS];
+    glm::vec4  emitter_origins[PARTICLE_MAX_EMITTERS];
+    glm::vec4  emitter_motions[PARTICLE_MAX_EMITTERS];
+    glm::vec4  emitter_velocities[PARTICLE_MAX_EMITTERS];
+    glm::vec4  emitter_params[PARTICLE_MAX_EMITTERS];
+    int        cursor = 0;          // Próxima posição do anel
+    int        reserving = 0;       // Posições reservadas no quadro atual
+    std::vector<ParticleBatch> batches; // Quadros que ainda podem ter partículas vivas
+    int        live = 0;            // Posições antes de "cursor" que podem estar vivas
+    unsigned int seed = 0;
+    float      idle_time = 1e9f;    // Segundos desde a última emissão
+    float      max_lifetime = 0.0f; // Maior tempo de vida entre os tipos
+    bool       active = false;      // Há partículas vivas neste quadro
+
+    // Estatísticas
+    int    emitted_frame = 0;  // Partículas emitidas no último quadro simulado
+    int    emitting = 0;       // Partículas emitidas no quadro atual
+    long   emitted_total = 0;
+    int    dropped = 0;        // Emissões ignoradas por falta de emissores
+};
+
+ParticleSystem g_Particles;
+
+// Liga os atributos das partículas de "buffer_id", a partir da partícula
+// "first", ao VAO, com o divisor dado.
+static void Particles_SetAttributes(GLuint vertex_array_object_id, GLuint buffer_id, GLuint divisor, int first = 0)
+{
+    glBindVertexArray(vertex_array_object_id);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer_id);
+    for (GLuint location = 0; location < 3; ++location)
+    {
+        glEnableVertexAttribArray(location);
+        glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, sizeof(ParticleVertex), (void*)(first * sizeof(ParticleVertex) + location * sizeof(glm::vec4)));
+        glVertexAttribDivisor(location, divisor);
+    }
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+// Cria o programa de simulação e os buffers. Deve ser chamada após a
+// criação do contexto OpenGL.
+void Particles_Init()
+{
+    ParticleSystem& particles = g_Particles;
+    if ( !particles.enabled || particles.update_program_id != 0 )
+        return;
+
+    char defines[64];
+    snprintf(defines, sizeof(defines), "#define PARTICLE_MAX_EMITTERS %d\n", PARTICLE_MAX_EMITTERS);
+
+    GLuint vertex_shader_id = glCreateShader(GL_VERTEX_SHADER);
+    LoadShader(PARTICLE_UPDATE_VERTEX_FILE, vertex_shader_id, defines);
+
+    // O estado é gravado intercalado, no layout de ParticleVertex; por isso
+    // os varyings são definidos antes da linkagem.
+    GLuint program_id = glCreateProgram();
+    glAttachShader(program_id, vertex_shader_id);
+    const char* varyings[] = { "out_position_age", "out_velocity_life", "out_info" };
+    glTransformFeedbackVaryings(program_id, 3, varyings, GL_INTERLEAVED_ATTRIBS);
+    glLinkProgram(program_id);
+    glDeleteShader(vertex_shader_id);
+
+    GLint linked_ok = GL_FALSE;
+    glGetProgramiv(program_id, GL_LINK_STATUS, &linked_ok);
+    if ( linked_ok == GL_FALSE )
+    {
+        GLchar log[1024];
+        glGetProgramInfoLog(program_id, sizeof(log), NULL, log);
+        fprintf(stderr, "ERROR: OpenGL linking of particle program failed; particles disabled.\n== Start of link log\n%s\n== End of link log\n", log);
+        glDeleteProgram(program_id);
+        return;
+    }
+
+    particles.update_program_id = program_id;
+    particles.delta_time_uniform = glGetUniformLocation(program_id, "delta_time");
+    particles.gravity_uniform = glGetUniformLocation(program_id, "gravity");
+    particles.emitter_count_uniform = glGetUniformLocation(program_id, "emitter_count");
+    particles.emitter_ranges_uniform = glGetUniformLocation(program_id, "emitter_ranges");
+    particles.emitter_origins_uniform = glGetUniformLocation(program_id, "emitter_origins");
+    particles.emitter_motions_uniform = glGetUniformLocation(program_id, "emitter_motions");
+    particles.emitter_velocities_uniform = glGetUniformLocation(program_id, "emitter_velocities");
+    particles.emitter_params_uniform = glGetUniformLocation(program_id, "emitter_params");
+
+    // Os dois buffers começam zerados: idade 0 e tempo de vida 0, ou seja,
+    // todas as partículas mortas.
+    glGenBuffers(2, particles.buffers);
+    glGenVertexArrays(2, particles.update_vaos);
+    glGenVertexArrays(2, particles.render_vaos);
+    glGenVertexArrays(2, particles.window_vaos);
+    std::vector<ParticleVertex> zero(particles.capacity, ParticleVertex{ glm::vec4(0.0f), glm::vec4(0.0f), glm::vec4(0.0f) });
+    for (int i = 0; i < 2; ++i)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, particles.buffers[i]);
+        glBufferData(GL_ARRAY_BUFFER, particles.capacity * sizeof(ParticleVertex), zero.data(), GL_DYNAMIC_COPY);
+        Particles_SetAttributes(particles.update_vaos[i], particles.buffers[i], 0);
+        Particles_SetAttributes(particles.render_vaos[i], particles.buffers[i], 1);
+        Particles_SetAttributes(particles.window_vaos[i], particles.buffers[i], 1);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    for (int kind = 0; kind < PARTICLE_KIND_COUNT; ++kind)
+        particles.max_lifetime = std::max(particles.max_lifetime, g_ParticlePresets[kind].lifetime);
+
+    particles.supported = true;
+    printf("Particles: %d on the GPU (%.1f MB), transform feedback simulation.\n",
+           particles.capacity, 2.0 * particles.capacity * sizeof(ParticleVertex) / (1024.0 * 1024.0));
+}
+
+// Retorna se o sistema de partículas deve ser utilizado.
+bool Particles_Active()
+{
+    return g_Particles.enabled && g_Particles.supported;
+}
+
+// Guarda um emissor para o trecho [first, first + count) do anel.
+static void Particles_AddEmitter(ParticleKind kind, int first, int count, const glm::vec3& origin,
+                                 const glm::vec3& motion, const glm::vec3& velocity, float ground_y)
+{
+    ParticleSystem& particles = g_Particles;
+    if ( particles.emitter_count == PARTICLE_MAX_EMITTERS )
+    {
+        particles.dropped += 1;
+        return;
+    }
+
+    const ParticlePreset& preset = g_ParticlePresets[kind];
+    int e = particles.emitter_count++;
+    particles.emitter_ranges[e] = glm::ivec4(first, count, kind, (int)(++particles.seed));
+    particles.emitter_origins[e] = glm::vec4(origin, preset.radius);
+    particles.emitter_motions[e] = glm::vec4(motion, ground_y);
+    particles.emitter_velocities[e] = glm::vec4(velocity, preset.speed);
+    particles.emitter_params[e] = glm::vec4(preset.lifetime, preset.size, preset.vertical, 0.0f);
+    particles.emitting += count;
+}
+
+// Emite "count" partículas do tipo "kind" na próxima simulação. As
+// partículas saem ao longo do segmento de "origin" a "origin + motion"
+// (o deslocamento do emissor no quadro), com velocidade média "velocity",
+// e quicam no plano y = "ground_y" (std::numeric_limits<float>::lowest()
+// se não há chão sob o emissor).
+void Particles_Emit(ParticleKind kind, const glm::vec3& origin, const glm::vec3& motion,
+                    const glm::vec3& velocity, float ground_y, int count)
+{
+    ParticleSystem& particles = g_Particles;
+    if ( !Particles_Active() || count <= 0 )
+        return;
+
+    // As partículas mais antigas do anel são substituídas; um trecho que
+    // passa do fim do anel vira dois emissores.
+    count = std::min(count, particles.capacity);
+    particles.reserving += count;
+    int first = particles.cursor;
+    int tail = std::min(count, particles.capacity - first);
+    Particles_AddEmitter(kind, first, tail, origin, motion * ((float)tail / count), velocity, ground_y);
+    if ( tail < count )
+        Particles_AddEmitter(kind, 0, count - tail, origin + motion * ((float)tail / count),
+                             motion * ((float)(count - tail) / count), velocity, ground_y);
+    particles.cursor = (first + count) % particles.capacity;
+}
+
+// Avança a simulação de todas as partículas em "delta_time" segundos, com
+// a aceleração vertical "gravity", emitindo as partículas pedidas desde a
+// última chamada.
+void Particles_Simulate(float delta_time, float gravity)
+{
+    ParticleSystem& particles = g_Particles;
+    if ( !Particles_Active() )
+        return;
+
+    particles.idle_time = particles.emitter_count > 0 ? 0.0f : particles.idle_time + delta_time;
+    particles.active = particles.idle_time <= particles.max_lifetime;
+    if ( !particles.active )
+    {
+        particles.batches.clear();
+        particles.live = 0;
+        return;
+    }
+
+    glUseProgram(particles.update_program_id);
+    glUniform1f(particles.delta_time_uniform, delta_time);
+    glUniform1f(particles.gravity_uniform, gravity);
+    glUniform1i(particles.emitter_count_uniform, particles.emitter_count);
+    if ( particles.emitter_count > 0 )
+    {
+        GLsizei n = particles.emitter_count;
+        glUniform4iv(particles.emitter_ranges_uniform, n, glm::value_ptr(particles.emitter_ranges[0]));
+        glUniform4fv(particles.emitter_origins_uniform, n, glm::value_ptr(particles.emitter_origins[0]));
+        glUniform4fv(particles.emitter_motions_uniform, n, glm::value_ptr(particles.emitter_motions[0]));
+        glUniform4fv(particles.emitter_velocities_uniform, n, glm::value_ptr(particles.emitter_velocities[0]));
+        glUniform4fv(particles.emitter_params_uniform, n, glm::value_ptr(particles.emitter_params[0]));
+    }
+
+    int source = particles.current;
+    int target = 1 - source;
+
+    glEnable(GL_RASTERIZER_DISCARD);
+    glBindVertexArray(particles.update_vaos[source]);
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, particles.buffers[target]);
+    glBeginTransformFeedback(GL_POINTS);
+    glDrawArrays(GL_POINTS, 0, particles.capacity);
+    glEndTransformFeedback();
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+    glBindVertexArray(0);
+    glDisable(GL_RASTERIZER_DISCARD);
+    glUseProgram(0);
+
+    particles.current = target;
+
+    // Janela de partículas possivelmente vivas: as posições reservadas pelos
+    // quadros mais novos que o maior tempo de vida, incluindo este. Emissores
+    // descartados também contam, pois o cursor avançou sobre suas posições.
+    particles.live = 0;
+    size_t kept = 0;
+    for (size_t i = 0; i < particles.batches.size(); ++i)
+    {
+        ParticleBatch batch = particles.batches[i];
+        batch.age += delta_time;
+        if ( batch.age >= particles.max_lifetime )
+            continue;
+        particles.batches[kept++] = batch;
+        particles.live += batch.count;
+    }
+    particles.batches.resize(kept);
+    if ( particles.reserving > 0 )
+    {
+        particles.batches.push_back(ParticleBatch{ 0.0f, particles.reserving });
+        particles.live += particles.reserving;
+    }
+    particles.live = std::min(particles.live, particles.capacity);
+    particles.reserving = 0;
+
+    particles.emitted_frame = particles.emitting;
+    particles.emitted_total += particles.emitting;
+    particles.emitting = 0;
+    particles.emitter_count = 0;
+}
+
+// Enfileira o desenho das partículas possivelmente vivas simuladas neste
+// quadro: a janela de "live" posições antes de "cursor", em duas partes se
+// ela passar do fim do anel.
+void Particles_Queue()
+{
+    ParticleSystem& particles = g_Particles;
+    if ( !Particles_Active() || !particles.active || particles.live == 0 || particles.render_variant < 0 )
+        return;
+
+    // Os atributos por instância não aceitam uma posição inicial no
+    // OpenGL 3.3 (glDrawArraysInstancedBaseInstance é do 4.2), então o VAO
+    // da janela é apontado para o seu início.
+    int first = (particles.cursor - particles.live + particles.capacity) % particles.capacity;
+    int tail = std::min(particles.live, particles.capacity - first);
+    if ( first != particles.window_first )
+    {
+        for (int i = 0; i < 2; ++i)
+            Particles_SetAttributes(particles.window_vaos[i], particles.buffers[i], 1, first);
+        particles.window_first = first;
+    }
+
+    DrawPacket packet = RenderQueue_MakePacket(RENDER_PASS_BLENDED, g_ShaderVariants.variants[particles.render_variant].render_program);
+    packet.vao = particles.window_vaos[particles.current];
+    packet.command = RENDER_DRAW_ARRAYS_INSTANCED;
+    packet.mode = GL_TRIANGLE_STRIP;
+    packet.first = 0;
+    packet.count = 4;
+    packet.instance_count = tail;
+    packet.timer = GPU_TIMER_PARTICLES;
+    packet.replaceable = false;
+    RenderQueue_Push(packet, glm::mat4(1.0f), g_RenderQueue.camera_position);
+
+    if ( tail < particles.live )
+    {
+        packet.vao = particles.render_vaos[particles.current];
+        packet.instance_count = particles.live - tail;
+        RenderQueue_Push(packet, glm::mat4(1.0f), g_RenderQueue.camera_position);
+    }
+}
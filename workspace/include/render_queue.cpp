@@ -0,0 +1,741 @@
+// Fila de renderização com chaves de ordenação e cache de estado OpenGL.
+//
+// Em vez de chamar glUseProgram(), glBindVertexArray(), glUniform*() e
+// glDraw*() diretamente, o laço principal enfileira "pacotes de desenho"
+// (DrawPacket) com RenderQueue_Push(). Cada pacote recebe uma chave de 64
+// bits; RenderQueue_Submit() ordena os pacotes pela chave e os envia para a
+// GPU através de um cache de estado, que descarta trocas de estado
+// redundantes (mesmo programa, mesmo VAO, mesma textura, mesmo valor de
+// uniform). A ordem dos campos na chave define a prioridade da ordenação:
+//
+//     bits 60-63  posição do passo na ordem configurada (RenderQueue_PassRank())
+//     bits 52-59  programa de GPU
+//     bits 40-51  material (object_id; dentro de uma variante de programa)
+//     bits 24-39  VAO
+//     bits  0-23  profundidade (distância até a câmera, da frente para trás)
+//
+// Com "front_to_back" (padrão), os passos de objetos opacos colocam a
+// profundidade logo após o passo, de modo que os objetos próximos são
+// desenhados primeiro e escondem, pelo teste de profundidade, os fragmentos
+// dos objetos atrás deles; o estado fica em segundo lugar:
+//
+//     bits 60-63  passo
+//     bits 36-59  profundidade
+//     bits 28-35  programa de GPU
+//     bits 16-27  material
+//     bits  0-15  VAO
+//
+// Outras opções de RenderPassOrder: um passo que somente escreve
+// profundidade antes dos opacos ("depth prepass"), que então sombreiam
+// cada pixel uma única vez com GL_LEQUAL; o skybox por último, na
+// profundidade máxima, desenhado somente onde nenhum objeto foi desenhado;
+// e uma visualização de overdraw, que troca os programas por um que soma
+// uma cor constante com blending aditivo. O número de fragmentos
+// sombreados por pixel é medido com uma consulta GL_SAMPLES_PASSED.
+// Pacotes translúcidos (RENDER_PASS_BLENDED) são desenhados depois de
+// todos os outros, inclusive do skybox, sem escrever profundidade.
+//
+// O cache é invalidado no início de cada RenderQueue_Submit(), pois o
+// código fora da fila (texto, consultas de oclusão, ...) altera o estado
+// OpenGL diretamente.
+//
+// Listas de comandos: além dos pacotes enfileirados pela thread do OpenGL
+// com RenderQueue_Push(), tarefas do sistema de tarefas ("job_system.cpp")
+// podem preparar pacotes em paralelo, cada uma na sua RenderCommandList
+// (RenderQueue_BeginLists() e RenderQueue_PushTo()). RenderQueue_Build()
+// prepara (prepass, overdraw) e ordena cada lista em uma tarefa e então
+// intercala as listas ordenadas em g_RenderQueue.packets; a thread do
+// OpenGL somente percorre o resultado. Pacotes com "camera_visible" falso
+// (fora do frustum) não são desenhados pela câmera, mas continuam na fila
+// para os mapas de sombra.
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+#include <iterator>
+
+#include <glad/glad.h>
+
+#include <glm/mat3x3.hpp>
+#include <glm/mat4x4.hpp>
+#include <glm/matrix.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+// Passos de renderização, na ordem em que são desenhados. Cada passo define
+// o estado de profundidade e de culling (veja RenderState_SetPass()).
+enum RenderPass
+{
+    RENDER_PASS_SKY           = 0, // Sem escrita de profundidade, GL_LEQUAL, sem culling
+    RENDER_PASS_OPAQUE        = 1, // Estado padrão: escrita de profundidade, GL_LESS (GL_LEQUAL após o prepass), backface culling
+    RENDER_PASS_DEPTH_PREPASS = 2, // Somente profundidade (sem escrita de cor), GL_LESS, backface culling
+    RENDER_PASS_BLENDED       = 3, // Sem escrita de profundidade, GL_LESS, sem culling, blending com cor multiplicada pelo alfa; sempre o último
+    RENDER_PASS_COUNT
+};
+
+// Ordem dos passos e opções para reduzir o overdraw.
+struct RenderPassOrder
+{
+    bool front_to_back = true;  // Opacos ordenados da frente para trás antes do estado
+    bool depth_prepass = false; // Passo somente de profundidade antes dos opacos
+    bool sky_last = true;       // Skybox depois dos opacos (senão, antes)
+    bool overdraw_view = false; // Visualização do overdraw por pixel
+
+    // Programas (índices da fila) utilizados pelas opções acima; -1 = indisponível
+    int depth_program = -1;        // shader_vertex.glsl sem saída de cor
+    int overdraw_program = -1;     // shader_vertex.glsl com cor constante
+    int overdraw_sky_program = -1; // shader_vertex_skybox.glsl com cor constante
+};
+
+// Programas de GPU conhecidos pela fila. Os índices entram na chave de
+// ordenação. As variantes do programa principal ocupam os índices a partir
+// de RENDER_PROGRAM_FIRST_VARIANT (veja "shader_variants.cpp").
+enum RenderProgramIndex
+{
+    RENDER_PROGRAM_SKYBOX        = 0,
+    RENDER_PROGRAM_FIRST_VARIANT = 1
+};
+
+enum RenderCommand
+{
+    RENDER_DRAW_ARRAYS,             // glDrawArrays(mode, first, count)
+    RENDER_DRAW_ARRAYS_INSTANCED,   // glDrawArraysInstanced(mode, first, count, instance_count)
+    RENDER_DRAW_ELEMENTS,           // glDrawElements(mode, count, GL_UNSIGNED_INT, offset)
+    RENDER_MULTI_DRAW_ELEMENTS,     // glMultiDrawElements(mode, multi_counts, GL_UNSIGNED_INT, multi_offsets, multi_draw_count)
+    RENDER_DRAW_ELEMENTS_INSTANCED, // glDrawElementsInstanced(mode, count, GL_UNSIGNED_INT, offset, instance_count)
+    RENDER_DRAW_ELEMENTS_INDIRECT   // glDrawElementsIndirect(mode, GL_UNSIGNED_INT, offset) com o comando em indirect_buffer
+};
+
+// glDrawElementsIndirect() (OpenGL 4.0), ausente no GLAD do OpenGL 3.3;
+// carregada por GpuCulling_Init() (veja "gpu_culling.cpp").
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+typedef void (APIENTRYP RenderDrawElementsIndirectProc)(GLenum mode, GLenum type, const void* indirect);
+
+// Programa de GPU e a localização dos uniforms que a fila controla. Uniforms
+// ausentes no programa têm localização -1 e são ignorados.
+struct RenderProgram
+{
+    GLuint program_id = 0;
+    GLint  model_uniform = -1;
+    GLint  normal_matrix_uniform = -1;         // inverse(transpose(model)), 3x3
+    GLint  model_view_projection_uniform = -1; // view_projection * model
+    GLint  bbox_min_uniform = -1;
+    GLint  bbox_max_uniform = -1;
+    GLint  instanced_uniform = -1;
+};
+
+// Participação de um pacote nos mapas de sombra (veja "shadow_maps.cpp").
+// Geometria estática é desenhada em cascatas guardadas entre quadros;
+// objetos que se movem são desenhados a cada quadro.
+enum ShadowCaster
+{
+    SHADOW_CASTER_NONE    = 0,
+    SHADOW_CASTER_STATIC  = 1,
+    SHADOW_CASTER_DYNAMIC = 2
+};
+
+struct DrawPacket
+{
+    uint64_t      key;
+    RenderPass    pass;
+    int           program;          // RenderProgramIndex
+    GLuint        vao;
+    RenderCommand command;
+    GLenum        mode;
+    GLint         first;
+    GLsizei       count;
+    const void*   offset;
+    GLsizei       instance_count;
+    GLuint        indirect_buffer;  // Buffer com o comando de RENDER_DRAW_ELEMENTS_INDIRECT
+    const GLsizei*      multi_counts;
+    const void* const*  multi_offsets;
+    GLsizei       multi_draw_count;
+    int           object_id;        // Material; determina a variante de programa
+    int           model_index;      // Índice em RenderQueue::matrices
+    glm::vec3     bbox_min;
+    glm::vec3     bbox_max;
+    GLenum        texture_target;   // Textura extra do pacote (0 = nenhuma)
+    GLuint        texture_id;
+    GLuint        texture_unit;
+    ShadowCaster  shadow_caster;
+    int           timer;            // GpuTimerPass ao qual o tempo de GPU é atribuído
+    bool          camera_visible;   // Falso: somente para os mapas de sombra (fora do frustum)
+    bool          replaceable;      // Programa com "shader_vertex.glsl" e sem discard: o prepass e o overdraw podem trocá-lo
+    uint32_t      depth;            // Distância até a câmera, quantizada em 24 bits
+};
+
+// Estado OpenGL conhecido pelo cache. Valores "desconhecidos" forçam a
+// próxima troca a ser emitida.
+#define RENDER_STATE_MAX_TEXTURE_UNITS 16
+
+struct RenderStateCache
+{
+    GLuint    program;
+    GLuint    vao;
+    GLenum    texture_targets[RENDER_STATE_MAX_TEXTURE_UNITS];
+    GLuint    textures[RENDER_STATE_MAX_TEXTURE_UNITS];
+    int       pass;
+
+    // Últimos valores enviados aos uniforms de cada programa
+    struct ProgramUniforms
+    {
+        bool      valid;
+        int       instanced;
+        glm::mat4 model;
+        glm::vec3 bbox_min;
+        glm::vec3 bbox_max;
+    };
+    std::vector<ProgramUniforms> uniforms;
+};
+
+// Pacotes preparados por uma tarefa. "model_index" indexa "matrices" da
+// própria lista até RenderQueue_Build().
+struct RenderCommandList
+{
+    std::vector<DrawPacket> packets;
+    std::vector<glm::mat4>  matrices;
+    int                     frustum_culled = 0; // Pacotes descartados ou somente de sombra
+};
+
+struct RenderQueue
+{
+    std::vector<RenderProgram> programs;
+    std::vector<DrawPacket> packets;
+    std::vector<glm::mat4>  matrices;
+    glm::vec4               camera_position;
+    std::vector<RenderCommandList> lists; // Listas preparadas pelas tarefas
+    std::vector<DrawPacket> merge_buffer;
+    bool                    built = false; // RenderQueue_Build() já foi executada neste quadro
+    float                   max_depth = 500.0f; // Distância que corresponde à maior profundidade na chave
+
+    RenderStateCache        cache;
+    RenderPassOrder         order;
+
+    RenderDrawElementsIndirectProc draw_elements_indirect = NULL;
+
+    // Consultas GL_SAMPLES_PASSED dos passos com escrita de cor, lidas um
+    // quadro depois para não esperar a GPU.
+    GLuint samples_queries[2] = { 0, 0 };
+    bool   samples_pending[2] = { false, false };
+    int    samples_pixels[2] = { 0, 0 };
+    int    samples_frame = 0;
+
+    // Estatísticas do último quadro
+    int draw_calls = 0;
+    int state_changes = 0;  // Trocas de estado emitidas para o OpenGL
+    int state_elided = 0;   // Trocas descartadas por serem redundantes
+    int frustum_culled = 0; // Pacotes fora do frustum (descartados ou somente de sombra)
+    int lists_merged = 0;   // Listas de comandos preparadas em paralelo
+    float shaded_per_pixel = 0.0f; // Fragmentos sombreados por pixel da tela (medido)
+};
+
+RenderQueue g_RenderQueue;
+
+// Define (ou redefine, ao recarregar os shaders) um dos programas da fila.
+void RenderQueue_SetProgram(int index, const RenderProgram& program)
+{
+    if ( index >= (int)g_RenderQueue.programs.size() )
+    {
+        g_RenderQueue.programs.resize(index + 1);
+        g_RenderQueue.cache.uniforms.resize(index + 1);
+    }
+    g_RenderQueue.programs[index] = program;
+    g_RenderQueue.cache.uniforms[index].valid = false;
+}
+
+// Inicia um novo quadro, descartando os pacotes do quadro anterior. A
+// posição da câmera é utilizada para o campo de profundidade das chaves.
+void RenderQueue_Begin(const glm::vec4& camera_position)
+{
+    g_RenderQueue.packets.clear();
+    g_RenderQueue.matrices.clear();
+    g_RenderQueue.lists.clear();
+    g_RenderQueue.built = false;
+    g_RenderQueue.camera_position = camera_position;
+}
+
+// Prepara "count" listas de comandos vazias, uma por tarefa, preenchidas
+// com RenderQueue_PushTo().
+void RenderQueue_BeginLists(int count)
+{
+    RenderQueue& queue = g_RenderQueue;
+    queue.lists.resize(count);
+    for (int i = 0; i < count; ++i)
+    {
+        queue.lists[i].packets.clear();
+        queue.lists[i].matrices.clear();
+        queue.lists[i].frustum_culled = 0;
+    }
+}
+
+// Retorna um pacote com valores padrão para o passo e programa dados; o
+// chamador preenche o comando de desenho e o envia com RenderQueue_Push().
+DrawPacket RenderQueue_MakePacket(RenderPass pass, int program)
+{
+    DrawPacket packet;
+    packet.key = 0;
+    packet.pass = pass;
+    packet.program = program;
+    packet.vao = 0;
+    packet.command = RENDER_DRAW_ARRAYS;
+    packet.mode = GL_TRIANGLES;
+    packet.first = 0;
+    packet.count = 0;
+    packet.offset = NULL;
+    packet.instance_count = 0;
+    packet.indirect_buffer = 0;
+    packet.multi_counts = NULL;
+    packet.multi_offsets = NULL;
+    packet.multi_draw_count = 0;
+    packet.object_id = 0;
+    packet.model_index = -1;
+    packet.bbox_min = glm::vec3(0.0f);
+    packet.bbox_max = glm::vec3(0.0f);
+    packet.texture_target = 0;
+    packet.texture_id = 0;
+    packet.texture_unit = 0;
+    packet.shadow_caster = SHADOW_CASTER_NONE;
+    packet.timer = pass == RENDER_PASS_SKY ? GPU_TIMER_SKY : GPU_TIMER_OPAQUE;
+    packet.camera_visible = true;
+    packet.replaceable = true;
+    packet.depth = 0;
+    return packet;
+}
+
+// Posição de um passo na ordem de desenho configurada.
+static uint64_t RenderQueue_PassRank(RenderPass pass)
+{
+    switch ( pass )
+    {
+    case RENDER_PASS_DEPTH_PREPASS: return 0;
+    case RENDER_PASS_OPAQUE:        return 2;
+    case RENDER_PASS_SKY:           return g_RenderQueue.order.sky_last ? 3 : 1;
+    case RENDER_PASS_BLENDED:       return 4;
+    default:                        return 4;
+    }
+}
+
+// Chave de ordenação de um pacote (veja o comentário no início do arquivo).
+static uint64_t RenderQueue_MakeKey(const DrawPacket& packet)
+{
+    uint64_t rank = RenderQueue_PassRank(packet.pass);
+    if ( g_RenderQueue.order.front_to_back && packet.pass != RENDER_PASS_SKY )
+        return (rank << 60)
+             | ((uint64_t)(packet.depth     & 0xFFFFFF) << 36)
+             | ((uint64_t)(packet.program   & 0xFF)  << 28)
+             | ((uint64_t)(packet.object_id & 0xFFF) << 16)
+             | ((uint64_t)(packet.vao       & 0xFFFF));
+
+    return (rank << 60)
+         | ((uint64_t)(packet.program   & 0xFF)  << 52)
+         | ((uint64_t)(packet.object_id & 0xFFF) << 40)
+         | ((uint64_t)(packet.vao       & 0xFFFF) << 24)
+         | (uint64_t)(packet.depth & 0xFFFFFF);
+}
+
+// Calcula a profundidade e a chave de um pacote e o acrescenta a "packets",
+// com a matriz em "matrices". Só lê o estado da fila, e pode ser chamada
+// por várias tarefas ao mesmo tempo, com listas diferentes.
+static void RenderQueue_Append(std::vector<DrawPacket>& packets, std::vector<glm::mat4>& matrices,
+                               DrawPacket packet, const glm::mat4& model, const glm::vec4& center)
+{
+    const RenderQueue& queue = g_RenderQueue;
+
+    packet.model_index = matrices.size();
+    matrices.push_back(model);
+
+    glm::vec4 d = center - queue.camera_position;
+    float distance = sqrtf(d.x*d.x + d.y*d.y + d.z*d.z);
+    float normalized = std::min(std::max(distance / queue.max_depth, 0.0f), 1.0f);
+    packet.depth = (uint32_t)(normalized * 0xFFFFFF);
+    packet.key = RenderQueue_MakeKey(packet);
+
+    packets.push_back(packet);
+}
+
+// Enfileira um pacote com a matriz de modelagem "model". "center" é um ponto
+// (em coordenadas globais) usado para ordenar pacotes pela distância até a câmera.
+void RenderQueue_Push(DrawPacket packet, const glm::mat4& model, const glm::vec4& center)
+{
+    RenderQueue_Append(g_RenderQueue.packets, g_RenderQueue.matrices, packet, model, center);
+}
+
+// Idem, em uma lista de comandos preparada por uma tarefa.
+void RenderQueue_PushTo(RenderCommandList& list, DrawPacket packet, const glm::mat4& model, const glm::vec4& center)
+{
+    RenderQueue_Append(list.packets, list.matrices, packet, model, center);
+}
+
+// Esquece todo o estado conhecido. O próximo uso de cada estado será emitido.
+void RenderState_Invalidate()
+{
+    RenderStateCache& cache = g_RenderQueue.cache;
+    cache.program = (GLuint)-1;
+    cache.vao = (GLuint)-1;
+    for (int i = 0; i < RENDER_STATE_MAX_TEXTURE_UNITS; ++i)
+    {
+        cache.texture_targets[i] = 0;
+        cache.textures[i] = (GLuint)-1;
+    }
+    cache.pass = -1;
+    for (size_t i = 0; i < cache.uniforms.size(); ++i)
+        cache.uniforms[i].valid = false;
+}
+
+// Funções abaixo emitem uma troca de estado somente se o valor for diferente
+// do último valor conhecido, contabilizando trocas emitidas e descartadas.
+static bool RenderState_Changed(bool changed)
+{
+    if ( changed )
+        g_RenderQueue.state_changes += 1;
+    else
+        g_RenderQueue.state_elided += 1;
+    return changed;
+}
+
+void RenderState_SetPass(int pass)
+{
+    RenderStateCache& cache = g_RenderQueue.cache;
+    if ( !RenderState_Changed(cache.pass != pass) )
+        return;
+
+    cache.pass = pass;
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    if ( pass == RENDER_PASS_SKY )
+    {
+        glDepthMask(GL_FALSE);
+        glDepthFunc(GL_LEQUAL);
+        glDisable(GL_CULL_FACE);
+    }
+    else if ( pass == RENDER_PASS_DEPTH_PREPASS )
+    {
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        glDepthMask(GL_TRUE);
+        glDepthFunc(GL_LESS);
+        glEnable(GL_CULL_FACE);
+    }
+    else if ( pass == RENDER_PASS_BLENDED )
+    {
+        // Objetos translúcidos (partículas, veja "particles.cpp") são
+        // testados contra a profundidade da cena sem escrevê-la. Nenhum
+        // passo vem depois deste, e RenderQueue_Submit() desliga o blending.
+        glDepthMask(GL_FALSE);
+        glDepthFunc(GL_LESS);
+        glDisable(GL_CULL_FACE);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    }
+    else
+    {
+        // Após o prepass o Z-buffer já contém a superfície visível: cada
+        // pixel passa no teste somente para o fragmento mais próximo.
+        bool prepass = g_RenderQueue.order.depth_prepass && g_RenderQueue.order.depth_program >= 0;
+        glDepthMask(GL_TRUE);
+        glDepthFunc(prepass ? GL_LEQUAL : GL_LESS);
+        glEnable(GL_CULL_FACE);
+    }
+}
+
+void RenderState_UseProgram(GLuint program_id)
+{
+    RenderStateCache& cache = g_RenderQueue.cache;
+    if ( RenderState_Changed(cache.program != program_id) )
+    {
+        glUseProgram(program_id);
+        cache.program = program_id;
+    }
+}
+
+void RenderState_BindVertexArray(GLuint vao)
+{
+    RenderStateCache& cache = g_RenderQueue.cache;
+    if ( RenderState_Changed(cache.vao != vao) )
+    {
+        glBindVertexArray(vao);
+        cache.vao = vao;
+    }
+}
+
+void RenderState_BindTexture(GLuint unit, GLenum target, GLuint texture_id)
+{
+    RenderStateCache& cache = g_RenderQueue.cache;
+    if ( RenderState_Changed(cache.textures[unit] != texture_id || cache.texture_targets[unit] != target) )
+    {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(target, texture_id);
+        glActiveTexture(GL_TEXTURE0);
+        cache.textures[unit] = texture_id;
+        cache.texture_targets[unit] = target;
+    }
+}
+
+// Retorna se o pacote desenha várias instâncias, com atributos por instância.
+bool RenderQueue_IsInstanced(const DrawPacket& packet)
+{
+    return packet.command == RENDER_DRAW_ELEMENTS_INSTANCED || packet.command == RENDER_DRAW_ELEMENTS_INDIRECT
+        || packet.command == RENDER_DRAW_ARRAYS_INSTANCED;
+}
+
+// Envia os uniforms controlados pela fila para o programa atual.
+static void RenderState_SetUniforms(const DrawPacket& packet)
+{
+    RenderQueue& queue = g_RenderQueue;
+    RenderStateCache& cache = queue.cache;
+    const RenderProgram& program = queue.programs[packet.program];
+    RenderStateCache::ProgramUniforms& current = cache.uniforms[packet.program];
+    bool valid = current.valid;
+    int instanced = RenderQueue_IsInstanced(packet) ? 1 : 0;
+    const glm::mat4& model = queue.matrices[packet.model_index];
+
+    if ( program.model_uniform >= 0 && RenderState_Changed(!valid || current.model != model) )
+    {
+        glUniformMatrix4fv(program.model_uniform, 1, GL_FALSE, glm::value_ptr(model));
+        current.model = model;
+
+        // Matrizes derivadas de "model", computadas aqui uma vez por desenho
+        // em vez de uma vez por vértice no shader. O cache é invalidado a
+        // cada RenderQueue_Submit(), então a matriz view_projection do
+        // quadro atual sempre é utilizada.
+        if ( program.normal_matrix_uniform >= 0 )
+        {
+            glm::mat3 normal_matrix = glm::transpose(glm::inverse(glm::mat3(model)));
+            glUniformMatrix3fv(program.normal_matrix_uniform, 1, GL_FALSE, glm::value_ptr(normal_matrix));
+        }
+        if ( program.model_view_projection_uniform >= 0 )
+        {
+            glm::mat4 model_view_projection = g_FrameConstants.current.view_projection * model;
+            glUniformMatrix4fv(program.model_view_projection_uniform, 1, GL_FALSE, glm::value_ptr(model_view_projection));
+        }
+    }
+    if ( program.bbox_min_uniform >= 0 && RenderState_Changed(!valid || current.bbox_min != packet.bbox_min || current.bbox_max != packet.bbox_max) )
+    {
+        glUniform4f(program.bbox_min_uniform, packet.bbox_min.x, packet.bbox_min.y, packet.bbox_min.z, 1.0f);
+        glUniform4f(program.bbox_max_uniform, packet.bbox_max.x, packet.bbox_max.y, packet.bbox_max.z, 1.0f);
+        current.bbox_min = packet.bbox_min;
+        current.bbox_max = packet.bbox_max;
+    }
+    if ( program.instanced_uniform >= 0 && RenderState_Changed(!valid || current.instanced != instanced) )
+    {
+        glUniform1i(program.instanced_uniform, instanced);
+        current.instanced = instanced;
+    }
+
+    current.valid = true;
+}
+
+// Emite o comando de desenho de um pacote, com o estado já configurado.
+void RenderQueue_Draw(const DrawPacket& packet)
+{
+    switch ( packet.command )
+    {
+    case RENDER_DRAW_ARRAYS:
+        glDrawArrays(packet.mode, packet.first, packet.count);
+        break;
+    case RENDER_DRAW_ARRAYS_INSTANCED:
+        glDrawArraysInstanced(packet.mode, packet.first, packet.count, packet.instance_count);
+        break;
+    case RENDER_DRAW_ELEMENTS:
+        glDrawElements(packet.mode, packet.count, GL_UNSIGNED_INT, packet.offset);
+        break;
+    case RENDER_MULTI_DRAW_ELEMENTS:
+        glMultiDrawElements(packet.mode, packet.multi_counts, GL_UNSIGNED_INT, packet.multi_offsets, packet.multi_draw_count);
+        break;
+    case RENDER_DRAW_ELEMENTS_INSTANCED:
+        glDrawElementsInstanced(packet.mode, packet.count, GL_UNSIGNED_INT, packet.offset, packet.instance_count);
+        break;
+    case RENDER_DRAW_ELEMENTS_INDIRECT:
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, packet.indirect_buffer);
+        g_RenderQueue.draw_elements_indirect(packet.mode, GL_UNSIGNED_INT, packet.offset);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        break;
+    }
+}
+
+// Completa os pacotes de uma lista para a ordem de passos configurada e a
+// ordena pela chave. Executada por uma tarefa por lista.
+static void RenderQueue_PrepareList(std::vector<DrawPacket>& packets)
+{
+    const RenderPassOrder& order = g_RenderQueue.order;
+
+    // Prepass: uma cópia de cada pacote opaco visível com o programa sem
+    // saída de cor. As cópias não projetam sombra. Pacotes com vertex shader
+    // próprio ou que descartam fragmentos (impostores, veja "impostors.cpp")
+    // não têm cópia e são desenhados somente no passo de opacos.
+    if ( order.depth_prepass && order.depth_program >= 0 )
+    {
+        size_t count = packets.size();
+        for (size_t i = 0; i < count; ++i)
+        {
+            if ( packets[i].pass != RENDER_PASS_OPAQUE || !packets[i].camera_visible || !packets[i].replaceable )
+                continue;
+            DrawPacket packet = packets[i];
+            packet.pass = RENDER_PASS_DEPTH_PREPASS;
+            packet.program = order.depth_program;
+            packet.timer = GPU_TIMER_DEPTH_PREPASS;
+            packet.shadow_caster = SHADOW_CASTER_NONE;
+            packet.key = RenderQueue_MakeKey(packet);
+            packets.push_back(packet);
+        }
+    }
+
+    // Visualização do overdraw: os passos com escrita de cor somam uma cor
+    // constante por fragmento.
+    if ( order.overdraw_view && order.overdraw_program >= 0 )
+    {
+        for (size_t i = 0; i < packets.size(); ++i)
+        {
+            DrawPacket& packet = packets[i];
+            if ( !packet.replaceable )
+                continue;
+            if ( packet.pass == RENDER_PASS_OPAQUE )
+                packet.program = order.overdraw_program;
+            else if ( packet.pass == RENDER_PASS_SKY && order.overdraw_sky_program >= 0 )
+                packet.program = order.overdraw_sky_program;
+            else
+                continue;
+            packet.key = RenderQueue_MakeKey(packet);
+        }
+    }
+
+    std::stable_sort(packets.begin(), packets.end(),
+                     [](const DrawPacket& a, const DrawPacket& b) { return a.key < b.key; });
+}
+
+// Prepara e ordena, em paralelo, os pacotes da thread do OpenGL e as listas
+// das tarefas, e intercala as listas ordenadas em g_RenderQueue.packets.
+// Deve ser chamada depois de todos os pacotes do quadro terem sido
+// enfileirados, antes de ShadowMaps_Render(); RenderQueue_Submit() a chama
+// se isso ainda não foi feito.
+void RenderQueue_Build()
+{
+    RenderQueue& queue = g_RenderQueue;
+
+    JobSystem_ParallelFor((int)queue.lists.size() + 1, [](int i) {
+        RenderQueue& queue = g_RenderQueue;
+        RenderQueue_PrepareList(i == 0 ? queue.packets : queue.lists[i - 1].packets);
+    });
+
+    queue.frustum_culled = 0;
+    queue.lists_merged = (int)queue.lists.size();
+    for (size_t l = 0; l < queue.lists.size(); ++l)
+    {
+        RenderCommandList& list = queue.lists[l];
+        queue.frustum_culled += list.frustum_culled;
+        if ( list.packets.empty() )
+            continue;
+
+        int matrix_offset = (int)queue.matrices.size();
+        queue.matrices.insert(queue.matrices.end(), list.matrices.begin(), list.matrices.end());
+        for (size_t i = 0; i < list.packets.size(); ++i)
+            list.packets[i].model_index += matrix_offset;
+
+        // Intercalação estável: em chaves iguais, os pacotes anteriores vêm primeiro.
+        queue.merge_buffer.clear();
+        std::merge(queue.packets.begin(), queue.packets.end(), list.packets.begin(), list.packets.end(),
+                   std::back_inserter(queue.merge_buffer),
+                   [](const DrawPacket& a, const DrawPacket& b) { return a.key < b.key; });
+        queue.packets.swap(queue.merge_buffer);
+    }
+
+    queue.built = true;
+}
+
+// Desenha os pacotes preparados por RenderQueue_Build(). Ao final, o
+// estado OpenGL é deixado no padrão (escrita de cor e de profundidade,
+// GL_LESS, backface culling, sem blending), com o VAO 0 ligado e os
+// uniforms "instanced" desligados, como o restante do código espera.
+void RenderQueue_Submit()
+{
+    RenderQueue& queue = g_RenderQueue;
+    queue.draw_calls = 0;
+    queue.state_changes = 0;
+    queue.state_elided = 0;
+
+    if ( !queue.built )
+        RenderQueue_Build();
+
+    RenderState_Invalidate();
+
+    if ( queue.order.overdraw_view && queue.order.overdraw_program >= 0 )
+    {
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_ONE, GL_ONE);
+    }
+
+    // Resultado da consulta de fragmentos de dois quadros atrás, se pronto.
+    if ( queue.samples_queries[0] == 0 )
+        glGenQueries(2, queue.samples_queries);
+    queue.samples_frame = (queue.samples_frame + 1) % 2;
+    int f = queue.samples_frame;
+    if ( queue.samples_pending[f] )
+    {
+        GLint available = 0;
+        glGetQueryObjectiv(queue.samples_queries[f], GL_QUERY_RESULT_AVAILABLE, &available);
+        if ( available && queue.samples_pixels[f] > 0 )
+        {
+            GLuint samples = 0;
+            glGetQueryObjectuiv(queue.samples_queries[f], GL_QUERY_RESULT, &samples);
+            queue.shaded_per_pixel = (float)samples / queue.samples_pixels[f];
+        }
+        queue.samples_pending[f] = false;
+    }
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    queue.samples_pixels[f] = viewport[2] * viewport[3];
+    bool counting = false;
+
+    for (size_t i = 0; i < queue.packets.size(); ++i)
+    {
+        const DrawPacket& packet = queue.packets[i];
+        if ( !packet.camera_visible )
+            continue;
+
+        // Contamos os fragmentos dos passos com escrita de cor, que são
+        // os que executam o sombreamento completo.
+        if ( !counting && packet.pass != RENDER_PASS_DEPTH_PREPASS )
+        {
+            glBeginQuery(GL_SAMPLES_PASSED, queue.samples_queries[f]);
+            counting = true;
+        }
+
+        // Tempo de GPU por passo (veja "gpu_timers.cpp")
+        GpuTimers_Mark(packet.timer);
+
+        RenderState_SetPass(packet.pass);
+        RenderState_UseProgram(queue.programs[packet.program].program_id);
+        if ( packet.texture_target != 0 )
+            RenderState_BindTexture(packet.texture_unit, packet.texture_target, packet.texture_id);
+        RenderState_BindVertexArray(packet.vao);
+        RenderState_SetUniforms(packet);
+
+        RenderQueue_Draw(packet);
+        queue.draw_calls += 1;
+    }
+
+    if ( counting )
+    {
+        glEndQuery(GL_SAMPLES_PASSED);
+        queue.samples_pending[f] = true;
+    }
+
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    glDepthMask(GL_TRUE);
+    glDepthFunc(GL_LESS);
+    glEnable(GL_CULL_FACE);
+    glDisable(GL_BLEND);
+    queue.cache.pass = RENDER_PASS_OPAQUE;
+
+    for (size_t p = 0; p < queue.programs.size(); ++p)
+    {
+        RenderStateCache::ProgramUniforms& current = queue.cache.uniforms[p];
+        if ( current.valid && current.instanced != 0 )
+        {
+            RenderState_UseProgram(queue.programs[p].program_id);
+            glUniform1i(queue.programs[p].instanced_uniform, 0);
+            current.instanced = 0;
+        }
+    }
+    RenderState_BindVertexArray(0);
+}
@@ -0,0 +1,596 @@
+// Descrição da cena em arquivo. Em vez de fixar no código os objetos da cena
+// (plataformas, caminhos dos pássaros, colisores, ...), lemos essas
+// informações de um arquivo na inicialização. Suportamos dois formatos:
+//
+// - Texto (".scene"), fácil de editar à mão. Uma entrada por linha, linhas
+//   começando com '#' são comentários:
+//
+//     model      <caminho do .obj>
+//     instance   <objeto> <material> <tx ty tz> <rotação Y (rad)> <sx sy sz>
+//     character  <x y z>                       (posição inicial do personagem)
+//     bird_path  <n> <x y z> ... (n pontos)    (pontos de controle do caminho)
+//     collider   <min x y z> <max x y z>       (AABB estática em coords. globais)
+//     projectile <x y z> <vx vy vz> <raio>
+//     voxel_terrain <x y z> <sx sy sz> <semente>  (terreno em voxels, veja "voxel_world.cpp")
+//     light      <x y z> <r g b> <raio> [<dx dy dz> <ângulo (graus)>]
+//                (luz pontual; com direção e ângulo, spot. Veja "clustered_lighting.cpp")
+//
+// - Binário (".sceneb"), com as mesmas informações em registros de tamanho
+//   fixo, muito mais rápido de carregar para cenas com milhares de objetos.
+//
+// Este arquivo não depende de OpenGL, para que possa ser utilizado também
+// pelo gerador de cenas (veja "scenegen.cpp").
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+struct SceneInstance
+{
+    std::string object;      // Nome do objeto em g_VirtualScene
+    std::string material;    // Material (object_id utilizado nos shaders)
+    glm::vec3   translation;
+    float       rotation_y;
+    glm::vec3   scale;
+};
+
+struct SceneCollider
+{
+    glm::vec3 bbox_min;
+    glm::vec3 bbox_max;
+};
+
+struct SceneProjectile
+{
+    glm::vec3 position;
+    glm::vec3 velocity;
+    float     radius;
+};
+
+// Terreno em voxels gerado proceduralmente: o primeiro bloco fica em
+// "origin" e o terreno ocupa "size" blocos em cada eixo.
+struct SceneVoxelTerrain
+{
+    glm::ivec3   origin;
+    glm::ivec3   size;
+    unsigned int seed;
+};
+
+// Luz pontual (spot_angle == 0) ou spot, com alcance "radius".
+struct SceneLight
+{
+    glm::vec3 position;
+    glm::vec3 color;
+    float     radius;
+    glm::vec3 direction;
+    float     spot_angle; // Meio ângulo do cone, em graus
+};
+
+struct SceneDescription
+{
+    std::vector<std::string>             models;     // Arquivos ".obj" a serem carregados
+    std::vector<SceneInstance>           instances;  // Objetos estáticos
+    glm::vec3                            character_spawn = glm::vec3(0.0f);
+    std::vector<std::vector<glm::vec4>>  bird_paths; // Pontos de controle de cada pássaro
+    std::vector<SceneCollider>           colliders;
+    std::vector<SceneProjectile>         projectiles;
+    std::vector<SceneVoxelTerrain>       voxel_terrains;
+    std::vector<SceneLight>              lights;
+};
+
+static const char SCENE_BINARY_MAGIC[4] = { 'S', 'C', 'N', 'B' };
+static const unsigned int SCENE_BINARY_VERSION = 3; // Versão 2: terrenos em voxels; versão 3: luzes
+
+// ------------------------------------------------------------------------
+// Formato texto
+// ------------------------------------------------------------------------
+
+static void Scene_ParseError(const char* filename, int line, const char* message)
+{
+    fprintf(stderr, "ERROR: \"%s\" (line %d): %s\n", filename, line, message);
+    throw std::runtime_error("Erro ao carregar cena.");
+}
+
+static void Scene_ValidationError(const char* filename, const char* kind, size_t index, const char* message)
+{
+    fprintf(stderr, "ERROR: \"%s\" (%s #%d): %s\n", filename, kind, (int)index + 1, message);
+    throw std::runtime_error("Erro ao carregar cena.");
+}
+
+// Verifica valores que os dois formatos conseguem representar mas que não
+// formam uma cena válida. Utilizada por Scene_Load() após qualquer um dos
+// dois carregadores.
+static void Scene_Validate(const char* filename, const SceneDescription& scene)
+{
+    for (size_t i = 0; i < scene.bird_paths.size(); ++i)
+        if ( scene.bird_paths[i].size() < 2 )
+            Scene_ValidationError(filename, "bird_path", i, "at least 2 points are required");
+
+    for (size_t i = 0; i < scene.voxel_terrains.size(); ++i)
+    {
+        const glm::ivec3& size = scene.voxel_terrains[i].size;
+        if ( size.x <= 0 || size.y <= 0 || size.z <= 0 )
+            Scene_ValidationError(filename, "voxel_terrain", i, "size must be greater than 0");
+    }
+
+    for (size_t i = 0; i < scene.lights.size(); ++i)
+        if ( !(scene.lights[i].radius > 0.0f) )
+            Scene_ValidationError(filename, "light", i, "radius must be greater than 0");
+}
+
+// Lê uma cena no formato texto, já carregada em memória.
+void Scene_LoadTextFromMemory(const char* filename, const std::vector<char>& data, SceneDescription& scene)
+{
+    std::istringstream file(std::string(data.begin(), data.end()));
+
+    std::string text;
+    int line_number = 0;
+    while (std::getline(file, text))
+    {
+        line_number += 1;
+
+        std::istringstream line(text);
+        std::string keyword;
+        if ( !(line >> keyword) || keyword[0] == '#' )
+            continue;
+
+        if ( keyword == "model" )
+        {
+            std::string path;
+            if ( !(line >> path) )
+                Scene_ParseError(filename, line_number, "expected: model <path>");
+            scene.models.push_back(path);
+        }
+        else if ( keyword == "instance" )
+        {
+            SceneInstance instance;
+            if ( !(line >> instance.object >> instance.material
+                        >> instance.translation.x >> instance.translation.y >> instance.translation.z
+                        >> instance.rotation_y
+                        >> instance.scale.x >> instance.scale.y >> instance.scale.z) )
+                Scene_ParseError(filename, line_number, "expected: instance <object> <material> <tx ty tz> <ry> <sx sy sz>");
+            scene.instances.push_back(instance);
+        }
+        else if ( keyword == "character" )
+        {
+            glm::vec3& p = scene.character_spawn;
+            if ( !(line >> p.x >> p.y >> p.z) )
+                Scene_ParseError(filename, line_number, "expected: character <x y z>");
+        }
+        else if ( keyword == "bird_path" )
+        {
+            int n = 0;
+            if ( !(line >> n) || n < 0 )
+                Scene_ParseError(filename, line_number, "expected: bird_path <n >= 2> <x y z>...");
+
+            std::vector<glm::vec4> points;
+            for (int i = 0; i < n; ++i)
+            {
+                glm::vec4 p = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+                if ( !(line >> p.x >> p.y >> p.z) )
+                    Scene_ParseError(filename, line_number, "bird_path has fewer points than declared");
+                points.push_back(p);
+            }
+            scene.bird_paths.push_back(points);
+        }
+        else if ( keyword == "collider" )
+        {
+            SceneCollider collider;
+            if ( !(line >> collider.bbox_min.x >> collider.bbox_min.y >> collider.bbox_min.z
+                        >> collider.bbox_max.x >> collider.bbox_max.y >> collider.bbox_max.z) )
+                Scene_ParseError(filename, line_number, "expected: collider <min x y z> <max x y z>");
+            scene.colliders.push_back(collider);
+        }
+        else if ( keyword == "projectile" )
+        {
+            SceneProjectile projectile;
+            if ( !(line >> projectile.position.x >> projectile.position.y >> projectile.position.z
+                        >> projectile.velocity.x >> projectile.velocity.y >> projectile.velocity.z
+                        >> projectile.radius) )
+                Scene_ParseError(filename, line_number, "expected: projectile <x y z> <vx vy vz> <radius>");
+            scene.projectiles.push_back(projectile);
+        }
+        else if ( keyword == "voxel_terrain" )
+        {
+            SceneVoxelTerrain terrain;
+            if ( !(line >> terrain.origin.x >> terrain.origin.y >> terrain.origin.z
+                        >> terrain.size.x >> terrain.size.y >> terrain.size.z >> terrain.seed) )
+                Scene_ParseError(filename, line_number, "expected: voxel_terrain <x y z> <sx sy sz> <seed>");
+            scene.voxel_terrains.push_back(terrain);
+        }
+        else if ( keyword == "light" )
+        {
+            SceneLight light;
+            if ( !(line >> light.position.x >> light.position.y >> light.position.z
+                        >> light.color.r >> light.color.g >> light.color.b >> light.radius) )
+                Scene_ParseError(filename, line_number, "expected: light <x y z> <r g b> <radius> [<dx dy dz> <angle>]");
+
+            light.direction = glm::vec3(0.0f, -1.0f, 0.0f);
+            light.spot_angle = 0.0f;
+            if ( line >> light.direction.x )
+            {
+                if ( !(line >> light.direction.y >> light.direction.z >> light.spot_angle) )
+                    Scene_ParseError(filename, line_number, "expected: light <x y z> <r g b> <radius> [<dx dy dz> <angle>]");
+            }
+            scene.lights.push_back(light);
+        }
+        else
+        {
+            Scene_ParseError(filename, line_number, ("unknown keyword \"" + keyword + "\"").c_str());
+        }
+    }
+}
+
+void Scene_SaveText(const char* filename, const SceneDescription& scene)
+{
+    FILE* file = fopen(filename, "w");
+    if ( !file )
+    {
+        fprintf(stderr, "ERROR: Cannot write scene file \"%s\".\n", filename);
+        throw std::runtime_error("Erro ao salvar cena.");
+    }
+
+    for (size_t i = 0; i < scene.models.size(); ++i)
+        fprintf(file, "model %s\n", scene.models[i].c_str());
+
+    fprintf(file, "character %g %g %g\n", scene.character_spawn.x, scene.character_spawn.y, scene.character_spawn.z);
+
+    for (size_t i = 0; i < scene.instances.size(); ++i)
+    {
+        const SceneInstance& s = scene.instances[i];
+        fprintf(file, "instance %s %s %g %g %g %g %g %g %g\n", s.object.c_str(), s.material.c_str(),
+                s.translation.x, s.translation.y, s.translation.z, s.rotation_y, s.scale.x, s.scale.y, s.scale.z);
+    }
+
+    for (size_t i = 0; i < scene.bird_paths.size(); ++i)
+    {
+        fprintf(file, "bird_path %d", (int)scene.bird_paths[i].size());
+        for (size_t j = 0; j < scene.bird_paths[i].size(); ++j)
+        {
+            const glm::vec4& p = scene.bird_paths[i][j];
+            fprintf(file, "  %g %g %g", p.x, p.y, p.z);
+        }
+        fprintf(file, "\n");
+    }
+
+    for (size_t i = 0; i < scene.colliders.size(); ++i)
+    {
+        const SceneCollider& c = scene.colliders[i];
+        fprintf(file, "collider %g %g %g %g %g %g\n",
+                c.bbox_min.x, c.bbox_min.y, c.bbox_min.z, c.bbox_max.x, c.bbox_max.y, c.bbox_max.z);
+    }
+
+    for (size_t i = 0; i < scene.projectiles.size(); ++i)
+    {
+        const SceneProjectile& p = scene.projectiles[i];
+        fprintf(file, "projectile %g %g %g %g %g %g %g\n", p.position.x, p.position.y, p.position.z,
+                p.velocity.x, p.velocity.y, p.velocity.z, p.radius);
+    }
+
+    for (size_t i = 0; i < scene.voxel_terrains.size(); ++i)
+    {
+        const SceneVoxelTerrain& t = scene.voxel_terrains[i];
+        fprintf(file, "voxel_terrain %d %d %d %d %d %d %u\n", t.origin.x, t.origin.y, t.origin.z,
+                t.size.x, t.size.y, t.size.z, t.seed);
+    }
+
+    for (size_t i = 0; i < scene.lights.size(); ++i)
+    {
+        const SceneLight& l = scene.lights[i];
+        fprintf(file, "light %g %g %g %g %g %g %g", l.position.x, l.position.y, l.position.z,
+                l.color.r, l.color.g, l.color.b, l.radius);
+        if ( l.spot_angle > 0.0f )
+            fprintf(file, "  %g %g %g %g", l.direction.x, l.direction.y, l.direction.z, l.spot_angle);
+        fprintf(file, "\n");
+    }
+
+    fclose(file);
+}
+
+// ------------------------------------------------------------------------
+// Formato binário
+// ------------------------------------------------------------------------
+
+static void Scene_Write(FILE* file, const void* data, size_t size)
+{
+    if ( fwrite(data, 1, size, file) != size )
+        throw std::runtime_error("Erro ao salvar cena.");
+}
+
+static void Scene_WriteU32(FILE* file, unsigned int value)
+{
+    Scene_Write(file, &value, sizeof(value));
+}
+
+static void Scene_WriteString(FILE* file, const std::string& str)
+{
+    Scene_WriteU32(file, (unsigned int)str.size());
+    Scene_Write(file, str.data(), str.size());
+}
+
+static void Scene_WriteBinary(FILE* file, const SceneDescription& scene)
+{
+    Scene_Write(file, SCENE_BINARY_MAGIC, 4);
+    Scene_WriteU32(file, SCENE_BINARY_VERSION);
+
+    Scene_WriteU32(file, (unsigned int)scene.models.size());
+    for (size_t i = 0; i < scene.models.size(); ++i)
+        Scene_WriteString(file, scene.models[i]);
+
+    Scene_WriteU32(file, (unsigned int)scene.instances.size());
+    for (size_t i = 0; i < scene.instances.size(); ++i)
+    {
+        const SceneInstance& s = scene.instances[i];
+        Scene_WriteString(file, s.object);
+        Scene_WriteString(file, s.material);
+        float transform[7] = { s.translation.x, s.translation.y, s.translation.z, s.rotation_y, s.scale.x, s.scale.y, s.scale.z };
+        Scene_Write(file, transform, sizeof(transform));
+    }
+
+    Scene_Write(file, &scene.character_spawn[0], 3*sizeof(float));
+
+    Scene_WriteU32(file, (unsigned int)scene.bird_paths.size());
+    for (size_t i = 0; i < scene.bird_paths.size(); ++i)
+    {
+        Scene_WriteU32(file, (unsigned int)scene.bird_paths[i].size());
+        Scene_Write(file, scene.bird_paths[i].data(), scene.bird_paths[i].size()*sizeof(glm::vec4));
+    }
+
+    Scene_WriteU32(file, (unsigned int)scene.colliders.size());
+    for (size_t i = 0; i < scene.colliders.size(); ++i)
+    {
+        const SceneCollider& c = scene.colliders[i];
+        float bbox[6] = { c.bbox_min.x, c.bbox_min.y, c.bbox_min.z, c.bbox_max.x, c.bbox_max.y, c.bbox_max.z };
+        Scene_Write(file, bbox, sizeof(bbox));
+    }
+
+    Scene_WriteU32(file, (unsigned int)scene.projectiles.size());
+    for (size_t i = 0; i < scene.projectiles.size(); ++i)
+    {
+        const SceneProjectile& p = scene.projectiles[i];
+        float data[7] = { p.position.x, p.position.y, p.position.z, p.velocity.x, p.velocity.y, p.velocity.z, p.radius };
+        Scene_Write(file, data, sizeof(data));
+    }
+
+    Scene_WriteU32(file, (unsigned int)scene.voxel_terrains.size());
+    for (size_t i = 0; i < scene.voxel_terrains.size(); ++i)
+    {
+        const SceneVoxelTerrain& t = scene.voxel_terrains[i];
+        int data[6] = { t.origin.x, t.origin.y, t.origin.z, t.size.x, t.size.y, t.size.z };
+        Scene_Write(file, data, sizeof(data));
+        Scene_WriteU32(file, t.seed);
+    }
+
+    Scene_WriteU32(file, (unsigned int)scene.lights.size());
+    for (size_t i = 0; i < scene.lights.size(); ++i)
+    {
+        const SceneLight& l = scene.lights[i];
+        float data[11] = { l.position.x, l.position.y, l.position.z, l.color.r, l.color.g, l.color.b, l.radius,
+                           l.direction.x, l.direction.y, l.direction.z, l.spot_angle };
+        Scene_Write(file, data, sizeof(data));
+    }
+}
+
+void Scene_SaveBinary(const char* filename, const SceneDescription& scene)
+{
+    FILE* file = fopen(filename, "wb");
+    if ( !file )
+    {
+        fprintf(stderr, "ERROR: Cannot write scene file \"%s\".\n", filename);
+        throw std::runtime_error("Erro ao salvar cena.");
+    }
+
+    // Em caso de erro, fechamos e removemos o arquivo incompleto, que seria
+    // rejeitado pela leitura.
+    try {
+        Scene_WriteBinary(file, scene);
+    } catch ( ... ) {
+        fclose(file);
+        remove(filename);
+        fprintf(stderr, "ERROR: Cannot write scene file \"%s\".\n", filename);
+        throw;
+    }
+
+    if ( fclose(file) != 0 )
+    {
+        remove(filename);
+        fprintf(stderr, "ERROR: Cannot write scene file \"%s\".\n", filename);
+        throw std::runtime_error("Erro ao salvar cena.");
+    }
+}
+
+// Leitura sequencial de um arquivo binário já carregado em memória.
+struct SceneReader
+{
+    const char* filename;
+    const std::vector<char>& data;
+    size_t offset;
+
+    void read(void* out, size_t size)
+    {
+        if ( offset + size > data.size() )
+        {
+            fprintf(stderr, "ERROR: Scene file \"%s\" is truncated.\n", filename);
+            throw std::runtime_error("Erro ao carregar cena.");
+        }
+        memcpy(out, data.data() + offset, size);
+        offset += size;
+    }
+
+    unsigned int u32()
+    {
+        unsigned int value;
+        read(&value, sizeof(value));
+        return value;
+    }
+
+    // Lê um número de registros de pelo menos "record_size" bytes cada,
+    // verificando se cabem no restante do arquivo antes de qualquer alocação.
+    unsigned int count(size_t record_size)
+    {
+        unsigned int value = u32();
+        if ( value > (data.size() - offset) / record_size )
+        {
+            fprintf(stderr, "ERROR: Scene file \"%s\" is truncated.\n", filename);
+            throw std::runtime_error("Erro ao carregar cena.");
+        }
+        return value;
+    }
+
+    std::string string()
+    {
+        unsigned int size = u32();
+        if ( offset + size > data.size() )
+        {
+            fprintf(stderr, "ERROR: Scene file \"%s\" is truncated.\n", filename);
+            throw std::runtime_error("Erro ao carregar cena.");
+        }
+        std::string str(data.data() + offset, size);
+        offset += size;
+        return str;
+    }
+};
+
+void Scene_LoadBinaryFromMemory(const char* filename, const std::vector<char>& data, SceneDescription& scene)
+{
+    SceneReader reader = { filename, data, 0 };
+
+    char magic[4];
+    reader.read(magic, 4);
+    unsigned int version = 0;
+    if ( memcmp(magic, SCENE_BINARY_MAGIC, 4) == 0 )
+        version = reader.u32();
+    if ( version < 1 || version > SCENE_BINARY_VERSION )
+    {
+        fprintf(stderr, "ERROR: \"%s\" is not a supported binary scene file (version %u, expected 1 to %u).\n",
+                filename, version, SCENE_BINARY_VERSION);
+        throw std::runtime_error("Erro ao carregar cena.");
+    }
+
+    // Os números de registros são verificados contra o tamanho mínimo de
+    // cada registro (cadeias ocupam ao menos o seu tamanho, um u32).
+    unsigned int n = reader.count(sizeof(unsigned int));
+    for (unsigned int i = 0; i < n; ++i)
+        scene.models.push_back(reader.string());
+
+    n = reader.count(2*sizeof(unsigned int) + 7*sizeof(float));
+    scene.instances.reserve(scene.instances.size() + n);
+    for (unsigned int i = 0; i < n; ++i)
+    {
+        SceneInstance s;
+        s.object = reader.string();
+        s.material = reader.string();
+        float transform[7];
+        reader.read(transform, sizeof(transform));
+        s.translation = glm::vec3(transform[0], transform[1], transform[2]);
+        s.rotation_y = transform[3];
+        s.scale = glm::vec3(transform[4], transform[5], transform[6]);
+        scene.instances.push_back(s);
+    }
+
+    reader.read(&scene.character_spawn[0], 3*sizeof(float));
+
+    n = reader.count(sizeof(unsigned int));
+    for (unsigned int i = 0; i < n; ++i)
+    {
+        std::vector<glm::vec4> points(reader.count(sizeof(glm::vec4)));
+        reader.read(points.data(), points.size()*sizeof(glm::vec4));
+        scene.bird_paths.push_back(points);
+    }
+
+    n = reader.count(6*sizeof(float));
+    scene.colliders.reserve(scene.colliders.size() + n);
+    for (unsigned int i = 0; i < n; ++i)
+    {
+        float bbox[6];
+        reader.read(bbox, sizeof(bbox));
+        SceneCollider c;
+        c.bbox_min = glm::vec3(bbox[0], bbox[1], bbox[2]);
+        c.bbox_max = glm::vec3(bbox[3], bbox[4], bbox[5]);
+        scene.colliders.push_back(c);
+    }
+
+    n = reader.count(7*sizeof(float));
+    scene.projectiles.reserve(scene.projectiles.size() + n);
+    for (unsigned int i = 0; i < n; ++i)
+    {
+        float p[7];
+        reader.read(p, sizeof(p));
+        SceneProjectile projectile;
+        projectile.position = glm::vec3(p[0], p[1], p[2]);
+        projectile.velocity = glm::vec3(p[3], p[4], p[5]);
+        projectile.radius = p[6];
+        scene.projectiles.push_back(projectile);
+    }
+
+    if ( version < 2 )
+        return;
+
+    n = reader.count(6*sizeof(int) + sizeof(unsigned int));
+    for (unsigned int i = 0; i < n; ++i)
+    {
+        int data[6];
+        reader.read(data, sizeof(data));
+        SceneVoxelTerrain terrain;
+        terrain.origin = glm::ivec3(data[0], data[1], data[2]);
+        terrain.size = glm::ivec3(data[3], data[4], data[5]);
+        terrain.seed = reader.u32();
+        scene.voxel_terrains.push_back(terrain);
+    }
+
+    if ( version < 3 )
+        return;
+
+    n = reader.count(11*sizeof(float));
+    scene.lights.reserve(scene.lights.size() + n);
+    for (unsigned int i = 0; i < n; ++i)
+    {
+        float data[11];
+        reader.read(data, sizeof(data));
+        SceneLight light;
+        light.position = glm::vec3(data[0], data[1], data[2]);
+        light.color = glm::vec3(data[3], data[4], data[5]);
+        light.radius = data[6];
+        light.direction = glm::vec3(data[7], data[8], data[9]);
+        light.spot_angle = data[10];
+        scene.lights.push_back(light);
+    }
+}
+
+// Lê um arquivo inteiro para a memória. Retorna false se não foi possível abrir.
+bool Scene_ReadFile(const char* filename, std::vector<char>& data)
+{
+    std::ifstream file(filename, std::ios::binary);
+    if ( !file )
+        return false;
+
+    file.seekg(0, std::ios::end);
+    data.resize((size_t)file.tellg());
+    file.seekg(0, std::ios::beg);
+    file.read(data.data(), data.size());
+    return true;
+}
+
+// Carrega uma cena, detectando o formato (texto ou binário) pelo conteúdo.
+void Scene_Load(const char* filename, SceneDescription& scene)
+{
+    std::vector<char> data;
+    if ( !Scene_ReadFile(filename, data) )
+    {
+        fprintf(stderr, "ERROR: Cannot open scene file \"%s\".\n", filename);
+        throw std::runtime_error("Erro ao carregar cena.");
+    }
+
+    if ( data.size() >= 4 && memcmp(data.data(), SCENE_BINARY_MAGIC, 4) == 0 )
+        Scene_LoadBinaryFromMemory(filename, data, scene);
+    else
+        Scene_LoadTextFromMemory(filename, data, scene);
+
+    Scene_Validate(filename, scene);
+}
@@ -0,0 +1,156 @@
+// Variantes (permutações) dos programas da cena.
+//
+// Em vez de um único fragment shader que escolhe o material em tempo de
+// execução com uma cadeia de "if (object_id == ...)", cada material é
+// compilado como um programa próprio a partir dos mesmos arquivos
+// "shader_vertex.glsl" e "shader_fragment.glsl", com "#define"s diferentes
+// (veja o comentário no início de "shader_fragment.glsl"). Assim cada
+// variante contém somente o código e as texturas que utiliza.
+//
+// As variantes são identificadas pelo texto dos "#define"s: pedir duas vezes
+// a mesma combinação retorna o mesmo programa, de modo que materiais iguais
+// compartilham uma variante. Cada variante ocupa um índice de programa na
+// fila de renderização (RENDER_PROGRAM_FIRST_VARIANT + índice da variante),
+// e os pacotes são ordenados por variante. Por padrão as variantes são
+// compiladas de "shader_vertex.glsl" e "shader_fragment.glsl"; a iluminação
+// por vértice usa os arquivos "_gouraud" (veja "lighting_lod.cpp").
+#include <map>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdio>
+
+#include <glad/glad.h>
+
+GLuint LoadShader_Vertex(const char* filename, const std::string& defines);   // Funções definidas em main.cpp
+GLuint LoadShader_Fragment(const char* filename, const std::string& defines);
+GLuint CreateGpuProgram(GLuint vertex_shader_id, GLuint fragment_shader_id);
+
+#define SHADER_VARIANT_VERTEX_FILE   "../../src/shader_vertex.glsl"
+#define SHADER_VARIANT_FRAGMENT_FILE "../../src/shader_fragment.glsl"
+
+struct ShaderVariant
+{
+    std::string vertex_filename;
+    std::string fragment_filename;
+    std::string defines;
+    GLuint      program_id = 0;
+    GLint       model_uniform = -1;
+    GLint       normal_matrix_uniform = -1;
+    GLint       model_view_projection_uniform = -1;
+    GLint       bbox_min_uniform = -1;
+    GLint       bbox_max_uniform = -1;
+    GLint       instanced_uniform = -1;
+    int         render_program = -1; // Índice na fila de renderização
+    double      compile_ms = 0.0;    // Tempo de compilação + linkagem
+    int         users = 0;           // Número de pedidos que retornaram esta variante
+};
+
+struct ShaderVariantCache
+{
+    std::map<std::string, int> by_key; // Arquivos + "#define"s
+    std::vector<ShaderVariant> variants;
+
+    // Estatísticas
+    int    requests = 0;
+    double total_compile_ms = 0.0;
+};
+
+ShaderVariantCache g_ShaderVariants;
+
+// Retorna o índice da variante com os "#define"s dados, compilando-a caso
+// ainda não exista.
+int ShaderVariants_Get(const std::string& defines,
+                       const char* vertex_filename = SHADER_VARIANT_VERTEX_FILE,
+                       const char* fragment_filename = SHADER_VARIANT_FRAGMENT_FILE)
+{
+    ShaderVariantCache& cache = g_ShaderVariants;
+    cache.requests += 1;
+
+    std::string key = std::string(vertex_filename) + "\n" + fragment_filename + "\n" + defines;
+    std::map<std::string, int>::iterator found = cache.by_key.find(key);
+    if ( found != cache.by_key.end() )
+    {
+        cache.variants[found->second].users += 1;
+        return found->second;
+    }
+
+    ShaderVariant variant;
+    variant.vertex_filename = vertex_filename;
+    variant.fragment_filename = fragment_filename;
+    variant.defines = defines;
+    variant.users = 1;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    GLuint vertex_shader_id = LoadShader_Vertex(vertex_filename, defines);
+    GLuint fragment_shader_id = LoadShader_Fragment(fragment_filename, defines);
+    variant.program_id = CreateGpuProgram(vertex_shader_id, fragment_shader_id);
+
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+    variant.compile_ms = std::chrono::duration<double, std::milli>(end - start).count();
+    cache.total_compile_ms += variant.compile_ms;
+
+    FrameConstants_BindProgram(variant.program_id);
+
+    variant.model_uniform     = glGetUniformLocation(variant.program_id, "model");
+    variant.normal_matrix_uniform = glGetUniformLocation(variant.program_id, "normal_matrix");
+    variant.model_view_projection_uniform = glGetUniformLocation(variant.program_id, "model_view_projection");
+    variant.bbox_min_uniform  = glGetUniformLocation(variant.program_id, "bbox_min");
+    variant.bbox_max_uniform  = glGetUniformLocation(variant.program_id, "bbox_max");
+    variant.instanced_uniform = glGetUniformLocation(variant.program_id, "instanced");
+
+    int index = cache.variants.size();
+    variant.render_program = RENDER_PROGRAM_FIRST_VARIANT + index;
+
+    RenderProgram program;
+    program.program_id        = variant.program_id;
+    program.model_uniform     = variant.model_uniform;
+    program.normal_matrix_uniform = variant.normal_matrix_uniform;
+    program.model_view_projection_uniform = variant.model_view_projection_uniform;
+    program.bbox_min_uniform  = variant.bbox_min_uniform;
+    program.bbox_max_uniform  = variant.bbox_max_uniform;
+    program.instanced_uniform = variant.instanced_uniform;
+    RenderQueue_SetProgram(variant.render_program, program);
+
+    cache.variants.push_back(variant);
+    cache.by_key[key] = index;
+    return index;
+}
+
+// Apaga todas as variantes (por exemplo, antes de recarregar os shaders).
+void ShaderVariants_Clear()
+{
+    ShaderVariantCache& cache = g_ShaderVariants;
+    for (size_t i = 0; i < cache.variants.size(); ++i)
+        glDeleteProgram(cache.variants[i].program_id);
+
+    cache.variants.clear();
+    cache.by_key.clear();
+    cache.requests = 0;
+    cache.total_compile_ms = 0.0;
+}
+
+// Imprime no terminal as variantes compiladas e o tempo gasto em cada uma.
+void ShaderVariants_PrintReport()
+{
+    const ShaderVariantCache& cache = g_ShaderVariants;
+    fprintf(stdout, "Shader variants: %d compiled for %d requests (%.1f ms total)\n",
+            (int)cache.variants.size(), cache.requests, cache.total_compile_ms);
+
+    for (size_t i = 0; i < cache.variants.size(); ++i)
+    {
+        const ShaderVariant& variant = cache.variants[i];
+
+        // Os "#define"s são impressos em uma única linha
+        std::string defines = variant.defines;
+        for (size_t c = 0; c < defines.size(); ++c)
+            if ( defines[c] == '\n' )
+                defines[c] = ' ';
+
+        // Somente o nome do arquivo de vértices, sem o diretório
+        std::string program = variant.vertex_filename.substr(variant.vertex_filename.find_last_of('/') + 1);
+
+        fprintf(stdout, "  [%d] %6.1f ms  %d user(s)  %s: %s\n", (int)i, variant.compile_ms, variant.users, program.c_str(), defines.c_str());
+    }
+}
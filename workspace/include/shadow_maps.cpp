@@ -0,0 +1,410 @@
+// Sombras da luz direcional com mapas de sombra em cascata ("cascaded
+// shadow maps").
+//
+// O frustum da câmera, até SHADOW_DISTANCE, é dividido em
+// SHADOW_CASCADE_COUNT fatias de profundidade, e cada fatia recebe um mapa
+// de sombra com projeção ortográfica na direção da luz. As cascatas
+// próximas cobrem áreas pequenas com muitos texels; as distantes, áreas
+// grandes.
+//
+// A geometria estática (pacotes SHADOW_CASTER_STATIC: chunks do mundo,
+// terreno em voxels) é desenhada em um segundo conjunto de mapas, guardado
+// entre quadros. Para que esse cache continue válido enquanto a câmera se
+// move, a área coberta por cada cascata é um quadrado um pouco maior que a
+// esfera envolvente da sua fatia, com o centro arredondado para uma grade:
+// a cobertura só muda quando a câmera anda uma fração da cascata. Uma
+// cascata estática é redesenhada somente quando sua cobertura muda, quando
+// a direção da luz muda ou quando o conjunto de pacotes estáticos muda
+// (por exemplo, um chunk do mundo foi carregado).
+//
+// A cada quadro, ShadowMaps_Render() copia cada cascata estática para o
+// mapa final e desenha por cima somente os objetos que se movem (pacotes
+// SHADOW_CASTER_DYNAMIC: personagem, pássaros, projéteis). O custo por
+// quadro fica proporcional aos objetos dinâmicos, não ao tamanho da cena.
+// O tempo de GPU de cada cascata é medido com consultas GL_TIME_ELAPSED.
+//
+// O fragment shader (veja DirectionalShadow() em "shader_fragment.glsl")
+// escolhe a cascata pela profundidade do fragmento e lê o mapa final com
+// comparação de profundidade em hardware (sampler2DArrayShadow).
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <glm/matrix.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#define SHADOW_MAP_SIZE            1024
+#define SHADOW_MAP_TEXTURE_UNIT    11
+#define SHADOW_DISTANCE            60.0f  // Alcance das sombras a partir da câmera
+#define SHADOW_SPLIT_LAMBDA        0.75f  // Mistura entre divisões logarítmica (1) e uniforme (0)
+#define SHADOW_COVERAGE_MARGIN     0.2f   // Folga da cobertura de cada cascata, em fração do raio
+#define SHADOW_DEPTH_RANGE         150.0f // Profundidade coberta antes e depois do centro da cascata
+#define SHADOW_QUERY_FRAMES        2      // Quadros em voo das consultas de tempo
+
+#define SHADOW_VERTEX_FILE   "../../src/shader_vertex_shadow.glsl"
+#define SHADOW_FRAGMENT_FILE "../../src/shader_fragment_depth.glsl"
+
+struct ShadowCascade
+{
+    glm::mat4 light_view_projection;
+    glm::vec3 center;        // Centro da cobertura, em coordenadas da luz (arredondado)
+    float     half_size = 0.0f;
+    float     split = 0.0f;  // Profundidade (distância da câmera) onde a cascata termina
+
+    bool      static_valid = false;
+    glm::vec3 static_center; // Cobertura com que a cascata estática foi desenhada
+    float     static_half_size = 0.0f;
+};
+
+struct ShadowMaps
+{
+    bool enabled = true;
+
+    GLuint static_texture = 0; // Cascatas estáticas (cache)
+    GLuint final_texture = 0;  // Cascatas estáticas + objetos dinâmicos, lidas pelo fragment shader
+    GLuint draw_framebuffer = 0;
+    GLuint read_framebuffer = 0;
+
+    int    variant = -1; // Índice em g_ShaderVariants
+    GLuint program_id = 0;
+    GLint  model_uniform = -1;
+    GLint  light_view_projection_uniform = -1;
+    GLint  instanced_uniform = -1;
+
+    ShadowCascade cascades[SHADOW_CASCADE_COUNT];
+    glm::vec3     light_direction = glm::vec3(0.0f);
+    uint64_t      static_signature = 0; // Resumo dos pacotes estáticos desenhados no cache
+
+    // Consultas de tempo: [quadro][cascata][0 = estática, 1 = dinâmica]
+    GLuint queries[SHADOW_QUERY_FRAMES][SHADOW_CASCADE_COUNT][2];
+    bool   query_pending[SHADOW_QUERY_FRAMES][SHADOW_CASCADE_COUNT][2];
+    int    query_frame = 0;
+
+    // Estatísticas
+    double static_ms[SHADOW_CASCADE_COUNT];  // Último redesenho de cada cascata estática (GPU)
+    double dynamic_ms[SHADOW_CASCADE_COUNT]; // Cópia + objetos dinâmicos (GPU)
+    int    static_renders = 0;               // Cascatas estáticas redesenhadas neste quadro
+    int    static_renders_total = 0;
+    int    dynamic_casters = 0;
+};
+
+ShadowMaps g_ShadowMaps;
+
+static GLuint ShadowMaps_CreateTexture(bool compare)
+{
+    GLuint texture_id;
+    glGenTextures(1, &texture_id);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, texture_id);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, SHADOW_MAP_SIZE, SHADOW_MAP_SIZE, SHADOW_CASCADE_COUNT,
+                 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, NULL);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, compare ? GL_LINEAR : GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, compare ? GL_LINEAR : GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    if ( compare )
+    {
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+    }
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    return texture_id;
+}
+
+// Cria as texturas, framebuffers e consultas. Deve ser chamada após a
+// criação do contexto OpenGL. O mapa final fica ligado permanentemente à
+// unidade SHADOW_MAP_TEXTURE_UNIT.
+void ShadowMaps_Init()
+{
+    ShadowMaps& shadows = g_ShadowMaps;
+    if ( shadows.final_texture != 0 )
+        return;
+
+    shadows.static_texture = ShadowMaps_CreateTexture(false);
+    shadows.final_texture = ShadowMaps_CreateTexture(true);
+
+    GLint framebuffer = 0;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &framebuffer);
+
+    glGenFramebuffers(1, &shadows.draw_framebuffer);
+    glGenFramebuffers(1, &shadows.read_framebuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, shadows.draw_framebuffer);
+    glDrawBuffer(GL_NONE);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, shadows.read_framebuffer);
+    glReadBuffer(GL_NONE);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+
+    glGenQueries(SHADOW_QUERY_FRAMES * SHADOW_CASCADE_COUNT * 2, &shadows.queries[0][0][0]);
+    for (int f = 0; f < SHADOW_QUERY_FRAMES; ++f)
+    for (int c = 0; c < SHADOW_CASCADE_COUNT; ++c)
+        shadows.query_pending[f][c][0] = shadows.query_pending[f][c][1] = false;
+    for (int c = 0; c < SHADOW_CASCADE_COUNT; ++c)
+        shadows.static_ms[c] = shadows.dynamic_ms[c] = 0.0;
+
+    glActiveTexture(GL_TEXTURE0 + SHADOW_MAP_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, shadows.final_texture);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+// Compila (ou recompila) o programa dos mapas de sombra como uma variante.
+// Deve ser chamada por LoadShadersFromFiles(), após ShaderVariants_Clear().
+void ShadowMaps_LoadProgram()
+{
+    ShadowMaps& shadows = g_ShadowMaps;
+    shadows.variant = ShaderVariants_Get("", SHADOW_VERTEX_FILE, SHADOW_FRAGMENT_FILE);
+    shadows.program_id = g_ShaderVariants.variants[shadows.variant].program_id;
+    shadows.model_uniform = glGetUniformLocation(shadows.program_id, "model");
+    shadows.light_view_projection_uniform = glGetUniformLocation(shadows.program_id, "light_view_projection");
+    shadows.instanced_uniform = glGetUniformLocation(shadows.program_id, "instanced");
+}
+
+// Calcula a cobertura de cada cascata para a câmera atual e preenche as
+// matrizes, divisões e tamanhos de texel em "constants". A direção da luz é
+// a de FrameConstants::light_direction (sentido da fonte de luz).
+void ShadowMaps_Update(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& light_direction, FrameConstants& constants)
+{
+    ShadowMaps& shadows = g_ShadowMaps;
+
+    constants.shadow_splits = glm::vec4(0.0f);
+    constants.shadow_texel_sizes = glm::vec4(0.0f);
+    for (int c = 0; c < SHADOW_CASCADE_COUNT; ++c)
+        constants.shadow_matrices[c] = glm::mat4(1.0f);
+    if ( !shadows.enabled )
+        return;
+
+    // Mudança na direção da luz invalida todas as cascatas estáticas.
+    if ( light_direction != shadows.light_direction )
+    {
+        shadows.light_direction = light_direction;
+        for (int c = 0; c < SHADOW_CASCADE_COUNT; ++c)
+            shadows.cascades[c].static_valid = false;
+    }
+
+    // Planos near e far da câmera e meia largura/altura do frustum a uma
+    // profundidade d: d/P[0][0] e d/P[1][1] na projeção perspectiva,
+    // constantes na ortográfica.
+    glm::mat4 inverse_projection = glm::inverse(projection);
+    glm::vec4 near_point = inverse_projection * glm::vec4(0.0f, 0.0f, -1.0f, 1.0f);
+    glm::vec4 far_point  = inverse_projection * glm::vec4(0.0f, 0.0f,  1.0f, 1.0f);
+    float near_depth = -near_point.z / near_point.w;
+    float far_depth = std::min(-far_point.z / far_point.w, SHADOW_DISTANCE);
+    bool perspective = (projection[3][3] == 0.0f);
+    float extent_x = 1.0f / fabsf(projection[0][0]);
+    float extent_y = 1.0f / fabsf(projection[1][1]);
+
+    // Câmera: posição e sentido de visão em coordenadas globais.
+    glm::mat4 inverse_view = glm::inverse(view);
+    glm::vec3 camera_position = glm::vec3(inverse_view[3]);
+    glm::vec3 camera_forward = -glm::vec3(inverse_view[2]);
+
+    // Sistema de coordenadas da luz, com origem na origem global.
+    glm::vec4 up = (fabsf(light_direction.y) > 0.99f) ? glm::vec4(0.0f, 0.0f, 1.0f, 0.0f) : glm::vec4(0.0f, 1.0f, 0.0f, 0.0f);
+    glm::mat4 light_view = Matrix_Camera_View(glm::vec4(0.0f, 0.0f, 0.0f, 1.0f), -glm::vec4(light_direction, 0.0f), up);
+
+    float split_near = near_depth;
+    for (int c = 0; c < SHADOW_CASCADE_COUNT; ++c)
+    {
+        ShadowCascade& cascade = shadows.cascades[c];
+
+        // Divisão "prática": média entre as divisões logarítmica e uniforme.
+        float i = (float)(c + 1) / SHADOW_CASCADE_COUNT;
+        float split_log = near_depth * powf(far_depth / near_depth, i);
+        float split_uniform = near_depth + (far_depth - near_depth) * i;
+        float split_far = SHADOW_SPLIT_LAMBDA * split_log + (1.0f - SHADOW_SPLIT_LAMBDA) * split_uniform;
+
+        // Esfera envolvente da fatia [split_near, split_far], centrada no
+        // eixo da câmera. O raio depende somente das divisões e da
+        // projeção, então não varia enquanto a câmera se move; é arredondado
+        // para cima para que pequenas mudanças não invalidem o cache.
+        float center_depth = 0.5f * (split_near + split_far);
+        float radius = 0.0f;
+        for (int side = 0; side < 2; ++side)
+        {
+            float d = side ? split_far : split_near;
+            float ex = perspective ? d * extent_x : extent_x;
+            float ey = perspective ? d * extent_y : extent_y;
+            radius = std::max(radius, sqrtf(ex*ex + ey*ey + (d - center_depth)*(d - center_depth)));
+        }
+        radius = ceilf(radius);
+
+        // A cobertura tem uma folga de SHADOW_COVERAGE_MARGIN e o centro é
+        // arredondado para uma grade de passo menor que a folga (e múltiplo
+        // do texel, o que também evita que as bordas das sombras "tremam").
+        float half_size = radius * (1.0f + SHADOW_COVERAGE_MARGIN);
+        float texel = 2.0f * half_size / SHADOW_MAP_SIZE;
+        float step = texel * floorf(radius * SHADOW_COVERAGE_MARGIN / texel);
+
+        glm::vec4 center_world = glm::vec4(camera_position + camera_forward * center_depth, 1.0f);
+        glm::vec3 center = glm::vec3(light_view * center_world);
+        center = glm::floor(center / step + 0.5f) * step;
+
+        cascade.center = center;
+        cascade.half_size = half_size;
+        cascade.split = split_far;
+
+        glm::mat4 light_projection = Matrix_Orthographic(center.x - half_size, center.x + half_size,
+                                                         center.y - half_size, center.y + half_size,
+                                                         center.z + SHADOW_DEPTH_RANGE, center.z - SHADOW_DEPTH_RANGE);
+        cascade.light_view_projection = light_projection * light_view;
+
+        if ( cascade.static_valid && (cascade.static_center != center || cascade.static_half_size != half_size) )
+            cascade.static_valid = false;
+
+        // De NDC ([-1,1]) para coordenadas do mapa de sombra ([0,1]).
+        constants.shadow_matrices[c] = Matrix_Translate(0.5f, 0.5f, 0.5f) * Matrix_Scale(0.5f, 0.5f, 0.5f) * cascade.light_view_projection;
+        constants.shadow_splits[c] = split_far;
+        constants.shadow_texel_sizes[c] = texel;
+
+        split_near = split_far;
+    }
+    constants.shadow_splits.w = 1.0f;
+}
+
+// Desenha os pacotes de g_RenderQueue marcados com "caster" com a matriz
+// da luz dada.
+static int ShadowMaps_DrawCasters(ShadowCaster caster, const glm::mat4& light_view_projection)
+{
+    ShadowMaps& shadows = g_ShadowMaps;
+    const RenderQueue& queue = g_RenderQueue;
+
+    glUniformMatrix4fv(shadows.light_view_projection_uniform, 1, GL_FALSE, glm::value_ptr(light_view_projection));
+
+    int drawn = 0;
+    for (size_t i = 0; i < queue.packets.size(); ++i)
+    {
+        const DrawPacket& packet = queue.packets[i];
+        if ( packet.shadow_caster != caster )
+            continue;
+
+        glBindVertexArray(packet.vao);
+        glUniformMatrix4fv(shadows.model_uniform, 1, GL_FALSE, glm::value_ptr(queue.matrices[packet.model_index]));
+        glUniform1i(shadows.instanced_uniform, RenderQueue_IsInstanced(packet) ? 1 : 0);
+        if ( packet.texture_target != 0 )
+        {
+            glActiveTexture(GL_TEXTURE0 + packet.texture_unit);
+            glBindTexture(packet.texture_target, packet.texture_id);
+            glActiveTexture(GL_TEXTURE0);
+        }
+        RenderQueue_Draw(packet);
+        drawn += 1;
+    }
+    return drawn;
+}
+
+// Atualiza os mapas de sombra a partir dos pacotes enfileirados neste
+// quadro. Deve ser chamada após ShadowMaps_Update() e antes de
+// RenderQueue_Submit(); ao final, o framebuffer e o viewport anteriores são
+// restaurados.
+void ShadowMaps_Render()
+{
+    ShadowMaps& shadows = g_ShadowMaps;
+    const RenderQueue& queue = g_RenderQueue;
+
+    shadows.static_renders = 0;
+    shadows.dynamic_casters = 0;
+    if ( !shadows.enabled || shadows.program_id == 0 )
+        return;
+
+    // Resultados das consultas emitidas há SHADOW_QUERY_FRAMES quadros,
+    // sem esperar a GPU: consultas ainda não prontas são descartadas.
+    shadows.query_frame = (shadows.query_frame + 1) % SHADOW_QUERY_FRAMES;
+    int f = shadows.query_frame;
+    for (int c = 0; c < SHADOW_CASCADE_COUNT; ++c)
+    for (int k = 0; k < 2; ++k)
+    {
+        if ( !shadows.query_pending[f][c][k] )
+            continue;
+        GLint available = 0;
+        glGetQueryObjectiv(shadows.queries[f][c][k], GL_QUERY_RESULT_AVAILABLE, &available);
+        if ( available )
+        {
+            GLuint64 ns = 0;
+            glGetQueryObjectui64v(shadows.queries[f][c][k], GL_QUERY_RESULT, &ns);
+            (k == 0 ? shadows.static_ms : shadows.dynamic_ms)[c] = ns / 1.0e6;
+        }
+        shadows.query_pending[f][c][k] = false;
+    }
+
+    // Resumo dos pacotes estáticos: se mudou (chunks carregados ou
+    // descarregados, voxels editados), todas as cascatas estáticas são
+    // redesenhadas. A ordem dos pacotes na fila muda com a posição da
+    // câmera, então o resumo é a soma dos hashes de cada pacote, que não
+    // depende da ordem.
+    uint64_t signature = 0;
+    for (size_t i = 0; i < queue.packets.size(); ++i)
+    {
+        const DrawPacket& packet = queue.packets[i];
+        if ( packet.shadow_caster != SHADOW_CASTER_STATIC )
+            continue;
+        uint64_t hash = 1469598103934665603ull;
+        uint64_t values[3] = { packet.vao, (uint64_t)packet.first, (uint64_t)packet.count };
+        for (int v = 0; v < 3; ++v)
+            hash = (hash ^ values[v]) * 1099511628211ull;
+        signature += hash;
+    }
+    if ( signature != shadows.static_signature )
+    {
+        shadows.static_signature = signature;
+        for (int c = 0; c < SHADOW_CASCADE_COUNT; ++c)
+            shadows.cascades[c].static_valid = false;
+    }
+
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    GLint framebuffer = 0; // Não necessariamente 0 (por exemplo, no modo headless)
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &framebuffer);
+
+    glViewport(0, 0, SHADOW_MAP_SIZE, SHADOW_MAP_SIZE);
+    glUseProgram(shadows.program_id);
+    glEnable(GL_DEPTH_TEST);
+    glDepthMask(GL_TRUE);
+    glDepthFunc(GL_LESS);
+    glDisable(GL_CULL_FACE); // Objetos abertos (pássaros) também projetam sombra
+    glEnable(GL_POLYGON_OFFSET_FILL);
+    glPolygonOffset(2.0f, 4.0f);
+
+    for (int c = 0; c < SHADOW_CASCADE_COUNT; ++c)
+    {
+        ShadowCascade& cascade = shadows.cascades[c];
+
+        // Cascata estática, somente se a cobertura mudou.
+        if ( !cascade.static_valid )
+        {
+            glBeginQuery(GL_TIME_ELAPSED, shadows.queries[f][c][0]);
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, shadows.draw_framebuffer);
+            glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, shadows.static_texture, 0, c);
+            glClear(GL_DEPTH_BUFFER_BIT);
+            ShadowMaps_DrawCasters(SHADOW_CASTER_STATIC, cascade.light_view_projection);
+            glEndQuery(GL_TIME_ELAPSED);
+            shadows.query_pending[f][c][0] = true;
+
+            cascade.static_valid = true;
+            cascade.static_center = cascade.center;
+            cascade.static_half_size = cascade.half_size;
+            shadows.static_renders += 1;
+            shadows.static_renders_total += 1;
+        }
+
+        // Mapa final: cópia da cascata estática + objetos dinâmicos.
+        glBeginQuery(GL_TIME_ELAPSED, shadows.queries[f][c][1]);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, shadows.read_framebuffer);
+        glFramebufferTextureLayer(GL_READ_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, shadows.static_texture, 0, c);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, shadows.draw_framebuffer);
+        glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, shadows.final_texture, 0, c);
+        glBlitFramebuffer(0, 0, SHADOW_MAP_SIZE, SHADOW_MAP_SIZE, 0, 0, SHADOW_MAP_SIZE, SHADOW_MAP_SIZE,
+                          GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+        shadows.dynamic_casters = ShadowMaps_DrawCasters(SHADOW_CASTER_DYNAMIC, cascade.light_view_projection);
+        glEndQuery(GL_TIME_ELAPSED);
+        shadows.query_pending[f][c][1] = true;
+    }
+
+    glDisable(GL_POLYGON_OFFSET_FILL);
+    glEnable(GL_CULL_FACE);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glBindVertexArray(0);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+}
@@ -0,0 +1,339 @@
+// Culling por oclusão em software. Alternativa às consultas de oclusão em
+// hardware (veja "occlusion.cpp"), que não possui latência: o resultado é
+// conhecido no mesmo quadro, antes de qualquer chamada OpenGL.
+//
+// A cada quadro, rasterizamos na CPU alguns poucos objetos marcados como
+// oclusores (por exemplo, a plataforma) em um Z-buffer de baixa resolução.
+// A rasterização é dividida em faixas horizontais processadas em paralelo
+// pelo sistema de tarefas (veja "job_system.cpp"), e avalia 4 pixels por vez
+// com instruções SSE. Depois, construímos um Z-buffer hierárquico (Hi-Z)
+// guardando a MAIOR profundidade de cada bloco de 8x8 pixels. Para testar um
+// objeto, projetamos sua AABB na tela: se o ponto mais próximo da caixa está
+// atrás da profundidade máxima de todos os blocos que ela cobre, o objeto
+// está completamente escondido.
+#include <chrono>
+#include <vector>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define SOFTWARE_OCCLUSION_SSE 1
+#endif
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec4.hpp>
+
+#define SW_DEPTH_WIDTH  256
+#define SW_DEPTH_HEIGHT 128
+#define SW_HIZ_TILE     8
+#define SW_HIZ_WIDTH    (SW_DEPTH_WIDTH / SW_HIZ_TILE)
+#define SW_HIZ_HEIGHT   (SW_DEPTH_HEIGHT / SW_HIZ_TILE)
+
+// Um oclusor é uma lista de triângulos (3 vértices consecutivos) em
+// coordenadas do modelo, junto de sua matriz de modelagem.
+struct SoftwareOccluder
+{
+    std::vector<glm::vec4> vertices;
+    glm::mat4              model;
+};
+
+// Triângulo já projetado na tela, com as equações de aresta e de
+// profundidade na forma a*x + b*y + c, avaliadas no centro de cada pixel.
+struct SoftwareTriangle
+{
+    float edge_a[3], edge_b[3], edge_c[3];
+    float depth_a, depth_b, depth_c;
+    int   xmin, xmax, ymin, ymax;
+};
+
+struct SoftwareOcclusion
+{
+    bool enabled = false;
+
+    std::vector<SoftwareOccluder> occluders;
+    std::vector<SoftwareTriangle> triangles;
+
+    // Profundidade em [0,1] (0 = near plane). Linha 0 é a de baixo da tela.
+    std::vector<float> depth;
+    float              hiz[SW_HIZ_WIDTH * SW_HIZ_HEIGHT];
+
+    glm::mat4 view_projection;
+
+    // Estatísticas do quadro atual
+    double raster_ms = 0.0;
+    double test_ms = 0.0;
+    int    triangles_rasterized = 0;
+    int    objects_tested = 0;
+    int    objects_culled = 0;
+};
+
+SoftwareOcclusion g_SoftwareOcclusion;
+
+// Marca uma malha de triângulos como oclusor.
+void SoftwareOcclusion_AddOccluder(const std::vector<glm::vec4>& vertices, const glm::mat4& model)
+{
+    SoftwareOccluder occluder;
+    occluder.vertices = vertices;
+    occluder.model = model;
+    g_SoftwareOcclusion.occluders.push_back(occluder);
+}
+
+// Converte um ponto em coordenadas de recorte para coordenadas do Z-buffer
+// em software: x e y em pixels, z em [0,1].
+static glm::vec3 SoftwareOcclusion_ToScreen(const glm::vec4& p_clip)
+{
+    float inv_w = 1.0f / p_clip.w;
+    return glm::vec3((p_clip.x * inv_w * 0.5f + 0.5f) * SW_DEPTH_WIDTH,
+                     (p_clip.y * inv_w * 0.5f + 0.5f) * SW_DEPTH_HEIGHT,
+                     p_clip.z * inv_w * 0.5f + 0.5f);
+}
+
+// Projeta os triângulos dos oclusores e prepara suas equações de aresta.
+static void SoftwareOcclusion_SetupTriangles()
+{
+    g_SoftwareOcclusion.triangles.clear();
+
+    for (size_t o = 0; o < g_SoftwareOcclusion.occluders.size(); ++o)
+    {
+        const SoftwareOccluder& occluder = g_SoftwareOcclusion.occluders[o];
+        glm::mat4 mvp = g_SoftwareOcclusion.view_projection * occluder.model;
+
+        for (size_t v = 0; v + 2 < occluder.vertices.size(); v += 3)
+        {
+            glm::vec4 c0 = mvp * occluder.vertices[v + 0];
+            glm::vec4 c1 = mvp * occluder.vertices[v + 1];
+            glm::vec4 c2 = mvp * occluder.vertices[v + 2];
+
+            // Triângulos que cruzam o near plane são simplesmente ignorados.
+            // Isso é conservador: um oclusor a menos nunca esconde um objeto
+            // visível.
+            const float near_w = 1e-3f;
+            if ( c0.w < near_w || c1.w < near_w || c2.w < near_w )
+                continue;
+
+            glm::vec3 p0 = SoftwareOcclusion_ToScreen(c0);
+            glm::vec3 p1 = SoftwareOcclusion_ToScreen(c1);
+            glm::vec3 p2 = SoftwareOcclusion_ToScreen(c2);
+
+            // Backface culling: para malhas fechadas, as faces da frente já
+            // definem a superfície mais próxima.
+            float area = (p1.x - p0.x)*(p2.y - p0.y) - (p2.x - p0.x)*(p1.y - p0.y);
+            if ( area <= 0.0f )
+                continue;
+
+            SoftwareTriangle tri;
+            tri.xmin = std::max(0, (int)std::floor(std::min(p0.x, std::min(p1.x, p2.x))));
+            tri.xmax = std::min(SW_DEPTH_WIDTH - 1, (int)std::ceil(std::max(p0.x, std::max(p1.x, p2.x))));
+            tri.ymin = std::max(0, (int)std::floor(std::min(p0.y, std::min(p1.y, p2.y))));
+            tri.ymax = std::min(SW_DEPTH_HEIGHT - 1, (int)std::ceil(std::max(p0.y, std::max(p1.y, p2.y))));
+            if ( tri.xmin > tri.xmax || tri.ymin > tri.ymax )
+                continue;
+
+            // Função de aresta E(p) = (b.x-a.x)*(p.y-a.y) - (b.y-a.y)*(p.x-a.x),
+            // positiva no interior de um triângulo anti-horário. Pixels sobre
+            // a aresta (E = 0) são incluídos, para que não fiquem buracos
+            // entre triângulos vizinhos da mesma malha.
+            const glm::vec3* v_a[3] = { &p1, &p2, &p0 };
+            const glm::vec3* v_b[3] = { &p2, &p0, &p1 };
+            for (int e = 0; e < 3; ++e)
+            {
+                const glm::vec3& a = *v_a[e];
+                const glm::vec3& b = *v_b[e];
+                tri.edge_a[e] = -(b.y - a.y);
+                tri.edge_b[e] =  (b.x - a.x);
+                tri.edge_c[e] =  (b.y - a.y)*a.x - (b.x - a.x)*a.y;
+            }
+
+            // A profundidade z/w é uma função afim das coordenadas de tela,
+            // então a escrevemos como um plano z = a*x + b*y + c.
+            float inv_area = 1.0f / area;
+            tri.depth_a = (tri.edge_a[0]*p0.z + tri.edge_a[1]*p1.z + tri.edge_a[2]*p2.z) * inv_area;
+            tri.depth_b = (tri.edge_b[0]*p0.z + tri.edge_b[1]*p1.z + tri.edge_b[2]*p2.z) * inv_area;
+            tri.depth_c = (tri.edge_c[0]*p0.z + tri.edge_c[1]*p1.z + tri.edge_c[2]*p2.z) * inv_area;
+
+            g_SoftwareOcclusion.triangles.push_back(tri);
+        }
+    }
+}
+
+// Rasteriza todos os triângulos nas linhas [row_begin, row_end) do Z-buffer.
+static void SoftwareOcclusion_RasterizeRows(int row_begin, int row_end)
+{
+    float* depth = g_SoftwareOcclusion.depth.data();
+
+    std::fill(depth + row_begin*SW_DEPTH_WIDTH, depth + row_end*SW_DEPTH_WIDTH, 1.0f);
+
+    for (size_t t = 0; t < g_SoftwareOcclusion.triangles.size(); ++t)
+    {
+        const SoftwareTriangle& tri = g_SoftwareOcclusion.triangles[t];
+
+        int ymin = std::max(tri.ymin, row_begin);
+        int ymax = std::min(tri.ymax, row_end - 1);
+        if ( ymin > ymax )
+            continue;
+
+        // Começamos em um múltiplo de 4 para processar 4 pixels alinhados.
+        int xmin = tri.xmin & ~3;
+
+        for (int y = ymin; y <= ymax; ++y)
+        {
+            float py = (float)y + 0.5f;
+            float* row = depth + y*SW_DEPTH_WIDTH;
+
+#ifdef SOFTWARE_OCCLUSION_SSE
+            __m128 zero = _mm_setzero_ps();
+            __m128 px_step = _mm_set1_ps(4.0f);
+            __m128 px = _mm_add_ps(_mm_set1_ps((float)xmin + 0.5f), _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f));
+
+            __m128 ea[3], eb[3];
+            for (int e = 0; e < 3; ++e)
+            {
+                ea[e] = _mm_set1_ps(tri.edge_a[e]);
+                eb[e] = _mm_set1_ps(tri.edge_b[e]*py + tri.edge_c[e]);
+            }
+            __m128 za = _mm_set1_ps(tri.depth_a);
+            __m128 zb = _mm_set1_ps(tri.depth_b*py + tri.depth_c);
+
+            for (int x = xmin; x <= tri.xmax; x += 4)
+            {
+                __m128 w0 = _mm_add_ps(_mm_mul_ps(ea[0], px), eb[0]);
+                __m128 w1 = _mm_add_ps(_mm_mul_ps(ea[1], px), eb[1]);
+                __m128 w2 = _mm_add_ps(_mm_mul_ps(ea[2], px), eb[2]);
+
+                __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(w0, zero), _mm_cmpge_ps(w1, zero)),
+                                           _mm_cmpge_ps(w2, zero));
+
+                if ( _mm_movemask_ps(inside) != 0 )
+                {
+                    __m128 z = _mm_add_ps(_mm_mul_ps(za, px), zb);
+                    __m128 old_z = _mm_loadu_ps(row + x);
+                    __m128 new_z = _mm_min_ps(old_z, z);
+                    _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, new_z), _mm_andnot_ps(inside, old_z)));
+                }
+
+                px = _mm_add_ps(px, px_step);
+            }
+#else
+            for (int x = xmin; x <= tri.xmax; ++x)
+            {
+                float px = (float)x + 0.5f;
+                float w0 = tri.edge_a[0]*px + tri.edge_b[0]*py + tri.edge_c[0];
+                float w1 = tri.edge_a[1]*px + tri.edge_b[1]*py + tri.edge_c[1];
+                float w2 = tri.edge_a[2]*px + tri.edge_b[2]*py + tri.edge_c[2];
+                if ( w0 >= 0.0f && w1 >= 0.0f && w2 >= 0.0f )
+                {
+                    float z = tri.depth_a*px + tri.depth_b*py + tri.depth_c;
+                    row[x] = std::min(row[x], z);
+                }
+            }
+#endif
+        }
+    }
+
+    // Hi-Z: maior profundidade de cada bloco nas linhas processadas.
+    for (int ty = row_begin / SW_HIZ_TILE; ty < row_end / SW_HIZ_TILE; ++ty)
+    {
+        for (int tx = 0; tx < SW_HIZ_WIDTH; ++tx)
+        {
+            float max_depth = 0.0f;
+            for (int y = ty*SW_HIZ_TILE; y < (ty + 1)*SW_HIZ_TILE; ++y)
+                for (int x = tx*SW_HIZ_TILE; x < (tx + 1)*SW_HIZ_TILE; ++x)
+                    max_depth = std::max(max_depth, depth[y*SW_DEPTH_WIDTH + x]);
+            g_SoftwareOcclusion.hiz[ty*SW_HIZ_WIDTH + tx] = max_depth;
+        }
+    }
+}
+
+// Rasteriza os oclusores para o quadro atual. Deve ser chamada uma vez por
+// quadro, após a definição das matrizes view e projection.
+void SoftwareOcclusion_RenderOccluders(const glm::mat4& view_projection)
+{
+    g_SoftwareOcclusion.objects_tested = 0;
+    g_SoftwareOcclusion.objects_culled = 0;
+    g_SoftwareOcclusion.test_ms = 0.0;
+
+    if ( !g_SoftwareOcclusion.enabled )
+        return;
+
+    auto start = std::chrono::steady_clock::now();
+
+    if ( g_SoftwareOcclusion.depth.empty() )
+        g_SoftwareOcclusion.depth.resize(SW_DEPTH_WIDTH * SW_DEPTH_HEIGHT);
+
+    g_SoftwareOcclusion.view_projection = view_projection;
+    SoftwareOcclusion_SetupTriangles();
+    g_SoftwareOcclusion.triangles_rasterized = (int)g_SoftwareOcclusion.triangles.size();
+
+    // Uma tarefa por linha de blocos do Hi-Z: cada thread escreve somente em
+    // suas próprias linhas, então não há necessidade de sincronização.
+    JobSystem_ParallelFor(SW_HIZ_HEIGHT, [](int band) {
+        SoftwareOcclusion_RasterizeRows(band * SW_HIZ_TILE, (band + 1) * SW_HIZ_TILE);
+    });
+
+    auto end = std::chrono::steady_clock::now();
+    g_SoftwareOcclusion.raster_ms = std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+// Testa se uma AABB (em coordenadas globais) pode estar visível.
+bool SoftwareOcclusion_IsVisible(const glm::vec3& bbox_min, const glm::vec3& bbox_max)
+{
+    if ( !g_SoftwareOcclusion.enabled )
+        return true;
+
+    auto start = std::chrono::steady_clock::now();
+    g_SoftwareOcclusion.objects_tested += 1;
+
+    bool visible = false;
+
+    float xmin = std::numeric_limits<float>::max(), xmax = -std::numeric_limits<float>::max();
+    float ymin = std::numeric_limits<float>::max(), ymax = -std::numeric_limits<float>::max();
+    float zmin = std::numeric_limits<float>::max();
+
+    for (int i = 0; i < 8 && !visible; ++i)
+    {
+        glm::vec4 corner = glm::vec4((i & 1) ? bbox_max.x : bbox_min.x,
+                                     (i & 2) ? bbox_max.y : bbox_min.y,
+                                     (i & 4) ? bbox_max.z : bbox_min.z,
+                                     1.0f);
+        glm::vec4 c = g_SoftwareOcclusion.view_projection * corner;
+
+        // Caixa cruzando o near plane: não temos como projetá-la, então
+        // assumimos que está visível.
+        if ( c.w < 1e-3f )
+        {
+            visible = true;
+            break;
+        }
+
+        glm::vec3 p = SoftwareOcclusion_ToScreen(c);
+        xmin = std::min(xmin, p.x); xmax = std::max(xmax, p.x);
+        ymin = std::min(ymin, p.y); ymax = std::max(ymax, p.y);
+        zmin = std::min(zmin, p.z);
+    }
+
+    if ( !visible )
+    {
+        int txmin = std::max(0, (int)std::floor(xmin) / SW_HIZ_TILE);
+        int txmax = std::min(SW_HIZ_WIDTH - 1, (int)std::floor(xmax) / SW_HIZ_TILE);
+        int tymin = std::max(0, (int)std::floor(ymin) / SW_HIZ_TILE);
+        int tymax = std::min(SW_HIZ_HEIGHT - 1, (int)std::floor(ymax) / SW_HIZ_TILE);
+
+        // Fora da tela: isso é responsabilidade do frustum culling, não
+        // escondemos o objeto aqui.
+        if ( xmax < 0.0f || ymax < 0.0f || xmin >= SW_DEPTH_WIDTH || ymin >= SW_DEPTH_HEIGHT )
+            visible = true;
+
+        for (int ty = tymin; ty <= tymax && !visible; ++ty)
+            for (int tx = txmin; tx <= txmax && !visible; ++tx)
+                if ( zmin <= g_SoftwareOcclusion.hiz[ty*SW_HIZ_WIDTH + tx] )
+                    visible = true;
+    }
+
+    if ( !visible )
+        g_SoftwareOcclusion.objects_culled += 1;
+
+    auto end = std::chrono::steady_clock::now();
+    g_SoftwareOcclusion.test_ms += std::chrono::duration<double, std::milli>(end - start).count();
+
+    return visible;
+}
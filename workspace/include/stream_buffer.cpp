@@ -0,0 +1,238 @@
+// Buffer de streaming para dados que mudam a cada quadro (constantes do
+// quadro, instâncias, vértices do texto).
+//
+// Em vez de cada usuário reescrever o seu próprio buffer com
+// glBufferSubData() enquanto a GPU ainda pode estar lendo o conteúdo
+// anterior (o que obriga o driver a esperar ou a copiar os dados), todos
+// alocam regiões novas de um único buffer com StreamBuffer_Allocate(), uma
+// alocação "bump": o próximo byte livre só avança. O buffer é dividido em
+// STREAM_BUFFER_FRAMES regiões, uma por quadro; uma fence por região garante
+// que a região só é reutilizada depois que a GPU terminou o quadro que a
+// usou (normalmente, há muito tempo).
+//
+// Com glBufferStorage() (OpenGL 4.4 ou ARB_buffer_storage), o buffer é
+// mapeado uma única vez, de forma persistente e coerente: alocar é somente
+// somar um deslocamento, e a escrita vai direto para a memória lida pela
+// GPU. O GLAD deste projeto é o do OpenGL 3.3, então glBufferStorage() é
+// carregada à parte. Sem ela, cada quadro começa descartando o buffer
+// ("orphaning", glBufferData(NULL)) e cada alocação é mapeada com
+// GL_MAP_UNSYNCHRONIZED_BIT e desmapeada em StreamBuffer_Commit().
+//
+// Se uma região enche no meio do quadro, a alocação falha (pointer NULL) e
+// é contada em "overflows"; o chamador usa então o seu próprio buffer, como
+// antes do buffer de streaming. Não recomeçamos a região: as constantes do
+// quadro e as instâncias já alocadas nela ainda estão ligadas e serão lidas
+// pelos desenhos seguintes.
+#include <cstdio>
+#include <cstring>
+
+#include <glad/glad.h>
+
+#define STREAM_BUFFER_FRAMES      3
+#define STREAM_BUFFER_REGION_SIZE (4*1024*1024) // Bytes por quadro
+
+// Constantes e função de ARB_buffer_storage, ausentes no GLAD do OpenGL 3.3
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT   0x0080
+#endif
+typedef void (APIENTRYP StreamBufferStorageProc)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+
+// Região alocada: "pointer" aponta para "size" bytes em "buffer", a partir
+// de "offset". Os dados devem ser escritos antes de StreamBuffer_Commit().
+struct StreamAllocation
+{
+    GLuint     buffer;
+    GLintptr   offset;
+    GLsizeiptr size;
+    void*      pointer;
+};
+
+struct StreamBuffer
+{
+    bool           allow_persistent = true; // Falso com "--no-buffer-storage"
+    bool           persistent = false;      // Mapeamento persistente em uso
+    GLuint         buffer_id = 0;
+    unsigned char* mapped = NULL;           // Início do mapeamento persistente
+    GLint          uniform_alignment = 256; // GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+    int            region = 0;              // Região do quadro atual
+    GLsizeiptr     head = 0;                // Próximo byte livre da região
+    GLsync         fences[STREAM_BUFFER_FRAMES] = {};
+
+    // Estatísticas
+    GLsizeiptr     frame_bytes = 0;   // Bytes alocados no último quadro completo
+    unsigned int   allocations = 0;   // Alocações no último quadro completo
+    unsigned int   frame_allocations = 0;
+    unsigned int   fence_waits = 0;   // Vezes em que foi preciso esperar a GPU
+    unsigned int   overflows = 0;     // Alocações recusadas por falta de espaço
+};
+
+StreamBuffer g_StreamBuffer;
+
+// Cria o buffer. Deve ser chamada após a criação do contexto OpenGL.
+void StreamBuffer_Init()
+{
+    StreamBuffer& stream = g_StreamBuffer;
+    if ( stream.buffer_id != 0 )
+        return;
+
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &stream.uniform_alignment);
+
+    // glBufferStorage() existe a partir do OpenGL 4.4 ou com a extensão
+    bool has_storage = GLVersion.major > 4 || (GLVersion.major == 4 && GLVersion.minor >= 4);
+    GLint num_extensions = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &num_extensions);
+    for (GLint i = 0; i < num_extensions && !has_storage; ++i)
+        has_storage = strcmp((const char*)glGetStringi(GL_EXTENSIONS, i), "GL_ARB_buffer_storage") == 0;
+
+    StreamBufferStorageProc buffer_storage = NULL;
+    if ( has_storage && stream.allow_persistent )
+        buffer_storage = (StreamBufferStorageProc)Headless_GetProcAddress("glBufferStorage");
+
+    glGenBuffers(1, &stream.buffer_id);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, stream.buffer_id);
+
+    if ( buffer_storage != NULL )
+    {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        GLsizeiptr size = (GLsizeiptr)STREAM_BUFFER_REGION_SIZE * STREAM_BUFFER_FRAMES;
+        buffer_storage(GL_COPY_WRITE_BUFFER, size, NULL, flags);
+        stream.mapped = (unsigned char*)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, size, flags);
+        stream.persistent = (stream.mapped != NULL);
+    }
+
+    if ( !stream.persistent )
+    {
+        // O armazenamento de glBufferStorage() é imutável; se o mapeamento
+        // falhou, recomeçamos com um buffer comum.
+        if ( buffer_storage != NULL )
+        {
+            glDeleteBuffers(1, &stream.buffer_id);
+            glGenBuffers(1, &stream.buffer_id);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, stream.buffer_id);
+        }
+        glBufferData(GL_COPY_WRITE_BUFFER, STREAM_BUFFER_REGION_SIZE, NULL, GL_STREAM_DRAW);
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    printf("Stream buffer: %d x %d KB, %s.\n", STREAM_BUFFER_FRAMES, STREAM_BUFFER_REGION_SIZE / 1024,
+           stream.persistent ? "persistent mapping" : "orphaning");
+}
+
+// Inicia um quadro na próxima região, esperando, se necessário, que a GPU
+// termine o quadro que a usou.
+void StreamBuffer_BeginFrame()
+{
+    StreamBuffer& stream = g_StreamBuffer;
+    stream.region = (stream.region + 1) % STREAM_BUFFER_FRAMES;
+    stream.head = 0;
+    stream.frame_allocations = 0;
+
+    if ( stream.persistent )
+    {
+        GLsync& fence = stream.fences[stream.region];
+        if ( fence != 0 )
+        {
+            if ( glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED )
+            {
+                stream.fence_waits += 1;
+                glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+            }
+            glDeleteSync(fence);
+            fence = 0;
+        }
+    }
+    else
+    {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, stream.buffer_id);
+        glBufferData(GL_COPY_WRITE_BUFFER, STREAM_BUFFER_REGION_SIZE, NULL, GL_STREAM_DRAW);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+}
+
+// Aloca "size" bytes, com o início múltiplo de "alignment", na região do
+// quadro atual. Retorna pointer NULL se não há espaço na região.
+StreamAllocation StreamBuffer_Allocate(GLsizeiptr size, GLsizeiptr alignment)
+{
+    StreamBuffer& stream = g_StreamBuffer;
+
+    StreamAllocation allocation;
+    allocation.buffer = stream.buffer_id;
+    allocation.offset = 0;
+    allocation.size = size;
+    allocation.pointer = NULL;
+    if ( size <= 0 )
+        return allocation;
+
+    GLsizeiptr start = ((stream.head + alignment - 1) / alignment) * alignment;
+    if ( start + size > STREAM_BUFFER_REGION_SIZE )
+    {
+        // Região cheia: o restante do quadro usa os buffers dos chamadores.
+        stream.overflows += 1;
+        return allocation;
+    }
+    stream.head = start + size;
+    stream.frame_allocations += 1;
+
+    if ( stream.persistent )
+    {
+        allocation.offset = (GLintptr)stream.region * STREAM_BUFFER_REGION_SIZE + start;
+        allocation.pointer = stream.mapped + allocation.offset;
+    }
+    else
+    {
+        // A faixa nunca foi usada desde o último descarte do buffer, então
+        // não há o que sincronizar.
+        allocation.offset = start;
+        glBindBuffer(GL_COPY_WRITE_BUFFER, stream.buffer_id);
+        allocation.pointer = glMapBufferRange(GL_COPY_WRITE_BUFFER, start, size,
+                                              GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+    return allocation;
+}
+
+// Torna os dados escritos em uma alocação visíveis para a GPU. Deve ser
+// chamada antes do primeiro desenho que os utiliza.
+void StreamBuffer_Commit(const StreamAllocation& allocation)
+{
+    if ( g_StreamBuffer.persistent || allocation.pointer == NULL )
+        return; // Mapeamento coerente: nada a fazer
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, allocation.buffer);
+    glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+// Copia "size" bytes de "data" para uma nova alocação. Retorna o buffer e,
+// em "offset", a posição dos dados nele; retorna 0 se não há espaço.
+GLuint StreamBuffer_Write(const void* data, GLsizeiptr size, GLsizeiptr alignment, GLintptr* offset)
+{
+    StreamAllocation allocation = StreamBuffer_Allocate(size, alignment);
+    if ( allocation.pointer == NULL )
+        return 0;
+
+    memcpy(allocation.pointer, data, size);
+    StreamBuffer_Commit(allocation);
+    *offset = allocation.offset;
+    return allocation.buffer;
+}
+
+// Marca o fim dos comandos que utilizam a região do quadro atual. Deve ser
+// chamada após o último desenho do quadro.
+void StreamBuffer_EndFrame()
+{
+    StreamBuffer& stream = g_StreamBuffer;
+    stream.frame_bytes = stream.head;
+    stream.allocations = stream.frame_allocations;
+
+    if ( !stream.persistent )
+        return;
+
+    GLsync& fence = stream.fences[stream.region];
+    if ( fence != 0 )
+        glDeleteSync(fence);
+    fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
@@ -0,0 +1,444 @@
+// Terreno em voxels, feito do mesmo bloco de grama das plataformas (grama no
+// topo, "grass_sides3" nas laterais e terra embaixo). O terreno é uma grade
+// de blocos unitários dividida em chunks de VOXEL_CHUNK_SIZE^3 blocos.
+//
+// Cada chunk é desenhado com uma única chamada: sua malha contém somente as
+// faces expostas (entre um bloco sólido e um vazio), e faces coplanares
+// vizinhas do mesmo tipo são unidas em retângulos maiores ("greedy meshing").
+// Quando um bloco é alterado, o seu chunk (e os vizinhos, se o bloco estiver
+// na borda) é marcado como sujo e a malha é refeita nas threads de trabalho.
+//
+// A colisão com o terreno não utiliza SAT: consultamos diretamente na grade
+// os blocos que uma caixa ocupa.
+//
+// Utiliza JobSystem_ParallelFor() ("job_system.cpp") e o formato de vértices
+// de WorldChunk_CreateVertexArray() ("world_streaming.cpp").
+#include <cmath>
+#include <limits>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <functional>
+
+#include <glad/glad.h>
+
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+#define VOXEL_CHUNK_SIZE 32
+
+// Tipos de bloco (0 = vazio). O tipo é enviado ao shader em texcoords.x.
+#define VOXEL_EMPTY 0
+#define VOXEL_GRASS 1
+#define VOXEL_DIRT  2
+
+struct VoxelChunk
+{
+    std::vector<unsigned char> blocks;   // VOXEL_CHUNK_SIZE^3 blocos, índice x + S*(y + S*z)
+    bool                       dirty = true;
+    std::vector<float>         mesh;     // Malha refeita, aguardando envio à GPU
+    GLuint                     vao = 0;
+    GLuint                     vbo = 0;
+    GLsizei                    vertex_count = 0;
+};
+
+struct VoxelWorld
+{
+    bool       enabled = false;
+    glm::ivec3 origin;       // Coordenada global do primeiro bloco
+    glm::ivec3 size;         // Número de blocos em cada eixo
+    glm::ivec3 num_chunks;   // Número de chunks em cada eixo
+    std::vector<VoxelChunk> chunks;
+
+    // Estatísticas, mostradas na tela.
+    int    chunks_remeshed = 0;
+    double remesh_ms = 0.0;
+    int    quads = 0;
+    int    draw_calls = 0;
+};
+
+VoxelWorld g_VoxelWorld;
+
+// Cria um terreno vazio com "size" blocos em cada eixo, a partir
+// da coordenada global "origin".
+void Voxel_Init(const glm::ivec3& origin, const glm::ivec3& size)
+{
+    g_VoxelWorld.enabled = true;
+    g_VoxelWorld.origin = origin;
+    g_VoxelWorld.size = size;
+    g_VoxelWorld.num_chunks = (size + glm::ivec3(VOXEL_CHUNK_SIZE - 1)) / VOXEL_CHUNK_SIZE;
+    g_VoxelWorld.chunks.resize(g_VoxelWorld.num_chunks.x * g_VoxelWorld.num_chunks.y * g_VoxelWorld.num_chunks.z);
+
+    for (size_t i = 0; i < g_VoxelWorld.chunks.size(); ++i)
+        g_VoxelWorld.chunks[i].blocks.assign(VOXEL_CHUNK_SIZE*VOXEL_CHUNK_SIZE*VOXEL_CHUNK_SIZE, VOXEL_EMPTY);
+}
+
+static int Voxel_ChunkIndex(const glm::ivec3& c)
+{
+    return c.x + g_VoxelWorld.num_chunks.x * (c.y + g_VoxelWorld.num_chunks.y * c.z);
+}
+
+static int Voxel_FloorDiv(int a, int b)
+{
+    return (a >= 0) ? a / b : -((-a + b - 1) / b);
+}
+
+// Retorna o tipo do bloco na coordenada global (x,y,z). Fora do terreno, vazio.
+unsigned char Voxel_GetBlock(int x, int y, int z)
+{
+    if ( !g_VoxelWorld.enabled )
+        return VOXEL_EMPTY;
+
+    glm::ivec3 p = glm::ivec3(x, y, z) - g_VoxelWorld.origin;
+    glm::ivec3 c = glm::ivec3(Voxel_FloorDiv(p.x, VOXEL_CHUNK_SIZE), Voxel_FloorDiv(p.y, VOXEL_CHUNK_SIZE), Voxel_FloorDiv(p.z, VOXEL_CHUNK_SIZE));
+    if ( c.x < 0 || c.y < 0 || c.z < 0 || c.x >= g_VoxelWorld.num_chunks.x || c.y >= g_VoxelWorld.num_chunks.y || c.z >= g_VoxelWorld.num_chunks.z )
+        return VOXEL_EMPTY;
+
+    glm::ivec3 l = p - c * VOXEL_CHUNK_SIZE;
+    return g_VoxelWorld.chunks[Voxel_ChunkIndex(c)].blocks[l.x + VOXEL_CHUNK_SIZE*(l.y + VOXEL_CHUNK_SIZE*l.z)];
+}
+
+// Altera o bloco na coordenada global (x,y,z), marcando como sujos o seu
+// chunk e, se o bloco estiver na borda, os chunks vizinhos (cujas faces
+// expostas podem ter mudado).
+void Voxel_SetBlock(int x, int y, int z, unsigned char type)
+{
+    glm::ivec3 p = glm::ivec3(x, y, z) - g_VoxelWorld.origin;
+    glm::ivec3 c = glm::ivec3(Voxel_FloorDiv(p.x, VOXEL_CHUNK_SIZE), Voxel_FloorDiv(p.y, VOXEL_CHUNK_SIZE), Voxel_FloorDiv(p.z, VOXEL_CHUNK_SIZE));
+    if ( !g_VoxelWorld.enabled || c.x < 0 || c.y < 0 || c.z < 0 || c.x >= g_VoxelWorld.num_chunks.x || c.y >= g_VoxelWorld.num_chunks.y || c.z >= g_VoxelWorld.num_chunks.z )
+        return;
+
+    glm::ivec3 l = p - c * VOXEL_CHUNK_SIZE;
+    g_VoxelWorld.chunks[Voxel_ChunkIndex(c)].blocks[l.x + VOXEL_CHUNK_SIZE*(l.y + VOXEL_CHUNK_SIZE*l.z)] = type;
+    g_VoxelWorld.chunks[Voxel_ChunkIndex(c)].dirty = true;
+
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        glm::ivec3 neighbor = c;
+        if ( l[axis] == 0 )
+            neighbor[axis] -= 1;
+        else if ( l[axis] == VOXEL_CHUNK_SIZE - 1 )
+            neighbor[axis] += 1;
+        else
+            continue;
+
+        if ( neighbor[axis] >= 0 && neighbor[axis] < g_VoxelWorld.num_chunks[axis] )
+            g_VoxelWorld.chunks[Voxel_ChunkIndex(neighbor)].dirty = true;
+    }
+}
+
+// Preenche o terreno com colinas suaves: grama na camada de cima, terra abaixo.
+void Voxel_GenerateTerrain(unsigned int seed)
+{
+    glm::ivec3 size = g_VoxelWorld.size;
+    float phase_x = (seed % 97) * 0.37f;
+    float phase_z = (seed % 89) * 0.53f;
+
+    for (int z = 0; z < size.z; ++z)
+    for (int x = 0; x < size.x; ++x)
+    {
+        float h = 0.5f * size.y
+                + 0.18f * size.y * sin(x * 0.09f + phase_x) * cos(z * 0.07f + phase_z)
+                + 0.08f * size.y * sin((x + z) * 0.21f + phase_z);
+        int height = std::max(1, std::min(size.y, (int)h));
+
+        for (int y = 0; y < height; ++y)
+        {
+            glm::ivec3 p = g_VoxelWorld.origin + glm::ivec3(x, y, z);
+            Voxel_SetBlock(p.x, p.y, p.z, (y == height - 1) ? VOXEL_GRASS : VOXEL_DIRT);
+        }
+    }
+}
+
+// Adiciona um retângulo (dois triângulos) à malha. "normal_sign" indica se a
+// face aponta no sentido positivo ou negativo do eixo "d".
+static void Voxel_EmitQuad(std::vector<float>& mesh, const glm::vec3& p, const glm::vec3& du, const glm::vec3& dv, int d, int normal_sign, unsigned char type)
+{
+    glm::vec3 corners[4] = { p, p + du, p + du + dv, p + dv };
+    glm::vec3 normal(0.0f);
+    normal[d] = (float)normal_sign;
+
+    // du x dv aponta no sentido +d; para faces -d invertemos a ordem dos
+    // vértices, para que todas sejam anti-horárias vistas de fora (backface culling).
+    static const int order_positive[6] = { 0, 1, 2, 0, 2, 3 };
+    static const int order_negative[6] = { 0, 2, 1, 0, 3, 2 };
+    const int* order = (normal_sign > 0) ? order_positive : order_negative;
+
+    for (int i = 0; i < 6; ++i)
+    {
+        const glm::vec3& c = corners[order[i]];
+        float vertex[WORLD_CHUNK_VERTEX_FLOATS] = {
+            c.x, c.y, c.z, 1.0f,
+            normal.x, normal.y, normal.z, 0.0f,
+            (float)type, 0.0f,
+            c.x, c.y, c.z, 1.0f, // O "espaço do modelo" do terreno é o espaço global
+        };
+        mesh.insert(mesh.end(), vertex, vertex + WORLD_CHUNK_VERTEX_FLOATS);
+    }
+}
+
+// Refaz a malha de um chunk com greedy meshing. Executada nas threads de
+// trabalho: só lê os blocos (que não mudam durante a execução) e escreve na
+// malha do próprio chunk.
+static void Voxel_MeshChunk(int chunk_index)
+{
+    VoxelChunk& chunk = g_VoxelWorld.chunks[chunk_index];
+    chunk.mesh.clear();
+
+    const int S = VOXEL_CHUNK_SIZE;
+    glm::ivec3 c = glm::ivec3(chunk_index % g_VoxelWorld.num_chunks.x,
+                              (chunk_index / g_VoxelWorld.num_chunks.x) % g_VoxelWorld.num_chunks.y,
+                              chunk_index / (g_VoxelWorld.num_chunks.x * g_VoxelWorld.num_chunks.y));
+    glm::ivec3 base = g_VoxelWorld.origin + c * S;
+
+    // mask[i + S*j] = +tipo para face no sentido +d, -tipo para face -d, 0 sem face.
+    std::vector<int> mask(S*S);
+
+    for (int d = 0; d < 3; ++d)
+    {
+        int u = (d + 1) % 3;
+        int v = (d + 2) % 3;
+        glm::ivec3 q(0);
+        q[d] = 1;
+
+        // Percorremos os planos entre os blocos x[d] e x[d]+1.
+        glm::ivec3 x(0);
+        for (x[d] = -1; x[d] < S; ++x[d])
+        {
+            for (x[v] = 0; x[v] < S; ++x[v])
+            for (x[u] = 0; x[u] < S; ++x[u])
+            {
+                glm::ivec3 pa = base + x;
+                glm::ivec3 pb = pa + q;
+                unsigned char a = Voxel_GetBlock(pa.x, pa.y, pa.z);
+                unsigned char b = Voxel_GetBlock(pb.x, pb.y, pb.z);
+
+                // Cada face pertence ao chunk do seu bloco sólido.
+                int value = 0;
+                if ( a != VOXEL_EMPTY && b == VOXEL_EMPTY && x[d] >= 0 )
+                    value = a;
+                else if ( b != VOXEL_EMPTY && a == VOXEL_EMPTY && x[d] + 1 < S )
+                    value = -b;
+                mask[x[u] + S*x[v]] = value;
+            }
+
+            // Unimos faces iguais em retângulos: estendemos primeiro ao longo
+            // de u e depois ao longo de v, enquanto a linha inteira for igual.
+            for (int j = 0; j < S; ++j)
+            for (int i = 0; i < S; )
+            {
+                int value = mask[i + S*j];
+                if ( value == 0 )
+                {
+                    ++i;
+                    continue;
+                }
+
+                int w = 1;
+                while ( i + w < S && mask[i + w + S*j] == value )
+                    ++w;
+
+                int h = 1;
+                bool row_matches = true;
+                while ( j + h < S && row_matches )
+                {
+                    for (int k = 0; k < w; ++k)
+                    {
+                        if ( mask[i + k + S*(j + h)] != value )
+                        {
+                            row_matches = false;
+                            break;
+                        }
+                    }
+                    if ( row_matches )
+                        ++h;
+                }
+
+                glm::vec3 p(0.0f);
+                p[d] = (float)(x[d] + 1);
+                p[u] = (float)i;
+                p[v] = (float)j;
+                glm::vec3 du(0.0f), dv(0.0f);
+                du[u] = (float)w;
+                dv[v] = (float)h;
+
+                Voxel_EmitQuad(chunk.mesh, glm::vec3(base) + p, du, dv, d, (value > 0) ? 1 : -1, (unsigned char)abs(value));
+
+                for (int l = 0; l < h; ++l)
+                for (int k = 0; k < w; ++k)
+                    mask[i + k + S*(j + l)] = 0;
+
+                i += w;
+            }
+        }
+    }
+}
+
+// Refaz (nas threads de trabalho) e envia à GPU as malhas dos chunks sujos.
+void Voxel_Update()
+{
+    g_VoxelWorld.chunks_remeshed = 0;
+    if ( !g_VoxelWorld.enabled )
+        return;
+
+    std::vector<int> dirty;
+    for (size_t i = 0; i < g_VoxelWorld.chunks.size(); ++i)
+        if ( g_VoxelWorld.chunks[i].dirty )
+            dirty.push_back((int)i);
+
+    if ( dirty.empty() )
+        return;
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    JobSystem_ParallelFor((int)dirty.size(), [&dirty](int i) {
+        Voxel_MeshChunk(dirty[i]);
+    });
+
+    for (size_t i = 0; i < dirty.size(); ++i)
+    {
+        VoxelChunk& chunk = g_VoxelWorld.chunks[dirty[i]];
+        if ( chunk.vao != 0 )
+        {
+            glDeleteBuffers(1, &chunk.vbo);
+            glDeleteVertexArrays(1, &chunk.vao);
+            chunk.vao = chunk.vbo = 0;
+        }
+
+        chunk.vertex_count = (GLsizei)(chunk.mesh.size() / WORLD_CHUNK_VERTEX_FLOATS);
+        if ( chunk.vertex_count > 0 )
+            WorldChunk_CreateVertexArray(chunk.mesh, chunk.vao, chunk.vbo);
+
+        chunk.mesh.clear();
+        chunk.mesh.shrink_to_fit();
+        chunk.dirty = false;
+    }
+
+    g_VoxelWorld.quads = 0;
+    for (size_t i = 0; i < g_VoxelWorld.chunks.size(); ++i)
+        g_VoxelWorld.quads += g_VoxelWorld.chunks[i].vertex_count / 6;
+
+    g_VoxelWorld.chunks_remeshed = (int)dirty.size();
+    g_VoxelWorld.remesh_ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+// Retorna se a caixa [box_min, box_max] ocupa algum bloco sólido.
+bool Voxel_BoxIsSolid(const glm::vec3& box_min, const glm::vec3& box_max)
+{
+    if ( !g_VoxelWorld.enabled )
+        return false;
+
+    const float eps = 1e-4f;
+    for (int z = (int)floor(box_min.z); z <= (int)floor(box_max.z - eps); ++z)
+    for (int y = (int)floor(box_min.y); y <= (int)floor(box_max.y - eps); ++y)
+    for (int x = (int)floor(box_min.x); x <= (int)floor(box_max.x - eps); ++x)
+        if ( Voxel_GetBlock(x, y, z) != VOXEL_EMPTY )
+            return true;
+
+    return false;
+}
+
+// Resolve a colisão de uma caixa (box_min/box_max relativos a "position") que
+// se moveu de "previous_position" até "position". O movimento é refeito um
+// eixo por vez (Y, X, Z); se a caixa entrar em um bloco, ela é encostada na
+// face do bloco e a velocidade naquele eixo é anulada. "grounded" indica se
+// há um bloco logo abaixo da caixa ao final.
+void Voxel_ResolveCollision(const glm::vec4& previous_position, glm::vec4& position, glm::vec4& velocity,
+                            const glm::vec3& box_min, const glm::vec3& box_max, bool& grounded)
+{
+    grounded = false;
+    if ( !g_VoxelWorld.enabled )
+        return;
+
+    const float skin = 1e-3f;
+    glm::vec3 p = glm::vec3(previous_position);
+    glm::vec3 target = glm::vec3(position);
+
+    // Se a caixa já começou dentro de um bloco (por exemplo, um bloco foi
+    // colocado sobre o personagem), não há como resolver por eixo.
+    if ( Voxel_BoxIsSolid(p + box_min, p + box_max) )
+        return;
+
+    static const int axes[3] = { 1, 0, 2 };
+    for (int k = 0; k < 3; ++k)
+    {
+        int a = axes[k];
+        float delta = target[a] - p[a];
+        if ( delta == 0.0f )
+            continue;
+
+        p[a] = target[a];
+        if ( !Voxel_BoxIsSolid(p + box_min, p + box_max) )
+            continue;
+
+        // Encostamos a caixa na face do bloco atingido.
+        if ( delta > 0.0f )
+            p[a] = floor(p[a] + box_max[a]) - box_max[a] - skin;
+        else
+            p[a] = floor(p[a] + box_min[a]) + 1.0f - box_min[a] + skin;
+
+        velocity[a] = 0.0f;
+    }
+
+    position = glm::vec4(p, 1.0f);
+
+    glm::vec3 below = glm::vec3(0.0f, 2.0f*skin, 0.0f);
+    grounded = Voxel_BoxIsSolid(p + box_min - below, glm::vec3(p.x + box_max.x, p.y + box_min.y, p.z + box_max.z));
+}
+
+// Percorre a grade ao longo de um raio (algoritmo DDA de Amanatides & Woo) e
+// retorna a distância até o primeiro bloco sólido, ou -1 se nenhum for
+// atingido até max_distance. Se hit_block/hit_normal não forem NULL,
+// retornam o bloco atingido e a normal da face atingida.
+float Voxel_Raycast(const glm::vec3& origin, const glm::vec3& direction, float max_distance,
+                    glm::ivec3* hit_block = NULL, glm::ivec3* hit_normal = NULL)
+{
+    if ( !g_VoxelWorld.enabled )
+        return -1.0f;
+
+    glm::ivec3 cell = glm::ivec3((int)floor(origin.x), (int)floor(origin.y), (int)floor(origin.z));
+    glm::ivec3 step;
+    glm::vec3 t_max, t_delta;
+    glm::ivec3 normal(0);
+
+    for (int a = 0; a < 3; ++a)
+    {
+        if ( direction[a] > 0.0f )
+        {
+            step[a] = 1;
+            t_delta[a] = 1.0f / direction[a];
+            t_max[a] = (cell[a] + 1.0f - origin[a]) * t_delta[a];
+        }
+        else if ( direction[a] < 0.0f )
+        {
+            step[a] = -1;
+            t_delta[a] = -1.0f / direction[a];
+            t_max[a] = (origin[a] - cell[a]) * t_delta[a];
+        }
+        else
+        {
+            step[a] = 0;
+            t_delta[a] = t_max[a] = std::numeric_limits<float>::infinity();
+        }
+    }
+
+    float t = 0.0f;
+    while ( t <= max_distance )
+    {
+        if ( Voxel_GetBlock(cell.x, cell.y, cell.z) != VOXEL_EMPTY )
+        {
+            if ( hit_block )  *hit_block = cell;
+            if ( hit_normal ) *hit_normal = normal;
+            return t;
+        }
+
+        int a = (t_max.x < t_max.y) ? ((t_max.x < t_max.z) ? 0 : 2) : ((t_max.y < t_max.z) ? 1 : 2);
+        t = t_max[a];
+        t_max[a] += t_delta[a];
+        cell[a] += step[a];
+        normal = glm::ivec3(0);
+        normal[a] = -step[a];
+    }
+
+    return -1.0f;
+}
@@ -0,0 +1,489 @@
+// Streaming do mundo em blocos ("chunks"). O plano XZ é dividido em uma grade
+// de chunks de tamanho fixo, e cada instância estática da cena pertence ao
+// chunk onde está a sua origem. Em vez de manter toda a geometria do mundo na
+// memória desde a inicialização, somente os chunks próximos do personagem
+// ficam residentes:
+//
+// 1. A cada quadro, WorldStreaming_Update() pede os chunks dentro de
+//    "load_radius" que ainda não estão carregados.
+// 2. Threads de carregamento (em segundo plano) constroem a malha do chunk:
+//    os vértices e índices de todas as suas instâncias, já transformados
+//    para coordenadas globais e agrupados por material, um desenho por
+//    material (veja WorldStreaming_BuildChunk()).
+// 3. A thread principal envia para a GPU as malhas prontas, respeitando um
+//    limite de bytes por quadro ("upload_budget_bytes"), para que o streaming
+//    nunca cause picos no tempo de quadro.
+// 4. Chunks além de "unload_radius" são descartados (CPU e GPU). Como
+//    unload_radius > load_radius (histerese), um personagem parado na
+//    fronteira entre dois chunks não os fica carregando e descartando.
+//
+// Colisores, pássaros e projéteis não participam do streaming: são dados
+// pequenos e ficam sempre residentes.
+#include <map>
+#include <cmath>
+#include <deque>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <condition_variable>
+
+#include <glad/glad.h>
+
+#include <glm/mat3x3.hpp>
+#include <glm/mat4x4.hpp>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+// Número de floats por vértice das malhas dos chunks: posição global (4),
+// normal global (4), coordenadas de textura (2) e posição no espaço do
+// modelo (4), utilizada pelos shaders que texturizam em coordenadas do modelo.
+#define WORLD_CHUNK_VERTEX_FLOATS 14
+
+// Vértices dos chunks do mundo trazem também a AABB do objeto da instância
+// (mínimo e máximo, 3 floats cada, no espaço do modelo), lida pelos
+// materiais com MATERIAL_OBJECT_BOUNDS, para que instâncias de objetos
+// diferentes com o mesmo material sejam desenhadas juntas.
+#define WORLD_CHUNK_BOUNDS_VERTEX_FLOATS (WORLD_CHUNK_VERTEX_FLOATS + 6)
+
+// Geometria de um objeto (vértices sem repetição e triângulos, 3 índices
+// consecutivos cada), mantida na CPU para que as threads de carregamento
+// construam as malhas dos chunks.
+struct WorldObjectGeometry
+{
+    std::vector<glm::vec4> positions;
+    std::vector<glm::vec4> normals;
+    std::vector<glm::vec2> texcoords;
+    std::vector<GLuint>    indices;
+};
+
+struct WorldInstance
+{
+    std::string object;    // Nome do objeto em g_VirtualScene
+    int         object_id; // Material utilizado nos shaders
+    glm::mat4   model;
+    glm::vec3   bbox_min;  // AABB do objeto, no espaço do modelo
+    glm::vec3   bbox_max;
+};
+
+// Trecho da malha de um chunk desenhado com um único material, com todas as
+// instâncias desse material no chunk, de qualquer objeto.
+struct WorldChunkBatch
+{
+    int         object_id;
+    GLint       first;     // Primeiro índice
+    GLsizei     count;     // Número de índices
+    int         instances; // Instâncias desenhadas pelo grupo
+    glm::vec3   world_min; // AABB dos vértices do grupo, em coordenadas globais (frustum culling)
+    glm::vec3   world_max;
+};
+
+// Malha construída por uma thread de carregamento, aguardando envio à GPU.
+struct WorldChunkMesh
+{
+    long long                    key;
+    std::vector<float>           vertices;
+    std::vector<GLuint>          indices;
+    std::vector<WorldChunkBatch> batches;
+};
+
+enum WorldChunkState
+{
+    WORLD_CHUNK_UNLOADED,
+    WORLD_CHUNK_LOADING,   // Pedido às threads de carregamento
+    WORLD_CHUNK_RESIDENT,  // Malha na GPU, pronta para ser desenhada
+};
+
+struct WorldChunk
+{
+    int                          cx, cz;      // Coordenadas do chunk na grade
+    std::vector<int>             instances;   // Índices em WorldStreaming::instances
+    WorldChunkState              state = WORLD_CHUNK_UNLOADED;
+    GLuint                       vao = 0;
+    GLuint                       vbo = 0;
+    GLuint                       ebo = 0;
+    size_t                       gpu_bytes = 0;
+    std::vector<WorldChunkBatch> batches;
+};
+
+struct WorldStreaming
+{
+    float  chunk_size = 48.0f;
+    float  load_radius = 96.0f;     // Chunks mais próximos que isso são carregados ...
+    float  unload_radius = 128.0f;  // ... e só são descartados além disso (histerese).
+    size_t upload_budget_bytes = 512*1024; // Máximo enviado à GPU por quadro
+
+    std::map<std::string, WorldObjectGeometry> objects;
+    std::vector<WorldInstance>                 instances;
+    std::map<long long, WorldChunk>            chunks;
+
+    // Comunicação com as threads de carregamento. Os pedidos são ordenados
+    // do mais próximo para o mais distante do personagem.
+    std::vector<std::thread>    loaders;
+    std::mutex                  mutex;
+    std::condition_variable     request_available;
+    std::deque<long long>       requests;
+    std::deque<WorldChunkMesh*> finished;
+    bool                        quit = false;
+
+    // Estatísticas, mostradas na tela.
+    int    chunks_resident = 0;
+    int    chunks_loading = 0;
+    int    uploads_this_frame = 0;
+    size_t bytes_uploaded_this_frame = 0;
+    size_t gpu_bytes_resident = 0;
+    int    batches_resident = 0;   // Desenhos dos chunks residentes
+    int    instances_resident = 0; // Instâncias desenhadas por eles
+};
+
+WorldStreaming g_WorldStreaming;
+
+static long long WorldStreaming_Key(int cx, int cz)
+{
+    return ((long long)cx << 32) | (unsigned int)cz;
+}
+
+static int WorldStreaming_ChunkCoord(float x)
+{
+    return (int)floor(x / g_WorldStreaming.chunk_size);
+}
+
+// Distância no plano XZ entre um ponto e o retângulo ocupado por um chunk.
+static float WorldStreaming_Distance(const WorldChunk& chunk, const glm::vec4& position)
+{
+    float size = g_WorldStreaming.chunk_size;
+    float dx = std::max(std::max(chunk.cx*size - position.x, 0.0f), position.x - (chunk.cx + 1)*size);
+    float dz = std::max(std::max(chunk.cz*size - position.z, 0.0f), position.z - (chunk.cz + 1)*size);
+    return sqrt(dx*dx + dz*dz);
+}
+
+// Registra a geometria de um objeto que pode ser instanciado pelos chunks.
+void WorldStreaming_AddObject(const std::string& name, const WorldObjectGeometry& geometry)
+{
+    g_WorldStreaming.objects[name] = geometry;
+}
+
+// Adiciona uma instância estática ao mundo. Deve ser chamada antes de
+// WorldStreaming_Init(). A AABB do objeto, no espaço do modelo, é gravada
+// nos vértices da instância.
+void WorldStreaming_AddInstance(const std::string& object, int object_id, const glm::mat4& model,
+                                const glm::vec3& bbox_min, const glm::vec3& bbox_max)
+{
+    WorldInstance instance;
+    instance.object = object;
+    instance.object_id = object_id;
+    instance.model = model;
+    instance.bbox_min = bbox_min;
+    instance.bbox_max = bbox_max;
+
+    int cx = WorldStreaming_ChunkCoord(model[3][0]);
+    int cz = WorldStreaming_ChunkCoord(model[3][2]);
+    WorldChunk& chunk = g_WorldStreaming.chunks[WorldStreaming_Key(cx, cz)];
+    chunk.cx = cx;
+    chunk.cz = cz;
+    chunk.instances.push_back((int)g_WorldStreaming.instances.size());
+
+    g_WorldStreaming.instances.push_back(instance);
+}
+
+// Constrói a malha de um chunk. Executada pelas threads de carregamento: só
+// lê dados que não mudam após WorldStreaming_Init() (instâncias e objetos).
+static WorldChunkMesh* WorldStreaming_BuildChunk(long long key, const std::vector<int>& chunk_instances)
+{
+    WorldChunkMesh* mesh = new WorldChunkMesh;
+    mesh->key = key;
+
+    // Agrupamos as instâncias por material, para um desenho por material.
+    std::vector<int> sorted = chunk_instances;
+    std::stable_sort(sorted.begin(), sorted.end(), [](int a, int b) {
+        return g_WorldStreaming.instances[a].object_id < g_WorldStreaming.instances[b].object_id;
+    });
+
+    for (size_t i = 0; i < sorted.size(); ++i)
+    {
+        const WorldInstance& instance = g_WorldStreaming.instances[sorted[i]];
+        const WorldObjectGeometry& geometry = g_WorldStreaming.objects.at(instance.object);
+
+        if ( mesh->batches.empty() || mesh->batches.back().object_id != instance.object_id )
+        {
+            WorldChunkBatch batch;
+            batch.object_id = instance.object_id;
+            batch.first = (GLint)mesh->indices.size();
+            batch.count = 0;
+            batch.instances = 0;
+            batch.world_min = glm::vec3( std::numeric_limits<float>::max());
+            batch.world_max = glm::vec3(-std::numeric_limits<float>::max());
+            mesh->batches.push_back(batch);
+        }
+
+        // Os índices do objeto são deslocados para os vértices desta instância.
+        GLuint base_vertex = (GLuint)(mesh->vertices.size() / WORLD_CHUNK_BOUNDS_VERTEX_FLOATS);
+        for (size_t k = 0; k < geometry.indices.size(); ++k)
+            mesh->indices.push_back(base_vertex + geometry.indices[k]);
+
+        glm::mat3 normal_matrix = glm::transpose(glm::inverse(glm::mat3(instance.model)));
+
+        for (size_t v = 0; v < geometry.positions.size(); ++v)
+        {
+            glm::vec4 p = instance.model * geometry.positions[v];
+            glm::vec3 n = normal_matrix * glm::vec3(geometry.normals[v]);
+            const glm::vec2& t = geometry.texcoords[v];
+            const glm::vec4& m = geometry.positions[v];
+            const glm::vec3& b0 = instance.bbox_min;
+            const glm::vec3& b1 = instance.bbox_max;
+
+            float vertex[WORLD_CHUNK_BOUNDS_VERTEX_FLOATS] = {
+                p.x, p.y, p.z, 1.0f,
+                n.x, n.y, n.z, 0.0f,
+                t.x, t.y,
+                m.x, m.y, m.z, 1.0f,
+                b0.x, b0.y, b0.z,
+                b1.x, b1.y, b1.z,
+            };
+            mesh->vertices.insert(mesh->vertices.end(), vertex, vertex + WORLD_CHUNK_BOUNDS_VERTEX_FLOATS);
+            mesh->batches.back().world_min = glm::min(mesh->batches.back().world_min, glm::vec3(p));
+            mesh->batches.back().world_max = glm::max(mesh->batches.back().world_max, glm::vec3(p));
+        }
+
+        mesh->batches.back().count += (GLsizei)geometry.indices.size();
+        mesh->batches.back().instances += 1;
+    }
+
+    return mesh;
+}
+
+static void WorldStreaming_LoaderLoop()
+{
+    std::unique_lock<std::mutex> lock(g_WorldStreaming.mutex);
+    while (true)
+    {
+        g_WorldStreaming.request_available.wait(lock, []{
+            return g_WorldStreaming.quit || !g_WorldStreaming.requests.empty();
+        });
+
+        if ( g_WorldStreaming.quit )
+            return;
+
+        long long key = g_WorldStreaming.requests.front();
+        g_WorldStreaming.requests.pop_front();
+
+        // A lista de instâncias de um chunk não muda após a inicialização.
+        const std::vector<int>& chunk_instances = g_WorldStreaming.chunks.at(key).instances;
+
+        lock.unlock();
+        WorldChunkMesh* mesh = WorldStreaming_BuildChunk(key, chunk_instances);
+        lock.lock();
+
+        g_WorldStreaming.finished.push_back(mesh);
+    }
+}
+
+// Cria as threads de carregamento. Deve ser chamada após todas as instâncias
+// terem sido adicionadas.
+void WorldStreaming_Init(int num_loaders = 2)
+{
+    for (int i = 0; i < num_loaders; ++i)
+        g_WorldStreaming.loaders.push_back(std::thread(WorldStreaming_LoaderLoop));
+
+    printf("Streaming do mundo: %d instancias em %d chunks de %.0fx%.0f.\n",
+           (int)g_WorldStreaming.instances.size(), (int)g_WorldStreaming.chunks.size(),
+           g_WorldStreaming.chunk_size, g_WorldStreaming.chunk_size);
+}
+
+// Cria um VAO com os vértices de uma malha em coordenadas globais, no formato
+// de WORLD_CHUNK_VERTEX_FLOATS floats por vértice, ou
+// WORLD_CHUNK_BOUNDS_VERTEX_FLOATS se "object_bounds" for verdadeiro. Também
+// utilizada pelo terreno em voxels (veja "voxel_world.cpp"), sem a AABB.
+void WorldChunk_CreateVertexArray(const std::vector<float>& vertices, GLuint& vao, GLuint& vbo, bool object_bounds = false)
+{
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+
+    glGenBuffers(1, &vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+
+    GLsizei stride = (object_bounds ? WORLD_CHUNK_BOUNDS_VERTEX_FLOATS : WORLD_CHUNK_VERTEX_FLOATS) * sizeof(float);
+    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, stride, (void*)(0));                // "(location = 0)" em "shader_vertex.glsl"
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, stride, (void*)(4*sizeof(float)));  // "(location = 1)"
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (void*)(8*sizeof(float)));  // "(location = 2)"
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, stride, (void*)(10*sizeof(float))); // "(location = 3)"
+    glEnableVertexAttribArray(3);
+    if ( object_bounds )
+    {
+        glVertexAttribPointer(14, 3, GL_FLOAT, GL_FALSE, stride, (void*)(14*sizeof(float))); // "(location = 14)"
+        glEnableVertexAttribArray(14);
+        glVertexAttribPointer(15, 3, GL_FLOAT, GL_FALSE, stride, (void*)(17*sizeof(float))); // "(location = 15)"
+        glEnableVertexAttribArray(15);
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+}
+
+// Bytes enviados à GPU para uma malha de chunk.
+static size_t WorldStreaming_MeshBytes(const WorldChunkMesh& mesh)
+{
+    return mesh.vertices.size() * sizeof(float) + mesh.indices.size() * sizeof(GLuint);
+}
+
+// Envia a malha de um chunk para a GPU, criando seu VAO e o buffer de
+// índices, que fica associado ao VAO.
+static void WorldStreaming_Upload(WorldChunk& chunk, const WorldChunkMesh& mesh)
+{
+    WorldChunk_CreateVertexArray(mesh.vertices, chunk.vao, chunk.vbo, true);
+
+    glBindVertexArray(chunk.vao);
+    glGenBuffers(1, &chunk.ebo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, chunk.ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.indices.size() * sizeof(GLuint), mesh.indices.data(), GL_STATIC_DRAW);
+    glBindVertexArray(0);
+
+    chunk.gpu_bytes = WorldStreaming_MeshBytes(mesh);
+    chunk.batches = mesh.batches;
+    chunk.state = WORLD_CHUNK_RESIDENT;
+}
+
+static void WorldStreaming_Evict(WorldChunk& chunk)
+{
+    if ( chunk.state == WORLD_CHUNK_RESIDENT )
+    {
+        glDeleteBuffers(1, &chunk.vbo);
+        glDeleteBuffers(1, &chunk.ebo);
+        glDeleteVertexArrays(1, &chunk.vao);
+        chunk.vbo = 0;
+        chunk.ebo = 0;
+        chunk.vao = 0;
+        chunk.gpu_bytes = 0;
+        chunk.batches.clear();
+    }
+
+    // Um chunk ainda em carregamento é simplesmente marcado como descartado:
+    // sua malha será ignorada quando a thread de carregamento terminar.
+    chunk.state = WORLD_CHUNK_UNLOADED;
+}
+
+// Atualiza o conjunto de chunks residentes em torno de "position". Deve ser
+// chamada uma vez por quadro, na thread principal (que possui o contexto
+// OpenGL). Se "ignore_budget" for true, envia todas as malhas prontas.
+void WorldStreaming_Update(const glm::vec4& position, bool ignore_budget = false)
+{
+    g_WorldStreaming.uploads_this_frame = 0;
+    g_WorldStreaming.bytes_uploaded_this_frame = 0;
+
+    // Pedidos novos e descartes, com base na distância ao personagem.
+    std::vector<std::pair<float, long long>> new_requests;
+    for (std::map<long long, WorldChunk>::iterator it = g_WorldStreaming.chunks.begin(); it != g_WorldStreaming.chunks.end(); ++it)
+    {
+        WorldChunk& chunk = it->second;
+        float distance = WorldStreaming_Distance(chunk, position);
+
+        if ( chunk.state == WORLD_CHUNK_UNLOADED && distance < g_WorldStreaming.load_radius )
+        {
+            chunk.state = WORLD_CHUNK_LOADING;
+            new_requests.push_back(std::make_pair(distance, it->first));
+        }
+        else if ( chunk.state != WORLD_CHUNK_UNLOADED && distance > g_WorldStreaming.unload_radius )
+        {
+            WorldStreaming_Evict(chunk);
+        }
+    }
+    std::sort(new_requests.begin(), new_requests.end());
+
+    std::deque<WorldChunkMesh*> finished;
+    {
+        std::lock_guard<std::mutex> lock(g_WorldStreaming.mutex);
+        for (size_t i = 0; i < new_requests.size(); ++i)
+            g_WorldStreaming.requests.push_back(new_requests[i].second);
+
+        // Pegamos as malhas prontas que cabem no orçamento deste quadro. Pelo
+        // menos uma é sempre enviada, para que chunks grandes não fiquem
+        // esperando para sempre.
+        size_t bytes = 0;
+        while ( !g_WorldStreaming.finished.empty() )
+        {
+            WorldChunkMesh* mesh = g_WorldStreaming.finished.front();
+            size_t mesh_bytes = WorldStreaming_MeshBytes(*mesh);
+            if ( !ignore_budget && !finished.empty() && bytes + mesh_bytes > g_WorldStreaming.upload_budget_bytes )
+                break;
+
+            bytes += mesh_bytes;
+            finished.push_back(mesh);
+            g_WorldStreaming.finished.pop_front();
+        }
+    }
+    if ( !new_requests.empty() )
+        g_WorldStreaming.request_available.notify_all();
+
+    for (size_t i = 0; i < finished.size(); ++i)
+    {
+        WorldChunkMesh* mesh = finished[i];
+        WorldChunk& chunk = g_WorldStreaming.chunks.at(mesh->key);
+
+        // Se o chunk foi descartado (ou já enviado) enquanto carregava, ignoramos a malha.
+        if ( chunk.state == WORLD_CHUNK_LOADING )
+        {
+            WorldStreaming_Upload(chunk, *mesh);
+            g_WorldStreaming.uploads_this_frame += 1;
+            g_WorldStreaming.bytes_uploaded_this_frame += chunk.gpu_bytes;
+        }
+
+        delete mesh;
+    }
+
+    g_WorldStreaming.chunks_resident = 0;
+    g_WorldStreaming.chunks_loading = 0;
+    g_WorldStreaming.gpu_bytes_resident = 0;
+    g_WorldStreaming.batches_resident = 0;
+    g_WorldStreaming.instances_resident = 0;
+    for (std::map<long long, WorldChunk>::iterator it = g_WorldStreaming.chunks.begin(); it != g_WorldStreaming.chunks.end(); ++it)
+    {
+        if ( it->second.state == WORLD_CHUNK_RESIDENT )
+        {
+            g_WorldStreaming.chunks_resident += 1;
+            g_WorldStreaming.gpu_bytes_resident += it->second.gpu_bytes;
+            g_WorldStreaming.batches_resident += (int)it->second.batches.size();
+            g_WorldStreaming.instances_resident += (int)it->second.instances.size();
+        }
+        else if ( it->second.state == WORLD_CHUNK_LOADING )
+            g_WorldStreaming.chunks_loading += 1;
+    }
+}
+
+// Carrega, bloqueando, todos os chunks próximos de "position". Utilizada na
+// inicialização, quando ainda não há quadros a preservar.
+void WorldStreaming_Preload(const glm::vec4& position)
+{
+    WorldStreaming_Update(position, true);
+    while ( g_WorldStreaming.chunks_loading > 0 )
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        WorldStreaming_Update(position, true);
+    }
+}
+
+// Finaliza as threads de carregamento e descarta as malhas pendentes.
+void WorldStreaming_Shutdown()
+{
+    {
+        std::lock_guard<std::mutex> lock(g_WorldStreaming.mutex);
+        g_WorldStreaming.quit = true;
+        g_WorldStreaming.requests.clear();
+    }
+    g_WorldStreaming.request_available.notify_all();
+
+    for (size_t i = 0; i < g_WorldStreaming.loaders.size(); ++i)
+        g_WorldStreaming.loaders[i].join();
+    g_WorldStreaming.loaders.clear();
+
+    for (size_t i = 0; i < g_WorldStreaming.finished.size(); ++i)
+        delete g_WorldStreaming.finished[i];
+    g_WorldStreaming.finished.clear();
+}
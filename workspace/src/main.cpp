@@ -24,6 +24,7 @@
 #include <map>
 #include <stack>
 #include <string>
+#include <tuple>
 #include <vector>
 #include <limits>
 #include <fstream>
@@ -50,6 +51,25 @@
 #include "matrices.h"
 #include "jogo.cpp"
 #include "collisions.cpp"
+#include "headless.cpp"
+#include "stream_buffer.cpp"
+#include "gpu_timers.cpp"
+#include "dynamic_resolution.cpp"
+#include "frame_constants.cpp"
+#include "job_system.cpp"
+#include "render_queue.cpp"
+#include "shader_variants.cpp"
+#include "impostors.cpp"
+#include "gpu_culling.cpp"
+#include "particles.cpp"
+#include "lighting_lod.cpp"
+#include "occlusion.cpp"
+#include "software_occlusion.cpp"
+#include "scene_file.cpp"
+#include "clustered_lighting.cpp"
+#include "shadow_maps.cpp"
+#include "world_streaming.cpp"
+#include "voxel_world.cpp"
 
 // Estrutura que representa um modelo geométrico carregado a partir de um
 // arquivo ".obj". Veja https://en.wikipedia.org/wiki/Wavefront_.obj_file .
@@ -119,13 +139,37 @@ void PopMatrix(glm::mat4& M);
 void BuildTrianglesAndAddToVirtualScene(ObjModel*); // Constrói representação de um ObjModel como malha de triângulos para renderização
 void ComputeNormals(ObjModel* model); // Computa normais de um ObjModel, caso não existam.
 void LoadShadersFromFiles(); // Carrega os shaders de vértice e fragmento, criando um programa de GPU
+const ShaderVariant& MaterialVariant(int object_id, LightingLevel lighting = LIGHTING_PER_PIXEL); // Variante de shader do material "object_id"
+void UseShaderVariant(const ShaderVariant& variant); // Ativa uma variante para desenho imediato
+int MaterialRenderProgram(int object_id, LightingLevel lighting = LIGHTING_PER_PIXEL); // Índice, na fila de renderização, da variante do material "object_id"
+LightingLevel MaterialLightingLevel(int object_id, uint64_t lod_key, const glm::vec4& center, float radius); // Nível de iluminação de um objeto, pelo seu tamanho na tela
+void UseMaterialProgram(int object_id); // Ativa a variante do material "object_id" para desenho imediato
+void SetModelMatrixUniforms(const glm::mat4& model); // Envia "model" e as matrizes derivadas para o programa ativo
 void LoadTextureImage(const char* filename); // Função que carrega imagens de textura
+void LoadTextureArray(const std::vector<const char*>& filenames); // Carrega várias imagens como camadas de uma única textura
 void DrawVirtualObject(const char* object_name); // Desenha um objeto armazenado em g_VirtualScene
+void AddMultiDrawObject(const char* name, const std::vector<std::string>& parts); // Agrupa objetos de g_VirtualScene para desenho com uma chamada
+void DrawMultiDrawObject(const char* name); // Desenha um objeto criado por AddMultiDrawObject()
+struct InstanceData;
+void DrawVirtualObjectInstanced(const char* object_name, const std::vector<InstanceData>& instances); // Desenha várias cópias de um objeto com uma chamada
+GLuint UploadVirtualObjectInstances(const char* object_name, const std::vector<InstanceData>& instances, int slot = 0); // Envia os dados de instâncias de um objeto para a GPU
+GLuint CloneVertexArray(GLuint vertex_array_object_id); // Copia os atributos por vértice de um VAO para um novo VAO
+void EnableInstanceAttributes(GLuint vertex_array_object_id, GLuint divisor); // Habilita os atributos de InstanceData em um VAO
+void SetInstanceAttributes(GLuint vertex_array_object_id, GLuint buffer_id, GLintptr offset); // Aponta os atributos de InstanceData para um buffer
+void QueueVirtualObject(const char* object_name, int object_id, const glm::mat4& model, LightingLevel lighting = LIGHTING_PER_PIXEL); // Enfileira um objeto de g_VirtualScene em g_RenderQueue
+void QueueVirtualObjectInstanced(const char* object_name, int object_id, const std::vector<InstanceData>& instances, LightingLevel lighting = LIGHTING_PER_PIXEL, int slot = 0); // Enfileira várias cópias de um objeto
+void QueueMultiDrawObject(const char* name, int object_id, const glm::mat4& model); // Enfileira um objeto criado por AddMultiDrawObject()
+void RunInstancingBenchmark(); // Compara desenhos por objeto e instanciados
+void RunDerivedMatricesBenchmark(); // Compara matrizes de normais por vértice e computadas na CPU
 GLuint LoadShader_Vertex(const char* filename);   // Carrega um vertex shader
 GLuint LoadShader_Fragment(const char* filename); // Carrega um fragment shader
-void LoadShader(const char* filename, GLuint shader_id); // Função utilizada pelas duas acima
+GLuint LoadShader_Vertex(const char* filename, const std::string& defines);   // Idem, com "#define"s injetados
+GLuint LoadShader_Fragment(const char* filename, const std::string& defines);
+void LoadShader(const char* filename, GLuint shader_id, const std::string& defines = ""); // Função utilizada pelas quatro acima
 GLuint CreateGpuProgram(GLuint vertex_shader_id, GLuint fragment_shader_id); // Cria um programa de GPU
 void PrintObjModelInfo(ObjModel*); // Função para debugging
+std::vector<glm::vec4> GetTriangleVertices(ObjModel* model, const char* shape_name = NULL); // Lista de vértices (3 por triângulo) de um ObjModel, para uso na CPU
+WorldObjectGeometry GetWorldObjectGeometry(ObjModel* model, const char* shape_name); // Atributos dos triângulos de um objeto, para o streaming do mundo
 
 // Declaração de funções auxiliares para renderizar texto dentro da janela
 // OpenGL. Estas funções estão definidas no arquivo "textrendering.cpp".
@@ -145,6 +189,22 @@ void TextRendering_ShowModelViewProjection(GLFWwindow* window, glm::mat4 project
 void TextRendering_ShowEulerAngles(GLFWwindow* window);
 void TextRendering_ShowProjection(GLFWwindow* window);
 void TextRendering_ShowFramesPerSecond(GLFWwindow* window);
+void TextRendering_ShowOcclusionStats(GLFWwindow* window);
+void TextRendering_ShowSoftwareOcclusionStats(GLFWwindow* window);
+void TextRendering_ShowSceneStats(GLFWwindow* window, int num_instances, int num_projectiles);
+void TextRendering_ShowStreamingStats(GLFWwindow* window);
+void TextRendering_ShowVoxelStats(GLFWwindow* window);
+void TextRendering_ShowRenderQueueStats(GLFWwindow* window);
+void TextRendering_ShowLightingLodStats(GLFWwindow* window);
+void TextRendering_ShowClusteredLightingStats(GLFWwindow* window);
+void TextRendering_ShowShadowStats(GLFWwindow* window);
+void TextRendering_ShowPassOrderStats(GLFWwindow* window);
+void TextRendering_ShowGpuTimerStats(GLFWwindow* window);
+void TextRendering_ShowDynamicResolutionStats(GLFWwindow* window);
+void TextRendering_ShowStreamBufferStats(GLFWwindow* window);
+void TextRendering_ShowImpostorStats(GLFWwindow* window);
+void TextRendering_ShowGpuCullingStats(GLFWwindow* window);
+void TextRendering_ShowParticleStats(GLFWwindow* window);
 
 // Funções callback para comunicação com o sistema operacional e interação do
 // usuário. Veja mais comentários nas definições das mesmas, abaixo.
@@ -168,6 +228,40 @@ struct SceneObject
     glm::vec3    bbox_max;
 };
 
+// Dados de uma instância em DrawVirtualObjectInstanced(). O layout deve
+// corresponder às localizações 4 a 9 e 11 a 13 em "shader_vertex.glsl".
+// "model" e "normal_matrix" devem ser definidas com SetInstanceModel().
+struct InstanceData
+{
+    glm::mat4 model;
+    glm::vec4 params; // Fator multiplicado na refletância difusa (rgb)
+    glm::vec4 path;   // Caminho de Bézier: primeiro segmento, nº de segmentos, deslocamento no tempo
+    glm::mat3 normal_matrix; // inverse(transpose(model)), 3x3
+};
+
+// O culling na GPU grava instâncias neste layout (veja "gpu_culling.cpp").
+static_assert(sizeof(InstanceData) == GPU_CULLING_INSTANCE_BYTES, "InstanceData must match the GPU culling output");
+
+// Define a matriz de modelagem de uma instância e a matriz de normais
+// correspondente, computada uma vez aqui em vez de uma vez por vértice.
+void SetInstanceModel(InstanceData& instance, const glm::mat4& model)
+{
+    instance.model = model;
+    instance.normal_matrix = glm::transpose(glm::inverse(glm::mat3(model)));
+}
+
+// Buffer de dados por instância associado a um VAO, utilizado somente para
+// conjuntos de instâncias que não cabem no buffer de streaming. Objetos do
+// mesmo arquivo ".obj" compartilham o VAO e, portanto, o buffer. Para
+// desenhar o mesmo objeto com mais de um conjunto de instâncias no mesmo
+// quadro, cada conjunto ("slot") além do primeiro usa uma cópia do VAO (veja
+// CloneVertexArray()) com seus próprios atributos.
+struct InstanceBuffer
+{
+    GLuint buffer_id;
+    size_t capacity; // Em número de instâncias
+};
+
 
 
 typedef enum { LOOK_AT_CAMERA_OFF,
@@ -188,6 +282,27 @@ typedef enum {
 
 // Abaixo definimos variáveis globais utilizadas em várias funções do código.
 
+// Objeto composto por várias partes (objetos de g_VirtualScene que
+// compartilham o mesmo VAO), desenhadas com uma única chamada
+// glMultiDrawElements(). Veja AddMultiDrawObject().
+struct MultiDrawObject
+{
+    GLuint                    vertex_array_object_id;
+    std::vector<GLsizei>      counts;  // Número de índices de cada parte
+    std::vector<const void*>  offsets; // Deslocamento (em bytes) do primeiro índice de cada parte
+    glm::vec3                 bbox_min; // União das AABBs das partes
+    glm::vec3                 bbox_max;
+};
+
+std::map<std::string, MultiDrawObject> g_MultiDrawObjects;
+
+// Buffers de instâncias, indexados pelo VAO ao qual estão ligados.
+std::map<GLuint, InstanceBuffer> g_InstanceBuffers;
+
+// Cópias de VAOs para os slots de instâncias além do primeiro, indexadas
+// pelo VAO original e pelo slot. Veja UploadVirtualObjectInstances().
+std::map<std::pair<GLuint, int>, GLuint> g_InstanceSlotVertexArrays;
+
 // A cena virtual é uma lista de objetos nomeados, guardados em um dicionário
 // (map).  Veja dentro da função BuildTrianglesAndAddToVirtualScene() como que são incluídos
 // objetos dentro da variável g_VirtualScene, e veja na função main() como
@@ -267,99 +382,220 @@ float COLLISION_SLOP = 0.0001f;
 float RESTING_THRESHOLD = 0.001f;
 
 
-// Variáveis que definem um programa de GPU (shaders). Veja função LoadShadersFromFiles().
+// Variáveis que definem o programa de GPU ativo para desenho imediato
+// (DrawVirtualObject() e similares). Veja função UseMaterialProgram().
 GLuint g_GpuProgramID = 0;
 GLint g_model_uniform;
-GLint g_view_uniform;
-GLint g_projection_uniform;
-GLint g_object_id_uniform;
+GLint g_normal_matrix_uniform;
+GLint g_model_view_projection_uniform;
 GLint g_bbox_min_uniform;
 GLint g_bbox_max_uniform;
+GLint g_instanced_uniform;
 
-GLuint g_GpuProgramID_gouraud = 0;
-GLint g_model_uniform_gouraud;
-GLint g_view_uniform_gouraud;
-GLint g_projection_uniform_gouraud;
-GLint g_object_id_uniform_gouraud;
-GLint g_bbox_min_uniform_gouraud;
-GLint g_bbox_max_uniform_gouraud;
 
-// Variável global para o programa do Skybox
+// Variável global para o programa do Skybox. As matrizes "view" e
+// "projection" vêm do bloco FrameConstants (veja "frame_constants.cpp").
 GLuint g_SkyboxProgramID = 0;
 
-// Uniforms do Skybox
-GLint g_skybox_view_uniform = -1;
-GLint g_skybox_projection_uniform = -1;
+// Variante de shader (índice em g_ShaderVariants) de cada material, para
+// cada nível de iluminação, indexada pelo object_id. A chave -1 é o material
+// padrão. Materiais sem variante de iluminação por vértice usam sempre a
+// por fragmento. Veja LoadShadersFromFiles() e "lighting_lod.cpp".
+std::map<int, int> g_MaterialVariants[LIGHTING_LEVEL_COUNT];
 
 
 // Número de texturas carregadas pela função LoadTextureImage()
 GLuint g_NumLoadedTextures = 0;
 
-int main(int argc, char* argv[])
+// Cena carregada de arquivo (veja "scene_file.cpp"). O arquivo pode ser
+// escolhido pela linha de comando com "--scene <arquivo>".
+SceneDescription g_Scene;
+const char* g_SceneFilename = "../../data/default.scene";
+
+// Projétil simulado com gravidade e colisão contra os colisores da cena.
+struct Projectile
 {
-    // Inicializamos a biblioteca GLFW, utilizada para criar uma janela do
-    // sistema operacional, onde poderemos renderizar com OpenGL.
-    int success = glfwInit();
-    if (!success)
-    {
-        fprintf(stderr, "ERROR: glfwInit() failed.\n");
-        std::exit(EXIT_FAILURE);
-    }
+    glm::vec4 position;
+    glm::vec4 velocity;
+    float     radius;
+    glm::vec4 initial_position; // Projéteis que caem no vazio voltam ao início
+    glm::vec4 initial_velocity;
+};
 
-    // Definimos o callback para impressão de erros da GLFW no terminal
-    glfwSetErrorCallback(ErrorCallback);
+int SceneMaterialObjectId(const std::string& material); // Converte o nome do material para object_id
+float GroundHeightBelow(const glm::vec3& point, float max_distance); // Altura do chão logo abaixo de um ponto
 
-    // Pedimos para utilizar OpenGL versão 3.3 (ou superior)
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+// Edição do terreno em voxels pedida pelo teclado (teclas B e N), executada
+// no próximo quadro, quando a direção da câmera é conhecida.
+enum VoxelEditRequest { VOXEL_EDIT_NONE, VOXEL_EDIT_REMOVE, VOXEL_EDIT_PLACE };
+VoxelEditRequest g_VoxelEditRequest = VOXEL_EDIT_NONE;
 
-    #ifdef __APPLE__
-    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-    #endif
+int main(int argc, char* argv[])
+{
+    // Lemos os argumentos da linha de comando: "--scene <arquivo>" escolhe a
+    // cena a ser carregada, "--benchmark-instancing" executa a comparação de
+    // desenhos instanciados e encerra, "--benchmark-matrices" executa a
+    // comparação de matrizes derivadas e encerra, "--lighting-lod <fração>"
+    // define o tamanho na tela abaixo do qual objetos usam iluminação por
+    // vértice (0 desliga). "--headless" renderiza sem janela (veja
+    // "headless.cpp"), com "--frames <n>", "--duration <segundos>",
+    // "--size <largura>x<altura>" e "--dump-frames <diretório>".
+    // "--gpu-timers-csv <arquivo>" grava o tempo de GPU de cada passo (veja
+    // "gpu_timers.cpp"). "--frame-budget <ms>" liga a resolução dinâmica
+    // com o orçamento de tempo de GPU dado, e "--min-resolution-scale <f>"
+    // define a menor escala (veja "dynamic_resolution.cpp").
+    // "--no-buffer-storage" não utiliza glBufferStorage() no buffer de
+    // streaming (veja "stream_buffer.cpp"). "--impostor-distance <d>" define
+    // a distância a partir da qual pássaros viram impostores (0 desliga) e
+    // "--impostor-blend <d>" a largura da transição (veja "impostors.cpp").
+    // "--no-gpu-culling" faz o culling e o LOD dos pássaros na CPU (veja
+    // "gpu_culling.cpp").
+    // "--particles <n>" define o número de partículas e "--no-particles"
+    // desliga o sistema de partículas (veja "particles.cpp").
+    // Qualquer outro argumento que não comece com "--" é um modelo ".obj"
+    // extra.
+    const char* extra_model_filename = NULL;
+    bool benchmark_instancing = false;
+    bool benchmark_matrices = false;
+    bool frames_given = false; // "--frames" foi dado explicitamente
+    for (int i = 1; i < argc; ++i)
+    {
+        if ( strcmp(argv[i], "--scene") == 0 && i + 1 < argc )
+            g_SceneFilename = argv[++i];
+        else if ( strcmp(argv[i], "--benchmark-instancing") == 0 )
+            benchmark_instancing = true;
+        else if ( strcmp(argv[i], "--benchmark-matrices") == 0 )
+            benchmark_matrices = true;
+        else if ( strcmp(argv[i], "--lighting-lod") == 0 && i + 1 < argc )
+        {
+            g_LightingLod.min_screen_size = (float)atof(argv[++i]);
+            g_LightingLod.enabled = g_LightingLod.min_screen_size > 0.0f;
+        }
+        else if ( strcmp(argv[i], "--headless") == 0 )
+            g_Headless.enabled = true;
+        else if ( strcmp(argv[i], "--frames") == 0 && i + 1 < argc )
+        {
+            g_Headless.max_frames = atoi(argv[++i]);
+            frames_given = true;
+        }
+        else if ( strcmp(argv[i], "--duration") == 0 && i + 1 < argc )
+            g_Headless.max_seconds = atof(argv[++i]);
+        else if ( strcmp(argv[i], "--size") == 0 && i + 1 < argc )
+            sscanf(argv[++i], "%dx%d", &g_Headless.width, &g_Headless.height);
+        else if ( strcmp(argv[i], "--dump-frames") == 0 && i + 1 < argc )
+            g_Headless.dump_directory = argv[++i];
+        else if ( strcmp(argv[i], "--gpu-timers-csv") == 0 && i + 1 < argc )
+            g_GpuTimers.csv_filename = argv[++i];
+        else if ( strcmp(argv[i], "--frame-budget") == 0 && i + 1 < argc )
+        {
+            g_DynamicResolution.budget_ms = atof(argv[++i]);
+            g_DynamicResolution.enabled = g_DynamicResolution.budget_ms > 0.0;
+        }
+        else if ( strcmp(argv[i], "--min-resolution-scale") == 0 && i + 1 < argc )
+            g_DynamicResolution.min_scale = std::min(1.0f, std::max(0.1f, (float)atof(argv[++i])));
+        else if ( strcmp(argv[i], "--no-buffer-storage") == 0 )
+            g_StreamBuffer.allow_persistent = false;
+        else if ( strcmp(argv[i], "--impostor-distance") == 0 && i + 1 < argc )
+        {
+            g_Impostors.distance = (float)atof(argv[++i]);
+            g_Impostors.enabled = g_Impostors.distance > 0.0f;
+        }
+        else if ( strcmp(argv[i], "--impostor-blend") == 0 && i + 1 < argc )
+            g_Impostors.blend = std::max(0.0f, (float)atof(argv[++i]));
+        else if ( strcmp(argv[i], "--no-gpu-culling") == 0 )
+            g_GpuCulling.enabled = false;
+        else if ( strcmp(argv[i], "--particles") == 0 && i + 1 < argc )
+            g_Particles.capacity = std::max(1, atoi(argv[++i]));
+        else if ( strcmp(argv[i], "--no-particles") == 0 )
+            g_Particles.enabled = false;
+        else if ( strncmp(argv[i], "--", 2) == 0 )
+        {
+            fprintf(stderr, "ERROR: unknown option or missing value: \"%s\".\n", argv[i]);
+            fprintf(stderr, "Usage: %s [options] [model.obj] (see the options at the beginning of main() in main.cpp)\n", argv[0]);
+            std::exit(EXIT_FAILURE);
+        }
+        else
+            extra_model_filename = argv[i];
+    }
 
-    // Pedimos para utilizar o perfil "core", isto é, utilizaremos somente as
-    // funções modernas de OpenGL.
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    // Com "--duration" e sem "--frames", somente o limite de tempo vale.
+    if ( g_Headless.max_seconds > 0.0 && !frames_given )
+        g_Headless.max_frames = 0;
 
-    // Criamos uma janela do sistema operacional, com 800 colunas e 600 linhas
-    // de pixels, e com título "INF01047 ...".
-    GLFWwindow* window;
-    window = glfwCreateWindow(800, 600, "INF01047 - Seu Cartao - Seu Nome", NULL, NULL);
-    if (!window)
+    GLFWwindow* window = NULL;
+    if ( g_Headless.enabled )
     {
-        glfwTerminate();
-        fprintf(stderr, "ERROR: glfwCreateWindow() failed.\n");
-        std::exit(EXIT_FAILURE);
+        // Sem janela: contexto OpenGL e framebuffer criados por
+        // "headless.cpp". Não há teclado, mouse nem texto na tela.
+        if ( !Headless_Init() )
+            std::exit(EXIT_FAILURE);
+        FramebufferSizeCallback(window, g_Headless.width, g_Headless.height);
+        g_ShowInfoText = false;
     }
+    else
+    {
+        // Inicializamos a biblioteca GLFW, utilizada para criar uma janela do
+        // sistema operacional, onde poderemos renderizar com OpenGL.
+        int success = glfwInit();
+        if (!success)
+        {
+            fprintf(stderr, "ERROR: glfwInit() failed.\n");
+            std::exit(EXIT_FAILURE);
+        }
 
-    // Definimos a função de callback que será chamada sempre que o usuário
-    // pressionar alguma tecla do teclado ...
-    glfwSetKeyCallback(window, KeyCallback);
-    // ... ou clicar os botões do mouse ...
-    glfwSetMouseButtonCallback(window, MouseButtonCallback);
-    // ... ou movimentar o cursor do mouse em cima da janela ...
-    glfwSetCursorPosCallback(window, CursorPosCallback);
-    // ... ou rolar a "rodinha" do mouse.
-    glfwSetScrollCallback(window, ScrollCallback);
-
-    // Indicamos que as chamadas OpenGL deverão renderizar nesta janela
-    glfwMakeContextCurrent(window);
+        // Definimos o callback para impressão de erros da GLFW no terminal
+        glfwSetErrorCallback(ErrorCallback);
 
-    // Carregamento de todas funções definidas por OpenGL 3.3, utilizando a
-    // biblioteca GLAD.
-    gladLoadGLLoader((GLADloadproc) glfwGetProcAddress);
+        // Pedimos para utilizar OpenGL versão 3.3 (ou superior)
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
 
-    // Definimos a função de callback que será chamada sempre que a janela for
-    // redimensionada, por consequência alterando o tamanho do "framebuffer"
-    // (região de memória onde são armazenados os pixels da imagem).
-    glfwSetFramebufferSizeCallback(window, FramebufferSizeCallback);
-    FramebufferSizeCallback(window, 800, 600); // Forçamos a chamada do callback acima, para definir g_ScreenRatio.
+        #ifdef __APPLE__
+        glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+        #endif
 
+        // Pedimos para utilizar o perfil "core", isto é, utilizaremos somente as
+        // funções modernas de OpenGL.
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
-    // Desabilitamos o cursor do mouse para que ele não seja exibido na janela
-    // Também fazemos isso para que o cursor não "escape" da janela
-    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+        // Criamos uma janela do sistema operacional, com 800 colunas e 600 linhas
+        // de pixels, e com título "INF01047 ...".
+        window = glfwCreateWindow(800, 600, "INF01047 - Seu Cartao - Seu Nome", NULL, NULL);
+        if (!window)
+        {
+            glfwTerminate();
+            fprintf(stderr, "ERROR: glfwCreateWindow() failed.\n");
+            std::exit(EXIT_FAILURE);
+        }
 
+        // Definimos a função de callback que será chamada sempre que o usuário
+        // pressionar alguma tecla do teclado ...
+        glfwSetKeyCallback(window, KeyCallback);
+        // ... ou clicar os botões do mouse ...
+        glfwSetMouseButtonCallback(window, MouseButtonCallback);
+        // ... ou movimentar o cursor do mouse em cima da janela ...
+        glfwSetCursorPosCallback(window, CursorPosCallback);
+        // ... ou rolar a "rodinha" do mouse.
+        glfwSetScrollCallback(window, ScrollCallback);
+
+        // Indicamos que as chamadas OpenGL deverão renderizar nesta janela
+        glfwMakeContextCurrent(window);
+
+        // Carregamento de todas funções definidas por OpenGL 3.3, utilizando a
+        // biblioteca GLAD.
+        gladLoadGLLoader((GLADloadproc) glfwGetProcAddress);
+
+        // Definimos a função de callback que será chamada sempre que a janela for
+        // redimensionada, por consequência alterando o tamanho do "framebuffer"
+        // (região de memória onde são armazenados os pixels da imagem).
+        glfwSetFramebufferSizeCallback(window, FramebufferSizeCallback);
+        FramebufferSizeCallback(window, 800, 600); // Forçamos a chamada do callback acima, para definir g_ScreenRatio.
+
+
+        // Desabilitamos o cursor do mouse para que ele não seja exibido na janela
+        // Também fazemos isso para que o cursor não "escape" da janela
+        glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+    }
 
     // Imprimimos no terminal informações sobre a GPU do sistema
     const GLubyte *vendor      = glGetString(GL_VENDOR);
@@ -369,20 +605,49 @@ int main(int argc, char* argv[])
 
     printf("GPU: %s, %s, OpenGL %s, GLSL %s\n", vendor, renderer, glversion, glslversion);
 
+    // Criamos as threads de trabalho utilizadas, por exemplo, pelo culling
+    // por oclusão em software. Veja o arquivo "job_system.cpp".
+    JobSystem_Init();
+
+    // Criamos o buffer de streaming dos dados que mudam a cada quadro
+    // (constantes por quadro, instâncias e texto). Veja os arquivos
+    // "stream_buffer.cpp" e "frame_constants.cpp".
+    StreamBuffer_Init();
+
+    // Criamos os buffers das luzes agrupadas por cluster do frustum. Veja
+    // o arquivo "clustered_lighting.cpp".
+    ClusteredLighting_Init();
+
+    // Criamos os mapas de sombra em cascata da luz direcional. Veja o
+    // arquivo "shadow_maps.cpp".
+    ShadowMaps_Init();
+
+    // Criamos as consultas que medem o tempo de GPU de cada passo. Veja o
+    // arquivo "gpu_timers.cpp".
+    GpuTimers_Init();
+
     // Carregamos os shaders de vértices e de fragmentos que serão utilizados
     // para renderização. Veja slides 180-200 do documento Aula_03_Rendering_Pipeline_Grafico.pdf.
     //
     LoadShadersFromFiles();
 
+    // Criamos o programa e a geometria utilizados pelas consultas de oclusão.
+    // Veja o arquivo "occlusion.cpp".
+    OcclusionCulling_Init();
+
     // Carregamos duas imagens para serem utilizadas como textura
-    LoadTextureImage("../../data/Mario/textures/texture_character_hat.png"); // TextureImage0
-    LoadTextureImage("../../data/Mario/textures/texture_character_pants.png"); // TextureImage1
-    LoadTextureImage("../../data/Mario/textures/texture_character_face.png"); // TextureImage2
-    LoadTextureImage("../../data/Mario/textures/texture_character_eye.png"); // TextureImage3
-    LoadTextureImage("../../data/Mario/textures/texture_character_gloves.png"); // TextureImage4
-    LoadTextureImage("../../data/Mario/textures/texture_character_clothes.png"); // TextureImage5
-    LoadTextureImage("../../data/Mario/textures/texture_character_shoes.png"); // TextureImage6
-    LoadTextureImage("../../data/Mario/textures/texture_character_hair.png"); // TextureImage7
+    // Texturas do Mario: a camada i corresponde ao objeto "submesh_i" de
+    // Mario.obj (veja o atributo "part" em "shader_vertex.glsl").
+    std::vector<const char*> mario_textures;
+    mario_textures.push_back("../../data/Mario/textures/texture_character_hat.png");     // submesh_0
+    mario_textures.push_back("../../data/Mario/textures/texture_character_hair.png");    // submesh_1
+    mario_textures.push_back("../../data/Mario/textures/texture_character_gloves.png");  // submesh_2
+    mario_textures.push_back("../../data/Mario/textures/texture_character_eye.png");     // submesh_3
+    mario_textures.push_back("../../data/Mario/textures/texture_character_pants.png");   // submesh_4
+    mario_textures.push_back("../../data/Mario/textures/texture_character_clothes.png"); // submesh_5
+    mario_textures.push_back("../../data/Mario/textures/texture_character_shoes.png");   // submesh_6
+    mario_textures.push_back("../../data/Mario/textures/texture_character_face.png");    // submesh_7
+    LoadTextureArray(mario_textures); // TextureImageMario
     LoadTextureImage("../../data/grass.jpg"); // TextureImageGrass
     LoadTextureImage("../../data/grass_sides3.png"); // TextureImageGrassSide
     LoadTextureImage("../../data/dirt.png"); // TextureImageDirt
@@ -403,22 +668,172 @@ int main(int argc, char* argv[])
 
     // Construímos a representação de objetos geométricos através de malhas de triângulos
 
-    ObjModel platformmodel("../../data/platform.obj");
-    ComputeNormals(&platformmodel);
-    BuildTrianglesAndAddToVirtualScene(&platformmodel);
+    // Lemos a descrição da cena: modelos, instâncias, caminhos dos pássaros,
+    // colisores e projéteis.
+    double scene_load_start = Headless_GetWallTime();
+    Scene_Load(g_SceneFilename, g_Scene);
+    printf("Cena \"%s\" carregada em %.1f ms: %d modelos, %d instancias, %d passaros, %d colisores, %d projeteis.\n",
+           g_SceneFilename, (Headless_GetWallTime() - scene_load_start)*1000.0,
+           (int)g_Scene.models.size(), (int)g_Scene.instances.size(), (int)g_Scene.bird_paths.size(),
+           (int)g_Scene.colliders.size(), (int)g_Scene.projectiles.size());
+
+    // Luzes pontuais e spots da cena (veja "clustered_lighting.cpp").
+    ClusteredLighting_SetLights(g_Scene.lights);
+
+    // Triângulos de cada objeto da cena, utilizados pelo Z-buffer em software.
+    std::map<std::string, std::vector<glm::vec4>> scene_triangles;
+
+    for (size_t i = 0; i < g_Scene.models.size(); ++i)
+    {
+        ObjModel scenemodel(g_Scene.models[i].c_str());
+        ComputeNormals(&scenemodel);
+        BuildTrianglesAndAddToVirtualScene(&scenemodel);
+
+        for (size_t shape = 0; shape < scenemodel.shapes.size(); ++shape)
+        {
+            const char* shape_name = scenemodel.shapes[shape].name.c_str();
+            scene_triangles[shape_name] = GetTriangleVertices(&scenemodel, shape_name);
+            WorldStreaming_AddObject(shape_name, GetWorldObjectGeometry(&scenemodel, shape_name));
+        }
+    }
 
     // Estamos definindo a bounding box da plataforma manualmente com base na translação aplicada no modelo, já que essa atualização não ocorre de forma automática
-    g_VirtualScene["platform"].bbox_min.y = -2.0f;
-    g_VirtualScene["platform"].bbox_max.y = 0.0f;
+    if ( g_VirtualScene.count("platform") )
+    {
+        g_VirtualScene["platform"].bbox_min.y = -2.0f;
+        g_VirtualScene["platform"].bbox_max.y = 0.0f;
+    }
+
+    // As instâncias estáticas são desenhadas pelo streaming do mundo, que
+    // mantém na memória somente os chunks próximos do personagem.
+    for (size_t i = 0; i < g_Scene.instances.size(); ++i)
+    {
+        const SceneInstance& instance = g_Scene.instances[i];
+        if ( !g_VirtualScene.count(instance.object) )
+        {
+            fprintf(stderr, "ERROR: Scene instance refers to unknown object \"%s\".\n", instance.object.c_str());
+            std::exit(EXIT_FAILURE);
+        }
+
+        glm::mat4 instance_model = Matrix_Translate(instance.translation.x, instance.translation.y, instance.translation.z)
+                                 * Matrix_Rotate_Y(instance.rotation_y)
+                                 * Matrix_Scale(instance.scale.x, instance.scale.y, instance.scale.z);
+        const SceneObject& object = g_VirtualScene[instance.object];
+        WorldStreaming_AddInstance(instance.object, SceneMaterialObjectId(instance.material), instance_model,
+                                   object.bbox_min, object.bbox_max);
+
+        // As plataformas são os principais oclusores da cena: as rasterizamos
+        // também no Z-buffer em software (veja "software_occlusion.cpp").
+        if ( instance.material == "platform" )
+            SoftwareOcclusion_AddOccluder(scene_triangles[instance.object], instance_model);
+    }
+    WorldStreaming_Init();
+
+    // Colisores estáticos, como OBBs, para a colisão da câmera e dos projéteis.
+    std::vector<OBB> scene_collider_obbs;
+    for (size_t i = 0; i < g_Scene.colliders.size(); ++i)
+        scene_collider_obbs.push_back(createOBBFromAABB(g_Scene.colliders[i].bbox_min, g_Scene.colliders[i].bbox_max));
+
+    std::vector<Projectile> projectiles;
+    for (size_t i = 0; i < g_Scene.projectiles.size(); ++i)
+    {
+        const SceneProjectile& p = g_Scene.projectiles[i];
+        Projectile projectile;
+        projectile.position = projectile.initial_position = glm::vec4(p.position, 1.0f);
+        projectile.velocity = projectile.initial_velocity = glm::vec4(p.velocity, 0.0f);
+        projectile.radius = p.radius;
+        projectiles.push_back(projectile);
+    }
+
+    passaros = g_Scene.bird_paths;
+    n_passaros = passaros.size();
+
+    // Terreno em voxels (somente um por cena).
+    if ( !g_Scene.voxel_terrains.empty() )
+    {
+        const SceneVoxelTerrain& terrain = g_Scene.voxel_terrains[0];
+        if ( g_Scene.voxel_terrains.size() > 1 )
+            fprintf(stderr, "WARNING: Only the first voxel_terrain of the scene is used.\n");
+
+        Voxel_Init(terrain.origin, terrain.size);
+        Voxel_GenerateTerrain(terrain.seed);
+    }
+
+    character_position_c = glm::vec4(g_Scene.character_spawn, 1.0f);
+
+    ObjModel spheremodel("../../data/sphere.obj");
+    ComputeNormals(&spheremodel);
+    BuildTrianglesAndAddToVirtualScene(&spheremodel);
 
     ObjModel birdmodel("../../data/achara_bird2.obj");
     ComputeNormals(&birdmodel);
     BuildTrianglesAndAddToVirtualScene(&birdmodel);
 
+    // Os caminhos dos pássaros são enviados uma única vez para a GPU, que
+    // calcula a posição e a orientação de cada pássaro a cada quadro.
+    float bird_radius = std::max(glm::length(g_VirtualScene["achara_bird"].bbox_min),
+                                 glm::length(g_VirtualScene["achara_bird"].bbox_max));
+    UploadBirdPaths(passaros, bird_radius);
+
+    // Atlas dos impostores dos pássaros distantes, desenhado uma única vez.
+    // O quadrilátero dos impostores entra na cena virtual como um objeto
+    // comum, para ser desenhado com QueueVirtualObjectInstanced(). Veja o
+    // arquivo "impostors.cpp".
+    const SceneObject& bird_object = g_VirtualScene["achara_bird"];
+    Impostors_Bake(bird_object.vertex_array_object_id, bird_object.rendering_mode, (GLsizei)bird_object.num_indices,
+                   (const void*)(bird_object.first_index * sizeof(GLuint)), bird_object.bbox_min, bird_object.bbox_max);
+    if ( g_Impostors.baked )
+    {
+        SceneObject impostor_object;
+        impostor_object.name = "bird_impostor";
+        impostor_object.first_index = 0;
+        impostor_object.num_indices = 6;
+        impostor_object.rendering_mode = GL_TRIANGLES;
+        impostor_object.vertex_array_object_id = g_Impostors.quad_vao;
+        impostor_object.bbox_min = bird_object.bbox_min;
+        impostor_object.bbox_max = bird_object.bbox_max;
+        g_VirtualScene["bird_impostor"] = impostor_object;
+
+        for (size_t i = 0; i < g_ShaderVariants.variants.size(); ++i)
+            Impostors_SetUniforms(g_ShaderVariants.variants[i].program_id);
+        glUseProgram(0);
+    }
+
+    // Culling e LOD dos pássaros na GPU (veja "gpu_culling.cpp"). Cada LOD,
+    // em cada conjunto de saída, tem um VAO com o seu modelo (malha ou
+    // impostor) e os atributos por instância no buffer de saída do culling.
+    GpuCulling_Init(BIRD_PATH_TEXTURE_UNIT);
+    if ( g_GpuCulling.supported )
+    {
+        EnableInstanceAttributes(g_GpuCulling.input_vao, 0);
+        for (int lod = 0; lod < GPU_CULLING_LOD_COUNT; ++lod)
+        {
+            bool impostor = (lod == GPU_CULLING_IMPOSTOR && g_Impostors.baked);
+            const SceneObject& object = impostor ? g_VirtualScene["bird_impostor"] : bird_object;
+            for (int set = 0; set < g_GpuCulling.sets; ++set)
+            {
+                GLuint vertex_array_object_id = CloneVertexArray(object.vertex_array_object_id);
+                EnableInstanceAttributes(vertex_array_object_id, 1);
+                SetInstanceAttributes(vertex_array_object_id, g_GpuCulling.output_buffers[set][lod], 0);
+                g_GpuCulling.output_vaos[set][lod] = vertex_array_object_id;
+            }
+            GpuCulling_SetDrawCommand((GpuCullingLod)lod, (GLuint)object.num_indices, (GLuint)object.first_index);
+        }
+    }
+
+    // Partículas simuladas na GPU (veja "particles.cpp")
+    Particles_Init();
+
     ObjModel charactermodel("../../data/Mario/source/Mario.obj");
     ComputeNormals(&charactermodel);
     BuildTrianglesAndAddToVirtualScene(&charactermodel);
 
+    // As oito partes do Mario são desenhadas juntas com glMultiDrawElements().
+    std::vector<std::string> mario_parts;
+    for (size_t shape = 0; shape < charactermodel.shapes.size(); ++shape)
+        mario_parts.push_back(charactermodel.shapes[shape].name);
+    AddMultiDrawObject("mario", mario_parts);
+
     ObjModel skyboxmodel("../../data/skybox.obj");
     ComputeNormals(&skyboxmodel);
     BuildTrianglesAndAddToVirtualScene(&skyboxmodel);
@@ -434,6 +849,23 @@ int main(int argc, char* argv[])
         createOBBFromAABB(g_VirtualScene["submesh_6"].bbox_min, g_VirtualScene["submesh_6"].bbox_max) // boots
     };
 
+    // Caixa do personagem para a colisão com o terreno em voxels, relativa à
+    // posição do personagem (nos pés). É a união das caixas das partes do
+    // modelo, na escala em que ele é desenhado, e tem a mesma largura em X e
+    // Z para não depender da rotação do personagem.
+    glm::vec3 character_voxel_box_min = g_VirtualScene["submesh_0"].bbox_min;
+    glm::vec3 character_voxel_box_max = g_VirtualScene["submesh_0"].bbox_max;
+    for (int i = 1; i <= 6; ++i)
+    {
+        std::string submesh = "submesh_" + std::to_string(i);
+        character_voxel_box_min = glm::min(character_voxel_box_min, g_VirtualScene[submesh].bbox_min);
+        character_voxel_box_max = glm::max(character_voxel_box_max, g_VirtualScene[submesh].bbox_max);
+    }
+    float character_voxel_half_width = 0.5f * std::max(std::max(-character_voxel_box_min.x, character_voxel_box_max.x),
+                                                        std::max(-character_voxel_box_min.z, character_voxel_box_max.z));
+    character_voxel_box_min = glm::vec3(-character_voxel_half_width, 0.5f * character_voxel_box_min.y, -character_voxel_half_width);
+    character_voxel_box_max = glm::vec3( character_voxel_half_width, 0.5f * character_voxel_box_max.y,  character_voxel_half_width);
+
     std::vector<glm::vec3> character_obbs_initial_centers = {
         character_obbs[HAT].center,
         character_obbs[HAIR].center,
@@ -454,9 +886,13 @@ int main(int argc, char* argv[])
         character_obbs[BOOTS].half_sizes,
     };
 
-    if ( argc > 1 )
+    // Base da caixa das botas, que apoia o personagem nos colisores,
+    // relativa à sua posição (na escala em que ele é desenhado).
+    float character_feet_offset = 0.5f * (character_obbs_initial_centers[BOOTS].y - character_bbs_initial_half_sizes[BOOTS].y);
+
+    if ( extra_model_filename != NULL )
     {
-        ObjModel model(argv[1]);
+        ObjModel model(extra_model_filename);
         BuildTrianglesAndAddToVirtualScene(&model);
     }
 
@@ -473,13 +909,38 @@ int main(int argc, char* argv[])
 
 
 
+    // Carregamos os chunks em torno da posição inicial do personagem antes do
+    // primeiro quadro; depois disso, o streaming ocorre em segundo plano.
+    WorldStreaming_Preload(character_position_c);
+
+    // Construímos as malhas iniciais do terreno em voxels.
+    Voxel_Update();
+
+    if ( benchmark_instancing || benchmark_matrices )
+    {
+        if ( benchmark_instancing )
+            RunInstancingBenchmark();
+        if ( benchmark_matrices )
+            RunDerivedMatricesBenchmark();
+        GpuTimers_Shutdown();
+        WorldStreaming_Shutdown();
+        JobSystem_Shutdown();
+        if ( g_Headless.enabled )
+            Headless_Shutdown();
+        else
+            glfwTerminate();
+        return 0;
+    }
+
     // Define o tempo atual em segundos
-    float initial_time = glfwGetTime();
+    Headless_BeginLoop();
+    float initial_time = Headless_GetTime();
 
-    // Ficamos em um loop infinito, renderizando, até que o usuário feche a janela
-    while (!glfwWindowShouldClose(window))
+    // Ficamos em um loop infinito, renderizando, até que o usuário feche a
+    // janela (ou, no modo headless, até o número de quadros pedido)
+    while (!Headless_ShouldClose(window))
     {
-        float current_time = glfwGetTime();
+        float current_time = Headless_GetTime();
         float delta_time = current_time - initial_time;
         initial_time = current_time;
 
@@ -490,13 +951,36 @@ int main(int argc, char* argv[])
         // Vermelho, Verde, Azul, Alpha (valor de transparência).
         // Conversaremos sobre sistemas de cores nas aulas de Modelos de Iluminação.
         //
+        // Na visualização de overdraw (veja "render_queue.cpp") o fundo é
+        // preto, para que a cor de cada pixel seja somente a soma dos
+        // fragmentos desenhados nele.
+        //
         //           R     G     B     A
-        glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
+        if ( g_RenderQueue.order.overdraw_view )
+            glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+        else
+            glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
+
+        // Lemos os tempos de GPU de quadros anteriores que já estiverem
+        // prontos e marcamos o início deste quadro.
+        GpuTimers_BeginFrame();
+
+        // Passamos à próxima região do buffer de streaming.
+        StreamBuffer_BeginFrame();
+
+        // Com a resolução dinâmica, a cena é desenhada em um framebuffer
+        // reduzido, ampliado para a janela antes do texto. Veja o arquivo
+        // "dynamic_resolution.cpp".
+        DynamicResolution_Begin(window);
 
         // "Pintamos" todos os pixels do framebuffer com a cor definida acima,
         // e também resetamos todos os pixels do Z-buffer (depth buffer).
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+        // Lemos os resultados das consultas de oclusão emitidas em quadros
+        // anteriores que já estiverem prontos, sem esperar pela GPU.
+        OcclusionCulling_BeginFrame();
+
         // Pedimos para a GPU utilizar o programa de GPU criado acima (contendo
         // os shaders de vértice e fragmentos).
       //  glUseProgram(g_GpuProgramID);
@@ -545,13 +1029,13 @@ int main(int argc, char* argv[])
 
         glm::vec4 move_dir(0.0f);
 
-        if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
+        if (Headless_GetKey(window, GLFW_KEY_W) == GLFW_PRESS)
             move_dir += forward * forward_direction;
-        if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
+        if (Headless_GetKey(window, GLFW_KEY_S) == GLFW_PRESS)
             move_dir -= forward * forward_direction;
-        if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
+        if (Headless_GetKey(window, GLFW_KEY_A) == GLFW_PRESS)
             move_dir -= right * forward_direction;
-        if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
+        if (Headless_GetKey(window, GLFW_KEY_D) == GLFW_PRESS)
             move_dir += right * forward_direction;
 
         // Normalizamos o vetor para que não importe o ângulo do movimento, o comprimento do vetor velocidae vai ser sempre o mesmo
@@ -574,34 +1058,121 @@ int main(int argc, char* argv[])
 
 
 
-    printf("Character velocity Y: %f\n", character_velocity.y);
+    // Mensagens de depuração; omitidas no modo sem janela, onde poluiriam a
+    // saída e o tempo medido de cada quadro.
+    if ( !g_Headless.enabled )
+        printf("Character velocity Y: %f\n", character_velocity.y);
+    glm::vec4 previous_character_position = character_position_c;
+    float character_fall_speed = -character_velocity.y;
     character_position_c += character_velocity * delta_time;
 
-    printf("Character position Y before collision: %f\n", character_position_c.y);
+    if ( !g_Headless.enabled )
+        printf("Character position Y before collision: %f\n", character_position_c.y);
 
   
 
-   for(int i = 0; i < character_obbs.size(); i++){
-        // Atualiza OBBs do personagem de acordo com a posição atual
-        resolve_collision_obb_aabb(character_position_c, character_velocity, grounded, (i == BOOTS), character_obbs[i], g_VirtualScene["platform"].bbox_min, g_VirtualScene["platform"].bbox_max );
+    // Testamos o personagem contra todos colisores próximos. O personagem
+    // está no chão se as botas estiverem apoiadas em qualquer um deles.
+    bool was_grounded = grounded;
+    bool grounded_on_any = false;
+
+    glm::vec3 character_near_min = glm::vec3(character_position_c) - glm::vec3(2.0f);
+    glm::vec3 character_near_max = glm::vec3(character_position_c) + glm::vec3(2.0f);
+
+    for(size_t c = 0; c < g_Scene.colliders.size(); c++){
+        if (!colision_aabb_aabb(character_near_min, character_near_max, g_Scene.colliders[c].bbox_min, g_Scene.colliders[c].bbox_max))
+            continue;
+
+        for(int i = 0; i < character_obbs.size(); i++){
+            // Atualiza OBBs do personagem de acordo com a posição atual
+            bool grounded_on_collider = was_grounded;
+            resolve_collision_obb_aabb(character_position_c, character_velocity, grounded_on_collider, (i == BOOTS), character_obbs[i], g_Scene.colliders[c].bbox_min, g_Scene.colliders[c].bbox_max );
+            if (i == BOOTS && grounded_on_collider)
+                grounded_on_any = true;
+        }
+    }
+
+    // Colisão com o terreno em voxels, consultando a grade diretamente.
+    bool grounded_on_voxels = false;
+    Voxel_ResolveCollision(previous_character_position, character_position_c, character_velocity,
+                           character_voxel_box_min, character_voxel_box_max, grounded_on_voxels);
+    if (grounded_on_voxels)
+        grounded_on_any = true;
+
+    grounded = grounded_on_any;
+
+    // Poeira ao pousar, proporcional à velocidade da queda, e um rastro
+    // enquanto o personagem está no ar, que cai no chão logo abaixo dos pés
+    // (veja "particles.cpp").
+    glm::vec3 character_feet = glm::vec3(character_position_c) + glm::vec3(0.0f, character_feet_offset, 0.0f);
+    if ( grounded && !was_grounded )
+    {
+        float strength = std::min(std::max(character_fall_speed / 8.0f, 0.1f), 1.0f);
+        Particles_Emit(PARTICLE_DUST, character_feet, glm::vec3(0.0f), glm::vec3(0.0f), character_feet.y,
+                       (int)(PARTICLE_LANDING_COUNT * strength));
+    }
+    else if ( !grounded )
+    {
+        glm::vec3 motion = glm::vec3(character_position_c - previous_character_position);
+        Particles_Emit(PARTICLE_TRAIL, character_feet - motion, motion, glm::vec3(0.0f), GroundHeightBelow(character_feet, 32.0f),
+                       (int)(PARTICLE_TRAIL_RATE * delta_time));
     }
 
-    printf("Character position Y after collision: %f\n", character_position_c.y);
-    printf("Grounded: %d\n", grounded);
-    // Se acrescentarmos mais plataformas, podemos muito bem simplesmente chamar mais de uma vez a função acima e parar de checar pelas plataformas se o personagem já estiver "grounded" após uma detecção
-    // Para objetos no entanto, teremos que aplicar a verificação em todos
+    if ( !g_Headless.enabled )
+    {
+        printf("Character position Y after collision: %f\n", character_position_c.y);
+        printf("Grounded: %d\n", grounded);
+    }
 
     
     if (colision_with_void(character_position_c.y)) {
-        character_position_c = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+        character_position_c = glm::vec4(g_Scene.character_spawn, 1.0f);
         grounded = true;
     }
 
-    if (grounded && glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS) {
+    // Movimentamos os projéteis da cena, com gravidade, e os colidimos
+    // contra os colisores próximos.
+    for(size_t p = 0; p < projectiles.size(); p++){
+        Projectile& projectile = projectiles[p];
+        glm::vec4 previous_projectile_position = projectile.position;
+        projectile.velocity.y += gravity * delta_time;
+        projectile.position += projectile.velocity * delta_time;
+        glm::vec4 projectile_free_velocity = projectile.velocity;
+
+        bool projectile_on_voxels = false;
+        Voxel_ResolveCollision(previous_projectile_position, projectile.position, projectile.velocity,
+                               glm::vec3(-projectile.radius), glm::vec3(projectile.radius), projectile_on_voxels);
+
+        glm::vec3 projectile_min = glm::vec3(projectile.position) - glm::vec3(projectile.radius);
+        glm::vec3 projectile_max = glm::vec3(projectile.position) + glm::vec3(projectile.radius);
+
+        for(size_t c = 0; c < g_Scene.colliders.size(); c++){
+            if (colision_aabb_aabb(projectile_min, projectile_max, g_Scene.colliders[c].bbox_min, g_Scene.colliders[c].bbox_max))
+                resolve_collision_sphere_obb(projectile.position, projectile.velocity, projectile.radius, scene_collider_obbs[c], 1);
+        }
+
+        // Faíscas quando a colisão muda bruscamente a velocidade (e não
+        // quando o projétil apenas repousa sobre um colisor).
+        float impact_speed = glm::length(projectile.velocity - projectile_free_velocity);
+        if ( impact_speed > PARTICLE_IMPACT_MIN_SPEED )
+            Particles_Emit(PARTICLE_SPARK, glm::vec3(projectile.position) - glm::vec3(0.0f, projectile.radius, 0.0f), glm::vec3(0.0f), 0.3f * glm::vec3(projectile.velocity),
+                           projectile.position.y - projectile.radius, (int)(PARTICLE_IMPACT_COUNT * std::min(impact_speed / 10.0f, 1.0f)));
+
+        if (colision_with_void(projectile.position.y)) {
+            projectile.position = projectile.initial_position;
+            projectile.velocity = projectile.initial_velocity;
+        }
+    }
+
+    if (grounded && Headless_GetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS) {
         grounded = false;
         character_velocity.y = 5.0f;
     }
 
+    // Pedimos os chunks que se aproximaram do personagem, descartamos os que
+    // ficaram longe e enviamos à GPU (dentro do orçamento) os já carregados.
+    WorldStreaming_Update(character_position_c);
+
 
         // ======================================================
         // ATUALIZAÇÃO DA CÂMERA
@@ -617,9 +1188,9 @@ int main(int argc, char* argv[])
         glm::vec4 camera_lookat_l = glm::vec4(character_position_c.x, character_position_c.y + 2.6f, character_position_c.z, 1.0f);
         glm::vec4 camera_view_vector;
 
-        bool current_y_state = glfwGetKey(window, GLFW_KEY_Y) == GLFW_PRESS;
+        bool current_y_state = Headless_GetKey(window, GLFW_KEY_Y) == GLFW_PRESS;
 
-        bool current_t_state = glfwGetKey(window, GLFW_KEY_T) == GLFW_PRESS;
+        bool current_t_state = Headless_GetKey(window, GLFW_KEY_T) == GLFW_PRESS;
 
         // Evita problema de apertar ambos botões juntos
         if (current_y_state && current_t_state) {
@@ -690,10 +1261,42 @@ int main(int argc, char* argv[])
         float desiredDist = glm::length(dir);
         dir = glm::normalize(dir);
 
-        OBB obb = createOBBFromAABB(g_VirtualScene["platform"].bbox_min,
-                                    g_VirtualScene["platform"].bbox_max);
+        // A câmera é aproximada do personagem se algum colisor estiver entre eles.
+        glm::vec3 camera_adjusted = look + dir * desiredDist;
+        for (size_t c = 0; c < scene_collider_obbs.size(); ++c)
+        {
+            camera_adjusted = resolve_collision_ray_obb(look, dir, desiredDist, scene_collider_obbs[c], 0.05f);
+            desiredDist = glm::length(camera_adjusted - look);
+        }
+
+        // O mesmo para o terreno em voxels, percorrendo a grade ao longo do raio.
+        float voxel_hit = Voxel_Raycast(look, dir, desiredDist);
+        if (voxel_hit >= 0.0f)
+            camera_adjusted = look + dir * std::max(voxel_hit - 0.05f, 0.01f);
+
+        camera_position_c = glm::vec4(camera_adjusted, 1.0f);
+
+        // Removemos o bloco para o qual a câmera aponta, ou colocamos um bloco
+        // de terra encostado na face apontada (teclas B e N).
+        if (g_VoxelEditRequest != VOXEL_EDIT_NONE)
+        {
+            glm::ivec3 hit_block, hit_normal;
+            glm::vec3 view_direction = glm::normalize(glm::vec3(camera_view_vector));
+            if (Voxel_Raycast(glm::vec3(camera_position_c), view_direction, 8.0f, &hit_block, &hit_normal) >= 0.0f)
+            {
+                if (g_VoxelEditRequest == VOXEL_EDIT_REMOVE)
+                    Voxel_SetBlock(hit_block.x, hit_block.y, hit_block.z, VOXEL_EMPTY);
+                else
+                {
+                    glm::ivec3 b = hit_block + hit_normal;
+                    Voxel_SetBlock(b.x, b.y, b.z, VOXEL_DIRT);
+                }
+            }
+            g_VoxelEditRequest = VOXEL_EDIT_NONE;
+        }
 
-        camera_position_c = glm::vec4(resolve_collision_ray_obb(look, dir, desiredDist, obb, 0.05f), 1.0f);
+        // Refazemos (nas threads de trabalho) as malhas dos chunks alterados.
+        Voxel_Update();
 
         // Abaixo definimos as varáveis que efetivamente definem a câmera virtual.
         // Veja slides 195-227 e 229-234 do documento Aula_08_Sistemas_de_Coordenadas.pdf.
@@ -736,80 +1339,186 @@ int main(int argc, char* argv[])
             projection = Matrix_Orthographic(l, r, b, t, nearplane, farplane);
         }
 
+        // Rasterizamos os oclusores no Z-buffer em software, que será utilizado
+        // para descartar objetos escondidos antes de qualquer chamada OpenGL.
+        SoftwareOcclusion_RenderOccluders(projection * view);
 
-// ---------------------------------------------------------------------
-// 2. DESENHO DO SKYBOX (PRIMEIRO OU ÚLTIMO)
-// ---------------------------------------------------------------------
-
-// Boa prática: renderizar o Skybox primeiro ou por último para otimização de profundidade.
-// Vamos renderizá-lo primeiro, ANTES de enviar a matriz View padrão.
-
-// A) Preparar a Matriz View sem Translação (apenas Rotação)
-// Removemos a 4ª coluna (translação) da matriz View original.
+        // Enviamos, uma única vez, as constantes do quadro utilizadas por
+        // todos os programas de GPU (skybox, cena, consultas de oclusão).
+        FrameConstants frame_constants;
+        frame_constants.view = view;
+        frame_constants.projection = projection;
+        frame_constants.view_projection = projection * view;
+        frame_constants.camera_position = camera_position_c;
+        frame_constants.light_direction = glm::normalize(glm::vec4(1.0f, 1.0f, 0.0f, 0.0f));
+        frame_constants.time = (float)Headless_GetTime();
 
-// --- Skybox ---
-glDepthMask(GL_FALSE);
-glDepthFunc(GL_LEQUAL);
-glDisable(GL_CULL_FACE);
+        // Distribuímos as luzes pontuais nos clusters do frustum; os
+        // parâmetros da grade também vão para as constantes do quadro.
+        int framebuffer_width, framebuffer_height;
+        DynamicResolution_GetRenderSize(&framebuffer_width, &framebuffer_height);
+        ClusteredLighting_Update(view, projection, framebuffer_width, framebuffer_height, frame_constants);
 
-glUseProgram(g_SkyboxProgramID);
-
-glm::mat4 view_skybox = glm::mat4(glm::mat3(view));
-glUniformMatrix4fv(g_skybox_view_uniform, 1, GL_FALSE, glm::value_ptr(view_skybox));
-glUniformMatrix4fv(g_skybox_projection_uniform, 1, GL_FALSE, glm::value_ptr(projection));
-
-glActiveTexture(GL_TEXTURE13);
-glBindTexture(GL_TEXTURE_CUBE_MAP, skyboxTextureID);
-glUniform1i(glGetUniformLocation(g_SkyboxProgramID, "skybox"), 13);
-
-DrawVirtualObject("Skybox");
-
-glDepthMask(GL_TRUE);
-glDepthFunc(GL_LESS);
-glEnable(GL_CULL_FACE);
+        // Cobertura das cascatas de sombra para a câmera atual.
+        ShadowMaps_Update(view, projection, glm::vec3(frame_constants.light_direction), frame_constants);
 
+        FrameConstants_Update(frame_constants);
 
+        // Nível de iluminação (por fragmento ou por vértice) de cada objeto,
+        // escolhido pelo seu tamanho na tela. Veja "lighting_lod.cpp".
+        LightingLod_Begin(camera_position_c, projection);
 
         // ======================================================
         // RENDERIZAÇÃO DA CENA VIRTUAL
         // ======================================================
-
-glUseProgram(g_GpuProgramID); // Use o programa de shader dedicado.
-
-
-        glm::mat4 model = Matrix_Identity(); // Transformação identidade de modelagem
-
-        // Enviamos as matrizes "view" e "projection" para a placa de vídeo
-        // (GPU). Veja o arquivo "shader_vertex.glsl", onde estas são
-        // efetivamente aplicadas em todos os pontos.
-        glUniformMatrix4fv(g_view_uniform       , 1 , GL_FALSE , glm::value_ptr(view));
-        glUniformMatrix4fv(g_projection_uniform , 1 , GL_FALSE , glm::value_ptr(projection));
+        //
+        // Os desenhos do quadro são enfileirados em g_RenderQueue e enviados
+        // de uma vez por RenderQueue_Submit(), que os ordena por passo,
+        // programa, material, VAO e profundidade, e descarta trocas de
+        // estado redundantes. Veja o arquivo "render_queue.cpp".
+        RenderQueue_Begin(camera_position_c);
 
         #define SPHERE 0
         #define BUNNY  1
         #define PLATFORM 2
         #define BIRD   3
         #define CHARACTER 4
-        #define MARIO_HAT 5
-        #define MARIO_PANTS 6
-        #define MARIO_FACE 7
-        #define MARIO_EYE 8
-        #define MARIO_GLOVES 9
-        #define MARIO_CLOTHES 10
-        #define MARIO_SHOES 11
-        #define MARIO_HAIR 12
+        #define VOXEL 13
+        #define BIRD_IMPOSTOR 14
+
+        // Skybox: desenhado no passo RENDER_PASS_SKY, sem escrever no
+        // Z-buffer. Por padrão o passo vem depois dos objetos opacos: o
+        // vertex shader coloca o skybox na profundidade máxima, e GL_LEQUAL
+        // descarta os pixels já cobertos. O vertex shader também remove a
+        // translação da matriz "view".
+        {
+            const SceneObject& skybox = g_VirtualScene["Skybox"];
+            DrawPacket packet = RenderQueue_MakePacket(RENDER_PASS_SKY, RENDER_PROGRAM_SKYBOX);
+            packet.vao = skybox.vertex_array_object_id;
+            packet.command = RENDER_DRAW_ELEMENTS;
+            packet.mode = skybox.rendering_mode;
+            packet.count = skybox.num_indices;
+            packet.offset = (const void*)(skybox.first_index * sizeof(GLuint));
+            packet.texture_target = GL_TEXTURE_CUBE_MAP;
+            packet.texture_id = skyboxTextureID;
+            packet.texture_unit = 13;
+            RenderQueue_Push(packet, Matrix_Identity(), camera_position_c);
+        }
 
+        glm::mat4 model = Matrix_Identity(); // Transformação identidade de modelagem
 
+        // Chunks residentes do mundo (plataformas, ...) e do terreno em
+        // voxels. Os pacotes são preparados em paralelo, um grupo de chunks
+        // por tarefa, cada tarefa na sua lista de comandos (veja
+        // "render_queue.cpp"): frustum culling, nível de iluminação e chave
+        // de ordenação são calculados fora da thread do OpenGL. Chunks fora
+        // do frustum continuam na fila somente para os mapas de sombra, pois
+        // podem projetar sombra dentro da tela.
+        glm::vec4 frustum_planes[6];
+        extract_frustum_planes(projection * view, frustum_planes);
+
+        std::vector<const WorldChunk*> resident_chunks;
+        std::vector<long long> resident_keys;
+        for (std::map<long long, WorldChunk>::iterator it = g_WorldStreaming.chunks.begin(); it != g_WorldStreaming.chunks.end(); ++it)
+        {
+            if ( it->second.state != WORLD_CHUNK_RESIDENT )
+                continue;
+            resident_chunks.push_back(&it->second);
+            resident_keys.push_back(it->first);
+        }
+
+        const int chunks_per_task = 16;
+        int world_tasks = ((int)resident_chunks.size() + chunks_per_task - 1) / chunks_per_task;
+        int voxel_tasks = ((int)g_VoxelWorld.chunks.size() + chunks_per_task - 1) / chunks_per_task;
+        RenderQueue_BeginLists(world_tasks + voxel_tasks);
 
-        // Desenhamos a plataforma
-        model = Matrix_Translate(0.0f,-1.0f,0.0f);
-        glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-        glUniform1i(g_object_id_uniform, PLATFORM);
-        DrawVirtualObject("platform");
+        JobSystem_ParallelFor(world_tasks + voxel_tasks, [&](int task) {
+            RenderCommandList& list = g_RenderQueue.lists[task];
+            glm::mat4 identity = Matrix_Identity();
 
-        // Atualizamos a AABB da plataforma para colisões
+            if ( task < world_tasks )
+            {
+                size_t end = std::min(resident_chunks.size(), (size_t)(task + 1) * chunks_per_task);
+                for (size_t c = (size_t)task * chunks_per_task; c < end; ++c)
+                {
+                    const WorldChunk& chunk = *resident_chunks[c];
+                    float size = g_WorldStreaming.chunk_size;
+                    glm::vec4 center = glm::vec4((chunk.cx + 0.5f)*size, 0.0f, (chunk.cz + 0.5f)*size, 1.0f);
+
+                    for (size_t b = 0; b < chunk.batches.size(); ++b)
+                    {
+                        const WorldChunkBatch& batch = chunk.batches[b];
+                        bool visible = colision_aabb_frustum(batch.world_min, batch.world_max, frustum_planes);
+                        LightingLevel lighting = LIGHTING_PER_PIXEL;
+                        if ( visible )
+                        {
+                            uint64_t lod_key = LIGHTING_LOD_KEY(1, (((uint64_t)resident_keys[c] << 8) | b) & 0xFFFFFFFFFFFFull);
+                            lighting = MaterialLightingLevel(batch.object_id, lod_key, center, size);
+                        }
+                        else
+                            list.frustum_culled += 1;
+
+                        DrawPacket packet = RenderQueue_MakePacket(RENDER_PASS_OPAQUE, MaterialRenderProgram(batch.object_id, lighting));
+                        packet.vao = chunk.vao;
+                        packet.command = RENDER_DRAW_ELEMENTS;
+                        packet.count = batch.count;
+                        packet.offset = (const void*)(batch.first * sizeof(GLuint));
+                        packet.object_id = batch.object_id;
+                        packet.shadow_caster = SHADOW_CASTER_STATIC;
+                        packet.camera_visible = visible;
+                        RenderQueue_PushTo(list, packet, identity, center);
+                    }
+                }
+            }
+            else
+            {
+                // Terreno em voxels: um pacote por chunk.
+                size_t first = (size_t)(task - world_tasks) * chunks_per_task;
+                size_t end = std::min(g_VoxelWorld.chunks.size(), first + chunks_per_task);
+                for (size_t i = first; i < end; ++i)
+                {
+                    const VoxelChunk& chunk = g_VoxelWorld.chunks[i];
+                    if ( chunk.vertex_count == 0 )
+                        continue;
+
+                    glm::ivec3 c = glm::ivec3(i % g_VoxelWorld.num_chunks.x,
+                                              (i / g_VoxelWorld.num_chunks.x) % g_VoxelWorld.num_chunks.y,
+                                              i / (g_VoxelWorld.num_chunks.x * g_VoxelWorld.num_chunks.y));
+                    glm::vec3 chunk_min = glm::vec3(g_VoxelWorld.origin) + glm::vec3(c) * (float)VOXEL_CHUNK_SIZE;
+                    glm::vec3 chunk_max = chunk_min + glm::vec3((float)VOXEL_CHUNK_SIZE);
+                    glm::vec3 center = 0.5f * (chunk_min + chunk_max);
+
+                    DrawPacket packet = RenderQueue_MakePacket(RENDER_PASS_OPAQUE, MaterialRenderProgram(VOXEL));
+                    packet.vao = chunk.vao;
+                    packet.command = RENDER_DRAW_ARRAYS;
+                    packet.count = chunk.vertex_count;
+                    packet.object_id = VOXEL;
+                    packet.shadow_caster = SHADOW_CASTER_STATIC;
+                    packet.camera_visible = colision_aabb_frustum(chunk_min, chunk_max, frustum_planes);
+                    if ( !packet.camera_visible )
+                        list.frustum_culled += 1;
+                    RenderQueue_PushTo(list, packet, identity, glm::vec4(center, 1.0f));
+                }
+            }
+        });
+
+        g_VoxelWorld.draw_calls = 0;
+        for (int task = world_tasks; task < world_tasks + voxel_tasks; ++task)
+        {
+            const RenderCommandList& list = g_RenderQueue.lists[task];
+            g_VoxelWorld.draw_calls += (int)list.packets.size() - list.frustum_culled;
+        }
+
+        // Projéteis
+        for (size_t i = 0; i < projectiles.size(); ++i)
+        {
+            model = Matrix_Translate(projectiles[i].position.x, projectiles[i].position.y, projectiles[i].position.z)
+                  * Matrix_Scale(projectiles[i].radius, projectiles[i].radius, projectiles[i].radius);
+            QueueVirtualObject("the_sphere", SPHERE, model);
+            g_RenderQueue.packets.back().shadow_caster = SHADOW_CASTER_DYNAMIC;
+        }
  
-        // Desenhamos o personagem
+        // Personagem
         model = Matrix_Translate(character_position_c.x, character_position_c.y, character_position_c.z)
             * Matrix_Rotate_Y(g_CameraTheta)
             * Matrix_Scale(0.5f, 0.5f, 0.5f);
@@ -819,64 +1528,215 @@ glUseProgram(g_GpuProgramID); // Use o programa de shader dedicado.
             updateOBB(character_obbs[i], model, character_obbs_initial_centers[i], character_bbs_initial_half_sizes[i]);
         }
 
+        // Todas as partes do personagem compartilham a matriz de modelagem e
+        // são desenhadas com uma única chamada; o fragment shader escolhe a
+        // textura de cada parte pelo atributo "part".
+        QueueMultiDrawObject("mario", CHARACTER, model);
+        g_RenderQueue.packets.back().shadow_caster = SHADOW_CASTER_DYNAMIC;
+        g_RenderQueue.packets.back().timer = GPU_TIMER_CHARACTERS;
+
+        // Pássaros voando em curvas de Bézier. Todos os pássaros visíveis são
+        // desenhados com uma única chamada instanciada, e a posição de cada
+        // um na curva é calculada no vertex shader a partir do tempo em
+        // FrameConstants.
+        //
+        // Pássaros pequenos na tela usam iluminação por vértice. A posição
+        // de cada pássaro só é conhecida na GPU, então usamos o ponto da
+        // AABB do caminho mais próximo da câmera: o pássaro nunca está mais
+        // perto que isso, e a troca nunca acontece perto da câmera.
+        const SceneObject& bird_object = g_VirtualScene["achara_bird"];
+        float bird_radius = 0.5f * glm::length(bird_object.bbox_max - bird_object.bbox_min);
 
-        glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-        glUniform1i(g_object_id_uniform, MARIO_PANTS);
-        //DrawVirtualObject("submesh_1");
-        //DrawVirtualObject("submesh_2");
-        //DrawVirtualObject("submesh_3");
-        DrawVirtualObject("submesh_4");
-        //DrawVirtualObject("submesh_5");
-        //DrawVirtualObject("submesh_6");
-        //DrawVirtualObject("submesh_7");
+        //
+        // Pássaros distantes são desenhados como impostores (veja
+        // "impostors.cpp"). Caminhos que cruzam a distância de transição
+        // entram nos dois desenhos, e o shader escolhe por pássaro; esses
+        // pacotes de malha descartam fragmentos e não entram no prepass.
+        //
+        // Com o culling na GPU (veja "gpu_culling.cpp"), a CPU só descarta
+        // os caminhos escondidos; o frustum, a iluminação e o impostor são
+        // escolhidos por pássaro, com a sua posição real no caminho.
+        std::vector<InstanceData> bird_instances[LIGHTING_LEVEL_COUNT];
+        std::vector<InstanceData> impostor_instances;
+        std::vector<InstanceData> impostor_shadow_instances; // Somente impostor, mas projetam sombra
+        std::vector<InstanceData> culling_instances;
+        bool bird_crossfade[LIGHTING_LEVEL_COUNT] = {};
+        bool gpu_culling = GpuCulling_Active();
+        Impostors_BeginFrame();
+        for (int i = 0; i< n_passaros; i++) {
 
-        
-        glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-        glUniform1i(g_object_id_uniform, MARIO_FACE);
-        DrawVirtualObject("submesh_7");
+            // Pássaros cujo caminho inteiro está escondido atrás da
+            // plataforma (ou de outros objetos) no último resultado de
+            // oclusão conhecido não são desenhados.
+            const BirdPath& path = g_BirdPaths[i];
+            if ( !SoftwareOcclusion_IsVisible(path.bbox_min, path.bbox_max) )
+                continue;
+            if ( !OcclusionCulling_IsVisible(i, path.bbox_min, path.bbox_max, camera_position_c) )
+                continue;
 
-        glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-        glUniform1i(g_object_id_uniform, MARIO_HAT);
-        DrawVirtualObject("submesh_0");
+            InstanceData instance;
+            SetInstanceModel(instance, Matrix_Rotate_Y(3.14159265f)); // Ajuste de orientação do modelo do pássaro
+            instance.params = glm::vec4(1.0f, 1.0f, 1.0f, 0.0f);
+            instance.path = glm::vec4((float)path.first_segment, (float)path.num_segments, 0.0f, 0.0f);
 
-        glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-        glUniform1i(g_object_id_uniform, MARIO_EYE);
-        DrawVirtualObject("submesh_3");
+            if ( gpu_culling )
+            {
+                culling_instances.push_back(instance);
+                continue;
+            }
 
-        glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-        glUniform1i(g_object_id_uniform, MARIO_GLOVES);
-        DrawVirtualObject("submesh_2");
+            ImpostorLevel impostor = Impostors_Classify(path.bbox_min, path.bbox_max, camera_position_c);
+            if ( impostor != IMPOSTOR_MESH )
+                impostor_instances.push_back(instance);
+            if ( impostor == IMPOSTOR_ONLY )
+            {
+                impostor_shadow_instances.push_back(instance);
+                continue;
+            }
 
-        glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-        glUniform1i(g_object_id_uniform, MARIO_CLOTHES);
-        DrawVirtualObject("submesh_5");
+            glm::vec3 nearest = glm::clamp(glm::vec3(camera_position_c), path.bbox_min, path.bbox_max);
+            LightingLevel lighting = MaterialLightingLevel(BIRD, LIGHTING_LOD_KEY(BIRD, i), glm::vec4(nearest, 1.0f), bird_radius);
+            bird_instances[lighting].push_back(instance);
+            bird_crossfade[lighting] = bird_crossfade[lighting] || impostor == IMPOSTOR_CROSSFADE;
+        }
 
-        glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-        glUniform1i(g_object_id_uniform, MARIO_SHOES);
-        DrawVirtualObject("submesh_6");
-        
+        for (int level = 0; level < LIGHTING_LEVEL_COUNT; ++level)
+        {
+            if ( bird_instances[level].empty() )
+                continue;
 
-        glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-        glUniform1i(g_object_id_uniform, MARIO_HAIR);
-        DrawVirtualObject("submesh_1");
+            QueueVirtualObjectInstanced("achara_bird", BIRD, bird_instances[level], (LightingLevel)level, level);
+            DrawPacket& packet = g_RenderQueue.packets.back();
+            packet.texture_target = GL_TEXTURE_BUFFER;
+            packet.texture_id = g_BirdPathTextureID;
+            packet.texture_unit = BIRD_PATH_TEXTURE_UNIT;
+            packet.shadow_caster = SHADOW_CASTER_DYNAMIC;
+            packet.timer = GPU_TIMER_BIRDS;
+            packet.replaceable = !bird_crossfade[level];
+        }
 
+        if ( !impostor_instances.empty() )
+        {
+            QueueVirtualObjectInstanced("bird_impostor", BIRD_IMPOSTOR, impostor_instances);
+            DrawPacket& packet = g_RenderQueue.packets.back();
+            packet.texture_target = GL_TEXTURE_BUFFER;
+            packet.texture_id = g_BirdPathTextureID;
+            packet.texture_unit = BIRD_PATH_TEXTURE_UNIT;
+            packet.timer = GPU_TIMER_BIRDS;
+            packet.replaceable = false;
+        }
 
-        // Desenhamos os pássaros voando em curvas de Bézier
-        for (int i = 0; i< n_passaros; i++) {
+        if ( !impostor_shadow_instances.empty() )
+        {
+            // Impostores não são desenhados nos mapas de sombra: a malha dos
+            // pássaros desenhados somente como impostores projeta a sombra,
+            // para que ela não apareça e desapareça na distância de troca.
+            // O slot de instâncias é o seguinte aos dos níveis de iluminação,
+            // para não substituir as instâncias do pacote visível por pixel.
+            QueueVirtualObjectInstanced("achara_bird", BIRD, impostor_shadow_instances, LIGHTING_PER_PIXEL, LIGHTING_LEVEL_COUNT);
+            DrawPacket& shadow_packet = g_RenderQueue.packets.back();
+            shadow_packet.texture_target = GL_TEXTURE_BUFFER;
+            shadow_packet.texture_id = g_BirdPathTextureID;
+            shadow_packet.texture_unit = BIRD_PATH_TEXTURE_UNIT;
+            shadow_packet.shadow_caster = SHADOW_CASTER_DYNAMIC;
+            shadow_packet.timer = GPU_TIMER_BIRDS;
+            shadow_packet.camera_visible = false;
+        }
 
-            std::vector<glm::vec4> passaro = passaros[i];
-        
-            ClosedCompositeCubicBézierCurve path = generateClosedBezierCycle(passaro);
-            
-            model = prepareDrawBird(path, (glfwGetTime()*2.0f));
-            model = model * Matrix_Rotate_Y(3.14159265f); // Ajuste de orientação do modelo do pássaro
-            glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-            glUniform1i(g_object_id_uniform, BIRD);
-            DrawVirtualObject("achara_bird");
+        if ( !culling_instances.empty() )
+        {
+            // Todos os pássaros projetam sombra, mesmo fora do frustum da
+            // câmera: este pacote é desenhado somente nos mapas de sombra.
+            QueueVirtualObjectInstanced("achara_bird", BIRD, culling_instances);
+            DrawPacket& shadow_packet = g_RenderQueue.packets.back();
+            shadow_packet.texture_target = GL_TEXTURE_BUFFER;
+            shadow_packet.texture_id = g_BirdPathTextureID;
+            shadow_packet.texture_unit = BIRD_PATH_TEXTURE_UNIT;
+            shadow_packet.shadow_caster = SHADOW_CASTER_DYNAMIC;
+            shadow_packet.timer = GPU_TIMER_BIRDS;
+            shadow_packet.camera_visible = false;
+
+            glActiveTexture(GL_TEXTURE0 + BIRD_PATH_TEXTURE_UNIT);
+            glBindTexture(GL_TEXTURE_BUFFER, g_BirdPathTextureID);
+            bool per_vertex = g_LightingLod.enabled && g_MaterialVariants[LIGHTING_PER_VERTEX].count(BIRD) > 0;
+            glm::vec3 lighting_lod = glm::vec3(per_vertex ? g_LightingLod.min_screen_size : 0.0f,
+                                               g_LightingLod.projection_scale, g_LightingLod.perspective ? 1.0f : 0.0f);
+            glm::vec4 bird_sphere = glm::vec4(0.5f * (bird_object.bbox_min + bird_object.bbox_max), bird_radius);
+            GpuCulling_Run(culling_instances.data(), (GLsizei)culling_instances.size(), frustum_planes, bird_sphere, lighting_lod);
+
+            // Um desenho por LOD, com o número de instâncias escrito pela GPU.
+            for (int lod = 0; lod < GPU_CULLING_LOD_COUNT; ++lod)
+            {
+                bool impostor = (lod == GPU_CULLING_IMPOSTOR);
+                if ( impostor && !g_Impostors.baked )
+                    continue;
+                if ( !g_GpuCulling.indirect && g_GpuCulling.counts[lod] == 0 )
+                    continue;
+
+                const SceneObject& object = g_VirtualScene[impostor ? "bird_impostor" : "achara_bird"];
+                int object_id = impostor ? BIRD_IMPOSTOR : BIRD;
+                LightingLevel lighting = impostor ? LIGHTING_PER_PIXEL : (LightingLevel)lod;
+
+                DrawPacket packet = RenderQueue_MakePacket(RENDER_PASS_OPAQUE, MaterialRenderProgram(object_id, lighting));
+                packet.vao = g_GpuCulling.output_vaos[g_GpuCulling.draw_set][lod];
+                packet.mode = object.rendering_mode;
+                packet.count = object.num_indices;
+                if ( g_GpuCulling.indirect )
+                {
+                    packet.command = RENDER_DRAW_ELEMENTS_INDIRECT;
+                    packet.indirect_buffer = g_GpuCulling.indirect_buffer;
+                    packet.offset = GpuCulling_DrawCommandOffset((GpuCullingLod)lod);
+                }
+                else
+                {
+                    packet.command = RENDER_DRAW_ELEMENTS_INSTANCED;
+                    packet.offset = (const void*)(object.first_index * sizeof(GLuint));
+                    packet.instance_count = (GLsizei)g_GpuCulling.counts[lod];
+                }
+                packet.object_id = object_id;
+                packet.bbox_min = object.bbox_min;
+                packet.bbox_max = object.bbox_max;
+                packet.texture_target = GL_TEXTURE_BUFFER;
+                packet.texture_id = g_BirdPathTextureID;
+                packet.texture_unit = BIRD_PATH_TEXTURE_UNIT;
+                packet.timer = GPU_TIMER_BIRDS;
+                packet.replaceable = !impostor && !(g_Impostors.enabled && g_Impostors.baked);
+                RenderQueue_Push(packet, Matrix_Identity(), g_RenderQueue.camera_position);
+            }
         }
 
+        // Simulamos as partículas, com as emissões deste quadro, e
+        // enfileiramos o seu desenho (veja "particles.cpp").
+        GpuTimers_Mark(GPU_TIMER_PARTICLES);
+        Particles_Simulate(delta_time, gravity);
+        Particles_Queue();
+
+        // Todos os pacotes do quadro foram enfileirados: as listas são
+        // ordenadas em paralelo e intercaladas em uma única fila.
+        RenderQueue_Build();
 
+        // Mapas de sombra: cascatas estáticas somente quando sua cobertura
+        // muda, objetos dinâmicos a cada quadro. Os pássaros projetam sombra
+        // mesmo quando descartados pelo frustum na GPU ou desenhados somente
+        // como impostores (pacotes somente de sombra, acima); somente
+        // caminhos escondidos pelo culling por oclusão não projetam.
+        GpuTimers_Mark(GPU_TIMER_SHADOWS);
+        ShadowMaps_Render();
 
+        RenderQueue_Submit();
+
+        // Com todos os objetos opacos desenhados, emitimos as consultas de
+        // oclusão agendadas neste quadro. Os resultados serão utilizados nos
+        // próximos quadros.
+        GpuTimers_Mark(GPU_TIMER_OCCLUSION);
+        OcclusionCulling_IssueQueries();
+
+        // A cena está completa: ampliamos a imagem para a janela, e o texto
+        // abaixo é desenhado na resolução da janela.
+        GpuTimers_Mark(GPU_TIMER_UPSCALE);
+        DynamicResolution_End();
+
+        GpuTimers_Mark(GPU_TIMER_TEXT);
 
         // Imprimimos na tela os ângulos de Euler que controlam a rotação do
         // terceiro cubo.
@@ -889,12 +1749,45 @@ glUseProgram(g_GpuProgramID); // Use o programa de shader dedicado.
         // por segundo (frames per second).
         TextRendering_ShowFramesPerSecond(window);
 
+        // Imprimimos na tela as estatísticas do culling por oclusão.
+        TextRendering_ShowOcclusionStats(window);
+        TextRendering_ShowSoftwareOcclusionStats(window);
+        TextRendering_ShowSceneStats(window, (int)g_Scene.instances.size(), (int)projectiles.size());
+        TextRendering_ShowStreamingStats(window);
+        TextRendering_ShowVoxelStats(window);
+        TextRendering_ShowRenderQueueStats(window);
+        TextRendering_ShowLightingLodStats(window);
+        TextRendering_ShowClusteredLightingStats(window);
+        TextRendering_ShowShadowStats(window);
+        TextRendering_ShowPassOrderStats(window);
+        TextRendering_ShowGpuTimerStats(window);
+        TextRendering_ShowDynamicResolutionStats(window);
+        TextRendering_ShowStreamBufferStats(window);
+        TextRendering_ShowImpostorStats(window);
+        TextRendering_ShowGpuCullingStats(window);
+        TextRendering_ShowParticleStats(window);
+
+        // Marcamos o fim do trabalho de GPU deste quadro.
+        GpuTimers_EndFrame();
+
+        // Todos os comandos que leem os dados deste quadro no buffer de
+        // streaming já foram emitidos; sua região pode ser protegida.
+        StreamBuffer_EndFrame();
+
         // O framebuffer onde OpenGL executa as operações de renderização não
         // é o mesmo que está sendo mostrado para o usuário, caso contrário
         // seria possível ver artefatos conhecidos como "screen tearing". A
         // chamada abaixo faz a troca dos buffers, mostrando para o usuário
         // tudo que foi renderizado pelas funções acima.
         // Veja o link: https://en.wikipedia.org/w/index.php?title=Multiple_buffering&oldid=793452829#Double_buffering_in_computer_graphics
+        //
+        // No modo headless não há troca de buffers: o quadro termina no FBO
+        // (veja Headless_EndFrame()).
+        if ( g_Headless.enabled )
+        {
+            Headless_EndFrame();
+            continue;
+        }
         glfwSwapBuffers(window);
 
         // Verificamos com o sistema operacional se houve alguma interação do
@@ -904,13 +1797,63 @@ glUseProgram(g_GpuProgramID); // Use o programa de shader dedicado.
         glfwPollEvents();
     }
 
+    // Finalizamos as threads de trabalho e de carregamento do mundo
+    WorldStreaming_Shutdown();
+    JobSystem_Shutdown();
+
+    // Imprimimos o tempo médio de GPU de cada passo e fechamos o CSV
+    GpuTimers_Shutdown();
+
     // Finalizamos o uso dos recursos do sistema operacional
-    glfwTerminate();
+    if ( g_Headless.enabled )
+        Headless_Shutdown();
+    else
+        glfwTerminate();
 
     // Fim do programa
     return 0;
 }
 
+// Converte o nome de material de uma instância do arquivo de cena para o
+// object_id utilizado nos shaders (veja os #define dentro de main()).
+int SceneMaterialObjectId(const std::string& material)
+{
+    if ( material == "sphere" )   return SPHERE;
+    if ( material == "bunny" )    return BUNNY;
+    if ( material == "platform" ) return PLATFORM;
+    if ( material == "bird" )     return BIRD;
+
+    fprintf(stderr, "ERROR: Unknown scene material \"%s\".\n", material.c_str());
+    std::exit(EXIT_FAILURE);
+}
+
+// Retorna a altura do topo do colisor ou bloco de voxels mais alto abaixo
+// de "point", até "max_distance", ou o menor float se não houver chão: as
+// partículas emitidas ali caem sem quicar (veja Particles_Emit()). Um topo
+// pouco acima do ponto também conta, pois os pés do personagem afundam um
+// pouco no chão em que está apoiado.
+float GroundHeightBelow(const glm::vec3& point, float max_distance)
+{
+    const float skin = 0.05f;
+    float ground = std::numeric_limits<float>::lowest();
+    for (size_t c = 0; c < g_Scene.colliders.size(); ++c)
+    {
+        const SceneCollider& collider = g_Scene.colliders[c];
+        if ( point.x < collider.bbox_min.x || point.x > collider.bbox_max.x
+          || point.z < collider.bbox_min.z || point.z > collider.bbox_max.z )
+            continue;
+        float top = collider.bbox_max.y;
+        if ( top <= point.y + skin && top >= point.y - max_distance )
+            ground = std::max(ground, top);
+    }
+
+    glm::vec3 start = point + glm::vec3(0.0f, skin, 0.0f);
+    float voxel_hit = Voxel_Raycast(start, glm::vec3(0.0f, -1.0f, 0.0f), max_distance + skin);
+    if ( voxel_hit >= 0.0f )
+        ground = std::max(ground, start.y - voxel_hit);
+    return ground;
+}
+
 // Função que carrega uma imagem para ser utilizada como textura
 void LoadTextureImage(const char* filename)
 {
@@ -963,6 +1906,148 @@ void LoadTextureImage(const char* filename)
     g_NumLoadedTextures += 1;
 }
 
+// Carrega várias imagens como camadas de uma única textura (GL_TEXTURE_2D_ARRAY),
+// ligada à próxima unidade de textura livre. Todas as camadas têm o tamanho
+// da primeira imagem; imagens de outro tamanho são redimensionadas
+// (interpolação bilinear) na carga.
+void LoadTextureArray(const std::vector<const char*>& filenames)
+{
+    int layer_width = 0;
+    int layer_height = 0;
+    std::vector<unsigned char> layers;
+
+    stbi_set_flip_vertically_on_load(true);
+    for (size_t layer = 0; layer < filenames.size(); ++layer)
+    {
+        printf("Carregando imagem \"%s\" (camada %d)... ", filenames[layer], (int)layer);
+
+        int width;
+        int height;
+        int channels;
+        unsigned char *data = stbi_load(filenames[layer], &width, &height, &channels, 3);
+
+        if ( data == NULL )
+        {
+            fprintf(stderr, "ERROR: Cannot open image file \"%s\".\n", filenames[layer]);
+            std::exit(EXIT_FAILURE);
+        }
+
+        if ( layer == 0 )
+        {
+            layer_width = width;
+            layer_height = height;
+            layers.resize((size_t)layer_width * layer_height * 3 * filenames.size());
+        }
+
+        unsigned char* destination = &layers[(size_t)layer_width * layer_height * 3 * layer];
+        if ( width == layer_width && height == layer_height )
+        {
+            printf("OK (%dx%d).\n", width, height);
+            memcpy(destination, data, (size_t)width * height * 3);
+        }
+        else
+        {
+            printf("OK (%dx%d, redimensionada para %dx%d).\n", width, height, layer_width, layer_height);
+            for (int y = 0; y < layer_height; ++y)
+            for (int x = 0; x < layer_width; ++x)
+            {
+                float sx = std::max(0.0f, (x + 0.5f) * width / layer_width - 0.5f);
+                float sy = std::max(0.0f, (y + 0.5f) * height / layer_height - 0.5f);
+                int x0 = std::min((int)sx, width - 1);
+                int y0 = std::min((int)sy, height - 1);
+                int x1 = std::min(x0 + 1, width - 1);
+                int y1 = std::min(y0 + 1, height - 1);
+                float fx = sx - x0;
+                float fy = sy - y0;
+
+                for (int c = 0; c < 3; ++c)
+                {
+                    float top    = data[(y0*width + x0)*3 + c] * (1.0f - fx) + data[(y0*width + x1)*3 + c] * fx;
+                    float bottom = data[(y1*width + x0)*3 + c] * (1.0f - fx) + data[(y1*width + x1)*3 + c] * fx;
+                    destination[(y*layer_width + x)*3 + c] = (unsigned char)(top * (1.0f - fy) + bottom * fy + 0.5f);
+                }
+            }
+        }
+
+        stbi_image_free(data);
+    }
+
+    GLuint texture_id;
+    GLuint sampler_id;
+    glGenTextures(1, &texture_id);
+    glGenSamplers(1, &sampler_id);
+
+    glSamplerParameteri(sampler_id, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glSamplerParameteri(sampler_id, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glSamplerParameteri(sampler_id, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glSamplerParameteri(sampler_id, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+    glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+
+    GLuint textureunit = g_NumLoadedTextures;
+    glActiveTexture(GL_TEXTURE0 + textureunit);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, texture_id);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_SRGB8, layer_width, layer_height, (GLsizei)filenames.size(), 0, GL_RGB, GL_UNSIGNED_BYTE, layers.data());
+    glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+    glBindSampler(textureunit, sampler_id);
+
+    g_NumLoadedTextures += 1;
+}
+
+// Agrupa objetos de g_VirtualScene em um objeto desenhado com uma única
+// chamada glMultiDrawElements(). Todas as partes devem ter sido criadas pela
+// mesma chamada a BuildTrianglesAndAddToVirtualScene() (mesmo VAO); cada
+// vértice carrega o índice da sua parte (atributo "part_index").
+void AddMultiDrawObject(const char* name, const std::vector<std::string>& parts)
+{
+    MultiDrawObject object;
+    object.vertex_array_object_id = g_VirtualScene[parts[0]].vertex_array_object_id;
+    object.bbox_min = glm::vec3(std::numeric_limits<float>::max());
+    object.bbox_max = glm::vec3(std::numeric_limits<float>::lowest());
+
+    for (size_t i = 0; i < parts.size(); ++i)
+    {
+        const SceneObject& part = g_VirtualScene[parts[i]];
+        if ( part.vertex_array_object_id != object.vertex_array_object_id )
+        {
+            fprintf(stderr, "ERROR: Part \"%s\" of \"%s\" uses a different VAO.\n", parts[i].c_str(), name);
+            std::exit(EXIT_FAILURE);
+        }
+
+        object.counts.push_back((GLsizei)part.num_indices);
+        object.offsets.push_back((const void*)(part.first_index * sizeof(GLuint)));
+        object.bbox_min = glm::min(object.bbox_min, part.bbox_min);
+        object.bbox_max = glm::max(object.bbox_max, part.bbox_max);
+    }
+
+    g_MultiDrawObjects[name] = object;
+}
+
+// Desenha todas as partes de um objeto criado por AddMultiDrawObject() com
+// uma única chamada, utilizando a matriz "model" e o "object_id" atuais.
+void DrawMultiDrawObject(const char* name)
+{
+    const MultiDrawObject& object = g_MultiDrawObjects[name];
+
+    glBindVertexArray(object.vertex_array_object_id);
+
+    glUniform4f(g_bbox_min_uniform, object.bbox_min.x, object.bbox_min.y, object.bbox_min.z, 1.0f);
+    glUniform4f(g_bbox_max_uniform, object.bbox_max.x, object.bbox_max.y, object.bbox_max.z, 1.0f);
+
+    glMultiDrawElements(
+        GL_TRIANGLES,
+        object.counts.data(),
+        GL_UNSIGNED_INT,
+        object.offsets.data(),
+        (GLsizei)object.counts.size()
+    );
+
+    glBindVertexArray(0);
+}
+
 // Função que desenha um objeto armazenado em g_VirtualScene. Veja definição
 // dos objetos na função BuildTrianglesAndAddToVirtualScene().
 void DrawVirtualObject(const char* object_name)
@@ -996,6 +2081,475 @@ void DrawVirtualObject(const char* object_name)
     glBindVertexArray(0);
 }
 
+// Desenha "instances.size()" cópias de um objeto de g_VirtualScene com uma
+// única chamada glDrawElementsInstanced(). A matriz de modelagem e os
+// parâmetros de cada cópia são enviados em um buffer de instâncias ligado ao
+// VAO do objeto (localizações 4 a 9 em "shader_vertex.glsl").
+void DrawVirtualObjectInstanced(const char* object_name, const std::vector<InstanceData>& instances)
+{
+    if ( instances.empty() )
+        return;
+
+    UploadVirtualObjectInstances(object_name, instances);
+
+    SceneObject& object = g_VirtualScene[object_name];
+    glBindVertexArray(object.vertex_array_object_id);
+
+    glUniform4f(g_bbox_min_uniform, object.bbox_min.x, object.bbox_min.y, object.bbox_min.z, 1.0f);
+    glUniform4f(g_bbox_max_uniform, object.bbox_max.x, object.bbox_max.y, object.bbox_max.z, 1.0f);
+    glUniform1i(g_instanced_uniform, GL_TRUE);
+
+    glDrawElementsInstanced(
+        object.rendering_mode,
+        object.num_indices,
+        GL_UNSIGNED_INT,
+        (void*)(object.first_index * sizeof(GLuint)),
+        (GLsizei)instances.size()
+    );
+
+    glUniform1i(g_instanced_uniform, GL_FALSE);
+    glBindVertexArray(0);
+}
+
+// Envia os dados de "instances" para o buffer de instâncias do VAO do
+// objeto, criando o buffer na primeira chamada, e retorna o VAO que deve
+// ser ligado para o desenho. O slot 0 usa o VAO do próprio objeto; os
+// demais usam cópias dele, para que conjuntos de instâncias diferentes do
+// mesmo objeto possam ser desenhados no mesmo quadro. Utilizada por
+// DrawVirtualObjectInstanced() e QueueVirtualObjectInstanced().
+GLuint UploadVirtualObjectInstances(const char* object_name, const std::vector<InstanceData>& instances, int slot)
+{
+    SceneObject& object = g_VirtualScene[object_name];
+
+    GLuint vertex_array_object_id = object.vertex_array_object_id;
+    if ( slot > 0 )
+    {
+        std::pair<GLuint, int> key(object.vertex_array_object_id, slot);
+        std::map<std::pair<GLuint, int>, GLuint>::iterator clone = g_InstanceSlotVertexArrays.find(key);
+        if ( clone == g_InstanceSlotVertexArrays.end() )
+            clone = g_InstanceSlotVertexArrays.insert(std::make_pair(key, CloneVertexArray(object.vertex_array_object_id))).first;
+        vertex_array_object_id = clone->second;
+    }
+
+    // Na primeira vez que o VAO é desenhado com instâncias, habilitamos os
+    // atributos por instância, com divisor 1 (um valor por instância, e não
+    // por vértice).
+    std::map<GLuint, InstanceBuffer>::iterator it = g_InstanceBuffers.find(vertex_array_object_id);
+    if ( it == g_InstanceBuffers.end() )
+    {
+        EnableInstanceAttributes(vertex_array_object_id, 1);
+
+        InstanceBuffer buffer;
+        buffer.buffer_id = 0;
+        buffer.capacity = 0;
+        it = g_InstanceBuffers.insert(std::make_pair(vertex_array_object_id, buffer)).first;
+    }
+
+    // Escrevemos os dados das instâncias em uma nova alocação do buffer de
+    // streaming (veja "stream_buffer.cpp"), sem esperar pela GPU. Conjuntos
+    // maiores que uma região do buffer usam o buffer próprio do VAO, que é
+    // descartado ("orphaning") antes de cada escrita.
+    GLsizeiptr size = instances.size() * sizeof(InstanceData);
+    GLintptr offset = 0;
+    GLuint buffer_id = StreamBuffer_Write(instances.data(), size, sizeof(glm::vec4), &offset);
+    if ( buffer_id == 0 )
+    {
+        InstanceBuffer& buffer = it->second;
+        if ( buffer.buffer_id == 0 )
+            glGenBuffers(1, &buffer.buffer_id);
+        if ( instances.size() > buffer.capacity )
+            buffer.capacity = std::max(instances.size(), 2 * buffer.capacity);
+        glBindBuffer(GL_ARRAY_BUFFER, buffer.buffer_id);
+        glBufferData(GL_ARRAY_BUFFER, buffer.capacity * sizeof(InstanceData), NULL, GL_STREAM_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, size, instances.data());
+        buffer_id = buffer.buffer_id;
+    }
+
+    // Os atributos apontam para a posição dos dados deste envio.
+    SetInstanceAttributes(vertex_array_object_id, buffer_id, offset);
+
+    return vertex_array_object_id;
+}
+
+// Habilita, em um VAO, os atributos de InstanceData, com o divisor dado: 1
+// para um valor por instância, 0 para um valor por vértice (veja
+// "gpu_culling.cpp").
+void EnableInstanceAttributes(GLuint vertex_array_object_id, GLuint divisor)
+{
+    glBindVertexArray(vertex_array_object_id);
+    for (GLuint location = 4; location <= 13; ++location)
+    {
+        if ( location == 10 )
+            continue; // "(location = 10)" é um atributo por vértice
+        glEnableVertexAttribArray(location);
+        glVertexAttribDivisor(location, divisor);
+    }
+    glBindVertexArray(0);
+}
+
+// Aponta os atributos de InstanceData de um VAO para as instâncias que
+// começam em "offset" no buffer "buffer_id".
+void SetInstanceAttributes(GLuint vertex_array_object_id, GLuint buffer_id, GLintptr offset)
+{
+    glBindVertexArray(vertex_array_object_id);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer_id);
+    GLsizei stride = sizeof(InstanceData);
+    for (int column = 0; column < 4; ++column)
+    {
+        GLuint location = 4 + column; // "(location = 4)" em "shader_vertex.glsl"
+        glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, stride, (void*)(offset + column * sizeof(glm::vec4)));
+    }
+    glVertexAttribPointer(8, 4, GL_FLOAT, GL_FALSE, stride, (void*)(offset + offsetof(InstanceData, params))); // "(location = 8)"
+    glVertexAttribPointer(9, 4, GL_FLOAT, GL_FALSE, stride, (void*)(offset + offsetof(InstanceData, path)));   // "(location = 9)"
+    for (int column = 0; column < 3; ++column)
+    {
+        GLuint location = 11 + column; // "(location = 11)" em "shader_vertex.glsl"
+        size_t attribute_offset = offset + offsetof(InstanceData, normal_matrix) + column * sizeof(glm::vec3);
+        glVertexAttribPointer(location, 3, GL_FLOAT, GL_FALSE, stride, (void*)attribute_offset);
+    }
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+// Cria um novo VAO com os mesmos atributos por vértice (divisor 0) e o
+// mesmo buffer de índices de "vertex_array_object_id". Os buffers são
+// compartilhados; somente o estado do VAO é copiado.
+GLuint CloneVertexArray(GLuint vertex_array_object_id)
+{
+    struct VertexAttribute
+    {
+        GLint  buffer, size, type, normalized, stride, integer;
+        void*  pointer;
+    };
+
+    GLint max_attributes = 16;
+    glGetIntegerv(GL_MAX_VERTEX_ATTRIBS, &max_attributes);
+
+    glBindVertexArray(vertex_array_object_id);
+
+    GLint element_buffer = 0;
+    glGetIntegerv(GL_ELEMENT_ARRAY_BUFFER_BINDING, &element_buffer);
+
+    std::vector<std::pair<GLuint, VertexAttribute> > attributes;
+    for (GLint location = 0; location < max_attributes; ++location)
+    {
+        GLint enabled = 0, divisor = 0;
+        glGetVertexAttribiv(location, GL_VERTEX_ATTRIB_ARRAY_ENABLED, &enabled);
+        glGetVertexAttribiv(location, GL_VERTEX_ATTRIB_ARRAY_DIVISOR, &divisor);
+        if ( !enabled || divisor != 0 )
+            continue;
+
+        VertexAttribute attribute;
+        glGetVertexAttribiv(location, GL_VERTEX_ATTRIB_ARRAY_BUFFER_BINDING, &attribute.buffer);
+        glGetVertexAttribiv(location, GL_VERTEX_ATTRIB_ARRAY_SIZE, &attribute.size);
+        glGetVertexAttribiv(location, GL_VERTEX_ATTRIB_ARRAY_TYPE, &attribute.type);
+        glGetVertexAttribiv(location, GL_VERTEX_ATTRIB_ARRAY_NORMALIZED, &attribute.normalized);
+        glGetVertexAttribiv(location, GL_VERTEX_ATTRIB_ARRAY_STRIDE, &attribute.stride);
+        glGetVertexAttribiv(location, GL_VERTEX_ATTRIB_ARRAY_INTEGER, &attribute.integer);
+        glGetVertexAttribPointerv(location, GL_VERTEX_ATTRIB_ARRAY_POINTER, &attribute.pointer);
+        attributes.push_back(std::make_pair((GLuint)location, attribute));
+    }
+
+    GLuint clone_id;
+    glGenVertexArrays(1, &clone_id);
+    glBindVertexArray(clone_id);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, element_buffer);
+    for (size_t i = 0; i < attributes.size(); ++i)
+    {
+        GLuint location = attributes[i].first;
+        const VertexAttribute& attribute = attributes[i].second;
+
+        glBindBuffer(GL_ARRAY_BUFFER, attribute.buffer);
+        if ( attribute.integer )
+            glVertexAttribIPointer(location, attribute.size, attribute.type, attribute.stride, attribute.pointer);
+        else
+            glVertexAttribPointer(location, attribute.size, attribute.type, attribute.normalized, attribute.stride, attribute.pointer);
+        glEnableVertexAttribArray(location);
+    }
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    return clone_id;
+}
+
+// Enfileira em g_RenderQueue o desenho de um objeto de g_VirtualScene com
+// a variante do seu material, no passo opaco.
+void QueueVirtualObject(const char* object_name, int object_id, const glm::mat4& model, LightingLevel lighting)
+{
+    const SceneObject& object = g_VirtualScene[object_name];
+
+    DrawPacket packet = RenderQueue_MakePacket(RENDER_PASS_OPAQUE, MaterialRenderProgram(object_id, lighting));
+    packet.vao = object.vertex_array_object_id;
+    packet.command = RENDER_DRAW_ELEMENTS;
+    packet.mode = object.rendering_mode;
+    packet.count = object.num_indices;
+    packet.offset = (const void*)(object.first_index * sizeof(GLuint));
+    packet.object_id = object_id;
+    packet.bbox_min = object.bbox_min;
+    packet.bbox_max = object.bbox_max;
+
+    glm::vec4 center = model * glm::vec4(0.5f * (object.bbox_min + object.bbox_max), 1.0f);
+    RenderQueue_Push(packet, model, center);
+}
+
+// Envia os dados das instâncias e enfileira um único desenho instanciado
+// com o programa do nível de iluminação dado. Os atributos de instância do
+// VAO são apontados no momento do enfileiramento, então cada conjunto de
+// instâncias do mesmo objeto no mesmo quadro precisa do seu próprio slot
+// (veja UploadVirtualObjectInstances()).
+void QueueVirtualObjectInstanced(const char* object_name, int object_id, const std::vector<InstanceData>& instances, LightingLevel lighting, int slot)
+{
+    if ( instances.empty() )
+        return;
+
+    GLuint vertex_array_object_id = UploadVirtualObjectInstances(object_name, instances, slot);
+
+    const SceneObject& object = g_VirtualScene[object_name];
+
+    DrawPacket packet = RenderQueue_MakePacket(RENDER_PASS_OPAQUE, MaterialRenderProgram(object_id, lighting));
+    packet.vao = vertex_array_object_id;
+    packet.command = RENDER_DRAW_ELEMENTS_INSTANCED;
+    packet.mode = object.rendering_mode;
+    packet.count = object.num_indices;
+    packet.offset = (const void*)(object.first_index * sizeof(GLuint));
+    packet.instance_count = (GLsizei)instances.size();
+    packet.object_id = object_id;
+    packet.bbox_min = object.bbox_min;
+    packet.bbox_max = object.bbox_max;
+
+    // As instâncias estão espalhadas pela cena; a profundidade não é relevante.
+    RenderQueue_Push(packet, Matrix_Identity(), g_RenderQueue.camera_position);
+}
+
+// Enfileira todas as partes de um objeto criado por AddMultiDrawObject().
+void QueueMultiDrawObject(const char* name, int object_id, const glm::mat4& model)
+{
+    const MultiDrawObject& object = g_MultiDrawObjects[name];
+
+    DrawPacket packet = RenderQueue_MakePacket(RENDER_PASS_OPAQUE, MaterialRenderProgram(object_id));
+    packet.vao = object.vertex_array_object_id;
+    packet.command = RENDER_MULTI_DRAW_ELEMENTS;
+    packet.multi_counts = object.counts.data();
+    packet.multi_offsets = object.offsets.data();
+    packet.multi_draw_count = (GLsizei)object.counts.size();
+    packet.object_id = object_id;
+    packet.bbox_min = object.bbox_min;
+    packet.bbox_max = object.bbox_max;
+
+    glm::vec4 center = model * glm::vec4(0.5f * (object.bbox_min + object.bbox_max), 1.0f);
+    RenderQueue_Push(packet, model, center);
+}
+
+// Compara o custo de desenhar N pássaros com uma chamada por objeto (como o
+// laço original em main()) e com uma única chamada instanciada, para vários
+// valores de N. Executada com "--benchmark-instancing"; imprime uma tabela no
+// terminal com o tempo de CPU (envio dos comandos) e de GPU de cada caminho.
+void RunInstancingBenchmark()
+{
+    const int counts[] = { 1, 10, 100, 1000, 10000 };
+    const int frames = 20;
+
+    glm::mat4 view = Matrix_Camera_View(glm::vec4(0.0f, 40.0f, 90.0f, 1.0f), glm::vec4(0.0f, -40.0f, -90.0f, 0.0f), glm::vec4(0.0f, 1.0f, 0.0f, 0.0f));
+    glm::mat4 projection = Matrix_Perspective(3.141592f / 3.0f, g_ScreenRatio, -0.1f, -300.0f);
+
+    FrameConstants frame_constants;
+    frame_constants.view = view;
+    frame_constants.projection = projection;
+    frame_constants.view_projection = projection * view;
+    frame_constants.camera_position = glm::vec4(0.0f, 40.0f, 90.0f, 1.0f);
+    frame_constants.light_direction = glm::normalize(glm::vec4(1.0f, 1.0f, 0.0f, 0.0f));
+    frame_constants.time = 0.0f;
+
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    ClusteredLighting_Update(view, projection, viewport[2], viewport[3], frame_constants);
+    ShadowMaps_Update(view, projection, glm::vec3(frame_constants.light_direction), frame_constants);
+    frame_constants.shadow_splits.w = 0.0f; // Sem sombras: os mapas não são desenhados aqui
+
+    UseMaterialProgram(BIRD);
+
+    GLuint query_id;
+    glGenQueries(1, &query_id);
+
+    printf("\n%8s | %12s %12s | %12s %12s | %8s\n", "birds", "object CPU", "object GPU", "inst. CPU", "inst. GPU", "speedup");
+
+    for (size_t c = 0; c < sizeof(counts)/sizeof(counts[0]); ++c)
+    {
+        int count = counts[c];
+        int side = (int)ceil(sqrt((double)count));
+
+        std::vector<InstanceData> instances(count);
+        for (int i = 0; i < count; ++i)
+        {
+            float x = (i % side - side / 2) * 1.5f;
+            float z = (i / side - side / 2) * 1.5f;
+            SetInstanceModel(instances[i], Matrix_Translate(x, 5.0f, z) * Matrix_Rotate_Y(3.14159265f));
+            instances[i].params = glm::vec4(1.0f, 1.0f, 1.0f, 0.0f);
+            instances[i].path = glm::vec4(0.0f);
+        }
+
+        double cpu_ms[2] = { 0.0, 0.0 };
+        double gpu_ms[2] = { 0.0, 0.0 };
+
+        for (int mode = 0; mode < 2; ++mode)
+        {
+            for (int frame = -3; frame < frames; ++frame) // 3 quadros de aquecimento
+            {
+                // Como no laço principal, cada quadro escreve suas constantes
+                // em uma nova região do buffer de streaming.
+                StreamBuffer_BeginFrame();
+                FrameConstants_Update(frame_constants);
+
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                glBeginQuery(GL_TIME_ELAPSED, query_id);
+                double start = Headless_GetWallTime();
+
+                if ( mode == 0 )
+                {
+                    for (int i = 0; i < count; ++i)
+                    {
+                        SetModelMatrixUniforms(instances[i].model);
+                        DrawVirtualObject("achara_bird");
+                    }
+                }
+                else
+                {
+                    DrawVirtualObjectInstanced("achara_bird", instances);
+                }
+
+                double submitted = Headless_GetWallTime();
+                glEndQuery(GL_TIME_ELAPSED);
+
+                GLuint64 elapsed_ns = 0;
+                glGetQueryObjectui64v(query_id, GL_QUERY_RESULT, &elapsed_ns);
+                StreamBuffer_EndFrame();
+
+                if ( frame >= 0 )
+                {
+                    cpu_ms[mode] += (submitted - start) * 1000.0 / frames;
+                    gpu_ms[mode] += elapsed_ns / 1.0e6 / frames;
+                }
+            }
+        }
+
+        double object_total = std::max(cpu_ms[0], gpu_ms[0]);
+        double instanced_total = std::max(cpu_ms[1], gpu_ms[1]);
+        printf("%8d | %9.3f ms %9.3f ms | %9.3f ms %9.3f ms | %7.1fx\n", count,
+               cpu_ms[0], gpu_ms[0], cpu_ms[1], gpu_ms[1], object_total / std::max(instanced_total, 1e-6));
+    }
+
+    glDeleteQueries(1, &query_id);
+}
+
+// Compara o tempo de GPU do vertex shader que inverte a matriz de modelagem
+// para cada vértice (variante com NORMAL_MATRIX_PER_VERTEX, como antes) com
+// o que recebe a matriz de normais e a model-view-projection computadas na
+// CPU, desenhando N pássaros com uma chamada por objeto e com uma chamada
+// instanciada. Executada com "--benchmark-matrices"; imprime uma tabela no
+// terminal com o tempo de CPU (envio dos comandos) e de GPU de cada caminho.
+void RunDerivedMatricesBenchmark()
+{
+    const int counts[] = { 100, 1000, 10000 };
+    const int frames = 20;
+
+    glm::mat4 view = Matrix_Camera_View(glm::vec4(0.0f, 40.0f, 90.0f, 1.0f), glm::vec4(0.0f, -40.0f, -90.0f, 0.0f), glm::vec4(0.0f, 1.0f, 0.0f, 0.0f));
+    glm::mat4 projection = Matrix_Perspective(3.141592f / 3.0f, g_ScreenRatio, -0.1f, -300.0f);
+
+    FrameConstants frame_constants;
+    frame_constants.view = view;
+    frame_constants.projection = projection;
+    frame_constants.view_projection = projection * view;
+    frame_constants.camera_position = glm::vec4(0.0f, 40.0f, 90.0f, 1.0f);
+    frame_constants.light_direction = glm::normalize(glm::vec4(1.0f, 1.0f, 0.0f, 0.0f));
+    frame_constants.time = 0.0f;
+
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    ClusteredLighting_Update(view, projection, viewport[2], viewport[3], frame_constants);
+    ShadowMaps_Update(view, projection, glm::vec3(frame_constants.light_direction), frame_constants);
+    frame_constants.shadow_splits.w = 0.0f; // Sem sombras: os mapas não são desenhados aqui
+
+    // Mesmo material dos pássaros, com e sem a inversa por vértice.
+    std::string bird_defines = MaterialVariant(BIRD).defines;
+    int variants[2];
+    variants[0] = ShaderVariants_Get(bird_defines + "#define NORMAL_MATRIX_PER_VERTEX\n");
+    variants[1] = ShaderVariants_Get(bird_defines);
+
+    GLuint query_id;
+    glGenQueries(1, &query_id);
+
+    printf("\n%8s %-10s | %12s %12s | %12s %12s | %8s\n", "birds", "draws", "per-vtx CPU", "per-vtx GPU", "derived CPU", "derived GPU", "GPU gain");
+
+    for (size_t c = 0; c < sizeof(counts)/sizeof(counts[0]); ++c)
+    {
+        int count = counts[c];
+        int side = (int)ceil(sqrt((double)count));
+
+        std::vector<InstanceData> instances(count);
+        for (int i = 0; i < count; ++i)
+        {
+            float x = (i % side - side / 2) * 1.5f;
+            float z = (i / side - side / 2) * 1.5f;
+            SetInstanceModel(instances[i], Matrix_Translate(x, 5.0f, z) * Matrix_Rotate_Y(3.14159265f) * Matrix_Scale(1.0f, 1.5f, 1.0f));
+            instances[i].params = glm::vec4(1.0f, 1.0f, 1.0f, 0.0f);
+            instances[i].path = glm::vec4(0.0f);
+        }
+
+        for (int instanced = 0; instanced < 2; ++instanced)
+        {
+            double cpu_ms[2] = { 0.0, 0.0 };
+            double gpu_ms[2] = { 0.0, 0.0 };
+
+            for (int mode = 0; mode < 2; ++mode)
+            {
+                UseShaderVariant(g_ShaderVariants.variants[variants[mode]]);
+
+                for (int frame = -3; frame < frames; ++frame) // 3 quadros de aquecimento
+                {
+                    StreamBuffer_BeginFrame();
+                    FrameConstants_Update(frame_constants);
+
+                    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                    glBeginQuery(GL_TIME_ELAPSED, query_id);
+                    double start = Headless_GetWallTime();
+
+                    if ( !instanced )
+                    {
+                        for (int i = 0; i < count; ++i)
+                        {
+                            SetModelMatrixUniforms(instances[i].model);
+                            DrawVirtualObject("achara_bird");
+                        }
+                    }
+                    else
+                    {
+                        DrawVirtualObjectInstanced("achara_bird", instances);
+                    }
+
+                    double submitted = Headless_GetWallTime();
+                    glEndQuery(GL_TIME_ELAPSED);
+
+                    GLuint64 elapsed_ns = 0;
+                    glGetQueryObjectui64v(query_id, GL_QUERY_RESULT, &elapsed_ns);
+                    StreamBuffer_EndFrame();
+
+                    if ( frame >= 0 )
+                    {
+                        cpu_ms[mode] += (submitted - start) * 1000.0 / frames;
+                        gpu_ms[mode] += elapsed_ns / 1.0e6 / frames;
+                    }
+                }
+            }
+
+            printf("%8d %-10s | %9.3f ms %9.3f ms | %9.3f ms %9.3f ms | %7.2fx\n", count, instanced ? "instanced" : "per-object",
+                   cpu_ms[0], gpu_ms[0], cpu_ms[1], gpu_ms[1], gpu_ms[0] / std::max(gpu_ms[1], 1e-6));
+        }
+    }
+
+    glDeleteQueries(1, &query_id);
+}
+
 // Função que carrega os shaders de vértices e de fragmentos que serão
 // utilizados para renderização. Veja slides 180-200 do documento Aula_03_Rendering_Pipeline_Grafico.pdf.
 //
@@ -1019,20 +2573,17 @@ void LoadShadersFromFiles()
     //       |
     //       o-- shader_fragment.glsl
     //
-    GLuint vertex_shader_id = LoadShader_Vertex("../../src/shader_vertex.glsl");
-    GLuint fragment_shader_id = LoadShader_Fragment("../../src/shader_fragment.glsl");
-
-    //GLuint vertex_shader_gouraud_id = LoadShader_Vertex("../../src/shader_vertex_gouraud.glsl");
-    //GLuint fragment_shader_gouraud_id = LoadShader_Fragment("../../src/shader_fragment_gouraud.glsl");
-
     // Novos caminhos para os shaders do Skybox
     GLuint vertex_shader_skybox_id = LoadShader_Vertex("../../src/shader_vertex_skybox.glsl");
     GLuint fragment_shader_skybox_id = LoadShader_Fragment("../../src/shader_fragment_skybox.glsl");
 
 
-    // Deletamos o programa de GPU anterior, caso ele exista.
-    if ( g_GpuProgramID != 0 )
-        glDeleteProgram(g_GpuProgramID);
+    // Deletamos os programas de GPU anteriores, caso existam.
+    if ( g_SkyboxProgramID != 0 )
+        glDeleteProgram(g_SkyboxProgramID);
+    ShaderVariants_Clear();
+    for (int level = 0; level < LIGHTING_LEVEL_COUNT; ++level)
+        g_MaterialVariants[level].clear();
 
 
     // ------------------------------------
@@ -1042,9 +2593,11 @@ void LoadShadersFromFiles()
     // Criamos um programa de GPU para o Skybox.
     g_SkyboxProgramID = CreateGpuProgram(vertex_shader_skybox_id, fragment_shader_skybox_id);
 
-    // Buscamos o endereço das variáveis (Uniforms) do programa Skybox.
-    g_skybox_view_uniform       = glGetUniformLocation(g_SkyboxProgramID, "view");
-    g_skybox_projection_uniform = glGetUniformLocation(g_SkyboxProgramID, "projection");
+    FrameConstants_BindProgram(g_SkyboxProgramID);
+
+    RenderProgram skybox_program;
+    skybox_program.program_id = g_SkyboxProgramID;
+    RenderQueue_SetProgram(RENDER_PROGRAM_SKYBOX, skybox_program);
     
     // Configura a unidade de textura do Cubemap.
     glUseProgram(g_SkyboxProgramID);
@@ -1052,60 +2605,176 @@ void LoadShadersFromFiles()
     glUniform1i(glGetUniformLocation(g_SkyboxProgramID, "skybox"), 13);
     
 
-    // Gouraud
+    // Materiais
     // ###############################
 
-    // Criamos um programa de GPU utilizando os shaders carregados acima.
-    //g_GpuProgramID_gouraud = CreateGpuProgram(vertex_shader_gouraud_id, fragment_shader_gouraud_id);
+    // Cada material é uma variante de "shader_vertex.glsl" e
+    // "shader_fragment.glsl" compilada com os "#define"s abaixo (veja
+    // "shader_variants.cpp"). Materiais com os mesmos "#define"s
+    // compartilham o programa.
+    std::map<int, int>& per_pixel = g_MaterialVariants[LIGHTING_PER_PIXEL];
+    std::map<int, int>& per_vertex = g_MaterialVariants[LIGHTING_PER_VERTEX];
+
+    std::string bird_material =
+        "#define MATERIAL_TEXTURE_NONE\n"
+        "#define MATERIAL_LIGHTING_PHONG\n"
+        "#define MATERIAL_KD vec3(0.4, 0.4, 0.8)\n";
+    if ( g_Impostors.enabled )
+        bird_material += "#define MATERIAL_IMPOSTOR_FADE\n"; // Transição para o impostor
+    const char* default_material =
+        "#define MATERIAL_TEXTURE_NONE\n"
+        "#define MATERIAL_LIGHTING_PHONG\n";
+
+    per_pixel[SPHERE] = ShaderVariants_Get(
+        "#define MATERIAL_TEXTURE_ARRAY\n"
+        "#define MATERIAL_UV_SPHERICAL\n"
+        "#define MATERIAL_OBJECT_BOUNDS\n"
+        "#define MATERIAL_LIGHTING_LAMBERT\n");
+    per_pixel[BUNNY] = ShaderVariants_Get(
+        "#define MATERIAL_TEXTURE_ARRAY\n"
+        "#define MATERIAL_UV_PLANAR_XY\n"
+        "#define MATERIAL_OBJECT_BOUNDS\n"
+        "#define MATERIAL_LIGHTING_LAMBERT\n");
+    per_pixel[PLATFORM] = ShaderVariants_Get(
+        "#define MATERIAL_TEXTURE_TERRAIN\n"
+        "#define MATERIAL_OBJECT_BOUNDS\n"
+        "#define MATERIAL_LIGHTING_LAMBERT\n");
+    per_pixel[BIRD] = ShaderVariants_Get(bird_material);
+    per_pixel[CHARACTER] = ShaderVariants_Get(
+        "#define MATERIAL_TEXTURE_ARRAY\n"
+        "#define MATERIAL_UV_TEXCOORDS\n"
+        "#define MATERIAL_ARRAY_LAYER float(part)\n"
+        "#define MATERIAL_LIGHTING_LAMBERT\n");
+    per_pixel[VOXEL] = ShaderVariants_Get(
+        "#define MATERIAL_TEXTURE_VOXEL\n"
+        "#define MATERIAL_LIGHTING_LAMBERT\n");
+    per_pixel[-1] = ShaderVariants_Get(default_material);
+
+    // Iluminação por vértice, para objetos pequenos na tela (veja
+    // "lighting_lod.cpp"). Somente materiais de cor constante têm esta
+    // variante; os demais já usam Lambert, cujo custo por fragmento é
+    // dominado pela leitura das texturas.
+    const char* gouraud_vertex = "../../src/shader_vertex_gouraud.glsl";
+    const char* gouraud_fragment = "../../src/shader_fragment_gouraud.glsl";
+    per_vertex[BIRD] = ShaderVariants_Get(bird_material, gouraud_vertex, gouraud_fragment);
+    per_vertex[-1] = ShaderVariants_Get(default_material, gouraud_vertex, gouraud_fragment);
+
+    // Impostores dos pássaros distantes e o programa que desenha o seu
+    // atlas, com o mesmo material (veja "impostors.cpp").
+    if ( g_Impostors.enabled )
+    {
+        per_pixel[BIRD_IMPOSTOR] = ShaderVariants_Get(bird_material, IMPOSTOR_VERTEX_FILE, IMPOSTOR_FRAGMENT_FILE);
+        g_Impostors.bake_variant = ShaderVariants_Get(bird_material + "#define IMPOSTOR_BAKE\n", IMPOSTOR_VERTEX_FILE, IMPOSTOR_FRAGMENT_FILE);
+    }
+
+    // Programa que desenha as partículas (veja "particles.cpp").
+    if ( g_Particles.enabled )
+        g_Particles.render_variant = ShaderVariants_Get("", PARTICLE_VERTEX_FILE, PARTICLE_FRAGMENT_FILE);
+
+    // Programa dos mapas de sombra (veja "shadow_maps.cpp").
+    ShadowMaps_LoadProgram();
+
+    // Programas do "depth prepass" e da visualização de overdraw da fila de
+    // renderização (veja "render_queue.cpp"). Usam o mesmo vertex shader
+    // dos materiais, então a profundidade é idêntica.
+    const char* depth_fragment = "../../src/shader_fragment_depth.glsl";
+    const char* overdraw_fragment = "../../src/shader_fragment_overdraw.glsl";
+    g_RenderQueue.order.depth_program = g_ShaderVariants.variants[ShaderVariants_Get("", SHADER_VARIANT_VERTEX_FILE, depth_fragment)].render_program;
+    g_RenderQueue.order.overdraw_program = g_ShaderVariants.variants[ShaderVariants_Get("", SHADER_VARIANT_VERTEX_FILE, overdraw_fragment)].render_program;
+    g_RenderQueue.order.overdraw_sky_program = g_ShaderVariants.variants[ShaderVariants_Get("", "../../src/shader_vertex_skybox.glsl", overdraw_fragment)].render_program;
+
+    // Variáveis em "shader_fragment.glsl" para acesso das imagens de
+    // textura. Variantes que não usam uma textura não declaram o sampler, e
+    // glGetUniformLocation() retorna -1, que é ignorado por glUniform1i().
+    for (size_t i = 0; i < g_ShaderVariants.variants.size(); ++i)
+    {
+        GLuint program_id = g_ShaderVariants.variants[i].program_id;
+        glUseProgram(program_id);
+        glUniform1i(glGetUniformLocation(program_id, "TextureImageMario"), 0);
+        glUniform1i(glGetUniformLocation(program_id, "TextureImageGrass"), 1);
+        glUniform1i(glGetUniformLocation(program_id, "TextureImageGrassSide"), 2);
+        glUniform1i(glGetUniformLocation(program_id, "TextureImageDirt"), 3);
+        glUniform1i(glGetUniformLocation(program_id, "bird_paths"), BIRD_PATH_TEXTURE_UNIT);
+        glUniform1i(glGetUniformLocation(program_id, "cluster_grid_lights"), CLUSTER_GRID_TEXTURE_UNIT);
+        glUniform1i(glGetUniformLocation(program_id, "cluster_light_indices"), CLUSTER_INDEX_TEXTURE_UNIT);
+        glUniform1i(glGetUniformLocation(program_id, "cluster_lights"), CLUSTER_LIGHTS_TEXTURE_UNIT);
+        glUniform1i(glGetUniformLocation(program_id, "shadow_map"), SHADOW_MAP_TEXTURE_UNIT);
+        Impostors_SetUniforms(program_id);
+    }
+
+    ShaderVariants_PrintReport();
 
-    // Buscamos o endereço das variáveis definidas dentro do Vertex Shader.
-    // Utilizaremos estas variáveis para enviar dados para a placa de vídeo
-    // (GPU)! Veja arquivo "shader_vertex.glsl" e "shader_fragment.glsl".
-    g_model_uniform_gouraud      = glGetUniformLocation(g_GpuProgramID_gouraud, "model"); // Variável da matriz "model"
-    g_view_uniform_gouraud       = glGetUniformLocation(g_GpuProgramID_gouraud, "view"); // Variável da matriz "view" em shader_vertex.glsl
-    g_projection_uniform_gouraud = glGetUniformLocation(g_GpuProgramID_gouraud, "projection"); // Variável da matriz "projection" em shader_vertex.glsl
-    g_object_id_uniform_gouraud  = glGetUniformLocation(g_GpuProgramID_gouraud, "object_id"); // Variável "object_id" em shader_fragment.glsl
-    g_bbox_min_uniform_gouraud   = glGetUniformLocation(g_GpuProgramID_gouraud, "bbox_min");
-    g_bbox_max_uniform_gouraud   = glGetUniformLocation(g_GpuProgramID_gouraud, "bbox_max");
+    UseMaterialProgram(-1);
+    glUseProgram(0);
+}
 
-    // Variáveis em "shader_fragment.glsl" para acesso das imagens de textura
-    glUseProgram(g_GpuProgramID);
+// Retorna a variante de shader do material "object_id" (ou do material
+// padrão, para objetos sem material próprio) para o nível de iluminação
+// dado. Se o material não tem variante para o nível, usa a por fragmento.
+const ShaderVariant& MaterialVariant(int object_id, LightingLevel lighting)
+{
+    const std::map<int, int>& per_pixel = g_MaterialVariants[LIGHTING_PER_PIXEL];
+    int material = per_pixel.count(object_id) ? object_id : -1;
 
-    
-    // Phong
-    // ###############################
+    if ( lighting != LIGHTING_PER_PIXEL )
+    {
+        std::map<int, int>::const_iterator found = g_MaterialVariants[lighting].find(material);
+        if ( found != g_MaterialVariants[lighting].end() )
+            return g_ShaderVariants.variants[found->second];
+    }
+
+    return g_ShaderVariants.variants[per_pixel.find(material)->second];
+}
 
-    // Criamos um programa de GPU utilizando os shaders carregados acima.
-    g_GpuProgramID = CreateGpuProgram(vertex_shader_id, fragment_shader_id);
+int MaterialRenderProgram(int object_id, LightingLevel lighting)
+{
+    return MaterialVariant(object_id, lighting).render_program;
+}
+
+// Escolhe o nível de iluminação de um objeto com LightingLod_Select(), ou
+// LIGHTING_PER_PIXEL se o material não tem variante por vértice.
+LightingLevel MaterialLightingLevel(int object_id, uint64_t lod_key, const glm::vec4& center, float radius)
+{
+    const std::map<int, int>& per_vertex = g_MaterialVariants[LIGHTING_PER_VERTEX];
+    int material = g_MaterialVariants[LIGHTING_PER_PIXEL].count(object_id) ? object_id : -1;
+    if ( per_vertex.find(material) == per_vertex.end() )
+        return LIGHTING_PER_PIXEL;
 
-    // Buscamos o endereço das variáveis definidas dentro do Vertex Shader.
-    // Utilizaremos estas variáveis para enviar dados para a placa de vídeo
-    // (GPU)! Veja arquivo "shader_vertex.glsl" e "shader_fragment.glsl".
-    g_model_uniform      = glGetUniformLocation(g_GpuProgramID, "model"); // Variável da matriz "model"
-    g_view_uniform       = glGetUniformLocation(g_GpuProgramID, "view"); // Variável da matriz "view" em shader_vertex.glsl
-    g_projection_uniform = glGetUniformLocation(g_GpuProgramID, "projection"); // Variável da matriz "projection" em shader_vertex.glsl
-    g_object_id_uniform  = glGetUniformLocation(g_GpuProgramID, "object_id"); // Variável "object_id" em shader_fragment.glsl
-    g_bbox_min_uniform   = glGetUniformLocation(g_GpuProgramID, "bbox_min");
-    g_bbox_max_uniform   = glGetUniformLocation(g_GpuProgramID, "bbox_max");
+    return LightingLod_Select(lod_key, center, radius);
+}
 
-    // Variáveis em "shader_fragment.glsl" para acesso das imagens de textura
+// Ativa uma variante de shader e atualiza g_GpuProgramID e os uniforms
+// utilizados pelas funções de desenho imediato.
+void UseShaderVariant(const ShaderVariant& variant)
+{
+    g_GpuProgramID       = variant.program_id;
+    g_model_uniform      = variant.model_uniform;
+    g_normal_matrix_uniform = variant.normal_matrix_uniform;
+    g_model_view_projection_uniform = variant.model_view_projection_uniform;
+    g_bbox_min_uniform   = variant.bbox_min_uniform;
+    g_bbox_max_uniform   = variant.bbox_max_uniform;
+    g_instanced_uniform  = variant.instanced_uniform;
     glUseProgram(g_GpuProgramID);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "TextureImage0"), 0);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "TextureImage1"), 1);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "TextureImage2"), 2);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "TextureImage3"), 3);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "TextureImage4"), 4);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "TextureImage5"), 5);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "TextureImage6"), 6);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "TextureImage7"), 7);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "TextureImageGrass"), 8);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "TextureImageGrassSide"), 9);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "TextureImageDirt"), 10);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "TextureImageBlueBird"), 11);
+}
 
+// Ativa a variante do material "object_id" (veja UseShaderVariant()).
+void UseMaterialProgram(int object_id)
+{
+    UseShaderVariant(MaterialVariant(object_id));
+}
 
+// Envia a matriz de modelagem para o programa ativo, junto com a matriz de
+// normais e a matriz model-view-projection (com a view_projection do quadro
+// atual, em g_FrameConstants). Equivalente, no desenho imediato, ao que
+// RenderState_SetUniforms() faz para a fila de renderização.
+void SetModelMatrixUniforms(const glm::mat4& model)
+{
+    glm::mat3 normal_matrix = glm::transpose(glm::inverse(glm::mat3(model)));
+    glm::mat4 model_view_projection = g_FrameConstants.current.view_projection * model;
 
-    glUseProgram(0);
+    glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
+    glUniformMatrix3fv(g_normal_matrix_uniform, 1 , GL_FALSE , glm::value_ptr(normal_matrix));
+    glUniformMatrix4fv(g_model_view_projection_uniform, 1 , GL_FALSE , glm::value_ptr(model_view_projection));
 }
 
 // Função que pega a matriz M e guarda a mesma no topo da pilha
@@ -1257,6 +2926,7 @@ void BuildTrianglesAndAddToVirtualScene(ObjModel* model)
     std::vector<float>  model_coefficients;
     std::vector<float>  normal_coefficients;
     std::vector<float>  texture_coefficients;
+    std::vector<float>  part_coefficients; // Índice da shape de cada vértice
 
     for (size_t shape = 0; shape < model->shapes.size(); ++shape)
     {
@@ -1288,6 +2958,8 @@ void BuildTrianglesAndAddToVirtualScene(ObjModel* model)
                 model_coefficients.push_back( vz ); // Z
                 model_coefficients.push_back( 1.0f ); // W
 
+                part_coefficients.push_back( (float)shape );
+
                 bbox_min.x = std::min(bbox_min.x, vx);
                 bbox_min.y = std::min(bbox_min.y, vy);
                 bbox_min.z = std::min(bbox_min.z, vz);
@@ -1350,6 +3022,12 @@ void BuildTrianglesAndAddToVirtualScene(ObjModel* model)
     GLint  number_of_dimensions = 4; // vec4 em "shader_vertex.glsl"
     glVertexAttribPointer(location, number_of_dimensions, GL_FLOAT, GL_FALSE, 0, 0);
     glEnableVertexAttribArray(location);
+    // Para objetos comuns, a posição no espaço do modelo ("(location = 3)" em
+    // "shader_vertex.glsl") é a própria posição do vértice. Somente malhas já
+    // transformadas para coordenadas globais (veja "world_streaming.cpp")
+    // fornecem as duas separadamente.
+    glVertexAttribPointer(3, number_of_dimensions, GL_FLOAT, GL_FALSE, 0, 0);
+    glEnableVertexAttribArray(3);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
 
     if ( !normal_coefficients.empty() )
@@ -1381,6 +3059,17 @@ void BuildTrianglesAndAddToVirtualScene(ObjModel* model)
         glBindBuffer(GL_ARRAY_BUFFER, 0);
     }
 
+    // Índice da parte (shape) de cada vértice, utilizado quando várias
+    // partes são desenhadas juntas (veja AddMultiDrawObject()).
+    GLuint VBO_part_coefficients_id;
+    glGenBuffers(1, &VBO_part_coefficients_id);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO_part_coefficients_id);
+    glBufferData(GL_ARRAY_BUFFER, part_coefficients.size() * sizeof(float), part_coefficients.data(), GL_STATIC_DRAW);
+    location = 10; // "(location = 10)" em "shader_vertex.glsl"
+    glVertexAttribPointer(location, 1, GL_FLOAT, GL_FALSE, 0, 0);
+    glEnableVertexAttribArray(location);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
     GLuint indices_id;
     glGenBuffers(1, &indices_id);
 
@@ -1396,15 +3085,104 @@ void BuildTrianglesAndAddToVirtualScene(ObjModel* model)
     glBindVertexArray(0);
 }
 
+// Retorna os vértices de todos os triângulos de um ObjModel, em coordenadas do
+// modelo, na ordem em que aparecem (3 vértices consecutivos por triângulo).
+// Se shape_name != NULL, somente os triângulos do objeto com este nome.
+// Utilizada para geometria processada na CPU, como os oclusores em software.
+std::vector<glm::vec4> GetTriangleVertices(ObjModel* model, const char* shape_name)
+{
+    std::vector<glm::vec4> vertices;
+
+    for (size_t shape = 0; shape < model->shapes.size(); ++shape)
+    {
+        if ( shape_name != NULL && model->shapes[shape].name != shape_name )
+            continue;
+
+        const std::vector<tinyobj::index_t>& indices = model->shapes[shape].mesh.indices;
+        for (size_t i = 0; i < indices.size(); ++i)
+        {
+            int vertex_index = indices[i].vertex_index;
+            vertices.push_back(glm::vec4(model->attrib.vertices[3*vertex_index + 0],
+                                         model->attrib.vertices[3*vertex_index + 1],
+                                         model->attrib.vertices[3*vertex_index + 2],
+                                         1.0f));
+        }
+    }
+
+    return vertices;
+}
+
+// Retorna posição, normal e coordenadas de textura de cada vértice dos
+// triângulos de um objeto do ObjModel (3 vértices consecutivos por triângulo).
+// Utilizada pelas threads de carregamento do streaming do mundo.
+WorldObjectGeometry GetWorldObjectGeometry(ObjModel* model, const char* shape_name)
+{
+    WorldObjectGeometry geometry;
+
+    // Cantos de triângulos com a mesma posição, normal e coordenada de
+    // textura no ".obj" são o mesmo vértice; cada combinação é incluída uma
+    // única vez e referenciada pelos índices.
+    std::map<std::tuple<int, int, int>, GLuint> unique_vertices;
+
+    for (size_t shape = 0; shape < model->shapes.size(); ++shape)
+    {
+        if ( model->shapes[shape].name != shape_name )
+            continue;
+
+        const std::vector<tinyobj::index_t>& indices = model->shapes[shape].mesh.indices;
+        for (size_t i = 0; i < indices.size(); ++i)
+        {
+            const tinyobj::index_t& idx = indices[i];
+            std::tuple<int, int, int> key = std::make_tuple(idx.vertex_index, idx.normal_index, idx.texcoord_index);
+            std::map<std::tuple<int, int, int>, GLuint>::iterator found = unique_vertices.find(key);
+            if ( found != unique_vertices.end() )
+            {
+                geometry.indices.push_back(found->second);
+                continue;
+            }
+
+            GLuint index = (GLuint)geometry.positions.size();
+            unique_vertices[key] = index;
+            geometry.indices.push_back(index);
+
+            geometry.positions.push_back(glm::vec4(model->attrib.vertices[3*idx.vertex_index + 0],
+                                                   model->attrib.vertices[3*idx.vertex_index + 1],
+                                                   model->attrib.vertices[3*idx.vertex_index + 2],
+                                                   1.0f));
+
+            glm::vec4 normal = glm::vec4(0.0f, 0.0f, 0.0f, 0.0f);
+            if ( idx.normal_index != -1 )
+                normal = glm::vec4(model->attrib.normals[3*idx.normal_index + 0],
+                                   model->attrib.normals[3*idx.normal_index + 1],
+                                   model->attrib.normals[3*idx.normal_index + 2],
+                                   0.0f);
+            geometry.normals.push_back(normal);
+
+            glm::vec2 texcoord = glm::vec2(0.0f, 0.0f);
+            if ( idx.texcoord_index != -1 )
+                texcoord = glm::vec2(model->attrib.texcoords[2*idx.texcoord_index + 0],
+                                     model->attrib.texcoords[2*idx.texcoord_index + 1]);
+            geometry.texcoords.push_back(texcoord);
+        }
+    }
+
+    return geometry;
+}
+
 // Carrega um Vertex Shader de um arquivo GLSL. Veja definição de LoadShader() abaixo.
 GLuint LoadShader_Vertex(const char* filename)
+{
+    return LoadShader_Vertex(filename, "");
+}
+
+GLuint LoadShader_Vertex(const char* filename, const std::string& defines)
 {
     // Criamos um identificador (ID) para este shader, informando que o mesmo
     // será aplicado nos vértices.
     GLuint vertex_shader_id = glCreateShader(GL_VERTEX_SHADER);
 
     // Carregamos e compilamos o shader
-    LoadShader(filename, vertex_shader_id);
+    LoadShader(filename, vertex_shader_id, defines);
 
     // Retorna o ID gerado acima
     return vertex_shader_id;
@@ -1412,21 +3190,70 @@ GLuint LoadShader_Vertex(const char* filename)
 
 // Carrega um Fragment Shader de um arquivo GLSL . Veja definição de LoadShader() abaixo.
 GLuint LoadShader_Fragment(const char* filename)
+{
+    return LoadShader_Fragment(filename, "");
+}
+
+GLuint LoadShader_Fragment(const char* filename, const std::string& defines)
 {
     // Criamos um identificador (ID) para este shader, informando que o mesmo
     // será aplicado nos fragmentos.
     GLuint fragment_shader_id = glCreateShader(GL_FRAGMENT_SHADER);
 
     // Carregamos e compilamos o shader
-    LoadShader(filename, fragment_shader_id);
+    LoadShader(filename, fragment_shader_id, defines);
 
     // Retorna o ID gerado acima
     return fragment_shader_id;
 }
 
-// Função auxilar, utilizada pelas duas funções acima. Carrega código de GPU de
-// um arquivo GLSL e faz sua compilação.
-void LoadShader(const char* filename, GLuint shader_id)
+// Substitui cada linha '#include "arquivo"' de um shader pelo conteúdo do
+// arquivo, lido do mesmo diretório. Assim como os "#define"s injetados por
+// LoadShader(), o texto é inserido antes da compilação; trechos comuns a
+// vários shaders (por exemplo, "shader_bird_path.glsl") ficam em um único
+// arquivo. Após cada trecho, "#line" restaura a numeração do arquivo
+// original nas mensagens de erro.
+static std::string ExpandShaderIncludes(const char* filename, const std::string& source)
+{
+    std::string directory = filename;
+    directory = directory.substr(0, directory.find_last_of('/') + 1);
+
+    std::istringstream lines(source);
+    std::string result;
+    std::string line;
+    int line_number = 0;
+    while (std::getline(lines, line))
+    {
+        line_number += 1;
+
+        size_t quote = line.find('"');
+        if ( line.compare(0, 8, "#include") != 0 || quote == std::string::npos )
+        {
+            result += line + "\n";
+            continue;
+        }
+
+        std::string included = directory + line.substr(quote + 1, line.find('"', quote + 1) - quote - 1);
+        std::ifstream file(included.c_str());
+        if ( !file )
+        {
+            fprintf(stderr, "ERROR: Cannot open file \"%s\" included by \"%s\".\n", included.c_str(), filename);
+            std::exit(EXIT_FAILURE);
+        }
+        std::stringstream content;
+        content << file.rdbuf();
+        result += content.str();
+        result += "\n#line " + std::to_string(line_number + 1) + "\n";
+    }
+    return result;
+}
+
+// Função auxilar, utilizada pelas funções acima. Carrega código de GPU de
+// um arquivo GLSL e faz sua compilação. O texto "defines" (linhas
+// "#define ...") é inserido logo após a diretiva "#version", que precisa
+// ser a primeira do arquivo; "#line 2" mantém os números de linha das
+// mensagens de erro iguais aos do arquivo.
+void LoadShader(const char* filename, GLuint shader_id, const std::string& defines)
 {
     // Lemos o arquivo de texto indicado pela variável "filename"
     // e colocamos seu conteúdo em memória, apontado pela variável
@@ -1441,7 +3268,18 @@ void LoadShader(const char* filename, GLuint shader_id)
     }
     std::stringstream shader;
     shader << file.rdbuf();
-    std::string str = shader.str();
+    std::string str = ExpandShaderIncludes(filename, shader.str());
+    if ( !defines.empty() )
+    {
+        size_t version = str.find("#version");
+        size_t end_of_line = (version == std::string::npos) ? std::string::npos : str.find('\n', version);
+        if ( end_of_line == std::string::npos )
+        {
+            fprintf(stderr, "ERROR: Shader \"%s\" has no \"#version\" line to insert defines after.\n", filename);
+            std::exit(EXIT_FAILURE);
+        }
+        str.insert(end_of_line + 1, defines + "#line 2\n");
+    }
     const GLchar* shader_string = str.c_str();
     const GLint   shader_string_length = static_cast<GLint>( str.length() );
 
@@ -1815,10 +3653,68 @@ void KeyCallback(GLFWwindow* window, int key, int scancode, int action, int mod)
         g_ShowInfoText = !g_ShowInfoText;
     }
 
+    // Se o usuário apertar a tecla F1, ligamos/desligamos o culling por oclusão.
+    if (key == GLFW_KEY_F1 && action == GLFW_PRESS)
+    {
+        OcclusionCulling_Toggle();
+        fprintf(stdout,"Culling por oclusao: %s\n", g_OcclusionCulling.enabled ? "ligado" : "desligado");
+        fflush(stdout);
+    }
+
+    // Se o usuário apertar a tecla F2, ligamos/desligamos o culling por oclusão em software.
+    if (key == GLFW_KEY_F2 && action == GLFW_PRESS)
+    {
+        g_SoftwareOcclusion.enabled = !g_SoftwareOcclusion.enabled;
+        fprintf(stdout,"Culling por oclusao em software: %s\n", g_SoftwareOcclusion.enabled ? "ligado" : "desligado");
+        fflush(stdout);
+    }
+
+    // Se o usuário apertar a tecla F3, ligamos/desligamos o LOD de iluminação.
+    if (key == GLFW_KEY_F3 && action == GLFW_PRESS)
+    {
+        g_LightingLod.enabled = !g_LightingLod.enabled;
+        fprintf(stdout,"LOD de iluminacao: %s\n", g_LightingLod.enabled ? "ligado" : "desligado");
+        fflush(stdout);
+    }
+
+    // Se o usuário apertar a tecla F4, ligamos/desligamos as sombras.
+    if (key == GLFW_KEY_F4 && action == GLFW_PRESS)
+    {
+        g_ShadowMaps.enabled = !g_ShadowMaps.enabled;
+        fprintf(stdout,"Sombras: %s\n", g_ShadowMaps.enabled ? "ligadas" : "desligadas");
+        fflush(stdout);
+    }
+
+    // Teclas F5 a F8: ordem dos passos da fila de renderização (veja
+    // "render_queue.cpp"). F5 liga/desliga a visualização de overdraw, F6 o
+    // "depth prepass", F7 a ordenação da frente para trás e F8 o skybox por
+    // último.
+    if (key == GLFW_KEY_F5 && action == GLFW_PRESS)
+        g_RenderQueue.order.overdraw_view = !g_RenderQueue.order.overdraw_view;
+    if (key == GLFW_KEY_F6 && action == GLFW_PRESS)
+        g_RenderQueue.order.depth_prepass = !g_RenderQueue.order.depth_prepass;
+    if (key == GLFW_KEY_F7 && action == GLFW_PRESS)
+        g_RenderQueue.order.front_to_back = !g_RenderQueue.order.front_to_back;
+    if (key == GLFW_KEY_F8 && action == GLFW_PRESS)
+        g_RenderQueue.order.sky_last = !g_RenderQueue.order.sky_last;
+
+    // Se o usuário apertar a tecla F9, ligamos/desligamos a resolução
+    // dinâmica (veja "dynamic_resolution.cpp").
+    if (key == GLFW_KEY_F9 && action == GLFW_PRESS)
+        g_DynamicResolution.enabled = !g_DynamicResolution.enabled;
+
+    // Se o usuário apertar a tecla B, removemos o bloco do terreno em voxels
+    // para o qual a câmera aponta; com a tecla N, colocamos um bloco.
+    if (key == GLFW_KEY_B && action == GLFW_PRESS)
+        g_VoxelEditRequest = VOXEL_EDIT_REMOVE;
+    if (key == GLFW_KEY_N && action == GLFW_PRESS)
+        g_VoxelEditRequest = VOXEL_EDIT_PLACE;
+
     // Se o usuário apertar a tecla R, recarregamos os shaders dos arquivos "shader_fragment.glsl" e "shader_vertex.glsl".
     if (key == GLFW_KEY_R && action == GLFW_PRESS)
     {
         LoadShadersFromFiles();
+        OcclusionCulling_Init();
         fprintf(stdout,"Shaders recarregados!\n");
         fflush(stdout);
     }
@@ -1931,7 +3827,7 @@ void TextRendering_ShowFramesPerSecond(GLFWwindow* window)
 
     // Variáveis estáticas (static) mantém seus valores entre chamadas
     // subsequentes da função!
-    static float old_seconds = (float)glfwGetTime();
+    static float old_seconds = (float)Headless_GetTime();
     static int   ellapsed_frames = 0;
     static char  buffer[20] = "?? fps";
     static int   numchars = 7;
@@ -1939,7 +3835,7 @@ void TextRendering_ShowFramesPerSecond(GLFWwindow* window)
     ellapsed_frames += 1;
 
     // Recuperamos o número de segundos que passou desde a execução do programa
-    float seconds = (float)glfwGetTime();
+    float seconds = (float)Headless_GetTime();
 
     // Número de segundos desde o último cálculo do fps
     float ellapsed_seconds = seconds - old_seconds;
@@ -1958,6 +3854,317 @@ void TextRendering_ShowFramesPerSecond(GLFWwindow* window)
     TextRendering_PrintString(window, buffer, 1.0f-(numchars + 1)*charwidth, 1.0f-lineheight, 1.0f);
 }
 
+// Escrevemos na tela quantos objetos foram testados pelo culling por oclusão,
+// quantos desenhos foram evitados e quantas consultas foram emitidas.
+void TextRendering_ShowOcclusionStats(GLFWwindow* window)
+{
+    if ( !g_ShowInfoText )
+        return;
+
+    float lineheight = TextRendering_LineHeight(window);
+
+    char buffer[80];
+    if ( g_OcclusionCulling.enabled )
+        snprintf(buffer, 80, "Occlusion [F1]: %d tested, %d skipped, %d queries",
+                 g_OcclusionCulling.objects_tested, g_OcclusionCulling.draws_skipped, g_OcclusionCulling.queries_issued);
+    else
+        snprintf(buffer, 80, "Occlusion [F1]: off");
+
+    TextRendering_PrintString(window, buffer, -1.0f+lineheight/10, 1.0f-lineheight, 1.0f);
+}
+
+// Escrevemos na tela o tempo gasto rasterizando os oclusores e testando
+// objetos no culling por oclusão em software.
+void TextRendering_ShowSoftwareOcclusionStats(GLFWwindow* window)
+{
+    if ( !g_ShowInfoText )
+        return;
+
+    float lineheight = TextRendering_LineHeight(window);
+
+    char buffer[100];
+    if ( g_SoftwareOcclusion.enabled )
+        snprintf(buffer, 100, "SW occlusion [F2]: %d tris %.3f ms, %d tested %d culled %.3f ms",
+                 g_SoftwareOcclusion.triangles_rasterized, g_SoftwareOcclusion.raster_ms,
+                 g_SoftwareOcclusion.objects_tested, g_SoftwareOcclusion.objects_culled, g_SoftwareOcclusion.test_ms);
+    else
+        snprintf(buffer, 100, "SW occlusion [F2]: off");
+
+    TextRendering_PrintString(window, buffer, -1.0f+lineheight/10, 1.0f-2*lineheight, 1.0f);
+}
+
+// Escrevemos na tela o tamanho da cena carregada, para acompanhar o custo
+// de cada quadro conforme a cena cresce.
+void TextRendering_ShowSceneStats(GLFWwindow* window, int num_instances, int num_projectiles)
+{
+    if ( !g_ShowInfoText )
+        return;
+
+    float lineheight = TextRendering_LineHeight(window);
+
+    char buffer[100];
+    snprintf(buffer, 100, "Scene: %d instances, %d birds, %d colliders, %d projectiles",
+             num_instances, n_passaros, (int)g_Scene.colliders.size(), num_projectiles);
+
+    TextRendering_PrintString(window, buffer, -1.0f+lineheight/10, 1.0f-3*lineheight, 1.0f);
+}
+
+// Escrevemos na tela quantos chunks do mundo estão residentes e quanto foi
+// enviado à GPU neste quadro.
+void TextRendering_ShowStreamingStats(GLFWwindow* window)
+{
+    if ( !g_ShowInfoText )
+        return;
+
+    float lineheight = TextRendering_LineHeight(window);
+
+    char buffer[140];
+    snprintf(buffer, 140, "Streaming: %d/%d chunks (%d loading), %d instances in %d draws, %.1f MB GPU, %d uploads %.0f KB",
+             g_WorldStreaming.chunks_resident, (int)g_WorldStreaming.chunks.size(), g_WorldStreaming.chunks_loading,
+             g_WorldStreaming.instances_resident, g_WorldStreaming.batches_resident,
+             g_WorldStreaming.gpu_bytes_resident / (1024.0f*1024.0f),
+             g_WorldStreaming.uploads_this_frame, g_WorldStreaming.bytes_uploaded_this_frame / 1024.0f);
+
+    TextRendering_PrintString(window, buffer, -1.0f+lineheight/10, 1.0f-4*lineheight, 1.0f);
+}
+
+// Escrevemos na tela o tamanho das malhas do terreno em voxels e o custo da
+// última reconstrução de malhas.
+void TextRendering_ShowVoxelStats(GLFWwindow* window)
+{
+    if ( !g_ShowInfoText || !g_VoxelWorld.enabled )
+        return;
+
+    float lineheight = TextRendering_LineHeight(window);
+
+    char buffer[100];
+    snprintf(buffer, 100, "Voxels [B/N]: %d quads, %d draws, last remesh %.2f ms",
+             g_VoxelWorld.quads, g_VoxelWorld.draw_calls, g_VoxelWorld.remesh_ms);
+
+    TextRendering_PrintString(window, buffer, -1.0f+lineheight/10, 1.0f-5*lineheight, 1.0f);
+}
+
+// Escrevemos na tela quantas chamadas de desenho a fila de renderização
+// emitiu e quantas trocas de estado foram emitidas ou descartadas pelo cache.
+void TextRendering_ShowRenderQueueStats(GLFWwindow* window)
+{
+    if ( !g_ShowInfoText )
+        return;
+
+    float lineheight = TextRendering_LineHeight(window);
+
+    char buffer[160];
+    snprintf(buffer, 160, "Render queue: %d packets, %d state changes, %d elided, %d frustum-culled, %d lists",
+             g_RenderQueue.draw_calls, g_RenderQueue.state_changes, g_RenderQueue.state_elided,
+             g_RenderQueue.frustum_culled, g_RenderQueue.lists_merged);
+
+    TextRendering_PrintString(window, buffer, -1.0f+lineheight/10, 1.0f-6*lineheight, 1.0f);
+}
+
+// Escrevemos na tela quantos objetos usaram cada nível de iluminação.
+void TextRendering_ShowLightingLodStats(GLFWwindow* window)
+{
+    if ( !g_ShowInfoText )
+        return;
+
+    float lineheight = TextRendering_LineHeight(window);
+
+    char buffer[100];
+    if ( g_LightingLod.enabled )
+        snprintf(buffer, 100, "Lighting LOD [F3]: %d per-pixel, %d per-vertex (< %.0f%% of screen)",
+                 g_LightingLod.per_pixel, g_LightingLod.per_vertex, 100.0f * g_LightingLod.min_screen_size);
+    else
+        snprintf(buffer, 100, "Lighting LOD [F3]: off");
+
+    TextRendering_PrintString(window, buffer, -1.0f+lineheight/10, 1.0f-7*lineheight, 1.0f);
+}
+
+// Escrevemos na tela quantas luzes pontuais foram distribuídas nos clusters.
+void TextRendering_ShowClusteredLightingStats(GLFWwindow* window)
+{
+    if ( !g_ShowInfoText )
+        return;
+
+    float lineheight = TextRendering_LineHeight(window);
+
+    char buffer[100];
+    snprintf(buffer, 100, "Lights: %d/%d visible, max %d per cluster, %d overflows, %.2f ms",
+             g_ClusteredLighting.visible_lights, (int)g_ClusteredLighting.lights.size(),
+             g_ClusteredLighting.max_cluster_lights, g_ClusteredLighting.overflows, g_ClusteredLighting.assign_ms);
+
+    TextRendering_PrintString(window, buffer, -1.0f+lineheight/10, 1.0f-8*lineheight, 1.0f);
+}
+
+// Escrevemos na tela o tempo de GPU de cada cascata de sombra: redesenho
+// da parte estática (somente quando a cobertura muda) + objetos dinâmicos.
+void TextRendering_ShowShadowStats(GLFWwindow* window)
+{
+    if ( !g_ShowInfoText )
+        return;
+
+    float lineheight = TextRendering_LineHeight(window);
+
+    char buffer[160];
+    if ( g_ShadowMaps.enabled )
+    {
+        int n = snprintf(buffer, 160, "Shadows [F4]: %d/%d static redrawn (%d total), %d dynamic, ms:",
+                         g_ShadowMaps.static_renders, SHADOW_CASCADE_COUNT, g_ShadowMaps.static_renders_total, g_ShadowMaps.dynamic_casters);
+        for (int c = 0; c < SHADOW_CASCADE_COUNT && n < 160; ++c)
+            n += snprintf(buffer + n, 160 - n, " %.2f+%.2f", g_ShadowMaps.static_ms[c], g_ShadowMaps.dynamic_ms[c]);
+    }
+    else
+        snprintf(buffer, 160, "Shadows [F4]: off");
+
+    TextRendering_PrintString(window, buffer, -1.0f+lineheight/10, 1.0f-9*lineheight, 1.0f);
+}
+
+// Escrevemos na tela a ordem dos passos e quantos fragmentos foram
+// sombreados, em média, por pixel da tela.
+void TextRendering_ShowPassOrderStats(GLFWwindow* window)
+{
+    if ( !g_ShowInfoText )
+        return;
+
+    float lineheight = TextRendering_LineHeight(window);
+    const RenderPassOrder& order = g_RenderQueue.order;
+
+    char buffer[160];
+    snprintf(buffer, 160, "Passes: %s, %s, %s, %s [F5-F8]: %.2f shaded fragments/pixel",
+             order.overdraw_view ? "overdraw view" : "shaded",
+             order.depth_prepass ? "depth prepass" : "no prepass",
+             order.front_to_back ? "front-to-back" : "by state",
+             order.sky_last ? "sky last" : "sky first",
+             g_RenderQueue.shaded_per_pixel);
+
+    TextRendering_PrintString(window, buffer, -1.0f+lineheight/10, 1.0f-10*lineheight, 1.0f);
+}
+
+// Escrevemos na tela o tempo de GPU de cada passo, em milissegundos, médio
+// do último segundo (veja "gpu_timers.cpp").
+void TextRendering_ShowGpuTimerStats(GLFWwindow* window)
+{
+    if ( !g_ShowInfoText )
+        return;
+
+    float lineheight = TextRendering_LineHeight(window);
+
+    char buffer[256];
+    if ( g_GpuTimers.enabled )
+    {
+        int n = snprintf(buffer, 256, "GPU ms:");
+        for (int p = 0; p < GPU_TIMER_COUNT && n < 256; ++p)
+            n += snprintf(buffer + n, 256 - n, " %s %.2f", g_GpuTimerNames[p], g_GpuTimers.average_ms[p]);
+        if ( n < 256 )
+            snprintf(buffer + n, 256 - n, ", total %.2f", g_GpuTimers.average_total_ms);
+    }
+    else
+        snprintf(buffer, 256, "GPU ms: unavailable");
+
+    TextRendering_PrintString(window, buffer, -1.0f+lineheight/10, 1.0f-11*lineheight, 1.0f);
+}
+
+// Escrevemos na tela a escala da resolução dinâmica e a última medida de
+// tempo de GPU utilizada para escolhê-la.
+void TextRendering_ShowDynamicResolutionStats(GLFWwindow* window)
+{
+    if ( !g_ShowInfoText )
+        return;
+
+    float lineheight = TextRendering_LineHeight(window);
+    const DynamicResolution& resolution = g_DynamicResolution;
+
+    char buffer[160];
+    if ( resolution.enabled )
+        snprintf(buffer, 160, "Resolution [F9]: %.0f%% (%dx%d of %dx%d), GPU %.2f ms, budget %.2f ms",
+                 resolution.scale * 100.0f, resolution.render_width, resolution.render_height,
+                 resolution.target_width, resolution.target_height, resolution.measured_ms, resolution.budget_ms);
+    else
+        snprintf(buffer, 160, "Resolution [F9]: native");
+
+    TextRendering_PrintString(window, buffer, -1.0f+lineheight/10, 1.0f-12*lineheight, 1.0f);
+}
+
+// Escrevemos na tela o uso do buffer de streaming no último quadro. Veja o
+// arquivo "stream_buffer.cpp".
+void TextRendering_ShowStreamBufferStats(GLFWwindow* window)
+{
+    if ( !g_ShowInfoText )
+        return;
+
+    float lineheight = TextRendering_LineHeight(window);
+    const StreamBuffer& stream = g_StreamBuffer;
+
+    char buffer[160];
+    snprintf(buffer, 160, "Stream buffer (%s): %u allocs, %.1f/%d KB, %u waits, %u overflows",
+             stream.persistent ? "persistent" : "orphaning", stream.allocations, stream.frame_bytes / 1024.0,
+             STREAM_BUFFER_REGION_SIZE / 1024, stream.fence_waits, stream.overflows);
+
+    TextRendering_PrintString(window, buffer, -1.0f+lineheight/10, 1.0f-13*lineheight, 1.0f);
+}
+
+// Escrevemos na tela quantos caminhos de pássaros usam malha, impostor ou
+// ambos. Veja o arquivo "impostors.cpp".
+void TextRendering_ShowImpostorStats(GLFWwindow* window)
+{
+    if ( !g_ShowInfoText )
+        return;
+
+    float lineheight = TextRendering_LineHeight(window);
+    const Impostors& impostors = g_Impostors;
+
+    char buffer[160];
+    if ( impostors.enabled && impostors.baked && GpuCulling_Active() )
+        snprintf(buffer, 160, "Impostors: chosen per bird by GPU culling (from %.1f, blend %.1f)", impostors.distance, impostors.blend);
+    else if ( impostors.enabled && impostors.baked )
+        snprintf(buffer, 160, "Impostors: %d mesh, %d crossfade, %d impostor paths (from %.1f, blend %.1f)",
+                 impostors.mesh_paths, impostors.crossfade_paths, impostors.impostor_paths, impostors.distance, impostors.blend);
+    else
+        snprintf(buffer, 160, "Impostors: off");
+
+    TextRendering_PrintString(window, buffer, -1.0f+lineheight/10, 1.0f-14*lineheight, 1.0f);
+}
+
+// Escrevemos na tela quantos pássaros o culling na GPU selecionou para cada
+// LOD. Veja o arquivo "gpu_culling.cpp".
+void TextRendering_ShowGpuCullingStats(GLFWwindow* window)
+{
+    if ( !g_ShowInfoText )
+        return;
+
+    float lineheight = TextRendering_LineHeight(window);
+    const GpuCulling& culling = g_GpuCulling;
+
+    char buffer[160];
+    if ( GpuCulling_Active() )
+        snprintf(buffer, 160, "GPU culling: %d birds -> %d per-pixel, %d per-vertex, %d impostor (%s)",
+                 culling.instances, culling.selected[GPU_CULLING_MESH_PER_PIXEL], culling.selected[GPU_CULLING_MESH_PER_VERTEX],
+                 culling.selected[GPU_CULLING_IMPOSTOR], culling.indirect ? "indirect" : "read back");
+    else
+        snprintf(buffer, 160, "GPU culling: off");
+
+    TextRendering_PrintString(window, buffer, -1.0f+lineheight/10, 1.0f-15*lineheight, 1.0f);
+}
+
+// Escrevemos na tela o estado do sistema de partículas. Veja o arquivo
+// "particles.cpp".
+void TextRendering_ShowParticleStats(GLFWwindow* window)
+{
+    if ( !g_ShowInfoText )
+        return;
+
+    float lineheight = TextRendering_LineHeight(window);
+    const ParticleSystem& particles = g_Particles;
+
+    char buffer[160];
+    if ( Particles_Active() )
+        snprintf(buffer, 160, "Particles: %d slots, %d drawn, %s, %d emitted last frame, %ld total, %d emitters dropped",
+                 particles.capacity, particles.live, particles.active ? "simulating" : "idle", particles.emitted_frame, particles.emitted_total, particles.dropped);
+    else
+        snprintf(buffer, 160, "Particles: off");
+
+    TextRendering_PrintString(window, buffer, -1.0f+lineheight/10, 1.0f-16*lineheight, 1.0f);
+}
+
 // Função para debugging: imprime no terminal todas informações de um modelo
 // geométrico carregado de um arquivo ".obj".
 // Veja: https://github.com/syoyo/tinyobjloader/blob/22883def8db9ef1f3ffb9b404318e7dd25fdbb51/loader_example.cc#L98
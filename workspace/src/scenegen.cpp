@@ -0,0 +1,154 @@
+// Gerador de cenas sintéticas, utilizado para medir como o custo de cada
+// quadro cresce com o tamanho da cena, sem precisar recompilar o jogo.
+//
+// Uso:
+//     ./scenegen <arquivo> <plataformas> <passaros> <projeteis> [--binary] [--seed <n>] [--lights <n>]
+//
+// As plataformas são dispostas em uma grade ao redor da origem (o
+// personagem começa na plataforma central), os pássaros voam em círculos
+// sobre plataformas sorteadas e os projéteis caem sobre elas. As luzes são
+// pontuais, coloridas, logo acima de plataformas sorteadas. A cena gerada
+// é carregada com:
+//     ./main --scene <arquivo>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+
+#include "scene_file.cpp"
+
+// Dimensões do modelo "platform.obj" (veja data/platform.obj)
+static const float PLATFORM_HALF_SIZE = 10.865045f;
+static const float PLATFORM_SPACING   = 24.0f;
+
+int main(int argc, char* argv[])
+{
+    if ( argc < 5 )
+    {
+        fprintf(stderr, "Uso: %s <arquivo> <plataformas> <passaros> <projeteis> [--binary] [--seed <n>] [--lights <n>]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    const char* filename = argv[1];
+    int num_platforms   = atoi(argv[2]);
+    int num_birds       = atoi(argv[3]);
+    int num_projectiles = atoi(argv[4]);
+    bool binary = false;
+    unsigned int seed = 1;
+    int num_lights = 0;
+
+    for (int i = 5; i < argc; ++i)
+    {
+        if ( strcmp(argv[i], "--binary") == 0 )
+            binary = true;
+        else if ( strcmp(argv[i], "--seed") == 0 && i + 1 < argc )
+            seed = (unsigned int)atoi(argv[++i]);
+        else if ( strcmp(argv[i], "--lights") == 0 && i + 1 < argc )
+            num_lights = atoi(argv[++i]);
+        else
+        {
+            fprintf(stderr, "ERROR: Unknown argument \"%s\".\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if ( num_platforms < 1 )
+        num_platforms = 1; // O personagem precisa de chão para começar
+
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+
+    SceneDescription scene;
+    scene.models.push_back("../../data/platform.obj");
+    scene.character_spawn = glm::vec3(0.0f);
+
+    // Grade de plataformas, em espiral a partir da origem para que a
+    // plataforma 0 fique sempre no centro.
+    std::vector<glm::vec3> platform_centers;
+    for (int ring = 0; (int)platform_centers.size() < num_platforms; ++ring)
+    {
+        for (int gz = -ring; gz <= ring && (int)platform_centers.size() < num_platforms; ++gz)
+        for (int gx = -ring; gx <= ring && (int)platform_centers.size() < num_platforms; ++gx)
+        {
+            if ( abs(gx) != ring && abs(gz) != ring )
+                continue; // Já inserida em um anel anterior
+
+            // Pequena variação de altura entre plataformas vizinhas
+            float height = (ring == 0) ? 0.0f : (uniform(rng) - 0.5f);
+            platform_centers.push_back(glm::vec3(gx*PLATFORM_SPACING, height, gz*PLATFORM_SPACING));
+        }
+    }
+
+    for (size_t i = 0; i < platform_centers.size(); ++i)
+    {
+        const glm::vec3& c = platform_centers[i];
+
+        // O topo do modelo está em y=1; o deslocamos para ficar em y=c.y.
+        SceneInstance instance;
+        instance.object = "platform";
+        instance.material = "platform";
+        instance.translation = glm::vec3(c.x, c.y - 1.0f, c.z);
+        instance.rotation_y = 0.0f;
+        instance.scale = glm::vec3(1.0f);
+        scene.instances.push_back(instance);
+
+        SceneCollider collider;
+        collider.bbox_min = glm::vec3(c.x - PLATFORM_HALF_SIZE, c.y - 2.0f, c.z - PLATFORM_HALF_SIZE);
+        collider.bbox_max = glm::vec3(c.x + PLATFORM_HALF_SIZE, c.y,        c.z + PLATFORM_HALF_SIZE);
+        scene.colliders.push_back(collider);
+    }
+
+    // Pássaros: caminhos circulares (8 pontos de controle) sobre plataformas sorteadas.
+    for (int i = 0; i < num_birds; ++i)
+    {
+        const glm::vec3& c = platform_centers[rng() % platform_centers.size()];
+        glm::vec3 center = c + glm::vec3((uniform(rng) - 0.5f) * 12.0f, 2.0f + uniform(rng) * 4.0f, (uniform(rng) - 0.5f) * 12.0f);
+        float radius = 2.0f + uniform(rng) * 4.0f;
+
+        std::vector<glm::vec4> path;
+        for (int k = 0; k < 8; ++k)
+        {
+            float angle = k * 3.141592f / 4.0f;
+            float height = center.y + (uniform(rng) - 0.5f);
+            path.push_back(glm::vec4(center.x + radius*cos(angle), height, center.z + radius*sin(angle), 1.0f));
+        }
+        scene.bird_paths.push_back(path);
+    }
+
+    // Projéteis: começam acima de plataformas sorteadas, com velocidade horizontal aleatória.
+    for (int i = 0; i < num_projectiles; ++i)
+    {
+        const glm::vec3& c = platform_centers[rng() % platform_centers.size()];
+
+        SceneProjectile projectile;
+        projectile.position = c + glm::vec3((uniform(rng) - 0.5f) * 18.0f, 5.0f + uniform(rng) * 15.0f, (uniform(rng) - 0.5f) * 18.0f);
+        projectile.velocity = glm::vec3((uniform(rng) - 0.5f) * 6.0f, 0.0f, (uniform(rng) - 0.5f) * 6.0f);
+        projectile.radius = 0.2f + uniform(rng) * 0.3f;
+        scene.projectiles.push_back(projectile);
+    }
+
+    // Luzes pontuais coloridas sobre plataformas sorteadas.
+    for (int i = 0; i < num_lights; ++i)
+    {
+        const glm::vec3& c = platform_centers[rng() % platform_centers.size()];
+
+        SceneLight light;
+        light.position = c + glm::vec3((uniform(rng) - 0.5f) * 18.0f, 0.5f + uniform(rng) * 1.5f, (uniform(rng) - 0.5f) * 18.0f);
+        light.color = glm::vec3(0.2f + uniform(rng), 0.2f + uniform(rng), 0.2f + uniform(rng));
+        light.radius = 3.0f + uniform(rng) * 5.0f;
+        light.direction = glm::vec3(0.0f, -1.0f, 0.0f);
+        light.spot_angle = 0.0f;
+        scene.lights.push_back(light);
+    }
+
+    if ( binary )
+        Scene_SaveBinary(filename, scene);
+    else
+        Scene_SaveText(filename, scene);
+
+    printf("Cena \"%s\" gerada (%s): %d plataformas, %d passaros, %d projeteis, %d luzes.\n",
+           filename, binary ? "binario" : "texto", (int)platform_centers.size(), num_birds, num_projectiles, num_lights);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,31 @@
+// Trecho comum dos shaders que desenham pássaros, incluído com
+// '#include "shader_bird_path.glsl"' (veja LoadShader() em "main.cpp").
+// Utiliza o samplerBuffer "bird_paths" declarado pelo shader que o inclui.
+
+// Matriz de modelagem de um objeto que percorre um caminho fechado de
+// Bézier: posiciona o objeto na curva e alinha seu eixo Z local com a
+// tangente, como prepareDrawBird() em "jogo.cpp" (que usa yaw/pitch; aqui a
+// base é montada diretamente a partir da tangente).
+mat4 BirdPathMatrix(int first_segment, int num_segments, float t)
+{
+    float remainder = mod(t, float(num_segments));
+    int segment = min(int(remainder), num_segments - 1);
+    float u = remainder - float(segment);
+
+    int base = 4 * (first_segment + segment);
+    vec3 p1 = texelFetch(bird_paths, base + 0).xyz;
+    vec3 p2 = texelFetch(bird_paths, base + 1).xyz;
+    vec3 p3 = texelFetch(bird_paths, base + 2).xyz;
+    vec3 p4 = texelFetch(bird_paths, base + 3).xyz;
+
+    float v = 1.0 - u;
+    vec3 position = v*v*v*p1 + 3.0*v*v*u*p2 + 3.0*v*u*u*p3 + u*u*u*p4;
+    vec3 tangent  = 3.0*v*v*(p2 - p1) + 6.0*v*u*(p3 - p2) + 3.0*u*u*(p4 - p3);
+
+    vec3 forward = normalize(tangent);
+    vec3 right = vec3(forward.z, 0.0, -forward.x);
+    right = (length(right) > 1e-6) ? normalize(right) : vec3(1.0, 0.0, 0.0);
+    vec3 up = cross(forward, right);
+
+    return mat4(vec4(right, 0.0), vec4(up, 0.0), vec4(forward, 0.0), vec4(position, 1.0));
+}
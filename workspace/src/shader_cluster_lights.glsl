@@ -0,0 +1,54 @@
+// Trecho comum dos shaders com iluminação, incluído com
+// '#include "shader_cluster_lights.glsl"' (veja LoadShader() em "main.cpp").
+// Utiliza os samplers "cluster_grid_lights", "cluster_light_indices" e
+// "cluster_lights" declarados pelo shader que o inclui e o bloco
+// FrameConstants.
+
+// Soma as contribuições das luzes do cluster que contém o ponto p, visto
+// na posição "pixel" da tela (gl_FragCoord.xy, no fragment shader), com
+// refletâncias Kd e Ks (Phong, expoente q).
+vec3 ClusterLights(vec2 pixel, vec4 p, vec4 n, vec4 v, vec3 Kd, vec3 Ks, float q)
+{
+    // Ladrilho da tela e fatia de profundidade (exponencial) do ponto
+    float depth = max(-(view * p).z, cluster_depth.x);
+    ivec3 cell = ivec3(pixel / cluster_depth.zw * cluster_grid.xy,
+                       log(depth / cluster_depth.x) * cluster_depth.y);
+    cell = clamp(cell, ivec3(0), ivec3(cluster_grid.xyz) - 1);
+    int cluster = (cell.z * int(cluster_grid.y) + cell.y) * int(cluster_grid.x) + cell.x;
+
+    uvec2 range = texelFetch(cluster_grid_lights, cluster).xy;
+
+    vec3 result = vec3(0.0);
+    for (uint i = 0u; i < range.y; ++i)
+    {
+        int light = int(texelFetch(cluster_light_indices, int(range.x + i)).x);
+        vec4 position_radius = texelFetch(cluster_lights, 3*light + 0);
+        vec4 color_cone      = texelFetch(cluster_lights, 3*light + 1);
+        vec3 spot_direction  = texelFetch(cluster_lights, 3*light + 2).xyz;
+
+        vec3 to_light = position_radius.xyz - p.xyz;
+        float d = length(to_light);
+        if ( d >= position_radius.w )
+            continue;
+        vec3 l = to_light / d;
+
+        // Atenuação com o inverso do quadrado da distância, levada
+        // suavemente a zero no raio da luz.
+        float x = d / position_radius.w;
+        float window = clamp(1.0 - x*x*x*x, 0.0, 1.0);
+        float attenuation = window * window / (d*d + 1.0);
+
+        // Cone do spot, com borda suave de 10% do cosseno
+        if ( color_cone.w > -1.0 )
+        {
+            float cos_angle = dot(-l, spot_direction);
+            attenuation *= smoothstep(color_cone.w, mix(color_cone.w, 1.0, 0.1), cos_angle);
+        }
+
+        float n_dot_l = max(0.0, dot(n.xyz, l));
+        vec3 r = -l + 2.0*n.xyz*n_dot_l;
+        vec3 I = color_cone.rgb * attenuation;
+        result += Kd * I * n_dot_l + Ks * I * pow(max(0.0, dot(r, v.xyz)), q);
+    }
+    return result;
+}
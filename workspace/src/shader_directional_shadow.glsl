@@ -0,0 +1,32 @@
+// Trecho comum dos shaders com iluminação, incluído com
+// '#include "shader_directional_shadow.glsl"' (veja LoadShader() em
+// "main.cpp"). Utiliza o sampler2DArrayShadow "shadow_map" declarado pelo
+// shader que o inclui e o bloco FrameConstants.
+
+// Fração (0 a 1) da luz direcional que chega ao ponto p, com normal n. A
+// cascata é escolhida pela profundidade do ponto; o ponto é deslocado na
+// direção da normal, proporcionalmente ao texel da cascata, para evitar
+// "acne" nas superfícies iluminadas. Quatro leituras com filtragem
+// bilinear da comparação cobrem uma vizinhança de 3x3 texels.
+float DirectionalShadow(vec4 p, vec4 n)
+{
+    if ( shadow_splits.w == 0.0 )
+        return 1.0;
+
+    float depth = -(view * p).z;
+    int cascade = (depth < shadow_splits.x) ? 0 : (depth < shadow_splits.y) ? 1 : (depth < shadow_splits.z) ? 2 : 3;
+    if ( cascade == 3 )
+        return 1.0;
+
+    vec4 s = shadow_matrices[cascade] * vec4(p.xyz + n.xyz * 1.5 * shadow_texel_sizes[cascade], 1.0);
+    if ( any(lessThan(s.xyz, vec3(0.0))) || any(greaterThan(s.xyz, vec3(1.0))) )
+        return 1.0;
+
+    vec2 texel = 1.0 / vec2(textureSize(shadow_map, 0).xy);
+    float lit = 0.0;
+    lit += texture(shadow_map, vec4(s.xy + vec2(-0.5, -0.5) * texel, float(cascade), s.z));
+    lit += texture(shadow_map, vec4(s.xy + vec2( 0.5, -0.5) * texel, float(cascade), s.z));
+    lit += texture(shadow_map, vec4(s.xy + vec2(-0.5,  0.5) * texel, float(cascade), s.z));
+    lit += texture(shadow_map, vec4(s.xy + vec2( 0.5,  0.5) * texel, float(cascade), s.z));
+    return lit / 4.0;
+}
@@ -13,59 +13,100 @@ in vec4 position_model;
 // Coordenadas de textura obtidas do arquivo OBJ (se existirem!)
 in vec2 texcoords;
 
-// Matrizes computadas no código C++ e enviadas para a GPU
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
-
-// Identificador que define qual objeto está sendo desenhado no momento
-#define SPHERE 0
-#define BOULDER  1
-#define PLATFORM  2
-#define BIRD  3
-#define CHARACTER 4
-#define MARIO_HAT 5
-#define MARIO_PANTS 6
-#define MARIO_FACE 7
-#define MARIO_EYE 8
-#define MARIO_GLOVE 9
-#define MARIO_CLOTHES 10
-#define MARIO_SHOES 11
-#define MARIO_HAIR 12
-
-
-uniform int object_id;
-
-// Parâmetros da axis-aligned bounding box (AABB) do modelo
-uniform vec4 bbox_min;
-uniform vec4 bbox_max;
-
-// Variáveis para acesso das imagens de textura
-
-// Mario Hat Texture
-uniform sampler2D TextureImage0;
+// Parâmetros por instância (veja "shader_vertex.glsl"); (1,1,1,0) fora de
+// desenhos instanciados.
+in vec4 params;
 
-// Mario Pants Texture
-uniform sampler2D TextureImage1;
+// Índice da parte (submesh) do modelo à qual o fragmento pertence.
+flat in int part;
 
-// Mario Face Texture
-uniform sampler2D TextureImage2;
+#ifdef MATERIAL_IMPOSTOR_FADE
+// Fração dos pixels cedida ao impostor (veja "shader_vertex.glsl").
+flat in float impostor_fade;
+#endif
 
-// Mario Eye
-uniform sampler2D TextureImage3;
-
-// Mario Gloves
-uniform sampler2D TextureImage4;
-
-// Mario Clothes
-uniform sampler2D TextureImage5;
+// Matriz de modelagem computada no código C++ e enviada para a GPU
+uniform mat4 model;
 
-// Mario Shoes
-uniform sampler2D TextureImage6;
+// Constantes do quadro, compartilhadas por todos os programas e atualizadas
+// uma vez por quadro (veja "frame_constants.cpp").
+layout (std140) uniform FrameConstants
+{
+    mat4  view;
+    mat4  projection;
+    mat4  view_projection;
+    vec4  camera_position;
+    vec4  light_direction;
+    vec4  cluster_grid;
+    vec4  cluster_depth;
+    mat4  shadow_matrices[3];
+    vec4  shadow_splits;
+    vec4  shadow_texel_sizes;
+    float time;
+};
+
+// Este shader é compilado em várias variantes, uma para cada combinação de
+// características de material (veja ShaderVariants_Get() em
+// "shader_variants.cpp" e LoadShadersFromFiles() em "main.cpp"). O código
+// C++ injeta, logo após a linha "#version", um "#define" de cada grupo:
+//
+//   Fonte da refletância difusa:
+//     MATERIAL_TEXTURE_NONE     cor constante MATERIAL_KD
+//     MATERIAL_TEXTURE_ARRAY    camada MATERIAL_ARRAY_LAYER de TextureImageMario
+//     MATERIAL_TEXTURE_TERRAIN  grama/terra/lateral escolhidas pela normal (plataformas)
+//     MATERIAL_TEXTURE_VOXEL    grama/terra escolhidas pelo tipo do bloco em texcoords.x
+//
+//   Coordenadas de textura (somente com MATERIAL_TEXTURE_ARRAY):
+//     MATERIAL_UV_TEXCOORDS     coordenadas do arquivo OBJ
+//     MATERIAL_UV_SPHERICAL     projeção esférica em coordenadas do modelo
+//     MATERIAL_UV_PLANAR_XY     projeção planar XY em coordenadas do modelo
+//
+//   Modelo de iluminação:
+//     MATERIAL_LIGHTING_LAMBERT difuso + pequeno termo constante
+//     MATERIAL_LIGHTING_PHONG   Phong com MATERIAL_KS e MATERIAL_Q
+//
+//   Opcional:
+//     MATERIAL_IMPOSTOR_FADE    transição para o impostor (veja "impostors.cpp")
+//
+// Somente as texturas utilizadas pela variante são declaradas.
+
+#if !defined(MATERIAL_TEXTURE_ARRAY) && !defined(MATERIAL_TEXTURE_TERRAIN) && !defined(MATERIAL_TEXTURE_VOXEL)
+#define MATERIAL_TEXTURE_NONE
+#endif
+#if !defined(MATERIAL_UV_SPHERICAL) && !defined(MATERIAL_UV_PLANAR_XY)
+#define MATERIAL_UV_TEXCOORDS
+#endif
+#if !defined(MATERIAL_LIGHTING_LAMBERT)
+#define MATERIAL_LIGHTING_PHONG
+#endif
+#ifndef MATERIAL_KD
+#define MATERIAL_KD vec3(0.08, 0.4, 0.8)
+#endif
+#ifndef MATERIAL_KS
+#define MATERIAL_KS vec3(0.8, 0.8, 0.8)
+#endif
+#ifndef MATERIAL_Q
+#define MATERIAL_Q 32.0
+#endif
+#ifndef MATERIAL_ARRAY_LAYER
+#define MATERIAL_ARRAY_LAYER 0.0
+#endif
+
+#ifdef MATERIAL_OBJECT_BOUNDS
+// Parâmetros da axis-aligned bounding box (AABB) do modelo, dos uniforms ou
+// dos vértices dos chunks do mundo (veja "shader_vertex.glsl").
+flat in vec4 object_bbox_min;
+flat in vec4 object_bbox_max;
+#endif
 
-// Mario Hair
-uniform sampler2D TextureImage7;
+// Variáveis para acesso das imagens de textura
+#if defined(MATERIAL_TEXTURE_ARRAY)
+// Texturas do Mario, uma camada por parte (submesh_0 a submesh_7: chapéu,
+// cabelo, luvas, olhos, calça, roupa, sapatos e rosto)
+uniform sampler2DArray TextureImageMario;
+#endif
 
+#if defined(MATERIAL_TEXTURE_TERRAIN) || defined(MATERIAL_TEXTURE_VOXEL)
 // Grass
 uniform sampler2D TextureImageGrass;
 
@@ -74,10 +115,19 @@ uniform sampler2D TextureImageGrassSide;
 
 // Dirt
 uniform sampler2D TextureImageDirt;
+#endif
 
-// Blue Bird 
-uniform sampler2D TextureImageBlueBird;
+// Luzes pontuais e spots da cena, agrupadas por cluster do frustum (veja
+// "clustered_lighting.cpp"): para cada cluster, o início e o número de
+// luzes em cluster_light_indices; para cada luz, três texels em
+// cluster_lights (posição e raio, cor e cosseno do cone, direção do spot).
+uniform usamplerBuffer cluster_grid_lights;
+uniform usamplerBuffer cluster_light_indices;
+uniform samplerBuffer  cluster_lights;
 
+// Mapas de sombra da luz direcional, uma camada por cascata (veja
+// "shadow_maps.cpp"), lidos com comparação de profundidade.
+uniform sampler2DArrayShadow shadow_map;
 
 // O valor de saída ("out") de um Fragment Shader é a cor final do fragmento.
 out vec4 color;
@@ -86,12 +136,19 @@ out vec4 color;
 #define M_PI   3.14159265358979323846
 #define M_PI_2 1.57079632679489661923
 
+#include "shader_directional_shadow.glsl"
+#include "shader_cluster_lights.glsl"
+
+#ifdef MATERIAL_IMPOSTOR_FADE
+#include "shader_impostor_dither.glsl"
+#endif
+
 void main()
 {
-    // Obtemos a posição da câmera utilizando a inversa da matriz que define o
-    // sistema de coordenadas da câmera.
-    vec4 origin = vec4(0.0, 0.0, 0.0, 1.0);
-    vec4 camera_position = inverse(view) * origin;
+#ifdef MATERIAL_IMPOSTOR_FADE
+    if ( ImpostorDither() < impostor_fade )
+        discard;
+#endif
 
     // O fragmento atual é coberto por um ponto que percente à superfície de um
     // dos objetos virtuais da cena. Este ponto, p, possui uma posição no
@@ -105,7 +162,7 @@ void main()
     vec4 n = normalize(normal);
 
     // Vetor que define o sentido da fonte de luz em relação ao ponto atual.
-    vec4 l = normalize(vec4(1.0,1.0,0.0,0.0));
+    vec4 l = light_direction;
 
     // Vetor que define o sentido da câmera em relação ao ponto atual.
     vec4 v = normalize(camera_position - p);
@@ -115,250 +172,134 @@ void main()
     vec4 r = -l + 2*n*n_dot_l;
     float r_dot_v = v.x * r.x + v.y * r.y + v.z * r.z;
 
-    // Coordenadas de textura U e V
-    float U = 0.0;
-    float V = 0.0;
-
     vec3 Kd; // Refletância difusa
-    vec3 Ks; // Refletância especular
-    vec3 Ka; // Refletância ambiente
-    float q; // Expoente especular para o modelo de iluminação de Phong
 
-    if ( object_id == SPHERE )
-    {
-        // PREENCHA AQUI as coordenadas de textura da esfera, computadas com
-        // projeção esférica EM COORDENADAS DO MODELO. Utilize como referência
-        // o slides 134-150 do documento Aula_20_Mapeamento_de_Texturas.pdf.
-        // A esfera que define a projeção deve estar centrada na posição
-        // "bbox_center" definida abaixo.
-
-        vec4 bbox_center = (bbox_min + bbox_max) / 2.0;
-
-        // COMO USEI LENGTH E O PORQUE DE VARIAVEIS OMISSAS:
-        // 
-        // p_linha = bbox_center + (ro * normalize(position_model - bbox_center));
-        // p_vec = p_linha - bbox_center;
-        //
-        // Equivale a:
-        // 
-        // p_vec = ro * normalize(position_model - bbox_center);
-        //
-        // E se temos ro = length(position_model - bbox_center);
-        // então:
-        //        ro * normalize(position_model - bbox_center)
-        //        =
-        //        position_model - bbox_center
-        //
-
-        float ro = length(position_model - bbox_center);
-
-        vec4 p_vec = position_model - bbox_center;
-
-        float theta = atan(p_vec.x, p_vec.z);    // ou x/z ?
-        float phi = asin(p_vec.y/ro);
-
-        U = (theta + M_PI) / (2 * M_PI);
-        V = (phi + M_PI_2) / M_PI;
-    }
-    else if ( object_id == BOULDER )
-    {
-        // PREENCHA AQUI as coordenadas de textura do coelho, computadas com
-        // projeção planar XY em COORDENADAS DO MODELO. Utilize como referência
-        // o slides 99-104 do documento Aula_20_Mapeamento_de_Texturas.pdf,
-        // e também use as variáveis min*/max* definidas abaixo para normalizar
-        // as coordenadas de textura U e V dentro do intervalo [0,1]. Para
-        // tanto, veja por exemplo o mapeamento da variável 'p_v' utilizando
-        // 'h' no slides 158-160 do documento Aula_20_Mapeamento_de_Texturas.pdf.
-        // Veja também a Questão 4 do Questionário 4 no Moodle.
-
-        float minx = bbox_min.x;
-        float maxx = bbox_max.x;
-
-        float miny = bbox_min.y;
-        float maxy = bbox_max.y;
-
-        float minz = bbox_min.z;
-        float maxz = bbox_max.z;
-
-        U = (position_model.x - minx) / (maxx - minx);
-        V = (position_model.y - miny) / (maxy - miny);
-    }
-    else if ( object_id == PLATFORM )
-    {
-
-     Kd = vec3(0.4, 0.9, 0.5);
-     Ks = vec3(0.4, 0.4, 0.4);
-     Ka = Kd/2;
-     q = 8.0;
-
-    }
-    else if ( object_id == BIRD )
+    // ------------------------------------------------------------------
+    // Coordenadas de textura U e V
+    // ------------------------------------------------------------------
+#if defined(MATERIAL_TEXTURE_ARRAY) && defined(MATERIAL_UV_SPHERICAL)
+    // Projeção esférica EM COORDENADAS DO MODELO, centrada no centro da
+    // AABB. Veja slides 134-150 do documento Aula_20_Mapeamento_de_Texturas.pdf.
+    // Como ro = length(position_model - bbox_center), o ponto projetado na
+    // esfera relativo ao centro é o próprio position_model - bbox_center.
+    vec4 bbox_center = (object_bbox_min + object_bbox_max) / 2.0;
+
+    float ro = length(position_model - bbox_center);
+
+    vec4 p_vec = position_model - bbox_center;
+
+    float theta = atan(p_vec.x, p_vec.z);
+    float phi = asin(p_vec.y/ro);
+
+    vec2 uv = vec2((theta + M_PI) / (2 * M_PI), (phi + M_PI_2) / M_PI);
+#elif defined(MATERIAL_TEXTURE_ARRAY) && defined(MATERIAL_UV_PLANAR_XY)
+    // Projeção planar XY em COORDENADAS DO MODELO, normalizada pela AABB.
+    // Veja slides 99-104 do documento Aula_20_Mapeamento_de_Texturas.pdf.
+    vec2 uv = vec2((position_model.x - object_bbox_min.x) / (object_bbox_max.x - object_bbox_min.x),
+                   (position_model.y - object_bbox_min.y) / (object_bbox_max.y - object_bbox_min.y));
+#else
+    vec2 uv = texcoords;
+#endif
+
+    // ------------------------------------------------------------------
+    // Refletância difusa
+    // ------------------------------------------------------------------
+#if defined(MATERIAL_TEXTURE_ARRAY)
+    // Para o personagem, MATERIAL_ARRAY_LAYER é o índice da parte, enviado
+    // como atributo de vértice (veja AddMultiDrawObject() em "main.cpp").
+    Kd = texture(TextureImageMario, vec3(uv, MATERIAL_ARRAY_LAYER)).rgb;
+
+#elif defined(MATERIAL_TEXTURE_TERRAIN)
+    vec4 abs_normal = abs(normal);
+
+    if (abs_normal.y >= abs_normal.x && abs_normal.y >= abs_normal.z)
     {
-        Kd = vec3(0.4, 0.4, 0.8);
-        Ks = vec3(0.8, 0.8, 0.8);
-        Ka = Kd/2;
-        q = 32.0;
+        if (normal.y > 0.0) {
+            // Face de Cima (Topo)
+            Kd = texture(TextureImageGrass, vec2(position_model.x, position_model.z)).rgb;
+        } else {
+            // Face de Baixo (Fundo)
+            Kd = texture(TextureImageDirt, vec2(position_model.x, position_model.z)).rgb;
+        }
     }
-
-    else if ( object_id == CHARACTER)
+    else
     {
-        Kd = vec3(0.4, 0.4, 0.8);
-        Ks = vec3(0.8, 0.8, 0.8);
-        Ka = Kd/2;
-        q = 32.0;
-    }
-    else {
-        Kd = vec3(0.08, 0.4, 0.8);
-        Ks = vec3(0.8, 0.8, 0.8);
-        Ka = Kd/2;
-        q = 32.0;
-    }
-
-
-    if(object_id == MARIO_HAT){
-        vec3 Kd_mario = texture(TextureImage0, texcoords).rgb;
-        // Equação de Iluminação
-        float lambert = max(0, n_dot_l);
-
-        color.rgb = Kd_mario * (lambert + 0.01);
-    }
-
-    else if(object_id == MARIO_PANTS){
-        vec3 Kd_mario = texture(TextureImage1, texcoords).rgb;
-        // Equação de Iluminação
-        float lambert = max(0, n_dot_l);
+        float miny = object_bbox_min.y + 1.0f;
+        float maxy = object_bbox_max.y + 1.0f;
 
-        color.rgb = Kd_mario * (lambert + 0.01);
-    }
-
-    else if(object_id == MARIO_FACE){
-        vec3 Kd_mario = texture(TextureImage2, texcoords).rgb;
-        // Equação de Iluminação
-        float lambert = max(0, n_dot_l);
-
-        color.rgb = Kd_mario * (lambert + 0.01);
-    }
-    
-    else if(object_id == MARIO_EYE){
-        vec3 Kd_mario = texture(TextureImage3, texcoords).rgb;
-        // Equação de Iluminação
-        float lambert = max(0, n_dot_l);
-
-        color.rgb = Kd_mario * (lambert + 0.01);
-    }
-
-    else if(object_id == MARIO_GLOVE){
-        vec3 Kd_mario = texture(TextureImage4, texcoords).rgb;
-        // Equação de Iluminação
-        float lambert = max(0, n_dot_l);
-
-        color.rgb = Kd_mario * (lambert + 0.01);
-    }
-
-    else if(object_id == MARIO_CLOTHES){
-        vec3 Kd_mario = texture(TextureImage5, texcoords).rgb;
-        // Equação de Iluminação
-        float lambert = max(0, n_dot_l);
-
-        color.rgb = Kd_mario * (lambert + 0.01);
-    }
+        float V = ((position_model.y - miny) / (maxy - miny));
 
-    else if(object_id == MARIO_SHOES){
-        vec3 Kd_mario = texture(TextureImage6, texcoords).rgb;
-        // Equação de Iluminação
-        float lambert = max(0, n_dot_l);
-
-        color.rgb = Kd_mario * (lambert + 0.01);
+        if (abs_normal.x >= abs_normal.z)
+            Kd = texture(TextureImageGrassSide, vec2(position_model.z, V)).rgb;
+        else
+            Kd = texture(TextureImageGrassSide, vec2(position_model.x, V)).rgb;
     }
 
-    else if(object_id == MARIO_HAIR){
-        vec3 Kd_mario = texture(TextureImage7, texcoords).rgb;
-        // Equação de Iluminação
-        float lambert = max(0, n_dot_l);
+#elif defined(MATERIAL_TEXTURE_VOXEL)
+    // Blocos do terreno em voxels (veja "voxel_world.cpp"). O tipo do bloco
+    // vem em texcoords.x: 1 = grama, 2 = terra. Cada bloco mede uma unidade,
+    // então usamos a parte fracionária de y nas laterais, mesmo em faces
+    // que unem vários blocos.
+    vec4 abs_normal = abs(normal);
+    bool grass_block = texcoords.x < 1.5;
 
-        color.rgb = Kd_mario * (lambert + 0.01);
+    if (abs_normal.y >= abs_normal.x && abs_normal.y >= abs_normal.z)
+    {
+        if (normal.y > 0.0 && grass_block)
+            Kd = texture(TextureImageGrass, vec2(position_model.x, position_model.z)).rgb;
+        else
+            Kd = texture(TextureImageDirt, vec2(position_model.x, position_model.z)).rgb;
     }
-
-    //else if(object_id == BIRD){
-    //    float lambert = max(0, n_dot_l);
-
-     //   color.rgb = texture(TextureImageBlueBird, texcoords).rgb;
-    //}
-
-    else if ( object_id == PLATFORM )
+    else
     {
+        float U_side = (abs_normal.x >= abs_normal.z) ? position_model.z : position_model.x;
+        vec2 side_uv = vec2(U_side, fract(position_model.y));
 
-    
-       vec4 abs_normal = abs(normal);
-       vec3 Kd_grass;
-       float lambert = max(0, n_dot_l);
-
-
-
-    
-       if (abs_normal.y >= abs_normal.x && abs_normal.y >= abs_normal.z) 
-        {
-            if (normal.y > 0.0) {
-                // Face de Cima (Topo)
-                Kd_grass = texture(TextureImageGrass, vec2(position_model.x, position_model.z)).rgb;
-            } else {
-                // Face de Baixo (Fundo)
-                Kd_grass =  texture(TextureImageDirt, vec2(position_model.x, position_model.z)).rgb;
-            }
-
-        }
-
-        else{
-            float miny = bbox_min.y + 1.0f;
-            float maxy = bbox_max.y + 1.0f;
-
-            V = ((position_model.y - miny) / (maxy - miny));
-
-            if (abs_normal.x >= abs_normal.z)
-            {
-                Kd_grass = texture(TextureImageGrassSide, vec2(position_model.z, V)).rgb;
-            }
-
-            else{
-                Kd_grass = texture(TextureImageGrassSide, vec2(position_model.x, V)).rgb;
-            }
-
-        
-       }
-
-            color.rgb = Kd_grass * (lambert + 0.01);
-
+        if (grass_block)
+            Kd = texture(TextureImageGrassSide, side_uv).rgb;
+        else
+            Kd = texture(TextureImageDirt, side_uv).rgb;
     }
 
-    else if (object_id < 2) {
-        // Obtemos a refletância difusa a partir da leitura da imagem TextureImage0
-        vec3 Kd0 = texture(TextureImage0, vec2(U,V)).rgb;
+#else
+    Kd = MATERIAL_KD;
+#endif
 
-        // Equação de Iluminação
-        float lambert = max(0, n_dot_l);
+    // Variação de cor por instância.
+    Kd *= params.rgb;
 
-        color.rgb = Kd0 * (lambert + 0.01);
-    } else {
-        // Espectro da fonte de iluminação
-        vec3 I = vec3(1.0,1.0,1.0); 
+    // ------------------------------------------------------------------
+    // Equação de iluminação
+    // ------------------------------------------------------------------
+#if defined(MATERIAL_LIGHTING_LAMBERT)
+    float lambert = max(0, n_dot_l) * DirectionalShadow(p, n);
 
-        // Termo difuso utilizando a lei dos cossenos de Lambert
-        vec3 lambert_diffuse_term = Kd * I * max(0.0, n_dot_l); 
+    color.rgb = Kd * (lambert + 0.01) + ClusterLights(gl_FragCoord.xy, p, n, v, Kd, vec3(0.0), 1.0);
+#else
+    vec3 Ks = MATERIAL_KS; // Refletância especular
+    vec3 Ka = Kd / 2;      // Refletância ambiente
+    float q = MATERIAL_Q;  // Expoente especular para o modelo de iluminação de Phong
 
-        // Espectro da luz ambiente
-        vec3 Ia = vec3(0.2, 0.2, 0.2); // PREENCHA AQUI o espectro da luz ambiente
+    // Espectro da fonte de iluminação, atenuado pela sombra
+    vec3 I = vec3(1.0,1.0,1.0) * DirectionalShadow(p, n);
 
-        // Termo ambiente
-        vec3 ambient_term = Ka * Ia; // PREENCHA AQUI o termo ambiente
+    // Termo difuso utilizando a lei dos cossenos de Lambert
+    vec3 lambert_diffuse_term = Kd * I * max(0.0, n_dot_l);
 
-        // Termo especular utilizando o modelo de iluminação de Phong
-        vec3 phong_specular_term  = Ks * I * pow(max(0.0, r_dot_v), q);
+    // Espectro da luz ambiente
+    vec3 Ia = vec3(0.2, 0.2, 0.2);
 
+    // Termo ambiente
+    vec3 ambient_term = Ka * Ia;
 
-        color.rgb = lambert_diffuse_term + ambient_term + phong_specular_term;
-    }
+    // Termo especular utilizando o modelo de iluminação de Phong
+    vec3 phong_specular_term  = Ks * I * pow(max(0.0, r_dot_v), q);
+
+    // Luzes pontuais e spots da cena
+    vec3 point_lights_term = ClusterLights(gl_FragCoord.xy, p, n, v, Kd, Ks, q);
 
-    
+    color.rgb = lambert_diffuse_term + ambient_term + phong_specular_term + point_lights_term;
+#endif
 
     // NOTE: Se você quiser fazer o rendering de objetos transparentes, é
     // necessário:
@@ -0,0 +1,8 @@
+#version 330 core
+
+// Programas que escrevem somente profundidade: mapas de sombra (veja
+// "shadow_maps.cpp") e o "depth prepass" da fila de renderização (veja
+// "render_queue.cpp"). A profundidade é escrita pelo próprio rasterizador.
+void main()
+{
+}
@@ -1,8 +1,26 @@
 #version 330 core
 
-in vec4 vertex_color; 
+// Cor computada por vértice em "shader_vertex_gouraud.glsl" e interpolada
+// pelo rasterizador.
+in vec4 vertex_color;
 out vec4 fragment_color;
 
+#ifdef MATERIAL_IMPOSTOR_FADE
+// Transição para o impostor (veja "shader_vertex.glsl").
+flat in float impostor_fade;
+
+#include "shader_impostor_dither.glsl"
+#endif
+
 void main() {
+#ifdef MATERIAL_IMPOSTOR_FADE
+    if ( ImpostorDither() < impostor_fade )
+        discard;
+#endif
+
     fragment_color = vertex_color;
+
+    // Cor final com correção gamma, considerando monitor sRGB (veja
+    // "shader_fragment.glsl").
+    fragment_color.rgb = pow(fragment_color.rgb, vec3(1.0,1.0,1.0)/2.2);
 }
\ No newline at end of file
@@ -0,0 +1,124 @@
+#version 330 core
+
+// Impostores dos pássaros distantes (veja "impostors.cpp" e
+// "shader_vertex_impostor.glsl").
+//
+// Com IMPOSTOR_BAKE, grava no atlas a refletância difusa do material e a
+// normal em coordenadas do modelo, ambas com alfa 1 onde o modelo cobre o
+// pixel. O fundo do atlas é (0,0,0,0), então, após a filtragem (bilinear e
+// mipmaps), os valores estão multiplicados pela cobertura e são recuperados
+// dividindo-se pelo alfa.
+//
+// Sem IMPOSTOR_BAKE, combina as quatro vistas escolhidas pelo vertex shader
+// e ilumina o resultado com o mesmo modelo de Phong dos pássaros em
+// "shader_fragment.glsl" (luz direcional e ambiente).
+
+#ifndef MATERIAL_KD
+#define MATERIAL_KD vec3(0.08, 0.4, 0.8)
+#endif
+#ifndef MATERIAL_KS
+#define MATERIAL_KS vec3(0.8, 0.8, 0.8)
+#endif
+#ifndef MATERIAL_Q
+#define MATERIAL_Q 32.0
+#endif
+
+#ifdef IMPOSTOR_BAKE
+
+in vec4 normal;
+
+layout (location = 0) out vec4 color;
+layout (location = 1) out vec4 normal_color;
+
+void main()
+{
+    // O modelo não é fechado: faces vistas por trás usam a normal invertida.
+    vec3 n = normalize(normal.xyz) * (gl_FrontFacing ? 1.0 : -1.0);
+
+    color = vec4(MATERIAL_KD, 1.0);
+    normal_color = vec4(n * 0.5 + 0.5, 1.0);
+}
+
+#else
+
+in vec4 position_world;
+in vec2 quad_uv;
+flat in vec4 impostor_cells[2];
+flat in vec4 impostor_weights;
+flat in mat3 object_to_world;
+flat in vec4 params;
+flat in float impostor_fade;
+
+// Constantes do quadro, compartilhadas por todos os programas e atualizadas
+// uma vez por quadro (veja "frame_constants.cpp").
+layout (std140) uniform FrameConstants
+{
+    mat4  view;
+    mat4  projection;
+    mat4  view_projection;
+    vec4  camera_position;
+    vec4  light_direction;
+    vec4  cluster_grid;
+    vec4  cluster_depth;
+    mat4  shadow_matrices[3];
+    vec4  shadow_splits;
+    vec4  shadow_texel_sizes;
+    float time;
+};
+
+// Atlas octaédrico: refletância difusa e normal de cada vista.
+uniform sampler2D impostor_color;
+uniform sampler2D impostor_normal;
+uniform float     impostor_grid;
+
+out vec4 color;
+
+#include "shader_impostor_dither.glsl"
+
+void main()
+{
+    // Transição para a malha: o impostor cobre a fração "impostor_fade" dos
+    // pixels, exatamente os que a malha descarta.
+    if ( ImpostorDither() >= impostor_fade )
+        discard;
+
+    vec2 cells[4] = vec2[4](impostor_cells[0].xy, impostor_cells[0].zw, impostor_cells[1].xy, impostor_cells[1].zw);
+
+    vec4 albedo = vec4(0.0);
+    vec4 packed_normal = vec4(0.0);
+    for (int i = 0; i < 4; ++i)
+    {
+        vec2 uv = (cells[i] + quad_uv) / impostor_grid;
+        albedo += impostor_weights[i] * texture(impostor_color, uv);
+        packed_normal += impostor_weights[i] * texture(impostor_normal, uv);
+    }
+
+    if ( albedo.a < 0.5 )
+        discard;
+
+    vec3 Kd = albedo.rgb / albedo.a * params.rgb;
+    vec4 n = vec4(normalize(object_to_world * (packed_normal.xyz / packed_normal.a * 2.0 - 1.0)), 0.0);
+
+    vec4 p = position_world;
+    vec4 l = light_direction;
+    vec4 v = normalize(camera_position - p);
+
+    float n_dot_l = dot(n,l);
+    vec4 r = -l + 2*n*n_dot_l;
+    float r_dot_v = max(0.0, dot(r.xyz, v.xyz));
+
+    vec3 Ks = MATERIAL_KS;
+    vec3 Ka = Kd / 2;
+    float q = MATERIAL_Q;
+
+    vec3 I = vec3(1.0,1.0,1.0);
+    vec3 Ia = vec3(0.2, 0.2, 0.2);
+
+    color.rgb = Kd * I * max(0.0, n_dot_l) + Ka * Ia + Ks * I * pow(r_dot_v, q);
+    color.a = 1;
+
+    // Cor final com correção gamma, considerando monitor sRGB.
+    color.rgb = pow(color.rgb, vec3(1.0,1.0,1.0)/2.2);
+}
+
+#endif
@@ -0,0 +1,11 @@
+#version 330 core
+
+// Fragment Shader (consultas de oclusão)
+// A escrita de cor e de profundidade fica desabilitada durante as consultas;
+// só nos interessa saber se algum fragmento passou no teste de profundidade.
+out vec4 color;
+
+void main()
+{
+    color = vec4(1.0, 0.0, 1.0, 1.0);
+}
@@ -0,0 +1,11 @@
+#version 330 core
+
+// Visualização do overdraw (veja "render_queue.cpp"): cada fragmento que
+// passa no teste de profundidade soma esta cor com blending aditivo. O
+// vermelho satura com 8 fragmentos por pixel e o verde com 16.
+out vec4 color;
+
+void main()
+{
+    color = vec4(1.0/8.0, 1.0/16.0, 1.0/32.0, 1.0);
+}
@@ -0,0 +1,23 @@
+#version 330 core
+
+// Partículas (veja "particles.cpp" e "shader_vertex_particle.glsl"). Cada
+// quadrilátero é um disco de bordas suaves. A cor é escrita multiplicada
+// pela opacidade (blending GL_ONE, GL_ONE_MINUS_SRC_ALPHA, veja
+// RENDER_PASS_BLENDED em "render_queue.cpp"); com alfa 0 a cor é somada à
+// da cena, o que ilumina as faíscas.
+
+in vec2 corner;
+in vec4 particle_color;
+flat in float additive;
+
+out vec4 color;
+
+void main()
+{
+    float coverage = 1.0 - smoothstep(0.4, 1.0, length(corner));
+    float alpha = particle_color.a * coverage;
+    if ( alpha <= 0.0 )
+        discard;
+
+    color = vec4(particle_color.rgb * alpha, alpha * (1.0 - additive));
+}
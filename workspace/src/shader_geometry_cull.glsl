@@ -0,0 +1,33 @@
+#version 330 core
+
+// Culling de instâncias na GPU (veja "gpu_culling.cpp" e
+// "shader_vertex_cull.glsl"). Emite somente as instâncias selecionadas pelo
+// vertex shader; o transform feedback grava as saídas abaixo, nesta ordem e
+// sem espaços entre elas, que é o layout de InstanceData em "main.cpp".
+
+layout (points) in;
+layout (points, max_vertices = 1) out;
+
+in mat4 vs_model[];
+in vec4 vs_params[];
+in vec4 vs_path[];
+in mat3 vs_normal_matrix[];
+flat in int vs_selected[];
+
+out mat4 cull_model;
+out vec4 cull_params;
+out vec4 cull_path;
+out mat3 cull_normal_matrix;
+
+void main()
+{
+    if ( vs_selected[0] == 0 )
+        return;
+
+    cull_model = vs_model[0];
+    cull_params = vs_params[0];
+    cull_path = vs_path[0];
+    cull_normal_matrix = vs_normal_matrix[0];
+    EmitVertex();
+    EndPrimitive();
+}
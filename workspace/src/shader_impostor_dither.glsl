@@ -0,0 +1,15 @@
+// Trecho comum dos fragment shaders com transição para impostores,
+// incluído com '#include "shader_impostor_dither.glsl"' (veja LoadShader()
+// em "main.cpp").
+
+// Limiar (0 a 1) do pixel atual em uma matriz de Bayer 4x4, utilizado na
+// transição entre a malha e o impostor: a malha descarta os pixels com
+// limiar abaixo de "impostor_fade" e o impostor (veja
+// "shader_fragment_impostor.glsl") os demais.
+float ImpostorDither()
+{
+    const float bayer[16] = float[16](0.0, 8.0, 2.0, 10.0, 12.0, 4.0, 14.0, 6.0,
+                                      3.0, 11.0, 1.0, 9.0, 15.0, 7.0, 13.0, 5.0);
+    ivec2 c = ivec2(gl_FragCoord.xy) & 3;
+    return (bayer[c.y * 4 + c.x] + 0.5) / 16.0;
+}
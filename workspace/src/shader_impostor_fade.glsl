@@ -0,0 +1,17 @@
+// Trecho comum dos vertex shaders com transição para impostores, incluído
+// com '#include "shader_impostor_fade.glsl"' (veja LoadShader() em
+// "main.cpp"). Utiliza o uniform "impostor_range" e "camera_position" (bloco
+// FrameConstants) declarados pelo shader que o inclui.
+
+// Fração (0 a 1) da transição da malha para o impostor de um pássaro na
+// posição p: a partir da distância impostor_range.x, ao longo de
+// impostor_range.y (veja "impostors.cpp"). Sem impostores, x é 0.
+float ImpostorFade(vec3 p)
+{
+    if ( impostor_range.x <= 0.0 )
+        return 0.0;
+    float d = distance(p, camera_position.xyz);
+    if ( impostor_range.y > 0.0 )
+        return clamp((d - impostor_range.x) / impostor_range.y, 0.0, 1.0);
+    return step(impostor_range.x, d);
+}
@@ -5,11 +5,71 @@
 layout (location = 0) in vec4 model_coefficients;
 layout (location = 1) in vec4 normal_coefficients;
 layout (location = 2) in vec2 texture_coefficients;
+// Posição no espaço do modelo. Igual a model_coefficients, exceto nas malhas
+// dos chunks do mundo, cujos vértices já estão em coordenadas globais.
+layout (location = 3) in vec4 model_space_coefficients;
 
-// Matrizes computadas no código C++ e enviadas para a GPU
+// Dados por instância, lidos somente em desenhos instanciados (veja
+// DrawVirtualObjectInstanced() em "main.cpp"): a matriz de modelagem ocupa
+// as localizações 4 a 7, a matriz de normais (computada na CPU por
+// SetInstanceModel()) as localizações 11 a 13, e "instance_params" carrega parâmetros livres
+// (atualmente, um fator multiplicado na refletância difusa). Se
+// "instance_path.y" for positivo, a instância percorre um caminho de Bézier
+// (veja BirdPathMatrix() em "shader_bird_path.glsl"): x é o primeiro
+// segmento, y o número de segmentos e z um deslocamento no tempo.
+layout (location = 4) in mat4 instance_model;
+layout (location = 8) in vec4 instance_params;
+layout (location = 9) in vec4 instance_path;
+layout (location = 11) in mat3 instance_normal_matrix;
+
+// Índice da parte (shape do arquivo ".obj") à qual o vértice pertence. Veja
+// BuildTrianglesAndAddToVirtualScene() em "main.cpp".
+layout (location = 10) in float part_index;
+
+#ifdef MATERIAL_OBJECT_BOUNDS
+// AABB do objeto no espaço do modelo, lida pelos materiais que projetam a
+// textura ou o terreno pela AABB (veja "shader_fragment.glsl"). As malhas
+// dos chunks do mundo juntam instâncias de objetos diferentes em um único
+// desenho, então cada vértice traz a AABB do seu objeto (veja
+// "world_streaming.cpp") e os uniforms chegam vazios (bbox_min == bbox_max).
+// Nos demais desenhos, a AABB vem dos uniforms e estes atributos não são lidos.
+layout (location = 14) in vec3 vertex_bbox_min;
+layout (location = 15) in vec3 vertex_bbox_max;
+uniform vec4 bbox_min;
+uniform vec4 bbox_max;
+#endif
+
+// Matriz de modelagem computada no código C++ e enviada para a GPU, junto
+// com as matrizes derivadas dela, computadas uma única vez por desenho (veja
+// RenderState_SetUniforms() em "render_queue.cpp"): a matriz de normais,
+// inverse(transpose(model)), e o produto view_projection * model.
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+uniform mat3 normal_matrix;
+uniform mat4 model_view_projection;
+
+// Constantes do quadro, compartilhadas por todos os programas e atualizadas
+// uma vez por quadro (veja "frame_constants.cpp").
+layout (std140) uniform FrameConstants
+{
+    mat4  view;
+    mat4  projection;
+    mat4  view_projection;
+    vec4  camera_position;
+    vec4  light_direction;
+    vec4  cluster_grid;
+    vec4  cluster_depth;
+    mat4  shadow_matrices[3];
+    vec4  shadow_splits;
+    vec4  shadow_texel_sizes;
+    float time;
+};
+
+// Se verdadeiro, a matriz de modelagem vem de "instance_model" em vez de "model".
+uniform bool instanced;
+
+// Pontos de controle dos caminhos dos pássaros, 4 texels por segmento (veja
+// UploadBirdPaths() em "jogo.cpp").
+uniform samplerBuffer bird_paths;
 
 // Atributos de vértice que serão gerados como saída ("out") pelo Vertex Shader.
 // ** Estes serão interpolados pelo rasterizador! ** gerando, assim, valores
@@ -19,6 +79,30 @@ out vec4 position_world;
 out vec4 position_model;
 out vec4 normal;
 out vec2 texcoords;
+out vec4 params;
+flat out int part;
+#ifdef MATERIAL_OBJECT_BOUNDS
+flat out vec4 object_bbox_min;
+flat out vec4 object_bbox_max;
+#endif
+
+#ifdef MATERIAL_IMPOSTOR_FADE
+// Pássaros que também têm impostor (veja "impostors.cpp"): fração dos
+// pixels que a malha cede ao impostor.
+uniform vec2 impostor_range;
+flat out float impostor_fade;
+#endif
+
+// Outros programas que desenham a mesma geometria (o "depth prepass" em
+// "render_queue.cpp", com GL_LEQUAL) precisam obter exatamente a mesma
+// profundidade.
+invariant gl_Position;
+
+#include "shader_bird_path.glsl"
+
+#ifdef MATERIAL_IMPOSTOR_FADE
+#include "shader_impostor_fade.glsl"
+#endif
 
 void main()
 {
@@ -34,7 +118,43 @@ void main()
     // deste Vertex Shader, a placa de vídeo (GPU) fará a divisão por W. Veja
     // slides 41-67 e 69-86 do documento Aula_09_Projecoes.pdf.
 
-    gl_Position = projection * view * model * model_coefficients;
+    mat4 M;
+    mat3 N; // Matriz de normais
+    if ( instanced )
+    {
+        M = instance_model;
+        N = instance_normal_matrix;
+        if ( instance_path.y > 0.0 )
+        {
+            // A matriz do caminho é uma rotação seguida de uma translação,
+            // então sua matriz de normais é a própria rotação.
+            mat4 path = BirdPathMatrix(int(instance_path.x), int(instance_path.y), 2.0*time + instance_path.z);
+            M = path * M;
+            N = mat3(path) * N;
+        }
+        gl_Position = view_projection * M * model_coefficients;
+    }
+    else
+    {
+        M = model;
+        N = normal_matrix;
+        gl_Position = model_view_projection * model_coefficients;
+    }
+    params = instanced ? instance_params : vec4(1.0, 1.0, 1.0, 0.0);
+
+#ifdef NORMAL_MATRIX_PER_VERTEX
+    // Caminho antigo, mantido somente para comparação em
+    // RunDerivedMatricesBenchmark() ("main.cpp"): inversa por vértice.
+    N = mat3(inverse(transpose(M)));
+    gl_Position = view_projection * M * model_coefficients;
+#endif
+
+#ifdef MATERIAL_IMPOSTOR_FADE
+    // Pássaro totalmente substituído pelo impostor: nada é desenhado.
+    impostor_fade = (instanced && instance_path.y > 0.0) ? ImpostorFade(M[3].xyz) : 0.0;
+    if ( impostor_fade >= 1.0 )
+        gl_Position = vec4(0.0, 0.0, 2.0, 1.0);
+#endif
 
     // Como as variáveis acima  (tipo vec4) são vetores com 4 coeficientes,
     // também é possível acessar e modificar cada coeficiente de maneira
@@ -51,17 +171,24 @@ void main()
     // rasterizador para gerar atributos únicos para cada fragmento gerado.
 
     // Posição do vértice atual no sistema de coordenadas global (World).
-    position_world = model * model_coefficients;
+    position_world = M * model_coefficients;
 
     // Posição do vértice atual no sistema de coordenadas local do modelo.
-    position_model = model_coefficients;
+    position_model = model_space_coefficients;
 
     // Normal do vértice atual no sistema de coordenadas global (World).
     // Veja slides 123-151 do documento Aula_07_Transformacoes_Geometricas_3D.pdf.
-    normal = inverse(transpose(model)) * normal_coefficients;
-    normal.w = 0.0;
+    normal = vec4(N * normal_coefficients.xyz, 0.0);
 
     // Coordenadas de textura obtidas do arquivo OBJ (se existirem!)
     texcoords = texture_coefficients;
+
+    part = int(part_index + 0.5);
+
+#ifdef MATERIAL_OBJECT_BOUNDS
+    bool vertex_bounds = (bbox_min.xyz == bbox_max.xyz);
+    object_bbox_min = vertex_bounds ? vec4(vertex_bbox_min, 1.0) : bbox_min;
+    object_bbox_max = vertex_bounds ? vec4(vertex_bbox_max, 1.0) : bbox_max;
+#endif
 }
 
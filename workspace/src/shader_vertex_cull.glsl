@@ -0,0 +1,116 @@
+#version 330 core
+
+// Culling e escolha de LOD das instâncias na GPU (veja "gpu_culling.cpp").
+//
+// Cada vértice é uma instância, com os atributos de InstanceData nas mesmas
+// localizações de "shader_vertex.glsl". O vertex shader posiciona a
+// instância (no caminho de Bézier, para os pássaros), testa a sua esfera
+// envolvente contra o frustum da câmera e decide se ela pertence ao LOD
+// gravado neste passo ("cull_lod"); o geometry shader
+// ("shader_geometry_cull.glsl") emite somente as instâncias selecionadas.
+
+layout (location = 4)  in mat4 instance_model;
+layout (location = 8)  in vec4 instance_params;
+layout (location = 9)  in vec4 instance_path;
+layout (location = 11) in mat3 instance_normal_matrix;
+
+// Constantes do quadro, compartilhadas por todos os programas e atualizadas
+// uma vez por quadro (veja "frame_constants.cpp").
+layout (std140) uniform FrameConstants
+{
+    mat4  view;
+    mat4  projection;
+    mat4  view_projection;
+    vec4  camera_position;
+    vec4  light_direction;
+    vec4  cluster_grid;
+    vec4  cluster_depth;
+    mat4  shadow_matrices[3];
+    vec4  shadow_splits;
+    vec4  shadow_texel_sizes;
+    float time;
+};
+
+// Pontos de controle dos caminhos dos pássaros (veja UploadBirdPaths() em
+// "jogo.cpp").
+uniform samplerBuffer bird_paths;
+
+// Distância de início e largura da transição para o impostor (veja
+// "impostors.cpp"); x = 0 desliga os impostores.
+uniform vec2 impostor_range;
+
+// Planos do frustum da câmera, não normalizados (veja
+// extract_frustum_planes() em "collisions.cpp").
+uniform vec4 frustum_planes[6];
+
+// Esfera envolvente do objeto: centro em coordenadas do modelo, raio em w.
+uniform vec4 cull_sphere;
+
+// LOD da iluminação (veja "lighting_lod.cpp"): fração mínima da altura da
+// tela para a iluminação por fragmento (0 desliga), elemento [1][1] da
+// matriz de projeção, e 1 se a projeção é perspectiva.
+uniform vec3 cull_lighting_lod;
+
+// LOD gravado neste passo: 0 = malha com iluminação por fragmento, 1 =
+// malha com iluminação por vértice, 2 = impostor (veja GpuCullingLod).
+uniform int cull_lod;
+
+out mat4 vs_model;
+out vec4 vs_params;
+out vec4 vs_path;
+out mat3 vs_normal_matrix;
+flat out int vs_selected;
+
+#include "shader_bird_path.glsl"
+
+#include "shader_impostor_fade.glsl"
+
+void main()
+{
+    vs_model = instance_model;
+    vs_params = instance_params;
+    vs_path = instance_path;
+    vs_normal_matrix = instance_normal_matrix;
+
+    mat4 M = instance_model;
+    if ( instance_path.y > 0.0 )
+        M = BirdPathMatrix(int(instance_path.x), int(instance_path.y), 2.0*time + instance_path.z) * M;
+
+    // Esfera envolvente em coordenadas globais
+    vec3 center = (M * vec4(cull_sphere.xyz, 1.0)).xyz;
+    float scale = max(length(M[0].xyz), max(length(M[1].xyz), length(M[2].xyz)));
+    float radius = cull_sphere.w * scale;
+
+    // A esfera está fora do frustum se está inteiramente do lado de fora de
+    // algum plano.
+    bool visible = true;
+    for (int i = 0; i < 6; ++i)
+    {
+        vec4 plane = frustum_planes[i];
+        if ( dot(plane.xyz, center) + plane.w < -radius * length(plane.xyz) )
+            visible = false;
+    }
+
+    // Malha e impostor, como nos shaders de desenho: a malha some quando a
+    // transição termina e o impostor só aparece depois que ela começa.
+    float fade = (instance_path.y > 0.0) ? ImpostorFade(M[3].xyz) : 0.0;
+
+    // Iluminação da malha pelo tamanho projetado da esfera, como em
+    // LightingLod_Select() (sem a histerese, que exigiria estado por
+    // instância).
+    float screen_size = radius * cull_lighting_lod.y;
+    if ( cull_lighting_lod.z > 0.0 )
+    {
+        float d = distance(center, camera_position.xyz);
+        screen_size = (d > radius) ? screen_size / d : 1.0;
+    }
+    int mesh_lod = (screen_size < cull_lighting_lod.x) ? 1 : 0;
+
+    bool selected;
+    if ( cull_lod == 2 )
+        selected = fade > 0.0;
+    else
+        selected = fade < 1.0 && cull_lod == mesh_lod;
+
+    vs_selected = (visible && selected) ? 1 : 0;
+}
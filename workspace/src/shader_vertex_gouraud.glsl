@@ -1,67 +1,162 @@
 #version 330 core
 
+// Iluminação por vértice (Gouraud), usada no lugar de "shader_vertex.glsl" e
+// "shader_fragment.glsl" para objetos pequenos na tela (veja
+// "lighting_lod.cpp"). As entradas são as mesmas de "shader_vertex.glsl";
+// o modelo de iluminação de Phong, com a sombra da luz direcional e as
+// luzes do cluster, é avaliado aqui, uma vez por vértice, e o rasterizador
+// interpola a cor resultante. Somente materiais de cor
+// constante (MATERIAL_TEXTURE_NONE) têm esta variante; MATERIAL_KD,
+// MATERIAL_KS e MATERIAL_Q são os mesmos #defines de "shader_fragment.glsl".
+
 // Atributos de vértice recebidos como entrada ("in") pelo Vertex Shader.
 // Veja a função BuildTrianglesAndAddToVirtualScene() em "main.cpp".
 layout (location = 0) in vec4 model_coefficients;
 layout (location = 1) in vec4 normal_coefficients;
-layout (location = 2) in vec2 texture_coefficients;
 
-// Matrizes computadas no código C++ e enviadas para a GPU
+// Dados por instância (veja "shader_vertex.glsl").
+layout (location = 4) in mat4 instance_model;
+layout (location = 8) in vec4 instance_params;
+layout (location = 9) in vec4 instance_path;
+layout (location = 11) in mat3 instance_normal_matrix;
+
+// Matriz de modelagem e matrizes derivadas, computadas no código C++.
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+uniform mat3 normal_matrix;
+uniform mat4 model_view_projection;
 
-// Atributos de vértice que serão gerados como saída ("out") pelo Vertex Shader.
-// ** Estes serão interpolados pelo rasterizador! ** gerando, assim, valores
-// para cada fragmento, os quais serão recebidos como entrada pelo Fragment
-// Shader. Veja o arquivo "shader_fragment.glsl".
-out vec4 fragment_color;
+// Constantes do quadro, compartilhadas por todos os programas e atualizadas
+// uma vez por quadro (veja "frame_constants.cpp").
+layout (std140) uniform FrameConstants
+{
+    mat4  view;
+    mat4  projection;
+    mat4  view_projection;
+    vec4  camera_position;
+    vec4  light_direction;
+    vec4  cluster_grid;
+    vec4  cluster_depth;
+    mat4  shadow_matrices[3];
+    vec4  shadow_splits;
+    vec4  shadow_texel_sizes;
+    float time;
+};
+
+// Se verdadeiro, a matriz de modelagem vem de "instance_model" em vez de "model".
+uniform bool instanced;
+
+// Pontos de controle dos caminhos dos pássaros (veja "shader_vertex.glsl").
+uniform samplerBuffer bird_paths;
+
+// Luzes do cluster e mapas de sombra (veja "shader_fragment.glsl").
+uniform usamplerBuffer cluster_grid_lights;
+uniform usamplerBuffer cluster_light_indices;
+uniform samplerBuffer  cluster_lights;
+uniform sampler2DArrayShadow shadow_map;
+
+#ifndef MATERIAL_KD
+#define MATERIAL_KD vec3(0.08, 0.4, 0.8)
+#endif
+#ifndef MATERIAL_KS
+#define MATERIAL_KS vec3(0.8, 0.8, 0.8)
+#endif
+#ifndef MATERIAL_Q
+#define MATERIAL_Q 32.0
+#endif
+
+// Cor do vértice, interpolada pelo rasterizador. Veja "shader_fragment_gouraud.glsl".
+out vec4 vertex_color;
+
+#ifdef MATERIAL_IMPOSTOR_FADE
+// Transição para o impostor (veja "shader_vertex.glsl").
+uniform vec2 impostor_range;
+flat out float impostor_fade;
+#endif
+
+// Outros programas que desenham a mesma geometria (o "depth prepass" em
+// "render_queue.cpp", com GL_LEQUAL) precisam obter exatamente a mesma
+// profundidade.
+invariant gl_Position;
+
+#include "shader_bird_path.glsl"
+#include "shader_directional_shadow.glsl"
+#include "shader_cluster_lights.glsl"
+
+#ifdef MATERIAL_IMPOSTOR_FADE
+#include "shader_impostor_fade.glsl"
+#endif
 
 void main()
 {
-    gl_Position = projection * view * model * model_coefficients;
-
-    // Posição do vértice atual no sistema de coordenadas global (World).
-    position_world = model * model_coefficients;
-
-    // Posição do vértice atual no sistema de coordenadas local do modelo.
-    position_model = model_coefficients;
-
-    // Normal do vértice atual no sistema de coordenadas global (World).
-    // Veja slides 123-151 do documento Aula_07_Transformacoes_Geometricas_3D.pdf.
-    normal = inverse(transpose(model)) * normal_coefficients;
-    normal.w = 0.0;
-
-    vec3 Kd; // Refletância difusa
-    vec3 Ks; // Refletância especular
-    vec3 Ka; // Refletância ambiente
-    float q; // Expoente especular para o modelo de iluminação de Phong
-
-
-    Kd = vec3(0.4, 0.9, 0.5);
-    Ks = vec3(0.4, 0.4, 0.4);
-    Ka = Kd/2;
-    q = 8.0;
-
-
-    // Espectro da fonte de iluminação
-    vec3 I = vec3(1.0,1.0,1.0); 
+    mat4 M;
+    mat3 N; // Matriz de normais
+    if ( instanced )
+    {
+        M = instance_model;
+        N = instance_normal_matrix;
+        if ( instance_path.y > 0.0 )
+        {
+            mat4 path = BirdPathMatrix(int(instance_path.x), int(instance_path.y), 2.0*time + instance_path.z);
+            M = path * M;
+            N = mat3(path) * N;
+        }
+        gl_Position = view_projection * M * model_coefficients;
+    }
+    else
+    {
+        M = model;
+        N = normal_matrix;
+        gl_Position = model_view_projection * model_coefficients;
+    }
+    vec4 params = instanced ? instance_params : vec4(1.0, 1.0, 1.0, 0.0);
+
+#ifdef MATERIAL_IMPOSTOR_FADE
+    impostor_fade = (instanced && instance_path.y > 0.0) ? ImpostorFade(M[3].xyz) : 0.0;
+    if ( impostor_fade >= 1.0 )
+        gl_Position = vec4(0.0, 0.0, 2.0, 1.0);
+#endif
+
+    // Posição e normal do vértice no sistema de coordenadas global (World).
+    vec4 p = M * model_coefficients;
+    vec4 n = vec4(normalize(N * normal_coefficients.xyz), 0.0);
+
+    // Vetor que define o sentido da fonte de luz em relação ao ponto atual.
+    vec4 l = light_direction;
+
+    // Vetor que define o sentido da câmera em relação ao ponto atual.
+    vec4 v = normalize(camera_position - p);
+
+    float n_dot_l = dot(n,l);
+
+    vec4 r = -l + 2*n*n_dot_l;
+    float r_dot_v = dot(r.xyz, v.xyz);
+
+    vec3 Kd = MATERIAL_KD * params.rgb; // Refletância difusa
+    vec3 Ks = MATERIAL_KS;              // Refletância especular
+    vec3 Ka = Kd / 2;                   // Refletância ambiente
+    float q = MATERIAL_Q;               // Expoente especular para o modelo de iluminação de Phong
+
+    // Espectro da fonte de iluminação, atenuado pela sombra
+    vec3 I = vec3(1.0,1.0,1.0) * DirectionalShadow(p, n);
 
     // Termo difuso utilizando a lei dos cossenos de Lambert
-    vec3 lambert_diffuse_term = Kd * I * max(0.0, n_dot_l); 
+    vec3 lambert_diffuse_term = Kd * I * max(0.0, n_dot_l);
 
     // Espectro da luz ambiente
-    vec3 Ia = vec3(0.2, 0.2, 0.2); // PREENCHA AQUI o espectro da luz ambiente
+    vec3 Ia = vec3(0.2, 0.2, 0.2);
 
     // Termo ambiente
-    vec3 ambient_term = Ka * Ia; // PREENCHA AQUI o termo ambiente
+    vec3 ambient_term = Ka * Ia;
 
     // Termo especular utilizando o modelo de iluminação de Phong
     vec3 phong_specular_term  = Ks * I * pow(max(0.0, r_dot_v), q);
 
-    fragment_color.rgb = lambert_diffuse_term + ambient_term + phong_specular_term;
-    fragment_color.a = 1;
-    fragment_color.rgb = pow(color.rgb, vec3(1.0,1.0,1.0)/2.2);
+    // Luzes pontuais e spots da cena, do cluster em que o vértice é
+    // projetado na tela.
+    vec2 pixel = (gl_Position.xy / max(gl_Position.w, 1e-6) * 0.5 + 0.5) * cluster_depth.zw;
+    vec3 point_lights_term = ClusterLights(pixel, p, n, v, Kd, Ks, q);
 
+    // A correção gamma é feita no fragment shader, após a interpolação.
+    vertex_color.rgb = lambert_diffuse_term + ambient_term + phong_specular_term + point_lights_term;
+    vertex_color.a = 1;
 }
-
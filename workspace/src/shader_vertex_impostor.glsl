@@ -0,0 +1,129 @@
+#version 330 core
+
+// Impostores dos pássaros distantes (veja "impostors.cpp").
+//
+// Com IMPOSTOR_BAKE, desenha o modelo do pássaro em uma célula do atlas
+// octaédrico: "model_view_projection" é a câmera ortográfica da célula e a
+// normal é passada em coordenadas do modelo.
+//
+// Sem IMPOSTOR_BAKE, cada instância é um quadrilátero voltado para a câmera,
+// com o tamanho da esfera envolvente do pássaro, colocado no caminho de
+// Bézier como o modelo em "shader_vertex.glsl". O vertex shader escolhe as
+// quatro vistas do atlas mais próximas da direção de observação (no sistema
+// de coordenadas do modelo) e os pesos da interpolação bilinear entre elas.
+
+layout (location = 0) in vec4 model_coefficients;
+layout (location = 1) in vec4 normal_coefficients;
+
+#ifdef IMPOSTOR_BAKE
+
+uniform mat4 model_view_projection;
+
+out vec4 normal;
+
+void main()
+{
+    gl_Position = model_view_projection * model_coefficients;
+    normal = vec4(normal_coefficients.xyz, 0.0);
+}
+
+#else
+
+// Dados por instância (veja DrawVirtualObjectInstanced() em "main.cpp")
+layout (location = 4) in mat4 instance_model;
+layout (location = 8) in vec4 instance_params;
+layout (location = 9) in vec4 instance_path;
+
+// Constantes do quadro, compartilhadas por todos os programas e atualizadas
+// uma vez por quadro (veja "frame_constants.cpp").
+layout (std140) uniform FrameConstants
+{
+    mat4  view;
+    mat4  projection;
+    mat4  view_projection;
+    vec4  camera_position;
+    vec4  light_direction;
+    vec4  cluster_grid;
+    vec4  cluster_depth;
+    mat4  shadow_matrices[3];
+    vec4  shadow_splits;
+    vec4  shadow_texel_sizes;
+    float time;
+};
+
+// Pontos de controle dos caminhos dos pássaros (veja UploadBirdPaths() em
+// "jogo.cpp").
+uniform samplerBuffer bird_paths;
+
+// Esfera envolvente do modelo (centro em coordenadas do modelo, raio em w),
+// número de vistas em cada eixo do atlas, e distância de início e largura
+// da transição entre a malha e o impostor.
+uniform vec4  impostor_sphere;
+uniform float impostor_grid;
+uniform vec2  impostor_range;
+
+out vec4 position_world;
+out vec2 quad_uv;                 // Posição no quadrilátero, [0,1]²
+flat out vec4 impostor_cells[2];  // Origem, em células, das quatro vistas (duas por vec4)
+flat out vec4 impostor_weights;   // Peso de cada vista
+flat out mat3 object_to_world;    // Rotação do modelo, para as normais do atlas
+flat out vec4 params;
+flat out float impostor_fade;
+
+#include "shader_bird_path.glsl"
+
+#include "shader_impostor_fade.glsl"
+
+vec2 SignNotZero(vec2 v)
+{
+    return vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+// Coordenadas octaédricas ([-1,1]²) de uma direção; inversa de
+// Impostors_OctahedralDecode() em "impostors.cpp".
+vec2 OctahedralEncode(vec3 d)
+{
+    d /= abs(d.x) + abs(d.y) + abs(d.z);
+    return (d.y >= 0.0) ? d.xz : (1.0 - abs(d.zx)) * SignNotZero(d.xz);
+}
+
+void main()
+{
+    mat4 M = instance_model;
+    if ( instance_path.y > 0.0 )
+        M = BirdPathMatrix(int(instance_path.x), int(instance_path.y), 2.0*time + instance_path.z) * M;
+
+    params = instance_params;
+    object_to_world = mat3(M);
+    impostor_fade = ImpostorFade(M[3].xyz);
+
+    // Direção da câmera no sistema de coordenadas do modelo. A matriz é uma
+    // rotação seguida de uma translação, então a inversa da parte 3x3 é a
+    // transposta.
+    vec4 center = M * vec4(impostor_sphere.xyz, 1.0);
+    vec3 to_camera = normalize(transpose(object_to_world) * (camera_position.xyz - center.xyz));
+
+    // Base do quadrilátero, montada como em Impostors_Bake() (e em
+    // Matrix_Camera_View()), para que as vistas do atlas fiquem alinhadas.
+    vec3 up_reference = (abs(to_camera.y) > 0.99) ? vec3(0.0, 0.0, 1.0) : vec3(0.0, 1.0, 0.0);
+    vec3 right = normalize(cross(up_reference, to_camera));
+    vec3 up = cross(to_camera, right);
+
+    vec3 offset = (right * model_coefficients.x + up * model_coefficients.y) * impostor_sphere.w;
+    position_world = center + vec4(object_to_world * offset, 0.0);
+    quad_uv = model_coefficients.xy * 0.5 + 0.5;
+
+    // Impostor totalmente substituído pela malha: nada é desenhado.
+    gl_Position = (impostor_fade > 0.0) ? view_projection * position_world : vec4(0.0, 0.0, 2.0, 1.0);
+
+    // Quatro células vizinhas na grade de vistas e pesos bilineares.
+    vec2 grid = (OctahedralEncode(to_camera) * 0.5 + 0.5) * impostor_grid - 0.5;
+    vec2 base = floor(grid);
+    vec2 f = grid - base;
+    vec2 last = vec2(impostor_grid - 1.0);
+    impostor_cells[0] = vec4(clamp(base, vec2(0.0), last), clamp(base + vec2(1.0, 0.0), vec2(0.0), last));
+    impostor_cells[1] = vec4(clamp(base + vec2(0.0, 1.0), vec2(0.0), last), clamp(base + vec2(1.0, 1.0), vec2(0.0), last));
+    impostor_weights = vec4((1.0 - f.x) * (1.0 - f.y), f.x * (1.0 - f.y), (1.0 - f.x) * f.y, f.x * f.y);
+}
+
+#endif
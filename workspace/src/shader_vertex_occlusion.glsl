@@ -0,0 +1,31 @@
+#version 330 core
+
+// Vertex Shader (consultas de oclusão)
+// Recebe os vértices de um cubo unitário [0,1]^3 e os posiciona sobre a AABB
+// (em coordenadas globais) do objeto sendo testado.
+layout (location = 0) in vec4 model_coefficients;
+
+// Constantes do quadro, compartilhadas por todos os programas e atualizadas
+// uma vez por quadro (veja "frame_constants.cpp").
+layout (std140) uniform FrameConstants
+{
+    mat4  view;
+    mat4  projection;
+    mat4  view_projection;
+    vec4  camera_position;
+    vec4  light_direction;
+    vec4  cluster_grid;
+    vec4  cluster_depth;
+    mat4  shadow_matrices[3];
+    vec4  shadow_splits;
+    vec4  shadow_texel_sizes;
+    float time;
+};
+uniform vec4 bbox_min;
+uniform vec4 bbox_max;
+
+void main()
+{
+    vec3 p = mix(bbox_min.xyz, bbox_max.xyz, model_coefficients.xyz);
+    gl_Position = view_projection * vec4(p, 1.0);
+}
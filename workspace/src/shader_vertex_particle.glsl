@@ -0,0 +1,72 @@
+#version 330 core
+
+// Desenho das partículas (veja "particles.cpp"). Cada instância é uma
+// partícula do buffer escrito pela simulação
+// ("shader_vertex_particle_update.glsl") e cada um dos quatro vértices um
+// canto de um quadrilátero voltado para a câmera (GL_TRIANGLE_STRIP, sem
+// buffer de vértices). Partículas mortas são colocadas fora do volume de
+// visualização e descartadas antes da rasterização.
+
+layout (location = 0) in vec4 position_age;  // xyz = posição, w = idade (s)
+layout (location = 1) in vec4 velocity_life; // xyz = velocidade, w = tempo de vida (s)
+layout (location = 2) in vec4 particle_info; // x = altura do chão, y = tamanho, z = tipo, w = valor aleatório
+
+// Constantes do quadro, compartilhadas por todos os programas e atualizadas
+// uma vez por quadro (veja "frame_constants.cpp").
+layout (std140) uniform FrameConstants
+{
+    mat4  view;
+    mat4  projection;
+    mat4  view_projection;
+    vec4  camera_position;
+    vec4  light_direction;
+    vec4  cluster_grid;
+    vec4  cluster_depth;
+    mat4  shadow_matrices[3];
+    vec4  shadow_splits;
+    vec4  shadow_texel_sizes;
+    float time;
+};
+
+out vec2 corner;
+out vec4 particle_color; // rgb = cor, a = opacidade
+flat out float additive; // 1 = soma à cor da cena (faíscas)
+
+// Cor, opacidade inicial e crescimento de cada ParticleKind: poeira,
+// rastro e faíscas. As cores já estão em sRGB.
+const vec4 colors[3] = vec4[3](vec4(0.60, 0.50, 0.38, 0.25),
+                               vec4(0.85, 0.88, 0.95, 0.15),
+                               vec4(1.00, 0.62, 0.25, 0.1));
+const float growth[3] = float[3](2.0, 1.0, -0.6);
+
+void main()
+{
+    float age = position_age.w;
+    float lifetime = velocity_life.w;
+    if ( age >= lifetime )
+    {
+        gl_Position = vec4(0.0, 0.0, 2.0, 1.0);
+        corner = vec2(0.0);
+        particle_color = vec4(0.0);
+        additive = 0.0;
+        return;
+    }
+
+    int kind = int(particle_info.z);
+    float t = age / lifetime;
+
+    const vec2 corners[4] = vec2[4](vec2(-1.0, -1.0), vec2(1.0, -1.0), vec2(-1.0, 1.0), vec2(1.0, 1.0));
+    corner = corners[gl_VertexID];
+
+    // Eixos da câmera em coordenadas globais: as linhas da rotação de "view".
+    vec3 right = vec3(view[0][0], view[1][0], view[2][0]);
+    vec3 up = vec3(view[0][1], view[1][1], view[2][1]);
+
+    float size = particle_info.y * (1.0 + growth[kind] * t);
+    vec3 p = position_age.xyz + size * (corner.x * right + corner.y * up);
+    gl_Position = view_projection * vec4(p, 1.0);
+
+    vec4 color = colors[kind];
+    particle_color = vec4(color.rgb * mix(0.8, 1.2, particle_info.w), color.a * (1.0 - t));
+    additive = (kind == 2) ? 1.0 : 0.0;
+}
@@ -0,0 +1,107 @@
+#version 330 core
+
+// Simulação das partículas (veja "particles.cpp").
+//
+// Cada vértice é uma partícula do anel, lida do buffer do quadro anterior e
+// gravada, por transform feedback, no outro buffer. Partículas no trecho de
+// um emissor deste quadro renascem na região do emissor; as demais, se
+// vivas, caem com a gravidade do jogo, perdem velocidade com o arrasto do
+// seu tipo e quicam no plano do chão guardado na própria partícula.
+// PARTICLE_MAX_EMITTERS é definido por Particles_Init().
+
+layout (location = 0) in vec4 position_age;  // xyz = posição, w = idade (s)
+layout (location = 1) in vec4 velocity_life; // xyz = velocidade, w = tempo de vida (s)
+layout (location = 2) in vec4 particle_info; // x = altura do chão, y = tamanho, z = tipo, w = valor aleatório
+
+uniform float delta_time;
+uniform float gravity;
+
+// Emissores do quadro (veja Particles_Emit())
+uniform int   emitter_count;
+uniform ivec4 emitter_ranges[PARTICLE_MAX_EMITTERS];     // x = primeira partícula, y = número, z = tipo, w = semente
+uniform vec4  emitter_origins[PARTICLE_MAX_EMITTERS];    // xyz = posição, w = raio da região de emissão
+uniform vec4  emitter_motions[PARTICLE_MAX_EMITTERS];    // xyz = deslocamento do emissor no quadro, w = altura do chão
+uniform vec4  emitter_velocities[PARTICLE_MAX_EMITTERS]; // xyz = velocidade média, w = variação aleatória
+uniform vec4  emitter_params[PARTICLE_MAX_EMITTERS];     // x = tempo de vida, y = tamanho, z = fração vertical da variação
+
+out vec4 out_position_age;
+out vec4 out_velocity_life;
+out vec4 out_info;
+
+// Arrasto do ar (1/s) de cada ParticleKind: poeira, rastro e faíscas.
+const float drag[3] = float[3](2.5, 1.5, 0.3);
+
+// Perda de velocidade ao quicar no chão
+const float restitution = 0.3;
+const float friction = 0.6;
+
+// Número pseudoaleatório em [0,1) a partir de um inteiro.
+float Random(uint n)
+{
+    n = (n << 13U) ^ n;
+    n = n * (n * n * 15731U + 789221U) + 1376312589U;
+    return float(n & 0x7fffffffU) / float(0x7fffffff);
+}
+
+void main()
+{
+    int id = gl_VertexID;
+
+    for (int e = 0; e < emitter_count; ++e)
+    {
+        ivec4 range = emitter_ranges[e];
+        if ( id < range.x || id >= range.x + range.y )
+            continue;
+
+        uint seed = uint(id) * 4U + uint(range.w) * 2654435761U;
+        float r0 = Random(seed);
+        float r1 = Random(seed + 1U);
+        float r2 = Random(seed + 2U);
+        float r3 = Random(seed + 3U);
+
+        // Direção aleatória no hemisfério superior, achatada para os lados
+        // conforme a fração vertical do emissor.
+        float angle = 6.2831853 * r0;
+        float up = mix(0.2, 1.0, r1) * emitter_params[e].z;
+        vec3 direction = normalize(vec3(cos(angle), up, sin(angle)));
+
+        // Posição ao longo do deslocamento do emissor no quadro, para que
+        // um emissor em movimento deixe um rastro contínuo.
+        float u = (float(id - range.x) + 0.5) / float(range.y);
+        vec3 origin = emitter_origins[e].xyz + u * emitter_motions[e].xyz
+                    + emitter_origins[e].w * sqrt(r2) * vec3(direction.x, 0.0, direction.z);
+
+        float speed = emitter_velocities[e].w * mix(0.3, 1.0, r3);
+        float lifetime = emitter_params[e].x * mix(0.5, 1.0, r2);
+
+        out_position_age = vec4(origin, 0.0);
+        out_velocity_life = vec4(emitter_velocities[e].xyz + speed * direction, lifetime);
+        out_info = vec4(emitter_motions[e].w, emitter_params[e].y, float(range.z), r1);
+        return;
+    }
+
+    out_info = particle_info;
+    if ( position_age.w >= velocity_life.w )
+    {
+        // Partícula morta: permanece como está até ser reemitida.
+        out_position_age = position_age;
+        out_velocity_life = velocity_life;
+        return;
+    }
+
+    vec3 velocity = velocity_life.xyz;
+    velocity.y += gravity * delta_time;
+    velocity *= exp(-drag[int(particle_info.z)] * delta_time);
+    vec3 position = position_age.xyz + velocity * delta_time;
+
+    float ground = particle_info.x;
+    if ( position.y < ground && velocity.y < 0.0 )
+    {
+        position.y = ground;
+        velocity.y = -velocity.y * restitution;
+        velocity.xz *= friction;
+    }
+
+    out_position_age = vec4(position, position_age.w + delta_time);
+    out_velocity_life = vec4(velocity, velocity_life.w);
+}
@@ -0,0 +1,53 @@
+#version 330 core
+
+// Desenho dos mapas de sombra (veja "shadow_maps.cpp"): somente a posição
+// de cada vértice, projetada pela matriz da cascata sendo desenhada. As
+// entradas são as mesmas de "shader_vertex.glsl".
+layout (location = 0) in vec4 model_coefficients;
+
+// Dados por instância (veja "shader_vertex.glsl").
+layout (location = 4) in mat4 instance_model;
+layout (location = 9) in vec4 instance_path;
+
+// Matriz de modelagem e matriz view_projection da fonte de luz para a
+// cascata atual, computadas no código C++.
+uniform mat4 model;
+uniform mat4 light_view_projection;
+
+// Constantes do quadro, compartilhadas por todos os programas e atualizadas
+// uma vez por quadro (veja "frame_constants.cpp").
+layout (std140) uniform FrameConstants
+{
+    mat4  view;
+    mat4  projection;
+    mat4  view_projection;
+    vec4  camera_position;
+    vec4  light_direction;
+    vec4  cluster_grid;
+    vec4  cluster_depth;
+    mat4  shadow_matrices[3];
+    vec4  shadow_splits;
+    vec4  shadow_texel_sizes;
+    float time;
+};
+
+// Se verdadeiro, a matriz de modelagem vem de "instance_model" em vez de "model".
+uniform bool instanced;
+
+// Pontos de controle dos caminhos dos pássaros (veja "shader_vertex.glsl").
+uniform samplerBuffer bird_paths;
+
+#include "shader_bird_path.glsl"
+
+void main()
+{
+    mat4 M = model;
+    if ( instanced )
+    {
+        M = instance_model;
+        if ( instance_path.y > 0.0 )
+            M = BirdPathMatrix(int(instance_path.x), int(instance_path.y), 2.0*time + instance_path.z) * M;
+    }
+
+    gl_Position = light_view_projection * M * model_coefficients;
+}
@@ -2,8 +2,22 @@
 
 
 // Vertex Shader (Skybox)
-uniform mat4 view;      // Deve ser a matriz View SEM translação
-uniform mat4 projection;
+// Constantes do quadro, compartilhadas por todos os programas e atualizadas
+// uma vez por quadro (veja "frame_constants.cpp").
+layout (std140) uniform FrameConstants
+{
+    mat4  view;
+    mat4  projection;
+    mat4  view_projection;
+    vec4  camera_position;
+    vec4  light_direction;
+    vec4  cluster_grid;
+    vec4  cluster_depth;
+    mat4  shadow_matrices[3];
+    vec4  shadow_splits;
+    vec4  shadow_texel_sizes;
+    float time;
+};
 layout (location = 0) in vec3 position;
 out vec3 tex_coords;
 
@@ -11,7 +25,7 @@ void main()
 {
     tex_coords = position;
     // O W deve ser ajustado para garantir que a profundidade seja a máxima (fundo).
-    // Usamos a view sem translação.
-    vec4 pos = projection * view * vec4(position, 1.0);
+    // Usamos a view sem translação (somente a parte de rotação).
+    vec4 pos = projection * mat4(mat3(view)) * vec4(position, 1.0);
     gl_Position = pos.xyww; // Garante que z = w (profundidade máxima)
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 // Based on http://hamelot.io/visualization/opengl-text-without-any-external-libraries/
 //   and on https://github.com/rougier/freetype-gl
 #include <string>
+#include <vector>
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
@@ -12,6 +13,7 @@
 #include "dejavufont.h"
 
 GLuint CreateGpuProgram(GLuint vertex_shader_id, GLuint fragment_shader_id); // Função definida em main.cpp
+GLuint StreamBuffer_Write(const void* data, GLsizeiptr size, GLsizeiptr alignment, GLintptr* offset); // Função definida em stream_buffer.cpp
 
 const GLchar* const textvertexshader_source = ""
 "#version 330\n"
@@ -152,6 +154,13 @@ void TextRendering_PrintString(GLFWwindow* window, const std::string &str, float
     float sx = scale / width;
     float sy = scale / height;
 
+    // Os quadriláteros de todos os caracteres são escritos de uma vez no
+    // buffer de streaming (veja "stream_buffer.cpp") e desenhados com uma
+    // única chamada.
+    struct TextVertex {float x, y, s, t;};
+    static std::vector<TextVertex> vertices;
+    vertices.clear();
+
     for (size_t i = 0; i < str.size(); i++)
     {
         // Find the glyph for the character we are looking for
@@ -178,7 +187,7 @@ void TextRendering_PrintString(GLFWwindow* window, const std::string &str, float
         float s1 = glyph->s1 - 0.5f/dejavufont.tex_width;
         float t1 = glyph->t1 - 0.5f/dejavufont.tex_height;
 
-        struct {float x, y, s, t;} data[6] = {
+        TextVertex data[6] = {
             { x0, y0, s0, t0 },
             { x0, y1, s0, t1 },
             { x1, y1, s1, t1 },
@@ -186,29 +195,44 @@ void TextRendering_PrintString(GLFWwindow* window, const std::string &str, float
             { x1, y1, s1, t1 },
             { x1, y0, s1, t0 }
         };
+        vertices.insert(vertices.end(), data, data + 6);
+
+        x += (glyph->advance_x * sx);
+    }
 
-        glEnable(GL_BLEND);
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    if ( vertices.empty() )
+        return;
 
-        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-        glDepthFunc(GL_ALWAYS);
+    // Sem espaço no buffer de streaming, usamos o buffer próprio do texto.
+    GLsizeiptr size = vertices.size() * sizeof(TextVertex);
+    GLintptr offset = 0;
+    GLuint buffer_id = StreamBuffer_Write(vertices.data(), size, sizeof(TextVertex), &offset);
+    glBindVertexArray(textVAO);
+    if ( buffer_id == 0 )
+    {
+        buffer_id = textVBO;
         glBindBuffer(GL_ARRAY_BUFFER, textVBO);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, 24 * sizeof(float), data);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glBufferData(GL_ARRAY_BUFFER, size, vertices.data(), GL_STREAM_DRAW);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, buffer_id);
+    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 0, (void*)offset);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-        glUseProgram(textprogram_id);
-        glBindVertexArray(textVAO);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-        glDrawArrays(GL_TRIANGLES, 0, 6);
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    glDepthFunc(GL_ALWAYS);
 
-        glBindVertexArray(0);
-        glUseProgram(0);
-        glDepthFunc(GL_LESS);
+    glUseProgram(textprogram_id);
 
-        glDisable(GL_BLEND);
+    glDrawArrays(GL_TRIANGLES, 0, (GLsizei)vertices.size());
 
-        x += (glyph->advance_x * sx);
-    }
+    glBindVertexArray(0);
+    glUseProgram(0);
+    glDepthFunc(GL_LESS);
+
+    glDisable(GL_BLEND);
 }
 
 float TextRendering_LineHeight(GLFWwindow* window)